@@ -0,0 +1,93 @@
+// Save as "InSituAnalysis.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include <vector>
+#include "InSituAnalysis.h"  // Generated
+
+#include "AnalysisKernels.hpp"
+#include "MacroCells.hpp"
+#include "BrickPyramid.hpp"
+#include "BrickPublisher.hpp"
+
+// number of elements of the given type in a direct buffer, 0 (with data == NULL) if the buffer is not direct
+static size_t elements(JNIEnv *env, jobject buffer, int dtype, const void **data)
+{
+	*data = env->GetDirectBufferAddress(buffer);
+	size_t elsize = dtype_size(dtype);
+	if (*data == NULL || elsize == 0)
+		return 0;
+	return (size_t) env->GetDirectBufferCapacity(buffer) / elsize;
+}
+
+JNIEXPORT jdoubleArray JNICALL Java_graphics_scenery_insitu_InSituAnalysis_stats(JNIEnv *env, jobject thisObj, jobject buffer, jint dtype, jint numThreads) {
+	const void *data;
+	size_t n = elements(env, buffer, dtype, &data);
+
+	FieldStats st = field_stats(data, dtype, n, numThreads);
+
+	jdouble res[] = {st.min, st.max, st.mean, st.var, (jdouble) st.count};
+	jdoubleArray arr = env->NewDoubleArray(5);
+	env->SetDoubleArrayRegion(arr, 0, 5, res);
+	return arr;
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituAnalysis_histogram(JNIEnv *env, jobject thisObj, jobject buffer, jint dtype, jdouble lo, jdouble hi, jlongArray bins, jint numThreads) {
+	const void *data;
+	size_t n = elements(env, buffer, dtype, &data);
+
+	jsize nbins = env->GetArrayLength(bins);
+	std::vector<jlong> counts(nbins);
+	env->GetLongArrayRegion(bins, 0, nbins, counts.data());
+
+	// bins are accumulated into, as in field_histogram
+	field_histogram(data, dtype, n, lo, hi, nbins, (uint64_t *) counts.data(), numThreads);
+
+	env->SetLongArrayRegion(bins, 0, nbins, counts.data());
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituAnalysis_threshold(JNIEnv *env, jobject thisObj, jobject buffer, jint dtype, jdouble threshold, jint numThreads) {
+	const void *data;
+	size_t n = elements(env, buffer, dtype, &data);
+
+	return (jlong) field_threshold(data, dtype, n, threshold, numThreads);
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituAnalysis_macroCells(JNIEnv *env, jobject thisObj, jobject voxels, jint dtype, jint dimX, jint dimY, jint dimZ, jint cellSize, jobject minmax, jint numThreads) {
+	int dims[] = {dimX, dimY, dimZ}, cells[3];
+	const void *data = env->GetDirectBufferAddress(voxels);
+	float *out = (float *) env->GetDirectBufferAddress(minmax);
+	size_t n = macro_grid_dims(dims, cellSize, cells);
+	if (data == NULL || out == NULL || dimX <= 0 || dimY <= 0 || dimZ <= 0
+			|| (size_t) env->GetDirectBufferCapacity(voxels) < brick_type_size(dtype) * dimX * dimY * dimZ
+			|| (size_t) env->GetDirectBufferCapacity(minmax) < 2 * n * sizeof(float))
+		return JNI_FALSE;
+
+	return macro_minmax(data, dtype, dims, cellSize, out, numThreads) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituAnalysis_occupancy(JNIEnv *env, jobject thisObj, jobject minmax, jfloatArray alpha, jfloat lo, jfloat hi, jobject occupied) {
+	const float *in = (const float *) env->GetDirectBufferAddress(minmax);
+	uint8_t *out = (uint8_t *) env->GetDirectBufferAddress(occupied);
+	if (in == NULL || out == NULL)
+		return 0;
+	size_t n = (size_t) env->GetDirectBufferCapacity(minmax) / (2 * sizeof(float));
+	if ((size_t) env->GetDirectBufferCapacity(occupied) < n)
+		n = (size_t) env->GetDirectBufferCapacity(occupied);
+
+	jsize tflen = env->GetArrayLength(alpha);
+	std::vector<float> tf(tflen);
+	env->GetFloatArrayRegion(alpha, 0, tflen, tf.data());
+	return (jlong) macro_occupancy(in, n, tf.data(), tflen, lo, hi, out);
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituAnalysis_downsample(JNIEnv *env, jobject thisObj, jobject voxels, jint dtype, jint dimX, jint dimY, jint dimZ, jint filter, jobject out, jint numThreads) {
+	int dims[] = {dimX, dimY, dimZ}, half[3];
+	const void *data = env->GetDirectBufferAddress(voxels);
+	void *dst = env->GetDirectBufferAddress(out);
+	size_t size = brick_type_size(dtype);
+	if (data == NULL || dst == NULL || size == 0 || dimX <= 0 || dimY <= 0 || dimZ <= 0
+			|| (size_t) env->GetDirectBufferCapacity(voxels) < size * dimX * dimY * dimZ
+			|| (size_t) env->GetDirectBufferCapacity(out) < size * pyramid_level_dims(dims, 1, half))
+		return JNI_FALSE;
+
+	return downsample_brick(data, dtype, dims, dst, filter, numThreads) ? JNI_TRUE : JNI_FALSE;
+}
@@ -0,0 +1,61 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class InSituAnalysis */
+
+#ifndef _Included_InSituAnalysis
+#define _Included_InSituAnalysis
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     InSituAnalysis
+ * Method:    stats
+ * Signature: (Ljava/nio/ByteBuffer;II)[D
+ */
+JNIEXPORT jdoubleArray JNICALL Java_graphics_scenery_insitu_InSituAnalysis_stats
+  (JNIEnv *, jobject, jobject, jint, jint);
+
+/*
+ * Class:     InSituAnalysis
+ * Method:    histogram
+ * Signature: (Ljava/nio/ByteBuffer;IDD[JI)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituAnalysis_histogram
+  (JNIEnv *, jobject, jobject, jint, jdouble, jdouble, jlongArray, jint);
+
+/*
+ * Class:     InSituAnalysis
+ * Method:    threshold
+ * Signature: (Ljava/nio/ByteBuffer;IDI)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituAnalysis_threshold
+  (JNIEnv *, jobject, jobject, jint, jdouble, jint);
+
+/*
+ * Class:     InSituAnalysis
+ * Method:    macroCells
+ * Signature: (Ljava/nio/ByteBuffer;IIIIILjava/nio/ByteBuffer;I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituAnalysis_macroCells
+  (JNIEnv *, jobject, jobject, jint, jint, jint, jint, jint, jobject, jint);
+
+/*
+ * Class:     InSituAnalysis
+ * Method:    occupancy
+ * Signature: (Ljava/nio/ByteBuffer;[FFFLjava/nio/ByteBuffer;)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituAnalysis_occupancy
+  (JNIEnv *, jobject, jobject, jfloatArray, jfloat, jfloat, jobject);
+
+/*
+ * Class:     InSituAnalysis
+ * Method:    downsample
+ * Signature: (Ljava/nio/ByteBuffer;IIIIILjava/nio/ByteBuffer;I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituAnalysis_downsample
+  (JNIEnv *, jobject, jobject, jint, jint, jint, jint, jint, jobject, jint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,70 @@
+package graphics.scenery.insitu
+
+import java.nio.ByteBuffer
+
+/**
+ * Statistics over frames that live in native memory, e.g. shared memory segments handed out by the
+ * native bridges or volumes allocated with MemoryUtil. The reductions run in place in libinsitu
+ * (AnalysisKernels.cpp), so the frame is never copied into the JVM. All buffers must be direct,
+ * and are read over their whole capacity.
+ */
+object InSituAnalysis {
+
+    const val UINT8 = 0
+    const val UINT16 = 1
+    const val FLOAT = 2
+    const val DOUBLE = 3
+
+    // indices into the array returned by [stats]
+    const val MIN = 0
+    const val MAX = 1
+    const val MEAN = 2
+    const val VARIANCE = 3
+    const val COUNT = 4
+
+    init {
+        System.loadLibrary("insitu")
+    }
+
+    /** Returns min, max, mean, variance and element count of [buffer], indexed by [MIN] .. [COUNT]. */
+    external fun stats(buffer: ByteBuffer, dtype: Int, numThreads: Int): DoubleArray
+
+    /** Adds the number of values of [buffer] in each of `bins.size` equal bins over [lo, hi] to [bins]. */
+    external fun histogram(buffer: ByteBuffer, dtype: Int, lo: Double, hi: Double, bins: LongArray, numThreads: Int)
+
+    /** Returns the number of values in [buffer] that are at least [threshold]. */
+    external fun threshold(buffer: ByteBuffer, dtype: Int, threshold: Double, numThreads: Int): Long
+
+    /** Number of macro cells of [cellSize] voxels along each axis that [macroCells] divides a brick of [dims] into. */
+    fun macroGridDims(dims: IntArray, cellSize: Int) = IntArray(3) { if(cellSize > 0 && dims[it] > 1) (dims[it] - 2) / cellSize + 1 else 1 }
+
+    /**
+     * Writes the min and max value of every macro cell of the brick in [voxels], two floats per cell with
+     * x fastest, into [minmax] (MacroCells.cpp). [dtype] is a brick type as in [BrickTable], e.g. one
+     * published through shared memory; neighbouring cells share their boundary voxels. Returns false if
+     * the type is unknown or a buffer is too small.
+     */
+    external fun macroCells(voxels: ByteBuffer, dtype: Int, dimX: Int, dimY: Int, dimZ: Int, cellSize: Int, minmax: ByteBuffer, numThreads: Int): Boolean
+
+    /**
+     * Sets one byte per cell of [occupied] to 1 if the cell's range in [minmax] reaches an entry of [alpha]
+     * with nonzero opacity, the transfer function sampled evenly over [lo, hi], and to 0 if the cell can
+     * be skipped. Returns the number of occupied cells.
+     */
+    external fun occupancy(minmax: ByteBuffer, alpha: FloatArray, lo: Float, hi: Float, occupied: ByteBuffer): Long
+
+    // filters of [downsample]
+    const val BOX = 0
+    const val MAX = 1
+
+    /** Dimensions of pyramid [level] of a brick of [dims], each level halving the one before, rounding up. */
+    fun levelDims(dims: IntArray, level: Int) = IntArray(3) { maxOf((dims[it] + (1 shl level) - 1) shr level, 1) }
+
+    /**
+     * Writes the next coarser pyramid level of the brick in [voxels] into [out], of [levelDims] with level 1
+     * (BrickPyramid.cpp): every voxel the average ([BOX]) or maximum ([MAX]) of the 2 x 2 x 2 voxels below
+     * it. [dtype] is a brick type as in [BrickTable]. Returns false if the type or filter is unknown or a
+     * buffer is too small.
+     */
+    external fun downsample(voxels: ByteBuffer, dtype: Int, dimX: Int, dimY: Int, dimZ: Int, filter: Int, out: ByteBuffer, numThreads: Int): Boolean
+}
@@ -0,0 +1,119 @@
+// Save as "InSituContainer.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include <vector>
+#include "InSituContainer.h"  // Generated
+
+#include "VDIContainer.hpp"
+
+// metadata bytes of a frame, empty for null
+static std::vector<jbyte> bytes_of(JNIEnv *env, jbyteArray metadata)
+{
+	std::vector<jbyte> meta;
+	if (metadata != NULL) {
+		meta.resize(env->GetArrayLength(metadata));
+		env->GetByteArrayRegion(metadata, 0, (jsize) meta.size(), meta.data());
+	}
+	return meta;
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituContainer_create(JNIEnv *env, jobject thisObj, jstring path, jint width, jint height, jint tileLength, jint codec, jint level, jint numThreads) {
+	const char *p = env->GetStringUTFChars(path, NULL);
+	VDIContainerWriter *w = new VDIContainerWriter(p, width, height, (size_t) tileLength, codec, level, numThreads);
+	env->ReleaseStringUTFChars(path, p);
+	if (!w->ok()) {
+		delete w;
+		return 0;
+	}
+	return (jlong) w;
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituContainer_appendDense(JNIEnv *env, jobject thisObj, jlong writer, jobject color, jobject depth, jobject prefix, jlong supersegments, jbyteArray metadata) {
+	VDIContainerWriter *w = (VDIContainerWriter *) writer;
+	const float *c = (const float *) env->GetDirectBufferAddress(color);
+	const float *d = (const float *) env->GetDirectBufferAddress(depth);
+	const int32_t *p = (const int32_t *) env->GetDirectBufferAddress(prefix);
+	if (w == NULL || c == NULL || d == NULL || p == NULL)
+		return JNI_FALSE;
+	std::vector<jbyte> meta = bytes_of(env, metadata);
+	return w->append_dense(c, d, p, (size_t) supersegments, meta.data(), meta.size()) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituContainer_appendFixed(JNIEnv *env, jobject thisObj, jlong writer, jobject color, jobject depth, jint maxSupersegments, jbyteArray metadata) {
+	VDIContainerWriter *w = (VDIContainerWriter *) writer;
+	const float *c = (const float *) env->GetDirectBufferAddress(color);
+	const float *d = (const float *) env->GetDirectBufferAddress(depth);
+	if (w == NULL || c == NULL || d == NULL)
+		return JNI_FALSE;
+	std::vector<jbyte> meta = bytes_of(env, metadata);
+	return w->append_fixed(c, d, maxSupersegments, meta.data(), meta.size()) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituContainer_finish(JNIEnv *env, jobject thisObj, jlong writer) {
+	VDIContainerWriter *w = (VDIContainerWriter *) writer;
+	if (w == NULL)
+		return JNI_FALSE;
+	bool ok = w->close();
+	delete w;
+	return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituContainer_open(JNIEnv *env, jobject thisObj, jstring path) {
+	const char *p = env->GetStringUTFChars(path, NULL);
+	VDIContainerReader *r = new VDIContainerReader();
+	bool ok = r->open(p);
+	env->ReleaseStringUTFChars(path, p);
+	if (!ok) {
+		delete r;
+		return 0;
+	}
+	return (jlong) r;
+}
+
+JNIEXPORT jlongArray JNICALL Java_graphics_scenery_insitu_InSituContainer_info(JNIEnv *env, jobject thisObj, jlong reader) {
+	VDIContainerReader *r = (VDIContainerReader *) reader;
+	jlong info[] = {r->width(), r->height(), (jlong) r->tilelen(), (jlong) r->ntiles(), (jlong) r->frames(), r->codec()};
+	jlongArray out = env->NewLongArray(6);
+	env->SetLongArrayRegion(out, 0, 6, info);
+	return out;
+}
+
+JNIEXPORT jbyteArray JNICALL Java_graphics_scenery_insitu_InSituContainer_metadata(JNIEnv *env, jobject thisObj, jlong reader, jint frame) {
+	VDIContainerReader *r = (VDIContainerReader *) reader;
+	if (frame < 0 || (size_t) frame >= r->frames())
+		return NULL;
+	size_t bytes;
+	const jbyte *meta = (const jbyte *) r->metadata(frame, &bytes);
+	jbyteArray out = env->NewByteArray((jsize) bytes);
+	if (bytes > 0)
+		env->SetByteArrayRegion(out, 0, (jsize) bytes, meta);
+	return out;
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituContainer_supersegmentBound(JNIEnv *env, jobject thisObj, jlong reader, jint frame, jlong first, jint count) {
+	VDIContainerReader *r = (VDIContainerReader *) reader;
+	if (frame < 0 || first < 0 || count <= 0)
+		return 0;
+	return (jlong) r->range_bound(frame, (size_t) first, (size_t) count);
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituContainer_readLists(JNIEnv *env, jobject thisObj, jlong reader, jint frame, jlong first, jint count,
+		jobject counts, jobject color, jobject depth) {
+	VDIContainerReader *r = (VDIContainerReader *) reader;
+	if (frame < 0 || (size_t) frame >= r->frames() || first < 0 || count <= 0 || (size_t) first + count > r->lists())
+		return -1;
+
+	// never run past the buffers, whatever the lists hold
+	size_t bound = r->range_bound(frame, (size_t) first, (size_t) count);
+	int32_t *n = (int32_t *) env->GetDirectBufferAddress(counts);
+	float *c = (float *) env->GetDirectBufferAddress(color);
+	float *d = (float *) env->GetDirectBufferAddress(depth);
+	if (n == NULL || c == NULL || d == NULL || (size_t) env->GetDirectBufferCapacity(counts) < count * sizeof(int32_t)
+			|| (size_t) env->GetDirectBufferCapacity(color) < bound * 4 * sizeof(float)
+			|| (size_t) env->GetDirectBufferCapacity(depth) < bound * 2 * sizeof(float))
+		return -1;
+	return (jlong) r->read_lists(frame, (size_t) first, (size_t) count, n, c, d);
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituContainer_close(JNIEnv *env, jobject thisObj, jlong reader) {
+	delete (VDIContainerReader *) reader;
+}
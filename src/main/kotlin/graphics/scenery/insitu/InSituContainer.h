@@ -0,0 +1,93 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class InSituContainer */
+
+#ifndef _Included_InSituContainer
+#define _Included_InSituContainer
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     InSituContainer
+ * Method:    create
+ * Signature: (Ljava/lang/String;IIIIII)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituContainer_create
+  (JNIEnv *, jobject, jstring, jint, jint, jint, jint, jint, jint);
+
+/*
+ * Class:     InSituContainer
+ * Method:    appendDense
+ * Signature: (JLjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;J[B)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituContainer_appendDense
+  (JNIEnv *, jobject, jlong, jobject, jobject, jobject, jlong, jbyteArray);
+
+/*
+ * Class:     InSituContainer
+ * Method:    appendFixed
+ * Signature: (JLjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;I[B)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituContainer_appendFixed
+  (JNIEnv *, jobject, jlong, jobject, jobject, jint, jbyteArray);
+
+/*
+ * Class:     InSituContainer
+ * Method:    finish
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituContainer_finish
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     InSituContainer
+ * Method:    open
+ * Signature: (Ljava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituContainer_open
+  (JNIEnv *, jobject, jstring);
+
+/*
+ * Class:     InSituContainer
+ * Method:    info
+ * Signature: (J)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_graphics_scenery_insitu_InSituContainer_info
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     InSituContainer
+ * Method:    metadata
+ * Signature: (JI)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_graphics_scenery_insitu_InSituContainer_metadata
+  (JNIEnv *, jobject, jlong, jint);
+
+/*
+ * Class:     InSituContainer
+ * Method:    supersegmentBound
+ * Signature: (JIJI)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituContainer_supersegmentBound
+  (JNIEnv *, jobject, jlong, jint, jlong, jint);
+
+/*
+ * Class:     InSituContainer
+ * Method:    readLists
+ * Signature: (JIJILjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituContainer_readLists
+  (JNIEnv *, jobject, jlong, jint, jlong, jint, jobject, jobject, jobject);
+
+/*
+ * Class:     InSituContainer
+ * Method:    close
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituContainer_close
+  (JNIEnv *, jobject, jlong);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
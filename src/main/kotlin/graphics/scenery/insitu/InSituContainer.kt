@@ -0,0 +1,56 @@
+package graphics.scenery.insitu
+
+import java.nio.ByteBuffer
+
+/**
+ * Chunked, indexed VDI container files (VDIContainer.cpp in libinsitu): frames of one resolution,
+ * each stored in tiles of consecutive lists that are compressed on their own, so a reader fetches
+ * only the lists it asks for instead of whole dumps. Writers and readers are native handles, 0 if
+ * they could not be created. All buffers must be direct and in native order; lists hold RGBA32F
+ * colours and start/end depths per supersegment, as dense VDIs.
+ */
+object InSituContainer {
+
+    // indices into the array returned by [info]
+    const val WIDTH = 0
+    const val HEIGHT = 1
+    const val TILE_LENGTH = 2
+    const val TILES = 3
+    const val FRAMES = 4
+    const val CODEC = 5
+
+    init {
+        System.loadLibrary("insitu")
+    }
+
+    /** Creates a container at [path]; [codec] as in ChunkCodec.hpp, 0 to store tiles raw. */
+    external fun create(path: String, width: Int, height: Int, tileLength: Int, codec: Int, level: Int, numThreads: Int): Long
+
+    /** Appends a dense VDI, [prefix] holding the exclusive prefix sum of the supersegments per list. */
+    external fun appendDense(writer: Long, color: ByteBuffer, depth: ByteBuffer, prefix: ByteBuffer, supersegments: Long, metadata: ByteArray?): Boolean
+
+    /** Appends a VDI of [maxSupersegments] per list, each list ending at its first empty supersegment. */
+    external fun appendFixed(writer: Long, color: ByteBuffer, depth: ByteBuffer, maxSupersegments: Int, metadata: ByteArray?): Boolean
+
+    /** Writes the index and releases the writer; false if anything could not be written. */
+    external fun finish(writer: Long): Boolean
+
+    external fun open(path: String): Long
+
+    /** Returns the container's layout, indexed by [WIDTH] .. [CODEC]. */
+    external fun info(reader: Long): LongArray
+
+    external fun metadata(reader: Long, frame: Int): ByteArray?
+
+    /** At most as many supersegments as [readLists] returns for the same lists. */
+    external fun supersegmentBound(reader: Long, frame: Int, first: Long, count: Int): Long
+
+    /**
+     * Reads lists [first] to [first] + [count] of [frame]: their supersegment counts into [counts]
+     * and their supersegments into [color] and [depth]. Returns how many, or -1 if the lists are not
+     * in the container or the buffers are too small.
+     */
+    external fun readLists(reader: Long, frame: Int, first: Long, count: Int, counts: ByteBuffer, color: ByteBuffer, depth: ByteBuffer): Long
+
+    external fun close(reader: Long)
+}
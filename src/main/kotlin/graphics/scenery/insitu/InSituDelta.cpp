@@ -0,0 +1,56 @@
+// Save as "InSituDelta.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include "InSituDelta.h"  // Generated
+
+#include "DeltaCodec.hpp"
+#include "TraceRecorder.hpp"
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituDelta_createEncoder(JNIEnv *env, jobject thisObj, jint elementSize, jint codec, jint level, jint keyInterval, jint mode, jint numThreads) {
+	// the encoder gives up on these for good
+	if (!codec_available(codec) || (elementSize != 1 && elementSize != 2 && elementSize != 4 && elementSize != 8)
+			|| (mode != DELTA_XOR && mode != DELTA_SUB))
+		return 0;
+	return (jlong) new DeltaEncoder(elementSize, codec, level, keyInterval, numThreads, mode);
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituDelta_encodedBound(JNIEnv *env, jobject thisObj, jlong encoder, jlong bytes) {
+	DeltaEncoder *e = (DeltaEncoder *) encoder;
+	return (e == NULL || bytes < 0) ? 0 : (jlong) e->bound((size_t) bytes);
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituDelta_encode(JNIEnv *env, jobject thisObj, jlong encoder, jobject step, jlong bytes, jobject out) {
+	TRACE_SPAN_ARG("InSituDelta.encode", bytes);
+	DeltaEncoder *e = (DeltaEncoder *) encoder;
+	const void *src = env->GetDirectBufferAddress(step);
+	void *dst = env->GetDirectBufferAddress(out);
+	if (e == NULL || src == NULL || dst == NULL || bytes < 0 || env->GetDirectBufferCapacity(step) < bytes
+			|| (size_t) env->GetDirectBufferCapacity(out) < e->bound((size_t) bytes))
+		return 0;
+	return (jlong) e->encode(src, (size_t) bytes, dst);
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituDelta_forceKeyframe(JNIEnv *env, jobject thisObj, jlong encoder) {
+	if (encoder != 0)
+		((DeltaEncoder *) encoder)->keyframe();
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituDelta_releaseEncoder(JNIEnv *env, jobject thisObj, jlong encoder) {
+	delete (DeltaEncoder *) encoder;
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituDelta_createDecoder(JNIEnv *env, jobject thisObj, jint numThreads) {
+	return (jlong) new DeltaDecoder(numThreads);
+}
+
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituDelta_decode(JNIEnv *env, jobject thisObj, jlong decoder, jobject msg, jlong bytes) {
+	TRACE_SPAN_ARG("InSituDelta.decode", bytes);
+	DeltaDecoder *d = (DeltaDecoder *) decoder;
+	const void *data = env->GetDirectBufferAddress(msg);
+	if (d == NULL || data == NULL || bytes < 0 || env->GetDirectBufferCapacity(msg) < bytes || !d->decode(data, (size_t) bytes))
+		return NULL;
+	return env->NewDirectByteBuffer((void *) d->data(), (jlong) d->size());
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituDelta_releaseDecoder(JNIEnv *env, jobject thisObj, jlong decoder) {
+	delete (DeltaDecoder *) decoder;
+}
@@ -0,0 +1,77 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class InSituDelta */
+
+#ifndef _Included_InSituDelta
+#define _Included_InSituDelta
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     InSituDelta
+ * Method:    createEncoder
+ * Signature: (IIIIII)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituDelta_createEncoder
+  (JNIEnv *, jobject, jint, jint, jint, jint, jint, jint);
+
+/*
+ * Class:     InSituDelta
+ * Method:    encodedBound
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituDelta_encodedBound
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     InSituDelta
+ * Method:    encode
+ * Signature: (JLjava/nio/ByteBuffer;JLjava/nio/ByteBuffer;)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituDelta_encode
+  (JNIEnv *, jobject, jlong, jobject, jlong, jobject);
+
+/*
+ * Class:     InSituDelta
+ * Method:    forceKeyframe
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituDelta_forceKeyframe
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     InSituDelta
+ * Method:    releaseEncoder
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituDelta_releaseEncoder
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     InSituDelta
+ * Method:    createDecoder
+ * Signature: (I)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituDelta_createDecoder
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     InSituDelta
+ * Method:    decode
+ * Signature: (JLjava/nio/ByteBuffer;J)Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituDelta_decode
+  (JNIEnv *, jobject, jlong, jobject, jlong);
+
+/*
+ * Class:     InSituDelta
+ * Method:    releaseDecoder
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituDelta_releaseDecoder
+  (JNIEnv *, jobject, jlong);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
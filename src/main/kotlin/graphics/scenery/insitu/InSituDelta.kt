@@ -0,0 +1,59 @@
+package graphics.scenery.insitu
+
+import java.nio.ByteBuffer
+
+/**
+ * Temporal delta compression of field streams (DeltaCodec.cpp in libinsitu): an encoder per field turns
+ * each time step into a keyframe or the bit-shuffled, compressed difference to the step before, a
+ * decoder per field turns them back. Encoded steps are ordinary frames, e.g. for remote consumers or
+ * recordings. Coders are native handles, 0 if they could not be created. All buffers must be direct.
+ */
+object InSituDelta {
+
+    // modes of [createEncoder]
+    const val XOR = 0
+    const val SUB = 1
+
+    const val KEY_INTERVAL = 16
+
+    // offsets into the header of an encoded step
+    private const val KEYFRAME = 4
+    private const val SEQ = 16
+
+    init {
+        System.loadLibrary("insitu")
+    }
+
+    /**
+     * Creates an encoder for steps of elements of [elementSize] bytes; [codec] as in ChunkCodec.hpp, a
+     * keyframe every [keyInterval] steps, [XOR] for floats and [SUB] for integers.
+     */
+    external fun createEncoder(elementSize: Int, codec: Int, level: Int, keyInterval: Int, mode: Int, numThreads: Int): Long
+
+    /** Largest encoded size of a step of [bytes], what [encode] needs in its output buffer. */
+    external fun encodedBound(encoder: Long, bytes: Long): Long
+
+    /** Encodes the first [bytes] of [step] into [out], returns the encoded size or 0 on failure. */
+    external fun encode(encoder: Long, step: ByteBuffer, bytes: Long, out: ByteBuffer): Long
+
+    /** Makes the next step a keyframe, e.g. once a new consumer has joined. */
+    external fun forceKeyframe(encoder: Long)
+
+    external fun releaseEncoder(encoder: Long)
+
+    external fun createDecoder(numThreads: Int): Long
+
+    /**
+     * Decodes the first [bytes] of [msg], returns the step in the decoder's memory, valid until its next
+     * call, or null if the message is corrupt or needs a step that was missed; then wait for a keyframe.
+     */
+    external fun decode(decoder: Long, msg: ByteBuffer, bytes: Long): ByteBuffer?
+
+    external fun releaseDecoder(decoder: Long)
+
+    /** Whether the encoded step in [msg], in native order, can be decoded without the ones before it. */
+    fun isKeyframe(msg: ByteBuffer) = msg.get(KEYFRAME).toInt() != 0
+
+    /** The step number of the encoded step in [msg], in native order. */
+    fun step(msg: ByteBuffer) = msg.getLong(SEQ)
+}
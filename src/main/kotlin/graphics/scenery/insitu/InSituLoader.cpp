@@ -0,0 +1,56 @@
+// Save as "InSituLoader.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include <cstdio>
+#include <climits>
+#include "InSituLoader.h"  // Generated
+
+#include "RawVolumeLoader.hpp"
+#include "TraceRecorder.hpp"
+
+// a direct buffer over what was loaded, or NULL (and the memory released) if it does not fit one
+static jobject wrap(JNIEnv *env, void *ptr, jlong bytes)
+{
+	if (ptr == NULL)
+		return NULL;
+	jobject buf = env->NewDirectByteBuffer(ptr, bytes);
+	if (buf == NULL)
+		release_volume(ptr);
+	return buf;
+}
+
+static bool fits(const char *path, jlong bytes)
+{
+	if (bytes <= 0 || bytes > INT_MAX) {
+		fprintf(stderr, "%s: %lld bytes do not fit into one buffer\n", path, (long long) bytes);
+		return false;
+	}
+	return true;
+}
+
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituLoader_mapRaw(JNIEnv *env, jobject thisObj, jstring path, jlong bytes, jint advice, jint numThreads) {
+	TRACE_SPAN_ARG("InSituLoader.mapRaw", bytes);
+	const char *p = env->GetStringUTFChars(path, NULL);
+	void *ptr = fits(p, bytes) ? map_volume(p, (size_t) bytes, advice, numThreads) : NULL;
+	env->ReleaseStringUTFChars(path, p);
+	return wrap(env, ptr, bytes);
+}
+
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituLoader_readRaw(JNIEnv *env, jobject thisObj, jstring path, jlong bytes, jint numThreads, jint requestBytes, jboolean direct) {
+	TRACE_SPAN_ARG("InSituLoader.readRaw", bytes);
+	const char *p = env->GetStringUTFChars(path, NULL);
+	void *ptr = fits(p, bytes) ? read_volume(p, (size_t) bytes, numThreads, requestBytes > 0 ? (size_t) requestBytes : VOLUME_REQUEST, direct) : NULL;
+	env->ReleaseStringUTFChars(path, p);
+	return wrap(env, ptr, bytes);
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituLoader_advise(JNIEnv *env, jobject thisObj, jobject buffer, jlong offset, jlong length, jint advice) {
+	void *ptr = env->GetDirectBufferAddress(buffer);
+	jlong capacity = env->GetDirectBufferCapacity(buffer);
+	if (ptr == NULL || offset < 0 || length < 0 || offset + length > capacity)
+		return JNI_FALSE;
+	return advise_volume(ptr, (size_t) offset, (size_t) length, advice) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituLoader_release(JNIEnv *env, jobject thisObj, jobject buffer) {
+	release_volume(env->GetDirectBufferAddress(buffer));
+}
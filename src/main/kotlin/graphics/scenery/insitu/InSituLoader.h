@@ -0,0 +1,45 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class InSituLoader */
+
+#ifndef _Included_InSituLoader
+#define _Included_InSituLoader
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     InSituLoader
+ * Method:    mapRaw
+ * Signature: (Ljava/lang/String;JII)Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituLoader_mapRaw
+  (JNIEnv *, jobject, jstring, jlong, jint, jint);
+
+/*
+ * Class:     InSituLoader
+ * Method:    readRaw
+ * Signature: (Ljava/lang/String;JIIZ)Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituLoader_readRaw
+  (JNIEnv *, jobject, jstring, jlong, jint, jint, jboolean);
+
+/*
+ * Class:     InSituLoader
+ * Method:    advise
+ * Signature: (Ljava/nio/ByteBuffer;JJI)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituLoader_advise
+  (JNIEnv *, jobject, jobject, jlong, jlong, jint);
+
+/*
+ * Class:     InSituLoader
+ * Method:    release
+ * Signature: (Ljava/nio/ByteBuffer;)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituLoader_release
+  (JNIEnv *, jobject, jobject);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,41 @@
+package graphics.scenery.insitu
+
+import java.nio.ByteBuffer
+
+/**
+ * Loads raw volume files straight into native memory with libinsitu (RawVolumeLoader.cpp), either
+ * by mapping them or by reading them with several threads, instead of streaming them through the
+ * JVM. The buffers returned are direct and in big-endian order like any JNI buffer, so set the
+ * native order before reading multi-byte voxels. They are null if the file could not be loaded or
+ * is too large for one buffer (2 GiB), and stay valid until passed to [release].
+ */
+object InSituLoader {
+
+    // read-ahead hints for [mapRaw] and [advise]
+    const val ADVISE_NORMAL = 0
+    const val ADVISE_SEQUENTIAL = 1
+    const val ADVISE_RANDOM = 2
+    const val ADVISE_WILLNEED = 3
+
+    init {
+        System.loadLibrary("insitu")
+    }
+
+    /**
+     * Maps the first [bytes] of [path] copy on write, with the given read-ahead [advice]. With
+     * [numThreads] above 0, that many threads fault the pages in before returning.
+     */
+    external fun mapRaw(path: String, bytes: Long, advice: Int, numThreads: Int): ByteBuffer?
+
+    /**
+     * Reads the first [bytes] of [path] with [numThreads] threads issuing reads of [requestBytes]
+     * each, past the page cache if [direct] and the file system allows it.
+     */
+    external fun readRaw(path: String, bytes: Long, numThreads: Int, requestBytes: Int, direct: Boolean): ByteBuffer?
+
+    /** Gives the read-ahead [advice] for [length] bytes of a mapped [buffer] from [offset] on. */
+    external fun advise(buffer: ByteBuffer, offset: Long, length: Long, advice: Int): Boolean
+
+    /** Unmaps or frees a buffer returned by [mapRaw] or [readRaw]. */
+    external fun release(buffer: ByteBuffer)
+}
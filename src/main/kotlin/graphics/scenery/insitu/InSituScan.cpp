@@ -0,0 +1,40 @@
+// Save as "InSituScan.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include <vector>
+#include <algorithm>
+#include "InSituScan.h"  // Generated
+
+#include "PrefixScan.hpp"
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituScan_scan(JNIEnv *env, jobject thisObj, jobject input, jobject output, jint count, jint numThreads, jintArray rankCounts, jint tileLength, jintArray tileSums) {
+	const int32_t *in = (const int32_t *) env->GetDirectBufferAddress(input);
+	int32_t *out = (int32_t *) env->GetDirectBufferAddress(output);
+	if (in == NULL || out == NULL || count <= 0)
+		return 0;
+
+	// never run past either buffer
+	size_t n = (size_t) count;
+	size_t cap = (size_t) std::min(env->GetDirectBufferCapacity(input), env->GetDirectBufferCapacity(output)) / sizeof(int32_t);
+	if (n > cap)
+		n = cap;
+
+	int64_t total = exclusive_scan(in, out, n, numThreads);
+
+	if (rankCounts != NULL) {
+		jsize nranks = env->GetArrayLength(rankCounts);
+		std::vector<jint> counts(nranks);
+		if (nranks > 0) {
+			rank_sums(out, total, n, nranks, counts.data());
+			env->SetIntArrayRegion(rankCounts, 0, nranks, counts.data());
+		}
+	}
+
+	if (tileSums != NULL && tileLength > 0) {
+		std::vector<jint> sums(tile_count(n, (size_t) tileLength));
+		tile_sums(out, total, n, (size_t) tileLength, sums.data());
+		jsize len = std::min((jsize) sums.size(), env->GetArrayLength(tileSums));
+		env->SetIntArrayRegion(tileSums, 0, len, sums.data());
+	}
+
+	return total;
+}
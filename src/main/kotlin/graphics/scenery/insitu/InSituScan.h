@@ -0,0 +1,21 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class InSituScan */
+
+#ifndef _Included_InSituScan
+#define _Included_InSituScan
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     InSituScan
+ * Method:    scan
+ * Signature: (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;II[II[I)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituScan_scan
+  (JNIEnv *, jobject, jobject, jobject, jint, jint, jintArray, jint, jintArray);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
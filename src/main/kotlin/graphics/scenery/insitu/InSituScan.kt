@@ -0,0 +1,55 @@
+package graphics.scenery.insitu
+
+import org.lwjgl.system.MemoryUtil
+import java.nio.ByteBuffer
+
+/**
+ * Prefix sums over per-list counts held in native memory, e.g. the supersegments generated per
+ * pixel when creating dense VDIs, computed by libinsitu (PrefixScan.cpp) with several threads.
+ * Buffers must be direct and hold native-order 32 bit ints.
+ */
+object InSituScan {
+
+    init {
+        System.loadLibrary("insitu")
+    }
+
+    /**
+     * Writes the exclusive prefix sum of the first [count] ints of [input] to [output] (which may be
+     * [input]) and returns their total. If given, [rankCounts] receives the sum over the lists of each
+     * rank, split as in dense VDI distribution, and [tileSums] the sum over each range of [tileLength]
+     * lists; both are read off the scan in the same call.
+     */
+    external fun scan(input: ByteBuffer, output: ByteBuffer, count: Int, numThreads: Int,
+                      rankCounts: IntArray?, tileLength: Int, tileSums: IntArray?): Long
+}
+
+/**
+ * Keeps one output buffer for [InSituScan.scan] and reuses it for every frame, reallocating only
+ * when the number of lists grows.
+ */
+class PrefixScanner(val numThreads: Int = Runtime.getRuntime().availableProcessors()) : AutoCloseable {
+    /** Output of the last [scan], valid until the next one. */
+    var prefix: ByteBuffer? = null
+        private set
+
+    /** Total of the counts passed to the last [scan]. */
+    var total = 0L
+        private set
+
+    fun scan(counts: ByteBuffer, count: Int, rankCounts: IntArray? = null, tileLength: Int = 0, tileSums: IntArray? = null): ByteBuffer {
+        val out = prefix?.takeIf { it.capacity() >= count * 4 } ?: run {
+            prefix?.let { MemoryUtil.memFree(it) }
+            MemoryUtil.memAlloc(count * 4)
+        }
+        prefix = out
+        total = InSituScan.scan(counts, out, count, numThreads, rankCounts, tileLength, tileSums)
+        out.limit(count * 4)
+        return out
+    }
+
+    override fun close() {
+        prefix?.let { MemoryUtil.memFree(it) }
+        prefix = null
+    }
+}
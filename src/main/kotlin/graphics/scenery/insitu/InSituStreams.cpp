@@ -0,0 +1,298 @@
+// Save as "InSituStreams.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include "InSituStreams.h"  // Generated
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "ShmStreams.hpp"
+#include "StreamWaiter.hpp"
+#include "FrameRecorder.hpp"
+#include "TraceRecorder.hpp"
+
+#define VERBOSE false
+
+// layout of the frame descriptor returned by acquireFrame, see InSituStreams.kt
+#define SLOT_MASK 0x7fL
+#define REMAPPED  0x80L
+#define SEQ_SHIFT 8
+
+// layout of the events returned by poll: (handle << HANDLE_SHIFT) | frame descriptor
+#define HANDLE_SHIFT 48
+#define SEQ_MASK     ((1L << (HANDLE_SHIFT - SEQ_SHIFT)) - 1)
+
+// ByteBuffer wrapping one slot of a stream, kept in ShmStream::cookies
+struct SlotView {
+	jobject buffer; // global reference
+	void *addr;     // address the slot was mapped at when the buffer was created
+};
+
+// group of streams served by one waiter thread, attached to the JVM for its whole lifetime
+struct StreamGroup {
+	std::vector<int> handles;
+	JavaVM *vm;
+	JNIEnv *env;        // of the waiter thread
+	jobject listener;   // global reference, NULL if frames are only queued
+	jmethodID onFrame;
+	std::unique_ptr<StreamWaiter> waiter;
+	size_t maxframe;    // of the group's streams
+	std::shared_ptr<FrameRecorder> recorder; // NULL unless recording, swapped with atomic_load/atomic_store
+};
+
+static ShmStreams streams(VERBOSE);
+
+static std::mutex groups_lock;
+static std::vector<std::shared_ptr<StreamGroup> > groups; // indexed by group id, NULL once destroyed
+
+static std::shared_ptr<StreamGroup> get_group(int id)
+{
+	std::lock_guard<std::mutex> guard(groups_lock);
+	if (id < 0 || id >= (int) groups.size())
+		return std::shared_ptr<StreamGroup>();
+	return groups[id];
+}
+
+// update the cached buffer for the slot of frame, rebuilding it if the slot moved; return whether it was rebuilt
+// stream lock must be held; with pinned slots this only happens on the first frame of each slot
+static bool update_view(JNIEnv *env, ShmStream &stream, const ShmFrame &frame)
+{
+	SlotView *v = (SlotView *) stream.cookies[frame.slot];
+	if (v == NULL) {
+		v = new SlotView;
+		v->buffer = NULL;
+		v->addr = NULL;
+		stream.cookies[frame.slot] = v;
+	}
+
+	if (v->buffer == NULL || v->addr != frame.ptr) {
+		if (v->buffer != NULL)
+			env->DeleteGlobalRef(v->buffer);
+		jobject bb = env->NewDirectByteBuffer(frame.ptr, (jlong) frame.size);
+		v->buffer = env->NewGlobalRef(bb);
+		v->addr = frame.ptr;
+		env->DeleteLocalRef(bb);
+		return true;
+	}
+	return false;
+}
+
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituStreams_open(JNIEnv *env, jobject thisObj, jstring pname, jint rank, jlong size) {
+	const char *name = env->GetStringUTFChars(pname, NULL);
+	int handle = streams.open(name, rank, (size_t) size);
+	env->ReleaseStringUTFChars(pname, name);
+	return handle;
+}
+
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituStreams_acquire(JNIEnv *env, jobject thisObj, jint handle, jboolean wait) {
+	TRACE_SPAN_ARG("InSituStreams.acquire", handle);
+	std::shared_ptr<ShmStream> stream = streams.get(handle);
+	if (!stream)
+		return NULL;
+
+	std::lock_guard<std::recursive_mutex> guard(stream->lock);
+	ShmFrame frame = stream->acquire(wait);
+	if (frame.ptr == NULL)
+		return NULL;
+
+	update_view(env, *stream, frame);
+	return env->NewLocalRef(((SlotView *) stream->cookies[frame.slot])->buffer);
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituStreams_acquireFrame(JNIEnv *env, jobject thisObj, jint handle, jboolean wait) {
+	TRACE_SPAN_ARG("InSituStreams.acquireFrame", handle);
+	std::shared_ptr<ShmStream> stream = streams.get(handle);
+	if (!stream)
+		return -1;
+
+	std::lock_guard<std::recursive_mutex> guard(stream->lock);
+	ShmFrame frame = stream->acquire(wait);
+	if (frame.ptr == NULL)
+		return -1;
+
+	jlong desc = ((jlong) frame.seq << SEQ_SHIFT) | (jlong) frame.slot;
+	if (update_view(env, *stream, frame))
+		desc |= REMAPPED;
+	return desc;
+}
+
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituStreams_view(JNIEnv *env, jobject thisObj, jint handle, jint slot) {
+	std::shared_ptr<ShmStream> stream = streams.get(handle);
+	if (!stream || slot < 0 || slot >= NKEYS)
+		return NULL;
+
+	std::lock_guard<std::recursive_mutex> guard(stream->lock);
+	SlotView *v = (SlotView *) stream->cookies[slot];
+	if (v == NULL || v->buffer == NULL)
+		return NULL;
+	return env->NewLocalRef(v->buffer);
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituStreams_release(JNIEnv *env, jobject thisObj, jint handle) {
+	TRACE_SPAN_ARG("InSituStreams.release", handle);
+	std::shared_ptr<ShmStream> stream = streams.get(handle);
+	if (!stream)
+		return;
+
+	std::lock_guard<std::recursive_mutex> guard(stream->lock);
+	stream->release();
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituStreams_close(JNIEnv *env, jobject thisObj, jint handle) {
+	std::shared_ptr<ShmStream> stream = streams.close(handle);
+	if (!stream)
+		return JNI_FALSE; // not open, or its group's waiter still uses it
+
+	std::lock_guard<std::recursive_mutex> guard(stream->lock);
+	stream->detach_all();
+	for (int i = 0; i < NKEYS; ++i) {
+		SlotView *v = (SlotView *) stream->cookies[i];
+		if (v == NULL)
+			continue;
+		if (v->buffer != NULL)
+			env->DeleteGlobalRef(v->buffer);
+		delete v;
+		stream->cookies[i] = NULL;
+	}
+	return JNI_TRUE;
+}
+
+// called on the waiter thread for every new frame of the group, with the stream lock held
+static int report_frame(StreamGroup *group, int index, ShmStream &stream, const ShmFrame &frame)
+{
+	JNIEnv *env = group->env;
+	int flags = 0;
+	std::shared_ptr<FrameRecorder> recorder = std::atomic_load(&group->recorder);
+	if (recorder)
+		recorder->submit(frame.ptr, frame.size, group->handles[index], frame.seq, stream.rank, frame.slot, stream.pname.c_str());
+	if (update_view(env, stream, frame))
+		flags |= REMAPPED;
+
+	if (group->listener != NULL) {
+		jlong desc = (((jlong) frame.seq & SEQ_MASK) << SEQ_SHIFT) | flags | (jlong) frame.slot;
+		env->CallVoidMethod(group->listener, group->onFrame, (jint) group->handles[index], desc);
+		if (env->ExceptionCheck()) { // an exception must not end the waiter
+			env->ExceptionDescribe();
+			env->ExceptionClear();
+		}
+	}
+	return flags;
+}
+
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituStreams_createGroup(JNIEnv *env, jobject thisObj, jintArray handles, jobject listener, jint capacity) {
+	std::shared_ptr<StreamGroup> group(new StreamGroup);
+	group->handles.resize(env->GetArrayLength(handles));
+	if (!group->handles.empty())
+		env->GetIntArrayRegion(handles, 0, (jsize) group->handles.size(), &group->handles[0]);
+
+	std::vector<std::shared_ptr<ShmStream> > members;
+	if (!streams.join_group(group->handles, members))
+		return -1;
+	group->maxframe = 0;
+	for (size_t i = 0; i < members.size(); ++i)
+		group->maxframe = std::max(group->maxframe, members[i]->size());
+
+	env->GetJavaVM(&group->vm);
+	group->env = NULL;
+	group->listener = NULL;
+	group->onFrame = NULL;
+	if (listener != NULL) {
+		jclass cls = env->GetObjectClass(listener);
+		group->onFrame = env->GetMethodID(cls, "onFrame", "(IJ)V");
+		env->DeleteLocalRef(cls);
+		if (group->onFrame == NULL) {
+			streams.leave_group(group->handles);
+			return -1; // NoSuchMethodError pending
+		}
+		group->listener = env->NewGlobalRef(listener);
+	}
+
+	StreamGroup *g = group.get(); // the waiter is stopped before the group is freed
+	group->waiter.reset(new StreamWaiter(members,
+			[g](int index, ShmStream &stream, const ShmFrame &frame) { return report_frame(g, index, stream, frame); },
+			capacity > 0 ? (size_t) capacity : 0,
+			[g]() {
+				if (g->vm->AttachCurrentThreadAsDaemon((void **) &g->env, NULL) != JNI_OK) {
+					perror("AttachCurrentThreadAsDaemon"); std::exit(1);
+				}
+			},
+			[g]() { g->vm->DetachCurrentThread(); }));
+
+	std::lock_guard<std::mutex> guard(groups_lock);
+	groups.push_back(group);
+	return (int) groups.size() - 1;
+}
+
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituStreams_poll(JNIEnv *env, jobject thisObj, jint id, jlongArray events) {
+	std::shared_ptr<StreamGroup> group = get_group(id);
+	if (!group)
+		return 0;
+
+	// one call of the waiter's poll, every call releases the frames of the events of the one before
+	jsize max = env->GetArrayLength(events);
+	std::vector<StreamEvent> polled(max);
+	size_t n = max > 0 ? group->waiter->poll(&polled[0], (size_t) max) : 0;
+	std::vector<jlong> out(n);
+	for (size_t i = 0; i < n; ++i)
+		out[i] = ((jlong) group->handles[polled[i].index] << HANDLE_SHIFT)
+			| (((jlong) polled[i].seq & SEQ_MASK) << SEQ_SHIFT) | polled[i].flags | (jlong) polled[i].slot;
+	if (n > 0)
+		env->SetLongArrayRegion(events, 0, (jsize) n, &out[0]);
+	return (jint) n;
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituStreams_dropped(JNIEnv *env, jobject thisObj, jint id) {
+	std::shared_ptr<StreamGroup> group = get_group(id);
+	return group ? group->waiter->dropped() : 0;
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituStreams_destroyGroup(JNIEnv *env, jobject thisObj, jint id) {
+	std::shared_ptr<StreamGroup> group;
+	{
+		std::lock_guard<std::mutex> guard(groups_lock);
+		if (id < 0 || id >= (int) groups.size())
+			return;
+		group.swap(groups[id]);
+	}
+	if (!group)
+		return;
+
+	group->waiter->stop();
+	streams.leave_group(group->handles);
+	std::atomic_store(&group->recorder, std::shared_ptr<FrameRecorder>());
+	if (group->listener != NULL)
+		env->DeleteGlobalRef(group->listener);
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituStreams_startRecording(JNIEnv *env, jobject thisObj, jint id, jstring path, jlong memory, jint writers, jboolean dropOldest) {
+	std::shared_ptr<StreamGroup> group = get_group(id);
+	if (!group)
+		return JNI_FALSE;
+
+	const char *name = env->GetStringUTFChars(path, NULL);
+	std::shared_ptr<FrameRecorder> recorder(new FrameRecorder(name, group->maxframe, (size_t) memory, writers, dropOldest ? DROP_OLDEST : DROP_NEWEST));
+	env->ReleaseStringUTFChars(path, name);
+	if (!recorder->ok())
+		return JNI_FALSE;
+
+	// a recorder replaced here finishes its queue once the waiter thread lets go of it
+	std::atomic_store(&group->recorder, recorder);
+	return JNI_TRUE;
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituStreams_recordingStats(JNIEnv *env, jobject thisObj, jint id, jlongArray stats) {
+	std::shared_ptr<StreamGroup> group = get_group(id);
+	std::shared_ptr<FrameRecorder> recorder = group ? std::atomic_load(&group->recorder) : std::shared_ptr<FrameRecorder>();
+	if (!recorder)
+		return JNI_FALSE;
+
+	jlong out[] = {recorder->recorded(), recorder->dropped(), recorder->failed(), (jlong) recorder->written_bytes()};
+	env->SetLongArrayRegion(stats, 0, std::min(env->GetArrayLength(stats), (jsize) 4), out);
+	return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituStreams_stopRecording(JNIEnv *env, jobject thisObj, jint id) {
+	std::shared_ptr<StreamGroup> group = get_group(id);
+	if (group)
+		std::atomic_store(&group->recorder, std::shared_ptr<FrameRecorder>());
+}
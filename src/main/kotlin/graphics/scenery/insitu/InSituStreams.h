@@ -0,0 +1,117 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class InSituStreams */
+
+#ifndef _Included_InSituStreams
+#define _Included_InSituStreams
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     InSituStreams
+ * Method:    open
+ * Signature: (Ljava/lang/String;IJ)I
+ */
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituStreams_open
+  (JNIEnv *, jobject, jstring, jint, jlong);
+
+/*
+ * Class:     InSituStreams
+ * Method:    acquire
+ * Signature: (IZ)Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituStreams_acquire
+  (JNIEnv *, jobject, jint, jboolean);
+
+/*
+ * Class:     InSituStreams
+ * Method:    acquireFrame
+ * Signature: (IZ)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituStreams_acquireFrame
+  (JNIEnv *, jobject, jint, jboolean);
+
+/*
+ * Class:     InSituStreams
+ * Method:    view
+ * Signature: (II)Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_InSituStreams_view
+  (JNIEnv *, jobject, jint, jint);
+
+/*
+ * Class:     InSituStreams
+ * Method:    release
+ * Signature: (I)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituStreams_release
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     InSituStreams
+ * Method:    close
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituStreams_close
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     InSituStreams
+ * Method:    createGroup
+ * Signature: ([ILgraphics/scenery/insitu/FrameListener;I)I
+ */
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituStreams_createGroup
+  (JNIEnv *, jobject, jintArray, jobject, jint);
+
+/*
+ * Class:     InSituStreams
+ * Method:    poll
+ * Signature: (I[J)I
+ */
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituStreams_poll
+  (JNIEnv *, jobject, jint, jlongArray);
+
+/*
+ * Class:     InSituStreams
+ * Method:    dropped
+ * Signature: (I)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituStreams_dropped
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     InSituStreams
+ * Method:    destroyGroup
+ * Signature: (I)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituStreams_destroyGroup
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     InSituStreams
+ * Method:    startRecording
+ * Signature: (ILjava/lang/String;JIZ)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituStreams_startRecording
+  (JNIEnv *, jobject, jint, jstring, jlong, jint, jboolean);
+
+/*
+ * Class:     InSituStreams
+ * Method:    recordingStats
+ * Signature: (I[J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituStreams_recordingStats
+  (JNIEnv *, jobject, jint, jlongArray);
+
+/*
+ * Class:     InSituStreams
+ * Method:    stopRecording
+ * Signature: (I)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituStreams_stopRecording
+  (JNIEnv *, jobject, jint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,146 @@
+package graphics.scenery.insitu
+
+import java.nio.ByteBuffer
+
+/**
+ * Handle-based access to shared memory published by simulation ranks through ShmAllocator, backed by
+ * the stream table in libinsitu (ShmStreams.cpp). One stream is one field of one rank; the field is
+ * selected by the path its producer passes to ftok, e.g. "/tmp" for positions and "/home" for
+ * properties in shm_mpiproducer. Any number of streams can be open, and different streams can be
+ * used from different threads concurrently.
+ *
+ * Each stream attaches the two slots of its producer at fixed addresses, so the ByteBuffer of a slot is
+ * created once and cached natively. On the frame path only [acquireFrame] crosses JNI, returning the
+ * slot and sequence number as a primitive; the buffer itself is fetched with [view] when the frame
+ * descriptor has [REMAPPED] set. Callers must not read a slot's buffer after [release] of its frame,
+ * and should use absolute gets since the same buffer object is handed out for every frame of a slot.
+ */
+object InSituStreams {
+
+    // frame descriptor returned by [acquireFrame]: (sequence number shl SEQ_SHIFT) or slot, plus REMAPPED if the slot moved
+    const val SLOT_MASK = 0x7fL
+    const val REMAPPED = 0x80L
+    const val SEQ_SHIFT = 8
+
+    // events returned by [poll]: (handle shl HANDLE_SHIFT) or frame descriptor
+    const val HANDLE_SHIFT = 48
+    const val SEQ_MASK = (1L shl (HANDLE_SHIFT - SEQ_SHIFT)) - 1
+
+    init {
+        System.loadLibrary("insitu")
+    }
+
+    /** Opens the stream of [size] bytes published by [rank] under [pname], returns its handle. */
+    external fun open(pname: String, rank: Int, size: Long): Int
+
+    /**
+     * Switches to the latest frame of the stream and returns it. Blocks until a new frame arrives if
+     * [wait] is set, otherwise returns null when there is none. Also returns null for closed handles.
+     */
+    external fun acquire(handle: Int, wait: Boolean): ByteBuffer?
+
+    /**
+     * Like [acquire], but returns a frame descriptor instead of a buffer, or -1 if there is no frame.
+     * If [REMAPPED] is set the slot's buffer was rebuilt and must be fetched again with [view].
+     */
+    external fun acquireFrame(handle: Int, wait: Boolean): Long
+
+    /** Returns the cached buffer of [slot], or null if the slot has not been acquired yet. */
+    external fun view(handle: Int, slot: Int): ByteBuffer?
+
+    /** Detaches from the frame before the one last acquired, so its producer can free it. */
+    external fun release(handle: Int)
+
+    /**
+     * Detaches from all frames of the stream and invalidates the handle. Returns false, leaving the
+     * stream open, if the handle is not open or belongs to a group that has not been destroyed.
+     */
+    external fun close(handle: Int): Boolean
+
+    /**
+     * Starts one native waiter thread for the streams [handles], attached to the JVM once, and returns
+     * the group id, or -1 if a handle is not open or already in a group. Each new frame is passed to
+     * [listener] on the waiter thread and, if [capacity] is positive, queued for [poll]. A frame passed
+     * to [listener] stays valid at least until it returns, a frame returned by [poll] until the next [poll] of the
+     * group, since the waiter takes no new frame of a stream while the consumer may still read two.
+     * The streams must not be acquired or released elsewhere while the group runs.
+     */
+    external fun createGroup(handles: IntArray, listener: FrameListener?, capacity: Int): Int
+
+    /**
+     * Drains up to events.size queued events of [group] into [events] and returns how many there were.
+     * The frames of the events returned by the previous call are released.
+     */
+    external fun poll(group: Int, events: LongArray): Int
+
+    /** Number of events of [group] that were not queued because the queue was full. */
+    external fun dropped(group: Int): Long
+
+    /** Stops the waiter thread of [group]; its streams stay open. */
+    external fun destroyGroup(group: Int)
+
+    /**
+     * Starts recording every frame of [group] to the file at [path] (FrameRecorder.hpp), or replaces the
+     * current recording. Frames are copied on the waiter thread into buffers worth at most [memory] bytes
+     * and written by [writers] background threads; when all buffers are busy, the newest frame is dropped,
+     * or the oldest one still queued if [dropOldest] is set, so recording never holds up the waiter.
+     * Returns false if the file cannot be created.
+     */
+    external fun startRecording(group: Int, path: String, memory: Long, writers: Int, dropOldest: Boolean): Boolean
+
+    /**
+     * Fills [stats] with the frames recorded, dropped and failed so far and the bytes written, in this
+     * order; returns false if [group] is not recording.
+     */
+    external fun recordingStats(group: Int, stats: LongArray): Boolean
+
+    /** Ends the recording of [group]; the frames queued are still written. */
+    external fun stopRecording(group: Int)
+
+    fun eventHandle(event: Long) = (event ushr HANDLE_SHIFT).toInt()
+    fun eventFrame(event: Long) = event and ((1L shl HANDLE_SHIFT) - 1)
+}
+
+/**
+ * Receives frames from the waiter thread of a stream group, see [InSituStreams.createGroup].
+ * [frame] is a frame descriptor as returned by [InSituStreams.acquireFrame].
+ */
+fun interface FrameListener {
+    fun onFrame(handle: Int, frame: Long)
+}
+
+/**
+ * Convenience wrapper for a single stream of [InSituStreams].
+ */
+class InSituStream(val pname: String, val rank: Int, val size: Long) : AutoCloseable {
+    val handle = InSituStreams.open(pname, rank, size)
+
+    private val views = arrayOfNulls<ByteBuffer>(2)
+
+    /** Slot of the frame last acquired, -1 before the first one. */
+    var slot = -1
+        private set
+
+    /** Sequence number of the frame last acquired, counting from 1. */
+    var seq = 0L
+        private set
+
+    fun acquire(wait: Boolean = true): ByteBuffer? {
+        val frame = InSituStreams.acquireFrame(handle, wait)
+        if(frame < 0) {
+            return null
+        }
+        slot = (frame and InSituStreams.SLOT_MASK).toInt()
+        seq = frame ushr InSituStreams.SEQ_SHIFT
+        if((frame and InSituStreams.REMAPPED) != 0L || views[slot] == null) {
+            views[slot] = InSituStreams.view(handle, slot)
+        }
+        return views[slot]
+    }
+
+    fun release() = InSituStreams.release(handle)
+
+    override fun close() {
+        InSituStreams.close(handle)
+    }
+}
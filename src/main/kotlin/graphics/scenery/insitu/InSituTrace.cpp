@@ -0,0 +1,74 @@
+// Save as "InSituTrace.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include "InSituTrace.h"  // Generated
+
+#include "TraceRecorder.hpp"
+
+// built with -DINSITU_NO_TRACE, the calls do nothing
+#ifdef TRACE_MAGIC
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituTrace_open(JNIEnv *env, jobject thisObj, jstring process) {
+	const char *p = env->GetStringUTFChars(process, NULL);
+	bool ok = trace_open(p);
+	env->ReleaseStringUTFChars(process, p);
+	return ok;
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituTrace_active(JNIEnv *env, jobject thisObj) {
+	return trace_active();
+}
+
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituTrace_name(JNIEnv *env, jobject thisObj, jstring name) {
+	const char *n = env->GetStringUTFChars(name, NULL);
+	jint id = (jint) trace_name(n);
+	env->ReleaseStringUTFChars(name, n);
+	return id;
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituTrace_now(JNIEnv *env, jobject thisObj) {
+	return (jlong) trace_now();
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_end(JNIEnv *env, jobject thisObj, jint name, jlong start, jlong payload) {
+	if (trace_active() && start > 0)
+		trace_event((uint32_t) name, TRACE_SPAN_EVENT, (uint64_t) start, trace_now() - (uint64_t) start, payload);
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_instant(JNIEnv *env, jobject thisObj, jint name, jlong payload) {
+	if (trace_active())
+		trace_event((uint32_t) name, TRACE_INSTANT_EVENT, trace_now(), 0, payload);
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_counter(JNIEnv *env, jobject thisObj, jint name, jlong value) {
+	if (trace_active())
+		trace_event((uint32_t) name, TRACE_COUNTER_EVENT, trace_now(), 0, value);
+}
+
+#else
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituTrace_open(JNIEnv *env, jobject thisObj, jstring process) {
+	return false;
+}
+
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituTrace_active(JNIEnv *env, jobject thisObj) {
+	return false;
+}
+
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituTrace_name(JNIEnv *env, jobject thisObj, jstring name) {
+	return 0;
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituTrace_now(JNIEnv *env, jobject thisObj) {
+	return 0;
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_end(JNIEnv *env, jobject thisObj, jint name, jlong start, jlong payload) {
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_instant(JNIEnv *env, jobject thisObj, jint name, jlong payload) {
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_counter(JNIEnv *env, jobject thisObj, jint name, jlong value) {
+}
+
+#endif
@@ -0,0 +1,69 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class InSituTrace */
+
+#ifndef _Included_InSituTrace
+#define _Included_InSituTrace
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     InSituTrace
+ * Method:    open
+ * Signature: (Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituTrace_open
+  (JNIEnv *, jobject, jstring);
+
+/*
+ * Class:     InSituTrace
+ * Method:    active
+ * Signature: ()Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_InSituTrace_active
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     InSituTrace
+ * Method:    name
+ * Signature: (Ljava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_InSituTrace_name
+  (JNIEnv *, jobject, jstring);
+
+/*
+ * Class:     InSituTrace
+ * Method:    now
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_InSituTrace_now
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     InSituTrace
+ * Method:    end
+ * Signature: (IJJ)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_end
+  (JNIEnv *, jobject, jint, jlong, jlong);
+
+/*
+ * Class:     InSituTrace
+ * Method:    instant
+ * Signature: (IJ)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_instant
+  (JNIEnv *, jobject, jint, jlong);
+
+/*
+ * Class:     InSituTrace
+ * Method:    counter
+ * Signature: (IJ)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_InSituTrace_counter
+  (JNIEnv *, jobject, jint, jlong);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,43 @@
+package graphics.scenery.insitu
+
+/**
+ * Hot-path tracing (TraceRecorder.hpp in libinsitu) from Kotlin: spans, instants and counters go into the
+ * same per-thread rings in shared memory as those of the native code, so that insitu_trace shows the
+ * renderer's frame loop next to the allocator and stream waits it calls. Register each event name once
+ * with [name] and keep the id; recording costs a JNI call and no allocation, nothing is printed.
+ */
+object InSituTrace {
+
+    init {
+        System.loadLibrary("insitu")
+    }
+
+    /** Starts tracing this process under [process], or renames it; also done by INSITU_TRACE. */
+    external fun open(process: String): Boolean
+
+    /** Whether events are being recorded. */
+    external fun active(): Boolean
+
+    /** The id of the event [name], the same for every call with it. */
+    external fun name(name: String): Int
+
+    /** Nanoseconds on the clock of the trace, CLOCK_MONOTONIC. */
+    external fun now(): Long
+
+    /** Records a span of [name] from [start], as returned by [now], until now. */
+    external fun end(name: Int, start: Long, payload: Long)
+
+    external fun instant(name: Int, payload: Long)
+
+    external fun counter(name: Int, value: Long)
+
+    /** Runs [block] as a span of [name]. */
+    inline fun <T> span(name: Int, payload: Long = 0, block: () -> T): T {
+        val start = now()
+        try {
+            return block()
+        } finally {
+            end(name, start, payload)
+        }
+    }
+}
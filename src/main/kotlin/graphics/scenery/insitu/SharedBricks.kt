@@ -0,0 +1,128 @@
+package graphics.scenery.insitu
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * One time step of volume bricks published by a simulation rank with BrickPublisher (BrickPublisher.hpp),
+ * read in place from the buffer of a stream slot. [grids] are slices of that buffer, in native order,
+ * and the other arrays are laid out as updateData of the volume renderers expects them: three ints of
+ * [origins], six of [gridDims] (start and end coordinates) and six of [domainDims] per grid, so a
+ * table can be handed over without copying any voxels.
+ */
+class BrickTable internal constructor(
+    val grids: Array<ByteBuffer?>,
+    val dtypes: IntArray,
+    val dims: IntArray,
+    val ghosts: IntArray,
+    val origins: IntArray,
+    val gridDims: IntArray,
+    val domainDims: IntArray
+) {
+    var step = 0L
+        internal set
+
+    val numGrids get() = grids.size
+
+    companion object {
+        // layout of BrickTableHeader and BrickDescriptor
+        const val MAGIC = "BRICKS01"
+        const val VERSION = 1
+        const val HEADER_BYTES = 64
+        const val DESCRIPTOR_BYTES = 72
+        const val STEP = 16
+        const val COMPLETE = 24
+        const val DOMAIN = 32
+
+        const val UINT8 = 0
+        const val UINT16 = 1
+        const val INT16 = 2
+        const val FLOAT32 = 3
+        const val FLOAT64 = 4
+
+        private val magic = MAGIC.toByteArray()
+
+        /** Whether [segment], in native order, holds a table that its producer has published. */
+        fun complete(segment: ByteBuffer): Boolean {
+            if(segment.capacity() < HEADER_BYTES || segment.getInt(COMPLETE) == 0) {
+                return false
+            }
+            for(i in magic.indices) {
+                if(segment.get(i) != magic[i]) {
+                    return false
+                }
+            }
+            return segment.getInt(8) == VERSION
+        }
+
+        /** Reads the table of a published step from [slot], or returns null if there is none. */
+        fun read(slot: ByteBuffer): BrickTable? {
+            val segment = slot.duplicate().order(ByteOrder.nativeOrder())
+            if(!complete(segment)) {
+                return null
+            }
+            val n = segment.getInt(12)
+            if(HEADER_BYTES + n.toLong() * DESCRIPTOR_BYTES > segment.capacity()) {
+                return null
+            }
+            val domain = IntArray(6) { segment.getInt(DOMAIN + 4 * it) }
+            val table = BrickTable(arrayOfNulls(n), IntArray(n), IntArray(3 * n), IntArray(n), IntArray(3 * n), IntArray(6 * n), IntArray(6 * n))
+            for(i in 0 until n) {
+                val d = HEADER_BYTES + i * DESCRIPTOR_BYTES
+                table.dtypes[i] = segment.getInt(d)
+                table.ghosts[i] = segment.getInt(d + 4)
+                for(k in 0 until 3) {
+                    table.dims[3 * i + k] = segment.getInt(d + 8 + 4 * k)
+                    table.origins[3 * i + k] = segment.getInt(d + 20 + 4 * k)
+                }
+                for(k in 0 until 6) {
+                    table.gridDims[6 * i + k] = segment.getInt(d + 32 + 4 * k)
+                    table.domainDims[6 * i + k] = domain[k]
+                }
+                val offset = segment.getLong(d + 56)
+                val bytes = segment.getLong(d + 64)
+                if(offset + bytes > segment.capacity()) {
+                    return null
+                }
+                val grid = segment.duplicate()
+                grid.limit((offset + bytes).toInt())
+                grid.position(offset.toInt())
+                table.grids[i] = grid.slice().order(ByteOrder.nativeOrder())
+            }
+            table.step = segment.getLong(STEP)
+            return table
+        }
+    }
+}
+
+/**
+ * The brick tables of one stream, cached per slot. Slots are pinned (see [InSituStreams]), so once both
+ * slots have been seen, [update] only reads the step number of each new frame and returns the cached
+ * table with its slices, and a renderer can swap time points without allocating.
+ */
+class SharedBricks {
+    private val slots = arrayOfNulls<ByteBuffer>(2)
+    private val ordered = arrayOfNulls<ByteBuffer>(2)
+    private val tables = arrayOfNulls<BrickTable>(2)
+
+    /**
+     * Returns the table in [buffer], the buffer of [slot] of a frame just acquired, or null if its step
+     * has not been published yet; poll again until it is.
+     */
+    fun update(slot: Int, buffer: ByteBuffer): BrickTable? {
+        val cached = tables[slot]
+        if(cached != null && slots[slot] === buffer) {
+            val segment = ordered[slot]!!
+            if(!BrickTable.complete(segment)) {
+                return null
+            }
+            cached.step = segment.getLong(BrickTable.STEP)
+            return cached
+        }
+        val table = BrickTable.read(buffer) ?: return null
+        slots[slot] = buffer
+        ordered[slot] = buffer.duplicate().order(ByteOrder.nativeOrder())
+        tables[slot] = table
+        return table
+    }
+}
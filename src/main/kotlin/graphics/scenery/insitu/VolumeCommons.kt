@@ -12,6 +12,7 @@ import org.lwjgl.system.MemoryUtil
 import org.slf4j.Logger
 import java.io.FileInputStream
 import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import java.nio.file.Files
 import java.nio.file.Path
 import java.nio.file.Paths
@@ -64,6 +65,73 @@ class VolumeCommons (val windowWidth: Int, val windowHeight: Int, val dataset: S
         true
     }
 
+    /**
+     * Whether [fromPathRaw] maps the raw files with [InSituLoader], faulting them in with all cores,
+     * rather than streaming them through the JVM. Turned off if libinsitu cannot be loaded.
+     */
+    var nativeLoading = true
+
+    /**
+     * Pyramid level [fromPathRaw] loads volumes at, each level halving the resolution of the one before
+     * along every axis with a box filter (BrickPyramid.cpp), so a far away camera or a slow link gets an
+     * eighth of the voxels per level. 0 is full resolution; needs libinsitu.
+     */
+    var levelOfDetail = 0
+
+    /** Dimensions of a volume of [dims] voxels at [levelOfDetail]. */
+    fun levelDims(dims: Vector3i) = if(levelOfDetail > 0) {
+        Vector3i(InSituAnalysis.levelDims(intArrayOf(dims.x, dims.y, dims.z), levelOfDetail))
+    } else {
+        dims
+    }
+
+    // returns full, of dims voxels, at levelOfDetail, releasing it if it had to be downsampled
+    private fun coarsen(full: ByteBuffer, dims: Vector3i, is16bit: Boolean, mapped: Boolean): ByteBuffer {
+        if(levelOfDetail <= 0) {
+            return full
+        }
+        val dtype = if(is16bit) BrickTable.UINT16 else BrickTable.UINT8
+        val numBytes = if(is16bit) 2 else 1
+        val numThreads = Runtime.getRuntime().availableProcessors()
+
+        var level = full
+        var levelDims = intArrayOf(dims.x, dims.y, dims.z)
+        for(l in 1..levelOfDetail) {
+            val next = InSituAnalysis.levelDims(levelDims, 1)
+            val out = MemoryUtil.memAlloc(numBytes * next[0] * next[1] * next[2])
+            if(!InSituAnalysis.downsample(level, dtype, levelDims[0], levelDims[1], levelDims[2], InSituAnalysis.BOX, out, numThreads)) {
+                throw IllegalStateException("Could not downsample a volume of ${levelDims.joinToString("x")} voxels")
+            }
+            if(level !== full) {
+                MemoryUtil.memFree(level)
+            }
+            level = out
+            levelDims = next
+        }
+
+        if(mapped) {
+            InSituLoader.release(full)
+        } else {
+            MemoryUtil.memFree(full)
+        }
+        logger.debug("Downsampled to level $levelOfDetail, ${levelDims.joinToString("x")} voxels")
+        return level.order(ByteOrder.nativeOrder())
+    }
+
+    private fun mapNative(file: Path, bytes: Long): ByteBuffer? {
+        if(!nativeLoading) {
+            return null
+        }
+        return try {
+            InSituLoader.mapRaw(file.toString(), bytes, InSituLoader.ADVISE_SEQUENTIAL, Runtime.getRuntime().availableProcessors())
+                ?.order(ByteOrder.nativeOrder())
+        } catch (e: LinkageError) {
+            logger.warn("Could not load libinsitu, reading volumes through the JVM: ${e.message}")
+            nativeLoading = false
+            null
+        }
+    }
+
     /**
      * Reads raw volumetric data from a [file].
      *
@@ -97,13 +165,21 @@ class VolumeCommons (val windowWidth: Int, val windowHeight: Int, val dataset: S
             val buffer: ByteBuffer by lazy {
 
                 logger.debug("Loading $id from disk")
-                val buffer = ByteArray(1024 * 1024)
-                val stream = FileInputStream(v.toFile())
                 val numBytes = if(is16bit) {
                     2
                 } else {
                     1
                 }
+
+                val mapStart = System.nanoTime()
+                val mapped = mapNative(v, numBytes.toLong() * dimensions.x * dimensions.y * dimensions.z)
+                if(mapped != null) {
+                    logger.debug("Mapping ${mapped.capacity()} bytes of ${v.fileName} took ${(System.nanoTime() - mapStart) / 10e5} ms")
+                    return@lazy coarsen(mapped, dimensions, is16bit, true)
+                }
+
+                val buffer = ByteArray(1024 * 1024)
+                val stream = FileInputStream(v.toFile())
                 val imageData: ByteBuffer = MemoryUtil.memAlloc((numBytes * dimensions.x * dimensions.y * dimensions.z))
 
                 logger.debug("${v.fileName}: Allocated ${imageData.capacity()} bytes for image of $dimensions containing $numBytes per voxel")
@@ -118,16 +194,17 @@ class VolumeCommons (val windowWidth: Int, val windowHeight: Int, val dataset: S
                 logger.debug("Reading took $duration ms")
 
                 imageData.flip()
-                imageData
+                coarsen(imageData, dimensions, is16bit, false)
             }
 
             volumes.add(BufferedVolume.Timepoint(id, buffer))
         }
 
+        val loaded = levelDims(dimensions)
         return if(is16bit) {
-            Volume.fromBuffer(volumes, dimensions.x, dimensions.y, dimensions.z, UnsignedShortType(), hub)
+            Volume.fromBuffer(volumes, loaded.x, loaded.y, loaded.z, UnsignedShortType(), hub)
         } else {
-            Volume.fromBuffer(volumes, dimensions.x, dimensions.y, dimensions.z, UnsignedByteType(), hub)
+            Volume.fromBuffer(volumes, loaded.x, loaded.y, loaded.z, UnsignedByteType(), hub)
         }
     }
 
@@ -226,6 +303,31 @@ class VolumeCommons (val windowWidth: Int, val windowHeight: Int, val dataset: S
         return tf
     }
 
+    /**
+     * Sets up a ramp transfer function over the value range actually present in [data], e.g. a volume
+     * published in situ. The range is computed in place by [InSituAnalysis], without copying [data].
+     */
+    fun setupTransferFunction(data: ByteBuffer, numThreads: Int = Runtime.getRuntime().availableProcessors()) : TransferFunction {
+        val dtype = if(is16bit) InSituAnalysis.UINT16 else InSituAnalysis.UINT8
+        val typeMax = if(is16bit) 65535.0 else 255.0
+
+        val stats = InSituAnalysis.stats(data, dtype, numThreads)
+        val low = (stats[InSituAnalysis.MIN] / typeMax).toFloat()
+        val high = (stats[InSituAnalysis.MAX] / typeMax).toFloat()
+        logger.info("Data range for transfer function: [$low, $high], mean ${stats[InSituAnalysis.MEAN] / typeMax}")
+
+        val tf = TransferFunction()
+        with(tf) {
+            addControlPoint(0.0f, 0.0f)
+            if(high > low) {
+                addControlPoint(low, 0.0f)
+                addControlPoint(high, 1.0f)
+            }
+            addControlPoint(1.0f, 1.0f)
+        }
+        return tf
+    }
+
     fun setColorMap(volume: BufferedVolume) {
         volume.name = "volume"
         volume.colormap = Colormap.get("hot")
@@ -247,7 +349,7 @@ class VolumeCommons (val windowWidth: Int, val windowHeight: Int, val dataset: S
 //        val datasetPath = Paths.get("/scratch/ws/1/argupta-distributed_vdis/Datasets/${dataset}")
 
 
-        val pixelToWorld = (0.0075f * 512f) / volumeDims.x
+        val pixelToWorld = (0.0075f * 512f) / volumeDims.x * (1 shl levelOfDetail)
 
         val parent = RichNode()
 
@@ -0,0 +1,209 @@
+/*
+ * In situ analysis kernels
+ *
+ *
+ *
+ */
+
+#include <vector>
+#include <cstring>
+
+#include "AnalysisKernels.hpp"
+#include "ParallelChunks.hpp"
+
+#define SUBHISTS 4         // histogram copies per thread, hides store-to-load dependencies between equal bins
+
+// partial moments of one chunk, sums taken relative to shift (the first value) for stability
+struct Partial {
+	double min, max;
+	double shift, sum, sumsq;
+	size_t n;
+};
+
+template <typename T>
+static Partial stats_chunk(const T *x, size_t n)
+{
+	Partial p;
+	p.n = n;
+	p.sum = p.sumsq = 0;
+	if (n == 0) {
+		p.min = p.max = p.shift = 0;
+		return p;
+	}
+	p.shift = (double) x[0];
+
+	T lmin[LANES], lmax[LANES];
+	double lsum[LANES], lsq[LANES];
+	for (int l = 0; l < LANES; ++l) {
+		lmin[l] = lmax[l] = x[0];
+		lsum[l] = lsq[l] = 0;
+	}
+
+	size_t i = 0;
+	for (; i + LANES <= n; i += LANES) {
+		for (int l = 0; l < LANES; ++l) {
+			T v = x[i+l];
+			lmin[l] = v < lmin[l] ? v : lmin[l];
+			lmax[l] = v > lmax[l] ? v : lmax[l];
+			double d = (double) v - p.shift;
+			lsum[l] += d;
+			lsq[l]  += d*d;
+		}
+	}
+	for (; i < n; ++i) { // remainder goes to lane 0
+		T v = x[i];
+		lmin[0] = v < lmin[0] ? v : lmin[0];
+		lmax[0] = v > lmax[0] ? v : lmax[0];
+		double d = (double) v - p.shift;
+		lsum[0] += d;
+		lsq[0]  += d*d;
+	}
+
+	p.min = (double) lmin[0];
+	p.max = (double) lmax[0];
+	for (int l = 0; l < LANES; ++l) {
+		if (lmin[l] < p.min) p.min = (double) lmin[l];
+		if (lmax[l] > p.max) p.max = (double) lmax[l];
+		p.sum   += lsum[l];
+		p.sumsq += lsq[l];
+	}
+	return p;
+}
+
+template <typename T>
+static FieldStats stats(const T *x, size_t n, int nthreads)
+{
+	std::vector<Partial> parts(nthreads < 1 ? 1 : nthreads);
+	for (size_t t = 0; t < parts.size(); ++t)
+		parts[t].n = 0;
+
+	parallel_chunks(n, nthreads, [&](size_t begin, size_t end, int t) {
+		parts[t] = stats_chunk(x + begin, end - begin);
+	});
+
+	// merge chunks pairwise (Chan et al.), each chunk contributing its mean and sum of squared deviations
+	FieldStats st;
+	st.count = 0;
+	st.min = st.max = st.mean = st.var = 0;
+	double m2 = 0;
+	for (size_t t = 0; t < parts.size(); ++t) {
+		const Partial &p = parts[t];
+		if (p.n == 0)
+			continue;
+		double mean = p.shift + p.sum / p.n;
+		double pm2 = p.sumsq - p.sum * p.sum / p.n;
+		if (st.count == 0) {
+			st.min = p.min;
+			st.max = p.max;
+			st.mean = mean;
+			m2 = pm2;
+		} else {
+			size_t total = st.count + p.n;
+			double delta = mean - st.mean;
+			st.mean += delta * p.n / total;
+			m2 += pm2 + delta * delta * ((double) st.count * p.n / total);
+			if (p.min < st.min) st.min = p.min;
+			if (p.max > st.max) st.max = p.max;
+		}
+		st.count += p.n;
+	}
+	if (st.count > 0)
+		st.var = (m2 > 0) ? m2 / st.count : 0;
+	return st;
+}
+
+template <typename T>
+static void histogram(const T *x, size_t n, double lo, double hi, int nbins, uint64_t *bins, int nthreads)
+{
+	if (nbins <= 0 || !(hi > lo))
+		return;
+
+	const double scale = nbins / (hi - lo);
+	std::vector<uint64_t> local((size_t) (nthreads < 1 ? 1 : nthreads) * SUBHISTS * nbins, 0);
+
+	parallel_chunks(n, nthreads, [&](size_t begin, size_t end, int t) {
+		uint64_t *h = &local[(size_t) t * SUBHISTS * nbins];
+		for (size_t i = begin; i < end; ++i) {
+			double v = (double) x[i];
+			if (!(v >= lo && v <= hi)) // also skips NaN
+				continue;
+			int b = (int) ((v - lo) * scale);
+			if (b == nbins) // v == hi lands in the last bin
+				--b;
+			++h[(i % SUBHISTS) * nbins + b];
+		}
+	});
+
+	for (size_t k = 0; k < local.size(); ++k)
+		bins[k % nbins] += local[k];
+}
+
+template <typename T>
+static size_t threshold(const T *x, size_t n, double thresh, int nthreads)
+{
+	std::vector<size_t> counts(nthreads < 1 ? 1 : nthreads, 0);
+
+	parallel_chunks(n, nthreads, [&](size_t begin, size_t end, int t) {
+		size_t lcnt[LANES];
+		for (int l = 0; l < LANES; ++l)
+			lcnt[l] = 0;
+		size_t i = begin;
+		for (; i + LANES <= end; i += LANES)
+			for (int l = 0; l < LANES; ++l)
+				lcnt[l] += ((double) x[i+l] >= thresh);
+		for (; i < end; ++i)
+			lcnt[0] += ((double) x[i] >= thresh);
+		for (int l = 0; l < LANES; ++l)
+			counts[t] += lcnt[l];
+	});
+
+	size_t total = 0;
+	for (size_t t = 0; t < counts.size(); ++t)
+		total += counts[t];
+	return total;
+}
+
+size_t dtype_size(int dtype)
+{
+	switch (dtype) {
+		case DTYPE_UINT8:  return sizeof(uint8_t);
+		case DTYPE_UINT16: return sizeof(uint16_t);
+		case DTYPE_FLOAT:  return sizeof(float);
+		case DTYPE_DOUBLE: return sizeof(double);
+		default:           return 0;
+	}
+}
+
+FieldStats field_stats(const void *data, int dtype, size_t n, int nthreads)
+{
+	switch (dtype) {
+		case DTYPE_UINT8:  return stats((const uint8_t *)  data, n, nthreads);
+		case DTYPE_UINT16: return stats((const uint16_t *) data, n, nthreads);
+		case DTYPE_FLOAT:  return stats((const float *)    data, n, nthreads);
+		case DTYPE_DOUBLE: return stats((const double *)   data, n, nthreads);
+	}
+	FieldStats st;
+	memset(&st, 0, sizeof(st));
+	return st;
+}
+
+void field_histogram(const void *data, int dtype, size_t n, double lo, double hi, int nbins, uint64_t *bins, int nthreads)
+{
+	switch (dtype) {
+		case DTYPE_UINT8:  histogram((const uint8_t *)  data, n, lo, hi, nbins, bins, nthreads); break;
+		case DTYPE_UINT16: histogram((const uint16_t *) data, n, lo, hi, nbins, bins, nthreads); break;
+		case DTYPE_FLOAT:  histogram((const float *)    data, n, lo, hi, nbins, bins, nthreads); break;
+		case DTYPE_DOUBLE: histogram((const double *)   data, n, lo, hi, nbins, bins, nthreads); break;
+	}
+}
+
+size_t field_threshold(const void *data, int dtype, size_t n, double thresh, int nthreads)
+{
+	switch (dtype) {
+		case DTYPE_UINT8:  return threshold((const uint8_t *)  data, n, thresh, nthreads);
+		case DTYPE_UINT16: return threshold((const uint16_t *) data, n, thresh, nthreads);
+		case DTYPE_FLOAT:  return threshold((const float *)    data, n, thresh, nthreads);
+		case DTYPE_DOUBLE: return threshold((const double *)   data, n, thresh, nthreads);
+	}
+	return 0;
+}
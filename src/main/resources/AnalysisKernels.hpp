@@ -0,0 +1,48 @@
+/*
+ * In situ analysis kernels
+ *
+ * Reductions computed in place on a frame, e.g. directly on the pointer returned by
+ * ShmBuffer::attach(), without copying it anywhere first:
+ *
+ * field_stats(data, dtype, n):                 min, max, mean and variance in a single pass
+ * field_histogram(data, dtype, n, lo, hi, ..): counts of values per bin over [lo, hi]
+ * field_threshold(data, dtype, n, thresh):     number of values >= thresh
+ *
+ * Each kernel splits the data into one contiguous chunk per thread (nthreads <= 1 runs inline
+ * on the caller) and keeps LANES independent accumulators per chunk so that the inner loops
+ * are vectorized by the compiler.
+ */
+
+#ifndef ANALYSIS_KERNELS_HPP
+#define ANALYSIS_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#define LANES 8 // independent accumulators per chunk, one SIMD register of floats
+
+enum DType {
+	DTYPE_UINT8  = 0,
+	DTYPE_UINT16 = 1,
+	DTYPE_FLOAT  = 2,
+	DTYPE_DOUBLE = 3
+};
+
+size_t dtype_size(int dtype); // size of one element in bytes, 0 for unknown types
+
+struct FieldStats {
+	double min;
+	double max;
+	double mean;
+	double var;   // population variance
+	size_t count;
+};
+
+FieldStats field_stats(const void *data, int dtype, size_t n, int nthreads = 1);
+
+// add the number of values falling into each of nbins equal bins over [lo, hi] to bins; values outside are ignored
+void field_histogram(const void *data, int dtype, size_t n, double lo, double hi, int nbins, uint64_t *bins, int nthreads = 1);
+
+size_t field_threshold(const void *data, int dtype, size_t n, double thresh, int nthreads = 1);
+
+#endif
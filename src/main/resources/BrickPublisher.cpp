@@ -0,0 +1,146 @@
+/*
+ * Publishing volume bricks of a simulation rank through shared memory
+ *
+ *
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "BrickPublisher.hpp"
+#include "ParallelChunks.hpp"
+
+#define COPYCHUNK (1 << 20) // bytes per thread at least when copying a brick
+
+namespace {
+
+inline size_t aligned(size_t bytes, size_t to)
+{
+	return (bytes + to - 1) / to * to;
+}
+
+}
+
+size_t brick_type_size(int dtype)
+{
+	switch (dtype) {
+	case BRICK_UINT8:   return 1;
+	case BRICK_UINT16:  return 2;
+	case BRICK_INT16:   return 2;
+	case BRICK_FLOAT32: return 4;
+	case BRICK_FLOAT64: return 8;
+	default:            return 0;
+	}
+}
+
+BrickPublisher::BrickPublisher(std::string pname, int rank) : alloc(pname, rank), bytes(0), current(NULL), published(NULL)
+{
+	memset(domain, 0, sizeof(domain));
+}
+
+BrickPublisher::~BrickPublisher()
+{
+	alloc.shm_free(published);
+	alloc.shm_free(current);
+}
+
+int BrickPublisher::add_brick(int dtype, const int dims[3], int ghost, const int origin[3], const int extent[6])
+{
+	size_t size = brick_type_size(dtype);
+	if (size == 0 || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0 || ghost < 0) {
+		fprintf(stderr, "BrickPublisher: brick of type %d and %d x %d x %d voxels not supported\n", dtype, dims[0], dims[1], dims[2]);
+		return -1;
+	}
+
+	BrickDescriptor d;
+	memset(&d, 0, sizeof(d));
+	d.dtype = (uint32_t) dtype;
+	d.ghost = (uint32_t) ghost;
+	for (int k = 0; k < 3; ++k) {
+		d.dims[k] = dims[k];
+		d.origin[k] = origin[k];
+	}
+	for (int k = 0; k < 6; ++k)
+		d.extent[k] = extent[k];
+	d.bytes = size * dims[0] * dims[1] * dims[2];
+	layout.push_back(d);
+
+	// the table grows, so every brick moves
+	bytes = aligned(sizeof(BrickTableHeader) + layout.size() * sizeof(BrickDescriptor), BRICK_ALIGN);
+	for (size_t i = 0; i < layout.size(); ++i) {
+		layout[i].offset = bytes;
+		bytes += aligned(layout[i].bytes, BRICK_ALIGN);
+	}
+	return (int) layout.size() - 1;
+}
+
+void BrickPublisher::set_domain(const int domain[6])
+{
+	for (int k = 0; k < 6; ++k)
+		this->domain[k] = domain[k];
+}
+
+void *BrickPublisher::begin_step(long step)
+{
+	if (layout.empty()) {
+		fprintf(stderr, "BrickPublisher: no bricks to publish\n");
+		return NULL;
+	}
+	if (current != NULL) {
+		fprintf(stderr, "BrickPublisher: step begun before the last one was published\n");
+		return current;
+	}
+
+	current = (char *) alloc.shm_alloc(bytes);
+	if (current == NULL) {
+		perror("BrickPublisher");
+		return NULL;
+	}
+	BrickTableHeader *h = (BrickTableHeader *) current;
+	memset(h, 0, sizeof(BrickTableHeader));
+	memcpy(h->magic, BRICK_MAGIC, sizeof(h->magic));
+	h->version = BRICK_VERSION;
+	h->nbricks = (uint32_t) layout.size();
+	h->step = step;
+	memcpy(h->domain, domain, sizeof(domain));
+	h->bytes = bytes;
+	memcpy(h + 1, layout.data(), layout.size() * sizeof(BrickDescriptor));
+	return current;
+}
+
+bool BrickPublisher::copy_brick(int i, const void *src, int nthreads)
+{
+	if (current == NULL || i < 0 || i >= (int) layout.size())
+		return false;
+	char *dst = current + layout[i].offset;
+	parallel_chunks(layout[i].bytes, nthreads, [&](size_t begin, size_t end, int) {
+		memcpy(dst + begin, (const char *) src + begin, end - begin);
+	}, COPYCHUNK);
+	return true;
+}
+
+void BrickPublisher::publish()
+{
+	if (current == NULL)
+		return;
+	__atomic_store_n(&((BrickTableHeader *) current)->complete, 1u, __ATOMIC_RELEASE);
+	alloc.shm_free(published);
+	published = current;
+	current = NULL;
+}
+
+const BrickTableHeader *brick_table(const void *segment, size_t bytes)
+{
+	const BrickTableHeader *h = (const BrickTableHeader *) segment;
+	if (segment == NULL || bytes < sizeof(BrickTableHeader) || __atomic_load_n(&h->complete, __ATOMIC_ACQUIRE) == 0)
+		return NULL;
+	if (memcmp(h->magic, BRICK_MAGIC, sizeof(h->magic)) != 0 || h->version != BRICK_VERSION || h->bytes > bytes
+			|| sizeof(BrickTableHeader) + h->nbricks * sizeof(BrickDescriptor) > bytes)
+		return NULL;
+	const BrickDescriptor *d = brick_descriptors(h);
+	for (uint32_t i = 0; i < h->nbricks; ++i)
+		if (d[i].offset % BRICK_ALIGN != 0 || d[i].offset + d[i].bytes > h->bytes)
+			return NULL;
+	return h;
+}
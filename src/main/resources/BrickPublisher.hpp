@@ -0,0 +1,110 @@
+/*
+ * Publishing volume bricks of a simulation rank through shared memory
+ *
+ * ShmAllocator publishes flat segments; a volume renderer needs to know what is in them. A rank
+ * publishes its grids as a set of 3D bricks, one segment per time step holding a descriptor table
+ * followed by the voxels of every brick:
+ *
+ *     BrickTableHeader | BrickDescriptor per brick | voxels of brick 0, BRICK_ALIGN aligned | ...
+ *
+ * The layout (the bricks' type, dimensions, ghost layers, origin and extent, and the domain) is set
+ * once with add_brick and set_domain, so every step has the same size, segment_bytes(), which
+ * consumers open their stream with. Per time step:
+ *
+ * begin_step(step): allocate the step's segment and write its table, return NULL on failure
+ * brick(i):         the voxels of brick i, for the simulation to write into, or copy_brick(i, src)
+ * publish():        mark the step complete and free the previous step's segment
+ *
+ * ShmAllocator signals a segment to consumers as soon as it is allocated, so readers check the
+ * table's complete flag, set last with release semantics; brick_table returns NULL until it is set.
+ * A step that the allocator had to place on the heap, because the consumer still holds both
+ * segments, is written but never seen.
+ *
+ * On the consumer side the bricks are used in place: brick_table validates a segment and
+ * brick_voxels points to a brick's voxels. With pinned stream slots (ShmStreams.hpp), a renderer
+ * can wrap every brick of both slots once and swap time points without allocating; SharedBricks.kt
+ * reads the same layout from the slot's ByteBuffer.
+ *
+ * Extents follow updateData of the volume renderers: origin is the grid's origin, extent its start
+ * and end coordinates, domain the start and end coordinates of the whole domain, all in voxels.
+ */
+
+#ifndef BRICK_PUBLISHER_HPP
+#define BRICK_PUBLISHER_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "ShmAllocator.hpp"
+
+#define BRICK_MAGIC "BRICKS01"
+#define BRICK_VERSION 1
+#define BRICK_ALIGN 4096 // of every brick's voxels in the segment
+
+enum BrickType {
+	BRICK_UINT8   = 0,
+	BRICK_UINT16  = 1,
+	BRICK_INT16   = 2,
+	BRICK_FLOAT32 = 3,
+	BRICK_FLOAT64 = 4
+};
+
+struct BrickTableHeader {   // 64 bytes
+	char magic[8];
+	uint32_t version;
+	uint32_t nbricks;
+	int64_t step;
+	uint32_t complete;      // set by publish, read with acquire semantics
+	uint32_t reserved;
+	int32_t domain[6];
+	uint64_t bytes;         // of the segment
+};
+
+struct BrickDescriptor {    // 72 bytes
+	uint32_t dtype;         // BrickType
+	uint32_t ghost;         // layers on every side, included in dims
+	int32_t dims[3];        // voxels along x, y and z
+	int32_t origin[3];
+	int32_t extent[6];
+	uint64_t offset;        // of the voxels from the start of the segment
+	uint64_t bytes;
+};
+
+size_t brick_type_size(int dtype); // 0 for an unknown type
+
+class BrickPublisher {
+
+	ShmAllocator alloc;
+	std::vector<BrickDescriptor> layout;
+	int32_t domain[6];
+	size_t bytes;           // of a step's segment
+	char *current, *published; // the step being written and the one before it
+
+public:
+
+	BrickPublisher(std::string pname, int rank);
+	~BrickPublisher();
+
+	BrickPublisher(const BrickPublisher &) = delete;
+	BrickPublisher &operator=(const BrickPublisher &) = delete;
+
+	// append a brick to the layout, return its index or -1 if dtype is unknown; dims include the ghost layers
+	int add_brick(int dtype, const int dims[3], int ghost, const int origin[3], const int extent[6]);
+	void set_domain(const int domain[6]);
+	size_t bricks() const { return layout.size(); }
+	size_t segment_bytes() const { return bytes; }
+
+	void *begin_step(long step);
+	void *brick(int i) const { return current ? current + layout[i].offset : NULL; }
+	bool copy_brick(int i, const void *src, int nthreads = 1);
+	void publish();
+};
+
+// NULL unless segment holds a complete brick table that fits into bytes
+const BrickTableHeader *brick_table(const void *segment, size_t bytes);
+inline const BrickDescriptor *brick_descriptors(const BrickTableHeader *table) { return (const BrickDescriptor *) (table + 1); }
+inline const void *brick_voxels(const BrickTableHeader *table, int i) { return (const char *) table + brick_descriptors(table)[i].offset; }
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * Multiresolution pyramids of volume bricks
+ *
+ *
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#include "BrickPyramid.hpp"
+#include "ParallelChunks.hpp"
+
+#define ROWCHUNK 64 // destination rows per thread at least
+
+namespace {
+
+// integers are summed in 32 bits, enough for eight 16 bit values, and rounded to nearest
+template <typename T> struct Box {
+	typedef int32_t sum;
+	static T mean(int32_t s) { return (T) ((s + 4) >> 3); }
+};
+
+template <> struct Box<float> {
+	typedef float sum;
+	static float mean(float s) { return s * 0.125f; }
+};
+
+template <> struct Box<double> {
+	typedef double sum;
+	static double mean(double s) { return s * 0.125; }
+};
+
+// floor(v / 2^l) and ceil(n / 2^l)
+inline int coarse(int v, int l)
+{
+	return (v >= 0) ? v >> l : -((-v + (1 << l) - 1) >> l);
+}
+
+inline int coarse_length(int n, int l)
+{
+	return (n + (1 << l) - 1) >> l;
+}
+
+template <typename T, bool MAX>
+void downsample(const T *src, const int dims[3], T *dst, int nthreads, int zbegin, int zend)
+{
+	typedef typename std::conditional<MAX, T, typename Box<T>::sum>::type A;
+
+	int out[3];
+	pyramid_level_dims(dims, 1, out);
+	const size_t sx = dims[0], sy = dims[1], sz = dims[2];
+	const size_t dx = out[0], dy = out[1], pairs = sx / 2;
+
+	parallel_chunks((size_t) (zend - zbegin) * dy, nthreads, [&](size_t begin, size_t end, int) {
+		std::vector<A> row(sx);
+		A *t = row.data();
+		for (size_t r = begin; r < end; ++r) {
+			size_t z = zbegin + r / dy, y = r % dy;
+			size_t z0 = 2 * z, z1 = std::min(2 * z + 1, sz - 1), y0 = 2 * y, y1 = std::min(2 * y + 1, sy - 1);
+			const T *a = src + (z0 * sy + y0) * sx, *b = src + (z0 * sy + y1) * sx;
+			const T *c = src + (z1 * sy + y0) * sx, *d = src + (z1 * sy + y1) * sx;
+			T *o = dst + (z * dy + y) * dx;
+
+			// the four source rows elementwise, then pairs along x; an odd last column counts twice
+			if (MAX) {
+				for (size_t x = 0; x < sx; ++x) {
+					A ab = a[x] > b[x] ? a[x] : b[x], cd = c[x] > d[x] ? c[x] : d[x];
+					t[x] = ab > cd ? ab : cd;
+				}
+				for (size_t x = 0; x < pairs; ++x)
+					o[x] = t[2*x] > t[2*x+1] ? t[2*x] : t[2*x+1];
+				if (sx % 2)
+					o[pairs] = t[sx-1];
+			} else {
+				for (size_t x = 0; x < sx; ++x)
+					t[x] = (A) a[x] + (A) b[x] + (A) c[x] + (A) d[x];
+				for (size_t x = 0; x < pairs; ++x)
+					o[x] = Box<T>::mean(t[2*x] + t[2*x+1]);
+				if (sx % 2)
+					o[pairs] = Box<T>::mean(t[sx-1] + t[sx-1]);
+			}
+		}
+	}, ROWCHUNK);
+}
+
+template <typename T>
+void downsample(const T *src, const int dims[3], T *dst, int filter, int nthreads, int zbegin, int zend)
+{
+	if (filter == PYRAMID_MAX)
+		downsample<T, true>(src, dims, dst, nthreads, zbegin, zend);
+	else
+		downsample<T, false>(src, dims, dst, nthreads, zbegin, zend);
+}
+
+}
+
+size_t pyramid_level_dims(const int dims[3], int level, int out[3])
+{
+	size_t n = 1;
+	for (int k = 0; k < 3; ++k) {
+		out[k] = std::max(coarse_length(dims[k], level), 1);
+		n *= out[k];
+	}
+	return n;
+}
+
+bool downsample_brick(const void *src, int dtype, const int dims[3], void *dst, int filter, int nthreads, int zbegin, int zend)
+{
+	int out[3];
+	pyramid_level_dims(dims, 1, out);
+	if (zend < 0)
+		zend = out[2];
+	if ((filter != PYRAMID_BOX && filter != PYRAMID_MAX) || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0
+			|| zbegin < 0 || zend > out[2])
+		return false;
+	if (zbegin >= zend)
+		return true;
+
+	switch (dtype) {
+	case BRICK_UINT8:   downsample((const uint8_t *) src, dims, (uint8_t *) dst, filter, nthreads, zbegin, zend); return true;
+	case BRICK_UINT16:  downsample((const uint16_t *) src, dims, (uint16_t *) dst, filter, nthreads, zbegin, zend); return true;
+	case BRICK_INT16:   downsample((const int16_t *) src, dims, (int16_t *) dst, filter, nthreads, zbegin, zend); return true;
+	case BRICK_FLOAT32: downsample((const float *) src, dims, (float *) dst, filter, nthreads, zbegin, zend); return true;
+	case BRICK_FLOAT64: downsample((const double *) src, dims, (double *) dst, filter, nthreads, zbegin, zend); return true;
+	default:            return false;
+	}
+}
+
+BrickPyramid::BrickPyramid(int nlevels, int filter, int nthreads) : nlevels(std::max(nlevels, 1)), filter(filter), nthreads(nthreads)
+{
+	memset(domain, 0, sizeof(domain));
+}
+
+int BrickPyramid::add_brick(int dtype, const int dims[3], int ghost, const int origin[3], const int extent[6])
+{
+	size_t size = brick_type_size(dtype);
+	if (size == 0 || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0 || ghost < 0) {
+		fprintf(stderr, "BrickPyramid: brick of type %d and %d x %d x %d voxels not supported\n", dtype, dims[0], dims[1], dims[2]);
+		return -1;
+	}
+
+	Brick b;
+	b.dtype = dtype;
+	b.ghost = ghost;
+	for (int k = 0; k < 3; ++k) {
+		b.dims[k] = dims[k];
+		b.origin[k] = origin[k];
+	}
+	for (int k = 0; k < 6; ++k)
+		b.extent[k] = extent[k];
+	int d[3];
+	for (int l = 1; l < nlevels; ++l)
+		b.levels.push_back(std::vector<char>(size * pyramid_level_dims(dims, l, d)));
+	bricks.push_back(std::move(b));
+	return (int) bricks.size() - 1;
+}
+
+void BrickPyramid::set_domain(const int domain[6])
+{
+	for (int k = 0; k < 6; ++k)
+		this->domain[k] = domain[k];
+}
+
+bool BrickPyramid::update(int i, const void *voxels, int zbegin, int zend)
+{
+	if (i < 0 || i >= (int) bricks.size())
+		return false;
+	const Brick &b = bricks[i];
+	if (zend < 0)
+		zend = b.dims[2];
+	if (zbegin < 0 || zend > b.dims[2])
+		return false;
+
+	// slices zbegin to zend of a level change slices zbegin / 2 to (zend + 1) / 2 of the next
+	const void *src = voxels;
+	int dims[3];
+	for (int k = 0; k < 3; ++k)
+		dims[k] = b.dims[k];
+	for (int l = 1; l < nlevels && zbegin < zend; ++l) {
+		zbegin /= 2;
+		zend = (zend + 1) / 2;
+		void *dst = (void *) b.levels[l-1].data();
+		if (!downsample_brick(src, b.dtype, dims, dst, filter, nthreads, zbegin, zend))
+			return false;
+		src = dst;
+		pyramid_level_dims(b.dims, l, dims);
+	}
+	return true;
+}
+
+bool BrickPyramid::publish_levels(const std::vector<std::string> &pnames, int rank)
+{
+	if (pnames.size() + 1 < (size_t) nlevels || bricks.empty()) {
+		fprintf(stderr, "BrickPyramid: %zu stream names for %d coarser levels of %zu bricks\n", pnames.size(), nlevels - 1, bricks.size());
+		return false;
+	}
+
+	publishers.clear();
+	for (int l = 1; l < nlevels; ++l) {
+		std::unique_ptr<BrickPublisher> p(new BrickPublisher(pnames[l-1], rank));
+		for (size_t i = 0; i < bricks.size(); ++i) {
+			const Brick &b = bricks[i];
+			int dims[3], origin[3], extent[6];
+			pyramid_level_dims(b.dims, l, dims);
+			for (int k = 0; k < 3; ++k) {
+				origin[k] = coarse(b.origin[k], l);
+				extent[k] = coarse(b.extent[k], l);
+				extent[k+3] = extent[k] + coarse_length(b.extent[k+3] - b.extent[k] + 1, l) - 1;
+			}
+			if (p->add_brick(b.dtype, dims, coarse_length(b.ghost, l), origin, extent) < 0)
+				return false;
+		}
+		int scaled[6];
+		for (int k = 0; k < 3; ++k) {
+			scaled[k] = coarse(domain[k], l);
+			scaled[k+3] = scaled[k] + coarse_length(domain[k+3] - domain[k] + 1, l) - 1;
+		}
+		p->set_domain(scaled);
+		publishers.push_back(std::move(p));
+	}
+	return true;
+}
+
+bool BrickPyramid::publish(long step)
+{
+	if (publishers.empty())
+		return false;
+	for (size_t l = 0; l < publishers.size(); ++l) {
+		BrickPublisher &p = *publishers[l];
+		if (p.begin_step(step) == NULL)
+			return false;
+		for (size_t i = 0; i < bricks.size(); ++i)
+			p.copy_brick((int) i, bricks[i].levels[l].data(), nthreads);
+		p.publish();
+	}
+	return true;
+}
@@ -0,0 +1,92 @@
+/*
+ * Multiresolution pyramids of volume bricks
+ *
+ * A far away camera or a slow link does not need every voxel. Each level of a brick's pyramid halves
+ * the one before it along every axis, ceil(dim / 2) voxels, each the box average (PYRAMID_BOX) or the
+ * maximum (PYRAMID_MAX, which keeps thin bright features) of the 2 x 2 x 2 voxels below it; along an
+ * odd axis the last voxel is used twice. Level 0 is the brick itself and is not kept.
+ *
+ * pyramid_level_dims(dims, level, out): dimensions of a level, at least 1 voxel along each axis
+ * downsample_brick(src, dtype, dims, dst, filter, nthreads, zbegin, zend): one level from the one
+ *     below, only its slices zbegin to zend (exclusive) if given; dtype as in BrickPublisher.hpp
+ *
+ * BrickPyramid keeps the coarser levels of a set of bricks from one time step to the next:
+ *
+ * add_brick(dtype, dims, ghost, origin, extent): as BrickPublisher::add_brick, return the brick's index
+ * update(i, voxels, zbegin, zend): rebuild brick i from its new voxels, of which only slices zbegin to
+ *     zend (exclusive) changed, so that a simulation updating part of its grid only pays for that part
+ * level(i, l), level_dims(i, l, dims): the voxels and dimensions of level l >= 1 of brick i
+ *
+ * The coarser levels can be published as streams of their own, one BrickPublisher per level with a
+ * pname of its own (publish_levels), so a consumer picks a level of detail by the stream it opens and
+ * a renderer moves an eighth of the data per level it goes down. publish(step) copies every level
+ * into its stream's segment. Origins, extents, ghost layers and the domain are scaled down with the
+ * level, rounding starts down, so neighbouring bricks with odd offsets may overlap by a voxel.
+ *
+ * Rows of destination voxels are split over threads. Per row the four source rows it covers are
+ * first combined elementwise, which the compiler vectorizes, and then neighbouring pairs; integers
+ * are summed in 32 bits and rounded to nearest.
+ */
+
+#ifndef BRICK_PYRAMID_HPP
+#define BRICK_PYRAMID_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "BrickPublisher.hpp"
+
+enum PyramidFilter {
+	PYRAMID_BOX = 0,
+	PYRAMID_MAX = 1
+};
+
+size_t pyramid_level_dims(const int dims[3], int level, int out[3]); // returns the number of voxels
+
+// false if dtype or filter is unknown; zend < 0 means the last slice of dst
+bool downsample_brick(const void *src, int dtype, const int dims[3], void *dst, int filter, int nthreads = 1,
+	int zbegin = 0, int zend = -1);
+
+class BrickPyramid {
+
+	struct Brick {
+		int dtype;
+		int dims[3];
+		int ghost;
+		int origin[3];
+		int extent[6];
+		std::vector<std::vector<char> > levels; // 1 to nlevels - 1
+	};
+
+	int nlevels;
+	int filter;
+	int nthreads;
+	int domain[6];
+	std::vector<Brick> bricks;
+	std::vector<std::unique_ptr<BrickPublisher> > publishers; // of levels 1 to nlevels - 1
+
+public:
+
+	// nlevels counts level 0, so 1 keeps no coarser levels
+	BrickPyramid(int nlevels, int filter = PYRAMID_BOX, int nthreads = 1);
+
+	BrickPyramid(const BrickPyramid &) = delete;
+	BrickPyramid &operator=(const BrickPyramid &) = delete;
+
+	int add_brick(int dtype, const int dims[3], int ghost, const int origin[3], const int extent[6]);
+	void set_domain(const int domain[6]);
+	int levels() const { return nlevels; }
+
+	bool update(int i, const void *voxels, int zbegin = 0, int zend = -1);
+	const void *level(int i, int l) const { return bricks[i].levels[l-1].data(); }
+	size_t level_dims(int i, int l, int dims[3]) const { return pyramid_level_dims(bricks[i].dims, l, dims); }
+
+	// one pname per coarser level, each an existing path; call once all bricks are added
+	bool publish_levels(const std::vector<std::string> &pnames, int rank);
+	size_t segment_bytes(int l) const { return publishers[l-1]->segment_bytes(); }
+	bool publish(long step);
+};
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Chunked compression of exchange messages
+ *
+ *
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef WITH_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "ChunkCodec.hpp"
+
+namespace {
+
+#ifdef WITH_ZSTD
+// one context per thread, they are expensive to create for every chunk
+struct ZstdContexts {
+	ZSTD_CCtx *c;
+	ZSTD_DCtx *d;
+	ZstdContexts() : c(ZSTD_createCCtx()), d(ZSTD_createDCtx()) {}
+	~ZstdContexts() { ZSTD_freeCCtx(c); ZSTD_freeDCtx(d); }
+};
+
+ZstdContexts &zstd_contexts()
+{
+	thread_local ZstdContexts contexts;
+	return contexts;
+}
+#endif
+
+inline size_t header_bytes(size_t nchunks)
+{
+	return nchunks * sizeof(uint32_t);
+}
+
+}
+
+bool codec_available(int codec)
+{
+	switch (codec) {
+	case CODEC_NONE:
+		return true;
+#ifdef WITH_LZ4
+	case CODEC_LZ4:
+		return true;
+#endif
+#ifdef WITH_ZSTD
+	case CODEC_ZSTD:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char *codec_name(int codec)
+{
+	switch (codec) {
+	case CODEC_NONE: return "none";
+	case CODEC_LZ4:  return "lz4";
+	case CODEC_ZSTD: return "zstd";
+	default:         return "unknown";
+	}
+}
+
+size_t chunk_bound(int codec, size_t bytes)
+{
+	switch (codec) {
+#ifdef WITH_LZ4
+	case CODEC_LZ4:
+		return (size_t) LZ4_compressBound((int) bytes);
+#endif
+#ifdef WITH_ZSTD
+	case CODEC_ZSTD:
+		return ZSTD_compressBound(bytes);
+#endif
+	default:
+		return bytes;
+	}
+}
+
+size_t compress_chunk(int codec, int level, const void *src, size_t bytes, void *dst, size_t capacity)
+{
+	size_t out = 0;
+	switch (codec) {
+#ifdef WITH_LZ4
+	case CODEC_LZ4: {
+		int n = (level > 0) ? LZ4_compress_HC((const char *) src, (char *) dst, (int) bytes, (int) capacity, level)
+		                    : LZ4_compress_fast((const char *) src, (char *) dst, (int) bytes, (int) capacity, 1 - level);
+		out = (n > 0) ? (size_t) n : 0;
+		break;
+	}
+#endif
+#ifdef WITH_ZSTD
+	case CODEC_ZSTD: {
+		size_t n = ZSTD_compressCCtx(zstd_contexts().c, dst, capacity, src, bytes, level);
+		out = ZSTD_isError(n) ? 0 : n;
+		break;
+	}
+#endif
+	default:
+		(void) level; (void) src; (void) dst; (void) capacity; // unused without codecs
+		break;
+	}
+	return (out < bytes) ? out : 0;
+}
+
+bool decompress_chunk(int codec, const void *src, size_t bytes, void *dst, size_t rawbytes)
+{
+	switch (codec) {
+#ifdef WITH_LZ4
+	case CODEC_LZ4:
+		return LZ4_decompress_safe((const char *) src, (char *) dst, (int) bytes, (int) rawbytes) == (int) rawbytes;
+#endif
+#ifdef WITH_ZSTD
+	case CODEC_ZSTD:
+		return ZSTD_decompressDCtx(zstd_contexts().d, dst, rawbytes, src, bytes) == rawbytes;
+#endif
+	default:
+		(void) src; (void) bytes; (void) dst; (void) rawbytes; // unused without codecs
+		return false;
+	}
+}
+
+ChunkCodec::ChunkCodec(int codec, int level, size_t chunkbytes) : codec(codec), level(level), chunkbytes(chunkbytes ? chunkbytes : CHUNK_BYTES)
+{
+	if (!codec_available(codec)) {
+		fprintf(stderr, "ChunkCodec: %s was not built in\n", codec_name(codec)); std::exit(1);
+	}
+}
+
+size_t ChunkCodec::chunks(size_t bytes) const
+{
+	return (bytes + chunkbytes - 1) / chunkbytes;
+}
+
+size_t ChunkCodec::bound(size_t bytes) const
+{
+	size_t n = chunks(bytes);
+	return n ? header_bytes(n) + (n - 1) * chunk_bound(codec, chunkbytes) + chunk_bound(codec, bytes - (n - 1) * chunkbytes) : 0;
+}
+
+void ChunkCodec::encode(const void *src, size_t bytes, void *out, ThreadPool &pool, std::vector<std::future<void> > &pending) const
+{
+	size_t n = chunks(bytes), stride = chunk_bound(codec, chunkbytes);
+	uint32_t *sizes = (uint32_t *) out;
+	char *data = (char *) out + header_bytes(n);
+
+	for (size_t i = 0; i < n; ++i) {
+		const char *from = (const char *) src + i * chunkbytes;
+		size_t len = (i == n - 1) ? bytes - i * chunkbytes : chunkbytes;
+		char *to = data + i * stride;
+		int c = codec, l = level;
+		pending.push_back(pool.submit([=]() {
+			size_t packed = compress_chunk(c, l, from, len, to, chunk_bound(c, len));
+			if (packed == 0) {
+				memcpy(to, from, len);
+				sizes[i] = (uint32_t) len | RAW_CHUNK;
+			} else {
+				sizes[i] = (uint32_t) packed;
+			}
+		}));
+	}
+}
+
+size_t ChunkCodec::finish(void *out, size_t bytes) const
+{
+	size_t n = chunks(bytes), stride = chunk_bound(codec, chunkbytes);
+	const uint32_t *sizes = (const uint32_t *) out;
+	char *data = (char *) out + header_bytes(n);
+
+	// chunk i only moves down, over space the chunks before it did not use
+	size_t at = 0;
+	for (size_t i = 0; i < n; ++i) {
+		size_t len = sizes[i] & ~RAW_CHUNK;
+		if (at != i * stride)
+			memmove(data + at, data + i * stride, len);
+		at += len;
+	}
+	return header_bytes(n) + at;
+}
+
+void ChunkCodec::decode(const void *msg, size_t rawbytes, void *dst, ThreadPool &pool, std::vector<std::future<void> > &pending) const
+{
+	size_t n = chunks(rawbytes);
+	const uint32_t *sizes = (const uint32_t *) msg;
+	const char *data = (const char *) msg + header_bytes(n);
+
+	size_t at = 0;
+	for (size_t i = 0; i < n; ++i) {
+		const char *from = data + at;
+		size_t len = sizes[i] & ~RAW_CHUNK, rawlen = (i == n - 1) ? rawbytes - i * chunkbytes : chunkbytes;
+		char *to = (char *) dst + i * chunkbytes;
+		at += len;
+
+		if (sizes[i] & RAW_CHUNK) {
+			memcpy(to, from, len);
+			continue;
+		}
+		int c = codec;
+		pending.push_back(pool.submit([=]() {
+			if (!decompress_chunk(c, from, len, to, rawlen)) {
+				fprintf(stderr, "ChunkCodec: corrupt %s chunk\n", codec_name(c)); std::exit(1);
+			}
+		}));
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * Chunked compression of exchange messages
+ *
+ * A message is cut into chunks of chunkbytes (the last one possibly shorter), which are compressed
+ * and decompressed independently, one task each on a ThreadPool, so a large message to one rank
+ * uses all threads and decompression of one message overlaps the arrival of the next. An encoded
+ * message is laid out as
+ *
+ *     uint32 size per chunk, RAW_CHUNK set if the chunk is stored as is | the chunks, back to back
+ *
+ * and the chunk count follows from the raw size, which the receiver of a VDI exchange knows from
+ * the supersegment counts. Chunks that would not shrink are stored as is.
+ *
+ * The codecs need their libraries: LZ4 (liblz4) with -DWITH_LZ4, zstd (libzstd) with -DWITH_ZSTD.
+ * Without them only CODEC_NONE is available. The level is passed on: for LZ4, 0 and below select
+ * the fast compressor with acceleration 1 - level, above 0 LZ4HC; for zstd, 0 is its default.
+ */
+
+#ifndef CHUNK_CODEC_HPP
+#define CHUNK_CODEC_HPP
+
+#include <future>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "ThreadPool.hpp"
+
+#define CHUNK_BYTES (1 << 18)   // large enough for LZ4 and zstd to find the repetition between supersegments
+#define RAW_CHUNK   0x80000000u
+
+enum Codec {
+	CODEC_NONE = 0,
+	CODEC_LZ4  = 1,
+	CODEC_ZSTD = 2
+};
+
+bool codec_available(int codec);
+const char *codec_name(int codec);
+
+// compress bytes from src into dst, returning the compressed size, or 0 if it fails or would not be smaller
+size_t compress_chunk(int codec, int level, const void *src, size_t bytes, void *dst, size_t capacity);
+bool decompress_chunk(int codec, const void *src, size_t bytes, void *dst, size_t rawbytes);
+size_t chunk_bound(int codec, size_t bytes);
+
+class ChunkCodec {
+
+	int codec, level;
+	size_t chunkbytes;
+
+public:
+
+	ChunkCodec(int codec = CODEC_NONE, int level = 0, size_t chunkbytes = CHUNK_BYTES);
+
+	// largest encoded size of a message of bytes, what encode needs at out
+	size_t bound(size_t bytes) const;
+	size_t chunks(size_t bytes) const;
+
+	// queue compression of each chunk into out, with chunk i at its bound offset; once the tasks
+	// added to pending are done, finish lays the chunks out back to back and returns the encoded size
+	void encode(const void *src, size_t bytes, void *out, ThreadPool &pool, std::vector<std::future<void> > &pending) const;
+	size_t finish(void *out, size_t bytes) const;
+
+	// queue decompression of each chunk of an encoded message into dst, which takes rawbytes
+	void decode(const void *msg, size_t rawbytes, void *dst, ThreadPool &pool, std::vector<std::future<void> > &pending) const;
+
+	int kind() const { return codec; }
+	int compression_level() const { return level; }
+	size_t chunk_bytes() const { return chunkbytes; }
+};
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * Temporal delta compression of field streams
+ *
+ *
+ *
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "DeltaCodec.hpp"
+
+namespace {
+
+inline bool element_size(int elsize)
+{
+	return elsize == 1 || elsize == 2 || elsize == 4 || elsize == 8;
+}
+
+inline size_t whole_blocks(size_t chunkbytes, int elsize)
+{
+	size_t block = 8 * (size_t) elsize;
+	return (chunkbytes >= block) ? chunkbytes / block * block : block;
+}
+
+// transpose the 8 x 8 bit matrix whose rows are the bytes of x
+inline uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+	x ^= t ^ (t << 28);
+	return x;
+}
+
+template <typename T>
+void subtract(const T *a, const T *b, size_t n, T *d)
+{
+	for (size_t i = 0; i < n; ++i)
+		d[i] = (T) (a[i] - b[i]);
+}
+
+template <typename T>
+void add(T *a, const T *d, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		a[i] = (T) (a[i] + d[i]);
+}
+
+// d = cur - prev over len bytes, elementwise
+void difference(const char *cur, const char *prev, size_t len, int elsize, int mode, char *d)
+{
+	if (mode == DELTA_XOR) {
+		for (size_t i = 0; i < len; ++i)
+			d[i] = cur[i] ^ prev[i];
+		return;
+	}
+	switch (elsize) {
+	case 1: subtract((const uint8_t *) cur, (const uint8_t *) prev, len, (uint8_t *) d); break;
+	case 2: subtract((const uint16_t *) cur, (const uint16_t *) prev, len / 2, (uint16_t *) d); break;
+	case 4: subtract((const uint32_t *) cur, (const uint32_t *) prev, len / 4, (uint32_t *) d); break;
+	case 8: subtract((const uint64_t *) cur, (const uint64_t *) prev, len / 8, (uint64_t *) d); break;
+	}
+}
+
+// frame += d, the reverse of difference
+void apply(char *frame, const char *d, size_t len, int elsize, int mode)
+{
+	if (mode == DELTA_XOR) {
+		for (size_t i = 0; i < len; ++i)
+			frame[i] ^= d[i];
+		return;
+	}
+	switch (elsize) {
+	case 1: add((uint8_t *) frame, (const uint8_t *) d, len); break;
+	case 2: add((uint16_t *) frame, (const uint16_t *) d, len / 2); break;
+	case 4: add((uint32_t *) frame, (const uint32_t *) d, len / 4); break;
+	case 8: add((uint64_t *) frame, (const uint64_t *) d, len / 8); break;
+	}
+}
+
+}
+
+const DeltaHeader *delta_header(const void *msg, size_t bytes)
+{
+	const DeltaHeader *h = (const DeltaHeader *) msg;
+	if (msg == NULL || bytes < sizeof(DeltaHeader) || memcmp(h->magic, DELTA_MAGIC, sizeof(h->magic)) != 0)
+		return NULL;
+	return h;
+}
+
+void bitshuffle(const void *src, size_t n, int elsize, void *dst)
+{
+	const uint8_t *in = (const uint8_t *) src;
+	uint8_t *out = (uint8_t *) dst;
+	const size_t s = elsize, groups = n / 8;
+
+	// byte k of elements 8g to 8g + 7 becomes byte g of bit planes 8k to 8k + 7
+	for (size_t k = 0; k < s; ++k) {
+		for (size_t g = 0; g < groups; ++g) {
+			const uint8_t *e = in + 8 * g * s + k;
+			uint64_t x = 0;
+			for (int j = 0; j < 8; ++j)
+				x |= (uint64_t) e[j * s] << (8 * j);
+			x = transpose8(x);
+			for (int b = 0; b < 8; ++b)
+				out[(8 * k + b) * groups + g] = (uint8_t) (x >> (8 * b));
+		}
+	}
+	memcpy(out + groups * 8 * s, in + groups * 8 * s, (n % 8) * s);
+}
+
+void bitunshuffle(const void *src, size_t n, int elsize, void *dst)
+{
+	const uint8_t *in = (const uint8_t *) src;
+	uint8_t *out = (uint8_t *) dst;
+	const size_t s = elsize, groups = n / 8;
+
+	for (size_t k = 0; k < s; ++k) {
+		for (size_t g = 0; g < groups; ++g) {
+			uint64_t x = 0;
+			for (int b = 0; b < 8; ++b)
+				x |= (uint64_t) in[(8 * k + b) * groups + g] << (8 * b);
+			x = transpose8(x);
+			uint8_t *e = out + 8 * g * s + k;
+			for (int j = 0; j < 8; ++j)
+				e[j * s] = (uint8_t) (x >> (8 * j));
+		}
+	}
+	memcpy(out + groups * 8 * s, in + groups * 8 * s, (n % 8) * s);
+}
+
+DeltaEncoder::DeltaEncoder(int elsize, int codec, int level, int keyint, int nthreads, int mode, size_t chunkbytes)
+	: codec(codec, level, whole_blocks(chunkbytes ? chunkbytes : CHUNK_BYTES, elsize)), elsize(elsize), mode(mode), keyint(keyint),
+	  pool(nthreads), seq(0), force(true)
+{
+	if (!element_size(elsize) || (mode != DELTA_XOR && mode != DELTA_SUB)) {
+		fprintf(stderr, "DeltaEncoder: elements of %d bytes with mode %d not supported\n", elsize, mode); std::exit(1);
+	}
+}
+
+size_t DeltaEncoder::encode(const void *src, size_t bytes, void *out)
+{
+	if (bytes % elsize != 0) {
+		fprintf(stderr, "DeltaEncoder: %zu bytes are not whole elements of %d bytes\n", bytes, elsize);
+		return 0;
+	}
+	bool key = force || prev.size() != bytes || (keyint > 0 && seq % keyint == 0);
+
+	DeltaHeader *h = (DeltaHeader *) out;
+	memset(h, 0, sizeof(DeltaHeader));
+	memcpy(h->magic, DELTA_MAGIC, sizeof(h->magic));
+	h->keyframe = key;
+	h->mode = (uint8_t) mode;
+	h->elsize = (uint8_t) elsize;
+	h->codec = (uint8_t) codec.kind();
+	h->chunkbytes = (uint32_t) codec.chunk_bytes();
+	h->seq = seq;
+	h->bytes = bytes;
+
+	prev.resize(bytes);
+	scratch.resize(bytes);
+	char *msg = (char *) (h + 1);
+	size_t n = codec.chunks(bytes), cb = codec.chunk_bytes(), stride = chunk_bound(codec.kind(), cb);
+	uint32_t *sizes = (uint32_t *) msg;
+	char *data = msg + n * sizeof(uint32_t);
+
+	// per chunk: the difference into the chunk's place in out, shuffled into scratch, compressed back
+	std::vector<std::future<void> > pending;
+	for (size_t i = 0; i < n; ++i) {
+		const char *from = (const char *) src + i * cb;
+		size_t len = (i == n - 1) ? bytes - i * cb : cb;
+		char *p = prev.data() + i * cb, *shuffled = scratch.data() + i * cb, *to = data + i * stride;
+		int c = codec.kind(), l = codec.compression_level(), s = elsize, m = mode;
+		pending.push_back(pool.submit([=]() {
+			const char *diff = from;
+			if (!key) {
+				difference(from, p, len, s, m, to);
+				diff = to;
+			}
+			bitshuffle(diff, len / s, s, shuffled);
+			memcpy(p, from, len);
+
+			size_t packed = compress_chunk(c, l, shuffled, len, to, chunk_bound(c, len));
+			if (packed == 0) {
+				memcpy(to, shuffled, len);
+				sizes[i] = (uint32_t) len | RAW_CHUNK;
+			} else {
+				sizes[i] = (uint32_t) packed;
+			}
+		}));
+	}
+	for (size_t i = 0; i < pending.size(); ++i)
+		pending[i].get();
+
+	++seq;
+	force = false;
+	return sizeof(DeltaHeader) + codec.finish(msg, bytes);
+}
+
+DeltaDecoder::DeltaDecoder(int nthreads) : pool(nthreads), seq(0), valid(false)
+{
+}
+
+bool DeltaDecoder::decode(const void *msg, size_t bytes)
+{
+	const DeltaHeader *h = delta_header(msg, bytes);
+	if (h == NULL || !element_size(h->elsize) || (h->mode != DELTA_XOR && h->mode != DELTA_SUB) || !codec_available(h->codec)
+			|| h->chunkbytes == 0 || h->chunkbytes % (8 * h->elsize) != 0 || h->bytes % h->elsize != 0) {
+		fprintf(stderr, "DeltaDecoder: not a delta frame this build can decode\n");
+		valid = false;
+		return false;
+	}
+	// a delta needs the step before it; after a gap only a keyframe helps
+	if (!h->keyframe && (!valid || h->seq != seq + 1 || h->bytes != frame.size())) {
+		valid = false;
+		return false;
+	}
+
+	const size_t cb = h->chunkbytes, n = (h->bytes + cb - 1) / cb;
+	const uint32_t *sizes = (const uint32_t *) (h + 1);
+	const char *data = (const char *) (sizes + n);
+	size_t total = sizeof(DeltaHeader) + n * sizeof(uint32_t);
+	for (size_t i = 0; i < n && total <= bytes; ++i)
+		total += sizes[i] & ~RAW_CHUNK;
+	if (total > bytes) {
+		fprintf(stderr, "DeltaDecoder: truncated frame\n");
+		valid = false;
+		return false;
+	}
+
+	frame.resize(h->bytes);
+	scratch.resize(2 * h->bytes);
+	std::atomic<bool> ok(true);
+	std::vector<std::future<void> > pending;
+	size_t at = 0;
+	for (size_t i = 0; i < n; ++i) {
+		const char *from = data + at;
+		size_t len = sizes[i] & ~RAW_CHUNK, rawlen = (i == n - 1) ? h->bytes - i * cb : cb;
+		bool raw = (sizes[i] & RAW_CHUNK) != 0;
+		char *f = frame.data() + i * cb, *packed = scratch.data() + i * cb, *diff = scratch.data() + h->bytes + i * cb;
+		int c = h->codec, s = h->elsize, m = h->mode;
+		bool key = h->keyframe;
+		at += len;
+
+		pending.push_back(pool.submit([=, &ok]() {
+			const char *shuffled = from;
+			if (raw) {
+				if (len != rawlen) {
+					ok = false;
+					return;
+				}
+			} else if (!decompress_chunk(c, from, len, packed, rawlen)) {
+				ok = false;
+				return;
+			} else {
+				shuffled = packed;
+			}
+			if (key) {
+				bitunshuffle(shuffled, rawlen / s, s, f);
+			} else {
+				bitunshuffle(shuffled, rawlen / s, s, diff);
+				apply(f, diff, rawlen, s, m);
+			}
+		}));
+	}
+	for (size_t i = 0; i < pending.size(); ++i)
+		pending[i].get();
+
+	if (!ok) {
+		fprintf(stderr, "DeltaDecoder: corrupt %s chunk\n", codec_name(h->codec));
+		valid = false;
+		return false;
+	}
+	seq = h->seq;
+	valid = true;
+	return true;
+}
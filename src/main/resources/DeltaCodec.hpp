@@ -0,0 +1,110 @@
+/*
+ * Temporal delta compression of field streams
+ *
+ * Successive time steps of a field, a volume grid or the particle positions of a rank, differ in few
+ * bits. A DeltaEncoder per field keeps the previous step and encodes each new one as its difference
+ * to it, every keyint steps as a keyframe of its own so that consumers joining late or having missed
+ * a frame can start again. The difference is the XOR of the two steps (DELTA_XOR, for floats, whose
+ * unchanged sign, exponent and leading mantissa bits become zeros) or their difference as integers of
+ * the element size (DELTA_SUB, for counters and quantized grids), then bit-shuffled, so that bit b of
+ * byte k of all elements of a chunk lies together and the mostly zero high bit planes become long
+ * runs, and then compressed with a ChunkCodec codec (LZ4 or zstd, see ChunkCodec.hpp). A frame is
+ *
+ *     DeltaHeader | a ChunkCodec message of the shuffled difference
+ *
+ * Chunks are independent, so each one is differenced, shuffled and compressed by a single task on
+ * the coder's ThreadPool while its data is in cache; the difference loops are plain elementwise
+ * loops the compiler vectorizes, the shuffle transposes 8 x 8 bit blocks in 64 bit words.
+ *
+ * DeltaEncoder::encode(src, bytes, out): encode a step of bytes into out, which takes bound(bytes),
+ *     return the encoded size, 0 on failure; a step of another size than the last is a keyframe
+ * DeltaEncoder::keyframe():             make the next step a keyframe, e.g. for a new consumer
+ * DeltaDecoder::decode(msg, bytes):     reconstruct a step into data(), false if the message is
+ *     corrupt or is a delta whose previous step was not decoded; wait for the next keyframe then
+ *
+ * Coders are per field and not thread safe. An encoded step is a frame like any other and can go
+ * through shared memory, an MPI message or a FrameRecorder recording as it is.
+ */
+
+#ifndef DELTA_CODEC_HPP
+#define DELTA_CODEC_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "ChunkCodec.hpp"
+#include "ThreadPool.hpp"
+
+#define DELTA_MAGIC "DLT1"
+#define DELTA_KEYINT 16 // steps from one keyframe to the next by default
+
+enum DeltaMode {
+	DELTA_XOR = 0,
+	DELTA_SUB = 1
+};
+
+struct DeltaHeader {        // 32 bytes
+	char magic[4];
+	uint8_t keyframe;       // 1 if the step does not depend on the one before
+	uint8_t mode;           // DeltaMode
+	uint8_t elsize;         // bytes per element, 1, 2, 4 or 8
+	uint8_t codec;
+	uint32_t chunkbytes;
+	uint32_t reserved;
+	uint64_t seq;           // step number on the field, from 0
+	uint64_t bytes;         // of the step
+};
+
+// NULL unless msg starts with a header for a message that fits into bytes
+const DeltaHeader *delta_header(const void *msg, size_t bytes);
+
+// bit-shuffle n elements of elsize bytes from src into dst, and back; the last n % 8 are copied as they are
+void bitshuffle(const void *src, size_t n, int elsize, void *dst);
+void bitunshuffle(const void *src, size_t n, int elsize, void *dst);
+
+class DeltaEncoder {
+
+	ChunkCodec codec;
+	int elsize, mode, keyint;
+	ThreadPool pool;
+	std::vector<char> prev, scratch; // the last step, and its successor's difference per chunk
+	uint64_t seq;
+	bool force;
+
+public:
+
+	// chunkbytes is rounded down to whole blocks of 8 elements
+	DeltaEncoder(int elsize, int codec = CODEC_NONE, int level = 0, int keyint = DELTA_KEYINT, int nthreads = 0,
+		int mode = DELTA_XOR, size_t chunkbytes = CHUNK_BYTES);
+
+	DeltaEncoder(const DeltaEncoder &) = delete;
+	DeltaEncoder &operator=(const DeltaEncoder &) = delete;
+
+	size_t bound(size_t bytes) const { return sizeof(DeltaHeader) + codec.bound(bytes); }
+	size_t encode(const void *src, size_t bytes, void *out);
+	void keyframe() { force = true; }
+	uint64_t steps() const { return seq; }
+};
+
+class DeltaDecoder {
+
+	ThreadPool pool;
+	std::vector<char> frame, scratch;
+	uint64_t seq;           // of the step in frame
+	bool valid;             // whether frame holds a step
+
+public:
+
+	explicit DeltaDecoder(int nthreads = 0);
+
+	DeltaDecoder(const DeltaDecoder &) = delete;
+	DeltaDecoder &operator=(const DeltaDecoder &) = delete;
+
+	bool decode(const void *msg, size_t bytes);
+	const void *data() const { return frame.data(); }
+	size_t size() const { return frame.size(); }
+	uint64_t step() const { return seq; }
+};
+
+#endif
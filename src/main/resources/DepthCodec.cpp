@@ -0,0 +1,95 @@
+/*
+ * 16-bit quantization of supersegment depths
+ *
+ *
+ *
+ */
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "DepthCodec.hpp"
+
+namespace {
+
+// supersegments of list l
+inline size_t list_length(const int32_t *prefix, size_t nlists, size_t supsegs, size_t l)
+{
+	return (l + 1 < nlists) ? (size_t) (prefix[l+1] - prefix[l]) : supsegs - (size_t) (prefix[l] - prefix[0]);
+}
+
+// n depths between near and far to levels, 0 staying 0
+void encode(const float *d, size_t n, float near, float scale, uint16_t *q)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128 vnear = _mm_set1_ps(near), vscale = _mm_set1_ps(scale), round = _mm_set1_ps(1.5f), zero = _mm_setzero_ps();
+	__m128i bias = _mm_set1_epi32(32768), flip = _mm_set1_epi16((short) 0x8000);
+	for (; i + 4 <= n; i += 4) {
+		__m128 v = _mm_loadu_ps(d + i);
+		__m128i l = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(v, vnear), vscale), round));
+		l = _mm_andnot_si128(_mm_castps_si128(_mm_cmpeq_ps(v, zero)), l);
+		// to unsigned 16 bits with the signed saturating pack of SSE2
+		__m128i p = _mm_packs_epi32(_mm_sub_epi32(l, bias), _mm_sub_epi32(l, bias));
+		_mm_storel_epi64((__m128i *) (q + i), _mm_xor_si128(p, flip));
+	}
+#endif
+	for (; i < n; ++i)
+		q[i] = (d[i] == 0) ? 0 : (uint16_t) ((d[i] - near) * scale + 1.5f);
+}
+
+void decode(const uint16_t *q, size_t n, float near, float step, float *d)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128 vbase = _mm_set1_ps(near - step), vstep = _mm_set1_ps(step);
+	__m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= n; i += 4) {
+		__m128i l = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) (q + i)), zero);
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(l), vstep), vbase);
+		_mm_storeu_ps(d + i, _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(l, zero)), v));
+	}
+#endif
+	for (; i < n; ++i)
+		d[i] = (q[i] == 0) ? 0 : q[i] * step + (near - step);
+}
+
+}
+
+float quantize_depths(const float *depth, const int32_t *prefix, size_t nlists, size_t supsegs, uint16_t *q, float *ranges)
+{
+	float bound = 0;
+	for (size_t l = 0; l < nlists; ++l) {
+		size_t first = 2 * (size_t) (prefix[l] - prefix[0]), n = 2 * list_length(prefix, nlists, supsegs, l);
+
+		// over starts and ends alike, leaving out empty supersegments
+		float near = 0, far = 0;
+		bool any = false;
+		for (size_t i = first; i < first + n; ++i) {
+			if (depth[i] == 0)
+				continue;
+			near = any ? std::min(near, depth[i]) : depth[i];
+			far = any ? std::max(far, depth[i]) : depth[i];
+			any = true;
+		}
+		ranges[2 * l] = near;
+		ranges[2 * l + 1] = far;
+
+		float scale = (far > near) ? DEPTH_STEPS / (far - near) : 0;
+		encode(depth + first, n, near, scale, q + first);
+		bound = std::max(bound, (far - near) / DEPTH_STEPS / 2);
+	}
+	return bound;
+}
+
+void dequantize_depths(const uint16_t *q, const float *ranges, const int32_t *prefix, size_t nlists, size_t supsegs, float *depth)
+{
+	for (size_t l = 0; l < nlists; ++l) {
+		size_t first = 2 * (size_t) (prefix[l] - prefix[0]), n = 2 * list_length(prefix, nlists, supsegs, l);
+		float near = ranges[2 * l], far = ranges[2 * l + 1];
+		decode(q + first, n, near, (far - near) / DEPTH_STEPS, depth + first);
+	}
+}
@@ -0,0 +1,340 @@
+/*
+ * Asynchronous recording of in situ frames to disk
+ *
+ *
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // O_DIRECT
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef WITH_URING
+#include <liburing.h>
+#endif
+
+#include "FrameRecorder.hpp"
+
+FrameRecorder::FrameRecorder(const char *path, size_t maxframe, size_t memory, int nwriters, int policy, bool direct)
+	: direct(direct), policy(policy), maxframe(maxframe), bufbytes(record_bytes(maxframe)), end(0), writing(0), stopping(false),
+	nrecorded(0), ndropped(0), nfailed(0), nbytes(0), warned(false)
+{
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+	if (fd < 0 && direct && errno == EINVAL) {
+		this->direct = false; // the file system does not support it
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if (fd < 0) {
+		perror(path);
+		return;
+	}
+
+	size_t n = memory / bufbytes;
+	for (size_t i = 0; i < (n ? n : 1); ++i) {
+		void *buf;
+		if (posix_memalign(&buf, RECORD_ALIGN, bufbytes) != 0) {
+			perror("posix_memalign");
+			break;
+		}
+		buffers.push_back((char *) buf);
+		idle.push_back((int) i);
+	}
+	if (buffers.empty()) {
+		::close(fd);
+		fd = -1;
+		return;
+	}
+
+#ifdef WITH_URING
+	(void) nwriters;
+	writers.push_back(std::thread(&FrameRecorder::uring_loop, this));
+#else
+	for (int i = 0; i < (nwriters > 0 ? nwriters : 1); ++i)
+		writers.push_back(std::thread(&FrameRecorder::write_loop, this));
+#endif
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	close();
+	for (size_t i = 0; i < buffers.size(); ++i)
+		free(buffers[i]);
+}
+
+bool FrameRecorder::submit(const void *data, size_t bytes, int stream, long seq, int rank, int slot, const char *name)
+{
+	if (fd < 0 || data == NULL || bytes > maxframe) {
+		++ndropped;
+		if (fd >= 0 && bytes > maxframe && !warned.exchange(true))
+			fprintf(stderr, "FrameRecorder: frame of %zu bytes over the limit of %zu, dropped\n", bytes, maxframe);
+		return false;
+	}
+
+	int b;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (stopping) {
+			++ndropped;
+			return false;
+		}
+		if (!idle.empty()) {
+			b = idle.back();
+			idle.pop_back();
+		} else if (policy == DROP_OLDEST && !queue.empty()) {
+			b = queue.front(); // not yet picked up by a writer, so it can be taken back
+			queue.pop_front();
+			++ndropped;
+		} else {
+			++ndropped;
+			return false;
+		}
+	}
+
+	// the buffer is ours until it is queued, so the copy runs without the lock
+	char *buf = buffers[b];
+	RecordHeader *h = (RecordHeader *) buf;
+	memset(h, 0, sizeof(RecordHeader));
+	memcpy(h->magic, RECORD_MAGIC, sizeof(h->magic));
+	h->version = RECORD_VERSION;
+	h->stream = (uint32_t) stream;
+	h->rank = rank;
+	h->slot = slot;
+	h->seq = seq;
+	h->bytes = bytes;
+	h->record = record_bytes(bytes);
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	h->time_us = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+	if (name != NULL)
+		strncpy(h->name, name, RECORD_NAME - 1);
+	memcpy(buf + sizeof(RecordHeader), data, bytes);
+	memset(buf + sizeof(RecordHeader) + bytes, 0, h->record - sizeof(RecordHeader) - bytes);
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		queue.push_back(b);
+	}
+	ready.notify_one();
+	return true;
+}
+
+bool FrameRecorder::write_record(const char *buf, size_t len, uint64_t offset, size_t done)
+{
+	while (done < len) {
+		ssize_t n = pwrite(fd, buf + done, len - done, (off_t) (offset + done));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EINVAL && direct) {
+			// accepted by open but not by the file system; the remaining writes go through the page cache
+			direct = false;
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+			continue;
+		}
+		if (n <= 0) {
+			if (nfailed.load() == 0)
+				perror("FrameRecorder: pwrite");
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+void FrameRecorder::finish(int buffer, bool written)
+{
+	if (written) {
+		++nrecorded;
+		nbytes += ((RecordHeader *) buffers[buffer])->record;
+	} else {
+		++nfailed;
+	}
+	idle.push_back(buffer);
+	--writing;
+	if (queue.empty() && writing == 0)
+		drained.notify_all();
+}
+
+void FrameRecorder::write_loop()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;) {
+		ready.wait(guard, [this]() { return stopping || !queue.empty(); });
+		if (queue.empty())
+			return; // stopping, and everything is written
+
+		int b = queue.front();
+		queue.pop_front();
+		size_t len = ((RecordHeader *) buffers[b])->record;
+		uint64_t offset = end;
+		end += len;
+		++writing;
+
+		guard.unlock();
+		bool written = write_record(buffers[b], len, offset);
+		guard.lock();
+		finish(b, written);
+	}
+}
+
+#ifdef WITH_URING
+void FrameRecorder::uring_loop()
+{
+	struct io_uring ring;
+	int err = io_uring_queue_init(URING_DEPTH, &ring, 0);
+	if (err < 0) {
+		fprintf(stderr, "FrameRecorder: io_uring_queue_init: %s, writing with pwrite\n", strerror(-err));
+		write_loop();
+		return;
+	}
+
+	std::vector<uint64_t> offsets(buffers.size());
+	std::unique_lock<std::mutex> guard(lock);
+	int inflight = 0;
+	for (;;) {
+		if (inflight == 0) {
+			ready.wait(guard, [this]() { return stopping || !queue.empty(); });
+			if (queue.empty())
+				break;
+		}
+
+		int queued = 0;
+		while (!queue.empty() && inflight < URING_DEPTH) {
+			struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+			if (sqe == NULL)
+				break;
+			int b = queue.front();
+			queue.pop_front();
+			size_t len = ((RecordHeader *) buffers[b])->record;
+			offsets[b] = end;
+			end += len;
+			++writing;
+			io_uring_prep_write(sqe, fd, buffers[b], (unsigned) len, offsets[b]);
+			io_uring_sqe_set_data(sqe, (void *) (intptr_t) b);
+			++inflight;
+			++queued;
+		}
+
+		guard.unlock();
+		if (queued > 0)
+			io_uring_submit(&ring);
+
+		// wait for one completion, then take whatever else has completed
+		std::vector<std::pair<int, bool> > done;
+		struct io_uring_cqe *cqe;
+		err = io_uring_wait_cqe(&ring, &cqe);
+		while (err == 0) {
+			int b = (int) (intptr_t) io_uring_cqe_get_data(cqe);
+			size_t len = ((RecordHeader *) buffers[b])->record;
+			int res = cqe->res;
+			io_uring_cqe_seen(&ring, cqe);
+			--inflight;
+			bool written;
+			if (res < 0) {
+				written = write_record(buffers[b], len, offsets[b]); // retried with pwrite, e.g. after EINVAL from O_DIRECT
+			} else {
+				written = write_record(buffers[b], len, offsets[b], (size_t) res); // completes short writes
+			}
+			done.push_back(std::make_pair(b, written));
+			err = io_uring_peek_cqe(&ring, &cqe);
+		}
+		guard.lock();
+		for (size_t i = 0; i < done.size(); ++i)
+			finish(done[i].first, done[i].second);
+	}
+	guard.unlock();
+	io_uring_queue_exit(&ring);
+}
+#endif
+
+void FrameRecorder::flush()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	drained.wait(guard, [this]() { return writers.empty() || (queue.empty() && writing == 0); });
+}
+
+void FrameRecorder::close()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	ready.notify_all();
+	for (size_t i = 0; i < writers.size(); ++i)
+		writers[i].join();
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		writers.clear();
+	}
+	drained.notify_all();
+
+	if (fd >= 0) {
+		if (nrecorded.load() > 0 && fdatasync(fd) < 0)
+			perror("fdatasync");
+		::close(fd);
+		fd = -1;
+	}
+}
+
+FrameRecording::FrameRecording() : base(NULL), bytes(0) {}
+
+FrameRecording::~FrameRecording()
+{
+	close();
+}
+
+bool FrameRecording::open(const char *path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(RecordHeader)) {
+		fprintf(stderr, "%s: no frames recorded\n", path);
+		::close(fd);
+		return false;
+	}
+	void *ptr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (ptr == MAP_FAILED) {
+		perror("mmap");
+		return false;
+	}
+	base = (const char *) ptr;
+	bytes = (size_t) st.st_size;
+
+	for (size_t offset = 0; offset + sizeof(RecordHeader) <= bytes; ) {
+		const RecordHeader *h = (const RecordHeader *) (base + offset);
+		if (memcmp(h->magic, RECORD_MAGIC, sizeof(h->magic)) != 0 || h->version != RECORD_VERSION
+				|| h->record != FrameRecorder::record_bytes(h->bytes) || offset + h->record > bytes)
+			break;
+		records.push_back(h);
+		offset += h->record;
+	}
+	if (records.empty()) {
+		fprintf(stderr, "%s: not a frame recording of version %d\n", path, RECORD_VERSION);
+		close();
+		return false;
+	}
+	return true;
+}
+
+void FrameRecording::close()
+{
+	if (base != NULL)
+		munmap((void *) base, bytes);
+	base = NULL;
+	bytes = 0;
+	records.clear();
+}
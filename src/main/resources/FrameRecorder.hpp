@@ -0,0 +1,162 @@
+/*
+ * Asynchronous recording of in situ frames to disk
+ *
+ * Writing every frame a simulation publishes to disk from the thread that receives it would tie the
+ * frame rate to the file system. The recorder decouples the two: submit copies a frame into one of a
+ * fixed set of buffers and queues it, and writer threads write the queued frames to one file in the
+ * background. Memory is bounded by the buffers, allocated once, as many of them as fit the memory
+ * budget (at least one) of maxframe bytes each plus the record header.
+ *
+ * submit never blocks on the disk. When every buffer is queued or being written the frame is dropped
+ * according to the policy:
+ *
+ * DROP_NEWEST: the submitted frame is dropped, the queue keeps the frames that came first
+ * DROP_OLDEST: the oldest frame still queued is dropped and its buffer takes the submitted one, so
+ *     the file keeps up with the simulation; if all buffers are being written, the submitted frame
+ *     is dropped
+ *
+ * Frames larger than maxframe are always dropped. Every frame is recorded as a RecordHeader followed
+ * by its bytes, padded to RECORD_ALIGN, so buffers, lengths and offsets all suit O_DIRECT, which is
+ * used unless the file system refuses it. Records are written in the order their frames were queued.
+ * A record that could not be written leaves a gap of zeros, so a reader stops at the first header
+ * without RECORD_MAGIC.
+ *
+ * Built with WITH_URING (linking -luring), a single writer thread keeps up to URING_DEPTH records in
+ * flight through io_uring instead of nwriters threads each blocking in pwrite.
+ *
+ * FrameRecording maps a recorded file read-only and indexes its records, for replaying them (see
+ * shm_replay.cpp) or looking at them offline.
+ *
+ * record_frames(recorder) is a StreamWaiter callback recording every frame of a stream group, tagged
+ * with the stream's index, rank and name. Like any reader, it copies a segment as it is when the
+ * frame is reported.
+ */
+
+#ifndef FRAME_RECORDER_HPP
+#define FRAME_RECORDER_HPP
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+#include "ShmStreams.hpp"
+
+#define RECORD_MAGIC "FRAMEREC"
+#define RECORD_VERSION 1
+#define RECORD_ALIGN 4096 // of buffers, record lengths and offsets, for O_DIRECT
+#define RECORD_NAME 64
+#define URING_DEPTH 32    // records in flight with io_uring
+
+enum DropPolicy {
+	DROP_NEWEST = 0,
+	DROP_OLDEST = 1
+};
+
+struct RecordHeader {           // 128 bytes, the frame follows
+	char magic[8];
+	uint32_t version;
+	uint32_t stream;            // tag given to submit, e.g. the index of the stream in its group
+	int32_t rank, slot;         // of the producer, -1 if not known
+	int64_t seq;
+	uint64_t bytes;             // of the frame
+	uint64_t record;            // of the whole record, header and padding included
+	int64_t time_us;            // wall clock time of submit
+	char name[RECORD_NAME];     // e.g. the producer's pname, NUL terminated
+	uint32_t reserved[2];
+};
+
+class FrameRecorder {
+
+	int fd;
+	std::atomic<bool> direct;   // cleared by a writer if the file system refuses O_DIRECT writes
+	int policy;
+	size_t maxframe, bufbytes;
+
+	std::vector<char *> buffers;
+	std::vector<int> idle;      // buffers free to take a frame
+	std::deque<int> queue;      // buffers holding frames to write, oldest first
+	uint64_t end;               // where the next record goes
+	int writing;                // records being written
+
+	std::mutex lock;
+	std::condition_variable ready, drained;
+	bool stopping;
+	std::vector<std::thread> writers;
+
+	std::atomic<long> nrecorded, ndropped, nfailed;
+	std::atomic<unsigned long long> nbytes;
+	std::atomic<bool> warned;   // about an oversized frame
+
+	void write_loop();
+#ifdef WITH_URING
+	void uring_loop();
+#endif
+	bool write_record(const char *buf, size_t len, uint64_t offset, size_t done = 0);
+	void finish(int buffer, bool written); // lock must be held
+
+public:
+
+	FrameRecorder(const char *path, size_t maxframe, size_t memory, int nwriters = 1, int policy = DROP_NEWEST, bool direct = true);
+	~FrameRecorder();
+
+	FrameRecorder(const FrameRecorder &) = delete;
+	FrameRecorder &operator=(const FrameRecorder &) = delete;
+
+	bool ok() const { return fd >= 0; }
+
+	// copy the frame and queue it, false if it was dropped
+	bool submit(const void *data, size_t bytes, int stream, long seq, int rank = -1, int slot = -1, const char *name = NULL);
+
+	void flush(); // wait until every queued frame is written
+	void close(); // write what is queued, stop the writers and close the file; called by the destructor
+
+	long recorded() const { return nrecorded.load(); }
+	long dropped() const { return ndropped.load(); }   // by the policy or for their size
+	long failed() const { return nfailed.load(); }     // queued but not written
+	unsigned long long written_bytes() const { return nbytes.load(); }
+	size_t nbuffers() const { return buffers.size(); }
+	bool direct_io() const { return direct; }
+
+	static size_t record_bytes(size_t bytes) { return (sizeof(RecordHeader) + bytes + RECORD_ALIGN - 1) / RECORD_ALIGN * RECORD_ALIGN; }
+};
+
+class FrameRecording {
+
+	const char *base;
+	size_t bytes;
+	std::vector<const RecordHeader *> records;
+
+public:
+
+	FrameRecording();
+	~FrameRecording();
+
+	FrameRecording(const FrameRecording &) = delete;
+	FrameRecording &operator=(const FrameRecording &) = delete;
+
+	bool open(const char *path); // map the file and index the records up to the first incomplete one
+	void close();
+
+	size_t frames() const { return records.size(); }
+	const RecordHeader &header(size_t frame) const { return *records[frame]; }
+	const void *data(size_t frame) const { return records[frame] + 1; }
+};
+
+// StreamWaiter callback submitting every reported frame to recorder, then calling next if given
+inline std::function<int(int, ShmStream &, const ShmFrame &)> record_frames(FrameRecorder &recorder,
+		std::function<int(int, ShmStream &, const ShmFrame &)> next = std::function<int(int, ShmStream &, const ShmFrame &)>())
+{
+	FrameRecorder *r = &recorder;
+	return [r, next](int index, ShmStream &stream, const ShmFrame &frame) {
+		r->submit(frame.ptr, frame.size, index, frame.seq, stream.rank, frame.slot, stream.pname.c_str());
+		return next ? next(index, stream, frame) : 0;
+	};
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Sort-last compositing of rendered images between ranks
+ *
+ *
+ *
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include "ImageCompositor.hpp"
+
+#define CHANNELS 4
+
+void blend_over(const uint8_t *front, const uint8_t *back, uint8_t *dst, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		unsigned t = 255 - front[CHANNELS * i + 3];
+		for (int c = 0; c < CHANNELS; ++c) {
+			unsigned x = t * back[CHANNELS * i + c] + 128;  // x / 255, rounded, without dividing
+			dst[CHANNELS * i + c] = (uint8_t) (front[CHANNELS * i + c] + ((x + (x >> 8)) >> 8));
+		}
+	}
+}
+
+std::vector<int> ImageCompositor::schedule_factors(int nranks, size_t pixels, int schedule, int radix)
+{
+	std::vector<int> f;
+	if (nranks <= 1)
+		return f;
+
+	bool pow2 = (nranks & (nranks - 1)) == 0;
+	if (schedule == SCHEDULE_AUTO)
+		schedule = (nranks <= DIRECT_RANKS || pixels / nranks < DIRECT_PIXELS) ? SCHEDULE_DIRECT_SEND : pow2 ? SCHEDULE_BINARY_SWAP : SCHEDULE_RADIX_K;
+
+	if (schedule == SCHEDULE_DIRECT_SEND) {
+		f.push_back(nranks);
+	} else if (schedule == SCHEDULE_BINARY_SWAP) {
+		int n = nranks;
+		for (; n % 2 == 0; n /= 2)
+			f.push_back(2);
+		if (n > 1)
+			f.push_back(n); // the odd remainder in one direct-send round
+	} else {
+		// prime factors, largest first, packed into rounds of at most radix
+		std::vector<int> primes;
+		int n = nranks;
+		for (int p = 2; p * p <= n; ++p)
+			for (; n % p == 0; n /= p)
+				primes.push_back(p);
+		if (n > 1)
+			primes.push_back(n);
+		std::sort(primes.rbegin(), primes.rend());
+
+		for (size_t i = 0; i < primes.size(); ++i) {
+			size_t r = 0;
+			while (r < f.size() && f[r] * primes[i] > radix)
+				++r;
+			if (r == f.size())
+				f.push_back(primes[i]);
+			else
+				f[r] *= primes[i];
+		}
+	}
+	return f;
+}
+
+ImageCompositor::ImageCompositor(MPI_Comm comm, int width, int height, int schedule, int radix) : comm(comm)
+{
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	pixels = (size_t) width * height;
+
+	factors = schedule_factors(size, pixels, schedule, radix);
+	int maxk = 1;
+	for (size_t i = 0; i < factors.size(); ++i)
+		maxk = std::max(maxk, factors[i]);
+
+	work.resize(pixels * CHANNELS);
+	recv.resize((pixels / maxk + 1) * maxk * CHANNELS);
+	order.resize(size);
+	distances.resize(size);
+	gathercounts.resize(size);
+	gatherdispls.resize(size);
+	times.assign(factors.size() + 1, 0);
+}
+
+// blend k parts of n pixels each, stride pixels apart, front first, into dst
+void ImageCompositor::blend_parts(uint8_t *dst, const uint8_t *parts, size_t stride, int k, size_t n) const
+{
+	blend_over(parts, parts + stride * CHANNELS, dst, n);
+	for (int d = 2; d < k; ++d)
+		blend_over(dst, parts + d * stride * CHANNELS, dst, n);
+}
+
+void ImageCompositor::composite(const uint8_t *image, float distance, uint8_t *out, int root)
+{
+	// visibility order, nearest first; ties keep rank order so all ranks agree
+	MPI_Allgather(&distance, 1, MPI_FLOAT, distances.data(), 1, MPI_FLOAT, comm);
+	for (int r = 0; r < size; ++r)
+		order[r] = r;
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return distances[a] < distances[b]; });
+	int pos = (int) (std::find(order.begin(), order.end(), rank) - order.begin());
+
+	// region (in pixels) held by each position after all rounds; all are computed for the gather
+	std::vector<size_t> lo(size, 0), hi(size, pixels);
+	for (int p = 0; p < size; ++p) {
+		int stride = 1;
+		for (size_t i = 0; i < factors.size(); ++i) {
+			int k = factors[i], d = (p / stride) % k;
+			size_t len = hi[p] - lo[p], l = lo[p];
+			lo[p] = l + len * d / k;
+			hi[p] = l + len * (d + 1) / k;
+			stride *= k;
+		}
+	}
+
+	const uint8_t *src = image; // what we hold of the current region, the image until the first round
+	size_t mylo = 0, myhi = pixels;
+	int stride = 1;
+	std::vector<MPI_Request> reqs;
+	for (size_t i = 0; i < factors.size(); ++i) {
+		double t0 = MPI_Wtime();
+		int k = factors[i], digit = (pos / stride) % k, base = pos - digit * stride;
+		size_t len = myhi - mylo;
+
+		// part d of the region goes to member d, which is sent it by all; parts are received into recv at the
+		// sender's digit, padded to the largest part
+		size_t partmax = len / k + 1;
+		size_t plo = mylo + len * digit / k, phi = mylo + len * (digit + 1) / k;
+		reqs.clear();
+		for (int d = 0; d < k; ++d) {
+			if (d == digit)
+				continue;
+			int peer = order[base + d * stride];
+			size_t dlo = mylo + len * d / k, dhi = mylo + len * (d + 1) / k;
+			reqs.push_back(MPI_REQUEST_NULL);
+			MPI_Irecv(&recv[d * partmax * CHANNELS], (int) ((phi - plo) * CHANNELS), MPI_BYTE, peer, (int) i, comm, &reqs.back());
+			reqs.push_back(MPI_REQUEST_NULL);
+			MPI_Isend(src + dlo * CHANNELS, (int) ((dhi - dlo) * CHANNELS), MPI_BYTE, peer, (int) i, comm, &reqs.back());
+		}
+		memcpy(&recv[digit * partmax * CHANNELS], src + plo * CHANNELS, (phi - plo) * CHANNELS);
+		MPI_Waitall((int) reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+
+		blend_parts(&work[plo * CHANNELS], recv.data(), partmax, k, phi - plo);
+
+		src = work.data();
+		mylo = plo;
+		myhi = phi;
+		stride *= k;
+		times[i] = MPI_Wtime() - t0;
+	}
+
+	double t0 = MPI_Wtime();
+	for (int r = 0; r < size; ++r) {
+		int p = (int) (std::find(order.begin(), order.end(), r) - order.begin());
+		gathercounts[r] = (int) ((hi[p] - lo[p]) * CHANNELS);
+		gatherdispls[r] = (int) (lo[p] * CHANNELS);
+	}
+	MPI_Gatherv(src + mylo * CHANNELS, (int) ((myhi - mylo) * CHANNELS), MPI_BYTE,
+			out, gathercounts.data(), gatherdispls.data(), MPI_BYTE, root, comm);
+	times[factors.size()] = MPI_Wtime() - t0;
+}
@@ -0,0 +1,76 @@
+/*
+ * Sort-last compositing of rendered images between ranks
+ *
+ * Every rank renders its part of the volume into a full-size RGBA8 image (premultiplied colour),
+ * and the images are blended front to back in visibility order, which comes from the volume
+ * decomposition: ranks sorted by the distance of their sub-volume to the eye.
+ *
+ * ImageCompositor::composite(image, distance, out, root): blend the images of all ranks, root
+ *     receives the result in out
+ *
+ * The schedule is radix-k: a number of rounds, round i splitting the ranks into groups of k_i.
+ * Within a group, each member takes 1/k_i of the region it currently holds, receives that part
+ * from the other members and blends the k_i parts. After the last round each rank holds the final
+ * image for 1/P of the pixels, and these are gathered at the root. Direct-send is the single round
+ * k = P, binary-swap all rounds k = 2. Groups are formed over positions in visibility order, not
+ * ranks, so each group always holds a contiguous run of the order and blending stays correct for
+ * any decomposition.
+ *
+ * SCHEDULE_AUTO uses direct-send for few ranks or small images, where the extra rounds cost more
+ * in latency than they save in bandwidth, binary-swap for powers of two and otherwise factors P
+ * into rounds of at most RADIX.
+ */
+
+#ifndef IMAGE_COMPOSITOR_HPP
+#define IMAGE_COMPOSITOR_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <mpi.h>
+
+#define RADIX 8                  // largest group of a radix-k round
+#define DIRECT_RANKS 4           // up to this many ranks, direct-send
+#define DIRECT_PIXELS (1 << 14)  // or if each rank would end up with fewer pixels than this
+
+enum CompositingSchedule {
+	SCHEDULE_AUTO        = 0,
+	SCHEDULE_DIRECT_SEND = 1,
+	SCHEDULE_BINARY_SWAP = 2,
+	SCHEDULE_RADIX_K     = 3
+};
+
+class ImageCompositor {
+
+	MPI_Comm comm;
+	int rank, size;
+	size_t pixels;
+
+	std::vector<int> factors;       // k of each round
+	std::vector<uint8_t> work, recv;
+	std::vector<int> order;         // rank at each position, front first
+	std::vector<float> distances;
+	std::vector<int> gathercounts, gatherdispls;
+	std::vector<double> times;      // per round, then the gather
+
+	void blend_parts(uint8_t *dst, const uint8_t *parts, size_t stride, int k, size_t n) const;
+
+public:
+
+	ImageCompositor(MPI_Comm comm, int width, int height, int schedule = SCHEDULE_AUTO, int radix = RADIX);
+
+	// distance of this rank's sub-volume from the eye; out needs width * height * 4 bytes at root only
+	void composite(const uint8_t *image, float distance, uint8_t *out, int root = 0);
+
+	const std::vector<int> &rounds() const { return factors; }
+	const std::vector<double> &round_times() const { return times; } // seconds per round of the last composite, the gather last
+	const std::vector<int> &visibility_order() const { return order; } // of the last composite
+	MPI_Comm communicator() const { return comm; }
+
+	static std::vector<int> schedule_factors(int nranks, size_t pixels, int schedule, int radix = RADIX);
+};
+
+// front over back for n premultiplied RGBA8 pixels, into dst (which may be front)
+void blend_over(const uint8_t *front, const uint8_t *back, uint8_t *dst, size_t n);
+
+#endif
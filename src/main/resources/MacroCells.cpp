@@ -0,0 +1,158 @@
+/*
+ * Min/max macro cells of volume bricks, for empty-space skipping
+ *
+ *
+ *
+ */
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include "MacroCells.hpp"
+#include "BrickPublisher.hpp"
+#include "ParallelChunks.hpp"
+
+#define MACRO_LANES 8 // independent accumulators per span
+
+namespace {
+
+// merge the min of lo[0 .. n) into mn and the max of hi[0 .. n) into mx, n > 0
+template <typename T>
+inline void span_minmax(const T *lo, const T *hi, size_t n, T &mn, T &mx)
+{
+	T lmin[MACRO_LANES], lmax[MACRO_LANES];
+	for (int l = 0; l < MACRO_LANES; ++l) {
+		lmin[l] = lo[0];
+		lmax[l] = hi[0];
+	}
+
+	size_t i = 0;
+	for (; i + MACRO_LANES <= n; i += MACRO_LANES) {
+		for (int l = 0; l < MACRO_LANES; ++l) {
+			lmin[l] = lo[i+l] < lmin[l] ? lo[i+l] : lmin[l];
+			lmax[l] = hi[i+l] > lmax[l] ? hi[i+l] : lmax[l];
+		}
+	}
+	for (; i < n; ++i) {
+		lmin[0] = lo[i] < lmin[0] ? lo[i] : lmin[0];
+		lmax[0] = hi[i] > lmax[0] ? hi[i] : lmax[0];
+	}
+
+	for (int l = 0; l < MACRO_LANES; ++l) {
+		mn = lmin[l] < mn ? lmin[l] : mn;
+		mx = lmax[l] > mx ? lmax[l] : mx;
+	}
+}
+
+// floats at most and at least the value, exact for all types but double
+template <typename T> inline float below(T v) { return (float) v; }
+template <typename T> inline float above(T v) { return (float) v; }
+
+template <> inline float below(double v)
+{
+	float f = (float) v;
+	return (f > v) ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+template <> inline float above(double v)
+{
+	float f = (float) v;
+	return (f < v) ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+// the last voxel of cell c along an axis of n voxels
+inline size_t cell_end(size_t c, size_t s, size_t n)
+{
+	return (c * s + s < n - 1) ? c * s + s : n - 1;
+}
+
+template <typename T>
+void minmax_cells(const T *v, const int dims[3], int cellsize, const int cells[3], float *minmax, int nthreads)
+{
+	const size_t dx = dims[0], dy = dims[1], dz = dims[2], s = cellsize;
+	const size_t cx = cells[0], cy = cells[1];
+
+	// per row of cells, the voxel rows it covers are reduced elementwise first, then each cell's span of the result
+	parallel_chunks((size_t) cells[2] * cy, nthreads, [&](size_t begin, size_t end, int) {
+		std::vector<T> lo(dx), hi(dx);
+		for (size_t r = begin; r < end; ++r) {
+			size_t c = r / cy, b = r % cy;
+			const T *first = v + (c * s * dy + b * s) * dx;
+			std::copy(first, first + dx, lo.begin());
+			std::copy(first, first + dx, hi.begin());
+			for (size_t z = c * s; z <= cell_end(c, s, dz); ++z) {
+				for (size_t y = b * s; y <= cell_end(b, s, dy); ++y) {
+					const T *row = v + (z * dy + y) * dx;
+					T *l = lo.data(), *h = hi.data();
+					for (size_t x = 0; x < dx; ++x) {
+						l[x] = row[x] < l[x] ? row[x] : l[x];
+						h[x] = row[x] > h[x] ? row[x] : h[x];
+					}
+				}
+			}
+
+			float *out = minmax + 2 * r * cx;
+			for (size_t a = 0; a < cx; ++a) {
+				size_t x0 = a * s, n = cell_end(a, s, dx) - x0 + 1;
+				T mn = lo[x0], mx = hi[x0];
+				span_minmax(lo.data() + x0, hi.data() + x0, n, mn, mx);
+				out[2*a]   = below(mn);
+				out[2*a+1] = above(mx);
+			}
+		}
+	}, 1);
+}
+
+}
+
+size_t macro_grid_dims(const int dims[3], int cellsize, int cells[3])
+{
+	size_t n = 1;
+	for (int k = 0; k < 3; ++k) {
+		cells[k] = (cellsize > 0 && dims[k] > 1) ? (dims[k] - 2) / cellsize + 1 : 1;
+		n *= cells[k];
+	}
+	return n;
+}
+
+bool macro_minmax(const void *voxels, int dtype, const int dims[3], int cellsize, float *minmax, int nthreads)
+{
+	if (cellsize <= 0 || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0)
+		return false;
+	int cells[3];
+	macro_grid_dims(dims, cellsize, cells);
+
+	switch (dtype) {
+	case BRICK_UINT8:   minmax_cells((const uint8_t *) voxels, dims, cellsize, cells, minmax, nthreads); return true;
+	case BRICK_UINT16:  minmax_cells((const uint16_t *) voxels, dims, cellsize, cells, minmax, nthreads); return true;
+	case BRICK_INT16:   minmax_cells((const int16_t *) voxels, dims, cellsize, cells, minmax, nthreads); return true;
+	case BRICK_FLOAT32: minmax_cells((const float *) voxels, dims, cellsize, cells, minmax, nthreads); return true;
+	case BRICK_FLOAT64: minmax_cells((const double *) voxels, dims, cellsize, cells, minmax, nthreads); return true;
+	default:            return false;
+	}
+}
+
+size_t macro_occupancy(const float *minmax, size_t ncells, const float *alpha, int tflen, float lo, float hi, uint8_t *occupied)
+{
+	if (tflen <= 0)
+		return 0;
+
+	// visible[i]: transfer function entries before i with nonzero opacity
+	std::vector<int> visible(tflen + 1, 0);
+	for (int i = 0; i < tflen; ++i)
+		visible[i+1] = visible[i] + (alpha[i] > 0);
+
+	const float scale = (hi > lo) ? (tflen - 1) / (hi - lo) : 0;
+	size_t count = 0;
+	for (size_t c = 0; c < ncells; ++c) {
+		// a value between two entries is interpolated from both
+		float first = (minmax[2*c] - lo) * scale, last = (minmax[2*c+1] - lo) * scale;
+		int i0 = (first > 0) ? (int) std::floor(first < tflen - 1 ? first : tflen - 1) : 0;
+		int i1 = (last > 0) ? (int) std::ceil(last < tflen - 1 ? last : tflen - 1) : 0;
+		occupied[c] = visible[i1 + 1] - visible[i0] > 0;
+		count += occupied[c];
+	}
+	return count;
+}
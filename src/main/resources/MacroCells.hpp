@@ -0,0 +1,40 @@
+/*
+ * Min/max macro cells of volume bricks, for empty-space skipping
+ *
+ * A brick of dims voxels is divided into macro cells of cellsize voxels along each axis, and for each
+ * cell the smallest and largest voxel value is kept, so that a ray marcher can skip every cell whose
+ * whole value range maps to zero opacity under the current transfer function. Cell c along an axis
+ * covers voxels c * cellsize to c * cellsize + cellsize inclusive, one voxel more than its share,
+ * since trilinear samples just short of the next cell still read that voxel; there are
+ * ceil((dim - 1) / cellsize) cells, at least one, and the last one ends at the brick's last voxel.
+ *
+ * macro_grid_dims(dims, cellsize, cells):  number of cells along each axis, returns their product
+ * macro_minmax(voxels, dtype, dims, cellsize, minmax, nthreads): min and max of every cell, two floats
+ *     per cell, x fastest; dtype as in BrickPublisher.hpp
+ * macro_occupancy(minmax, ncells, alpha, tflen, lo, hi, occupied): 1 for every cell whose range
+ *     reaches a transfer function entry with nonzero opacity, 0 otherwise; the transfer function
+ *     holds tflen opacities sampled evenly over [lo, hi], values outside clamp to its ends. Returns
+ *     how many cells are occupied.
+ *
+ * The min/max pass reads every voxel about once: threads take rows of cells, the voxel rows a row
+ * of cells covers are reduced elementwise, which the compiler vectorizes, and only then each cell's
+ * span of the result. Double values are rounded outwards to floats. The occupancy pass is
+ * O(cells) after a prefix count over the transfer function, cheap enough to redo whenever it changes.
+ */
+
+#ifndef MACRO_CELLS_HPP
+#define MACRO_CELLS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#define MACRO_CELL 8 // default cell size in voxels
+
+size_t macro_grid_dims(const int dims[3], int cellsize, int cells[3]);
+
+// false if dtype is unknown or dims or cellsize are not positive
+bool macro_minmax(const void *voxels, int dtype, const int dims[3], int cellsize, float *minmax, int nthreads = 1);
+
+size_t macro_occupancy(const float *minmax, size_t ncells, const float *alpha, int tflen, float lo, float hi, uint8_t *occupied);
+
+#endif
@@ -0,0 +1,370 @@
+/*
+ * Two-level exchange of dense VDIs: shared memory within a node, MPI between nodes
+ *
+ *
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "NodeExchange.hpp"
+
+#define HEADER 16 // supersegment count at the start of a part, keeping the floats after it aligned
+
+namespace {
+
+inline size_t aligned(size_t bytes)
+{
+	return (bytes + 15) & ~(size_t) 15;
+}
+
+// a rank's dense VDI in the input window: count | colours | depths | prefix sums of all lists
+struct InputPart {
+	size_t supsegs;
+	const float *color, *depth;
+	const int32_t *prefix;
+
+	InputPart(const char *part)
+	{
+		supsegs = (size_t) *(const uint64_t *) part;
+		color = (const float *) (part + HEADER);
+		depth = color + 4 * supsegs;
+		prefix = (const int32_t *) (depth + 2 * supsegs);
+	}
+};
+
+// a rank's share of the composited VDI of the node: count | supersegments per list | colours | depths
+struct CompositedPart {
+	size_t supsegs;
+	const int32_t *counts;
+	const float *color, *depth;
+
+	CompositedPart(const char *part, size_t lists)
+	{
+		supsegs = (size_t) *(const uint64_t *) part;
+		counts = (const int32_t *) (part + HEADER);
+		color = (const float *) (part + HEADER + aligned(lists * sizeof(int32_t)));
+		depth = color + 4 * supsegs;
+	}
+};
+
+}
+
+NodeExchange::NodeExchange(MPI_Comm comm, int ranks_per_node, int nthreads) : comm(comm), nthreads(nthreads), sentbytes(0), flatbytes(0)
+{
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	MPI_Comm shared;
+	MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &shared);
+	if (ranks_per_node > 0) {
+		MPI_Comm_split(shared, rank / ranks_per_node, rank, &node);
+		MPI_Comm_free(&shared);
+	} else {
+		node = shared;
+	}
+	MPI_Comm_rank(node, &noderank);
+	MPI_Comm_size(node, &nodesize);
+
+	// lists are owned by consecutive ranks, so a node's are only contiguous if its ranks are
+	std::vector<int> members(nodesize);
+	MPI_Allgather(&rank, 1, MPI_INT, members.data(), 1, MPI_INT, node);
+	int consecutive = 1;
+	for (int i = 1; i < nodesize; ++i)
+		consecutive = consecutive && members[i] == members[0] + i;
+	MPI_Allreduce(MPI_IN_PLACE, &consecutive, 1, MPI_INT, MPI_LAND, comm);
+	if (!consecutive) {
+		if (rank == 0)
+			fprintf(stderr, "NodeExchange: ranks are not consecutive by node, exchanging flat\n");
+		MPI_Comm_free(&node);
+		MPI_Comm_split(comm, rank, 0, &node);
+		noderank = 0;
+		nodesize = 1;
+		members.assign(1, rank);
+	}
+
+	MPI_Comm_split(comm, noderank == 0 ? 0 : MPI_UNDEFINED, rank, &leaders);
+	if (leaders != MPI_COMM_NULL) {
+		MPI_Comm_size(leaders, &nnodes);
+		MPI_Comm_rank(leaders, &nodeindex);
+	}
+	MPI_Bcast(&nnodes, 1, MPI_INT, 0, node);
+	MPI_Bcast(&nodeindex, 1, MPI_INT, 0, node);
+	nodefirst.resize(nnodes + 1);
+	if (leaders != MPI_COMM_NULL)
+		MPI_Allgather(&rank, 1, MPI_INT, nodefirst.data(), 1, MPI_INT, leaders);
+	MPI_Bcast(nodefirst.data(), nnodes, MPI_INT, 0, node);
+	nodefirst[nnodes] = size;
+
+	Segment empty = {MPI_WIN_NULL, 0, std::vector<char *>()};
+	input = composited = received = empty;
+	colors.resize(nodesize);
+	depths.resize(nodesize);
+	prefixes.resize(nodesize);
+	counts.resize(nodesize);
+	sendsupsegs.assign(nnodes, 0);
+	recvsupsegs.assign(nnodes, 0);
+	for (int s = 0; s < 3; ++s) {
+		sendcounts[s].assign(nnodes, 0);
+		senddispls[s].assign(nnodes, 0);
+		recvcounts[s].assign(nnodes, 0);
+		recvdispls[s].assign(nnodes, 0);
+	}
+	memset(&result, 0, sizeof(result));
+	for (int p = 0; p < NNODEPHASES; ++p)
+		times[p] = 0;
+}
+
+NodeExchange::~NodeExchange()
+{
+	Segment *segs[] = {&input, &composited, &received};
+	for (int s = 0; s < 3; ++s) {
+		if (segs[s]->win != MPI_WIN_NULL) {
+			MPI_Win_unlock_all(segs[s]->win);
+			MPI_Win_free(&segs[s]->win);
+		}
+	}
+	if (leaders != MPI_COMM_NULL)
+		MPI_Comm_free(&leaders);
+	MPI_Comm_free(&node);
+}
+
+void NodeExchange::reserve(Segment &seg, size_t bytes)
+{
+	int grow = seg.win == MPI_WIN_NULL || bytes > seg.capacity;
+	MPI_Allreduce(MPI_IN_PLACE, &grow, 1, MPI_INT, MPI_LOR, node);
+	if (!grow)
+		return;
+
+	if (seg.win != MPI_WIN_NULL) {
+		MPI_Win_unlock_all(seg.win);
+		MPI_Win_free(&seg.win);
+	}
+	if (bytes > seg.capacity)
+		seg.capacity = aligned((size_t) (bytes * GROWTH) + 1);
+	char *base;
+	if (MPI_Win_allocate_shared((MPI_Aint) seg.capacity, 1, MPI_INFO_NULL, node, &base, &seg.win) != MPI_SUCCESS) {
+		perror("MPI_Win_allocate_shared"); std::exit(1);
+	}
+	seg.parts.resize(nodesize);
+	for (int r = 0; r < nodesize; ++r) {
+		MPI_Aint partsize;
+		int unit;
+		MPI_Win_shared_query(seg.win, r, &partsize, &unit, &seg.parts[r]);
+	}
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, seg.win);
+}
+
+void NodeExchange::publish(Segment &seg)
+{
+	MPI_Win_sync(seg.win);
+	MPI_Barrier(node);
+	MPI_Win_sync(seg.win);
+}
+
+size_t NodeExchange::first_list(int r, size_t nlists) const
+{
+	return (nlists / size) * r;
+}
+
+size_t NodeExchange::lists_of(int r, size_t nlists) const
+{
+	return (r == size - 1) ? nlists - first_list(r, nlists) : nlists / size;
+}
+
+size_t NodeExchange::node_first_list(int m, size_t nlists) const
+{
+	return (m == nnodes) ? nlists : first_list(nodefirst[m], nlists);
+}
+
+DenseVDIs NodeExchange::exchange(const void *c, const void *d, const int32_t *p, size_t nlists, size_t supsegcount,
+	const CompositeView &view, int outsupsegs)
+{
+	double t0 = MPI_Wtime();
+
+	reserve(input, HEADER + supsegcount * (COLOR_BYTES + DEPTH_BYTES) + nlists * sizeof(int32_t));
+	char *part = input.parts[noderank];
+	*(uint64_t *) part = supsegcount;
+	memcpy(part + HEADER, c, supsegcount * COLOR_BYTES);
+	memcpy(part + HEADER + supsegcount * COLOR_BYTES, d, supsegcount * DEPTH_BYTES);
+	memcpy(part + HEADER + supsegcount * (COLOR_BYTES + DEPTH_BYTES), p, nlists * sizeof(int32_t));
+	publish(input);
+	double t1 = MPI_Wtime();
+
+	// composite our share of the node's lists from the sub-VDIs of all its ranks, in place
+	size_t share = nlists / nodesize, first = share * noderank, lists = (noderank == nodesize - 1) ? nlists - first : share;
+	for (int j = 0; j < nodesize; ++j) {
+		InputPart in(input.parts[j]);
+		size_t begin = in.prefix[first] - in.prefix[0];
+		size_t end = (first + lists < nlists) ? (size_t) (in.prefix[first + lists] - in.prefix[0]) : in.supsegs;
+		colors[j] = in.color + 4 * begin;
+		depths[j] = in.depth + 2 * begin;
+		prefixes[j] = in.prefix + first;
+		counts[j] = (int) (end - begin);
+	}
+	SubVDIs sub = {NULL, NULL, nodesize, lists, NULL, counts.data(), 0, colors.data(), depths.data(), prefixes.data()};
+	CompositeView v = view;
+	v.first_list = first;
+	v.tiles = NULL;
+	fixedcolor.resize(lists * outsupsegs * 4);
+	fixeddepth.resize(lists * outsupsegs * 2);
+	composite_vdis(sub, v, outsupsegs, fixedcolor.data(), fixeddepth.data(), nthreads);
+
+	// dense, into the window
+	reserve(composited, HEADER + aligned(lists * sizeof(int32_t)) + lists * outsupsegs * (COLOR_BYTES + DEPTH_BYTES));
+	part = composited.parts[noderank];
+	int32_t *listcounts = (int32_t *) (part + HEADER);
+	size_t total = 0;
+	for (size_t l = 0; l < lists; ++l) {
+		const float *fd = &fixeddepth[l * outsupsegs * 2];
+		int n = 0;
+		while (n < outsupsegs && fd[2 * n] != 0)
+			++n;
+		listcounts[l] = n;
+		total += n;
+	}
+	*(uint64_t *) part = total;
+	CompositedPart out(part, lists);
+	float *oc = (float *) out.color, *od = (float *) out.depth;
+	for (size_t l = 0; l < lists; ++l) {
+		memcpy(oc, &fixedcolor[l * outsupsegs * 4], listcounts[l] * COLOR_BYTES);
+		memcpy(od, &fixeddepth[l * outsupsegs * 2], listcounts[l] * DEPTH_BYTES);
+		oc += 4 * listcounts[l];
+		od += 2 * listcounts[l];
+	}
+	publish(composited);
+	double t2 = MPI_Wtime();
+
+	size_t mine = node_first_list(nodeindex, nlists), nodelists = node_first_list(nodeindex + 1, nlists) - mine;
+	if (leaders != MPI_COMM_NULL) {
+		// the node's VDI, its ranks' shares one after the other
+		nodeprefix.resize(nlists);
+		size_t nodesupsegs = 0;
+		for (int j = 0; j < nodesize; ++j) {
+			size_t jfirst = share * j, jlists = (j == nodesize - 1) ? nlists - jfirst : share;
+			CompositedPart cp(composited.parts[j], jlists);
+			for (size_t l = 0; l < jlists; ++l) {
+				nodeprefix[jfirst + l] = (int32_t) nodesupsegs;
+				nodesupsegs += cp.counts[l];
+			}
+		}
+		sendcolor.resize(4 * nodesupsegs);
+		senddepth.resize(2 * nodesupsegs);
+		for (int j = 0; j < nodesize; ++j) {
+			size_t jfirst = share * j, jlists = (j == nodesize - 1) ? nlists - jfirst : share;
+			CompositedPart cp(composited.parts[j], jlists);
+			memcpy(&sendcolor[4 * nodeprefix[jfirst]], cp.color, cp.supsegs * COLOR_BYTES);
+			memcpy(&senddepth[2 * nodeprefix[jfirst]], cp.depth, cp.supsegs * DEPTH_BYTES);
+		}
+
+		// what the flat exchange would have sent off the node: every rank's supersegments outside our lists
+		flatbytes = 0;
+		for (int j = 0; j < nodesize; ++j) {
+			InputPart in(input.parts[j]);
+			size_t inside = ((mine + nodelists < nlists) ? (size_t) (in.prefix[mine + nodelists] - in.prefix[0]) : in.supsegs)
+				- (in.prefix[mine] - in.prefix[0]);
+			flatbytes += (in.supsegs - inside) * (COLOR_BYTES + DEPTH_BYTES) + (nlists - nodelists) * sizeof(int32_t);
+		}
+
+		sentbytes = 0;
+		for (int m = 0; m < nnodes; ++m) {
+			size_t from = node_first_list(m, nlists), to = node_first_list(m + 1, nlists);
+			size_t begin = nodeprefix[from], end = (to < nlists) ? (size_t) nodeprefix[to] : nodesupsegs;
+			sendsupsegs[m] = (int) (end - begin);
+			sendcounts[0][m] = 4 * sendsupsegs[m];
+			senddispls[0][m] = (int) (4 * begin);
+			sendcounts[1][m] = 2 * sendsupsegs[m];
+			senddispls[1][m] = (int) (2 * begin);
+			sendcounts[2][m] = (int) (to - from);
+			senddispls[2][m] = (int) from;
+			if (m != nodeindex)
+				sentbytes += (end - begin) * (COLOR_BYTES + DEPTH_BYTES) + (to - from) * sizeof(int32_t);
+		}
+		MPI_Alltoall(sendsupsegs.data(), 1, MPI_INT, recvsupsegs.data(), 1, MPI_INT, leaders);
+
+		size_t recvd = 0;
+		for (int m = 0; m < nnodes; ++m) {
+			recvcounts[0][m] = 4 * recvsupsegs[m];
+			recvdispls[0][m] = (int) (4 * recvd);
+			recvcounts[1][m] = 2 * recvsupsegs[m];
+			recvdispls[1][m] = (int) (2 * recvd);
+			recvcounts[2][m] = (int) nodelists;
+			recvdispls[2][m] = (int) (m * nodelists);
+			recvd += recvsupsegs[m];
+		}
+
+		// received straight into the window: supersegments per node | colours | depths | prefix sums
+		reserve(received, aligned(nnodes * sizeof(int)) + recvd * (COLOR_BYTES + DEPTH_BYTES) + nnodes * nodelists * sizeof(int32_t));
+		part = received.parts[0];
+		memcpy(part, recvsupsegs.data(), nnodes * sizeof(int));
+		float *rc = (float *) (part + aligned(nnodes * sizeof(int))), *rd = rc + 4 * recvd;
+		int32_t *rp = (int32_t *) (rd + 2 * recvd);
+
+		MPI_Request reqs[3];
+		MPI_Ialltoallv(sendcolor.data(), sendcounts[0].data(), senddispls[0].data(), MPI_FLOAT,
+			rc, recvcounts[0].data(), recvdispls[0].data(), MPI_FLOAT, leaders, &reqs[0]);
+		MPI_Ialltoallv(senddepth.data(), sendcounts[1].data(), senddispls[1].data(), MPI_FLOAT,
+			rd, recvcounts[1].data(), recvdispls[1].data(), MPI_FLOAT, leaders, &reqs[1]);
+		MPI_Ialltoallv(nodeprefix.data(), sendcounts[2].data(), senddispls[2].data(), MPI_INT32_T,
+			rp, recvcounts[2].data(), recvdispls[2].data(), MPI_INT32_T, leaders, &reqs[2]);
+		MPI_Waitall(3, reqs, MPI_STATUSES_IGNORE);
+	} else {
+		reserve(received, 0);
+	}
+	publish(received);
+	double t3 = MPI_Wtime();
+
+	// our lists from every node's block
+	const char *r = received.parts[0];
+	const int *nodesupsegs = (const int *) r;
+	size_t recvd = 0;
+	for (int m = 0; m < nnodes; ++m)
+		recvd += nodesupsegs[m];
+	const float *rc = (const float *) (r + aligned(nnodes * sizeof(int))), *rd = rc + 4 * recvd;
+	const int32_t *rp = (const int32_t *) (rd + 2 * recvd);
+
+	size_t offset = first_list(rank, nlists) - mine, mylists = lists_of(rank, nlists);
+	const void *before[] = {color.data(), depth.data(), prefix.data()};
+	supsegs.resize(nnodes);
+	size_t block = 0, ours = 0;
+	for (int m = 0; m < nnodes; ++m) {
+		const int32_t *bp = rp + m * nodelists;
+		size_t begin = bp[offset] - bp[0], end = (offset + mylists < nodelists) ? (size_t) (bp[offset + mylists] - bp[0]) : nodesupsegs[m];
+		supsegs[m] = (int) (end - begin);
+		ours += end - begin;
+	}
+	color.resize(4 * ours);
+	depth.resize(2 * ours);
+	prefix.resize(nnodes * mylists);
+	ours = 0;
+	for (int m = 0; m < nnodes; ++m) {
+		const int32_t *bp = rp + m * nodelists;
+		size_t begin = block + (bp[offset] - bp[0]);
+		memcpy(&color[4 * ours], rc + 4 * begin, supsegs[m] * COLOR_BYTES);
+		memcpy(&depth[2 * ours], rd + 2 * begin, supsegs[m] * DEPTH_BYTES);
+		memcpy(&prefix[m * mylists], bp + offset, mylists * sizeof(int32_t));
+		ours += supsegs[m];
+		block += nodesupsegs[m];
+	}
+	double t4 = MPI_Wtime();
+
+	result.color = color.data();
+	result.depth = depth.data();
+	result.prefix = prefix.data();
+	result.supersegments = ours;
+	result.lists = mylists;
+	result.recvsupsegs = supsegs.data();
+	result.reallocated = before[0] != color.data() || before[1] != depth.data() || before[2] != prefix.data();
+	result.tiles = NULL;
+	result.ntiles = 0;
+	result.tilelen = 0;
+
+	times[NODE_SHARE] = t1 - t0;
+	times[NODE_COMPOSITE] = t2 - t1;
+	times[NODE_EXCHANGE] = t3 - t2;
+	times[NODE_SCATTER] = t4 - t3;
+	return result;
+}
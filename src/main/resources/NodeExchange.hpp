@@ -0,0 +1,117 @@
+/*
+ * Two-level exchange of dense VDIs: shared memory within a node, MPI between nodes
+ *
+ * In the flat exchange of VDIExchange.hpp every rank sends its part of each list to every other
+ * rank, so for each pair of nodes with p ranks each, p * p messages cross the interconnect, which
+ * together hold up to p times the supersegments the node would send once its own sub-VDIs were
+ * composited. NodeExchange groups the ranks by node (MPI_Comm_split_type, MPI_COMM_TYPE_SHARED)
+ * and exchanges in three steps:
+ *
+ * 1. every rank writes its dense VDI into an MPI-3 shared window of its node, and the ranks of the
+ *    node composite the node's sub-VDIs, each for an equal share of the lists, reading them from
+ *    the window in place, with the CPU compositor of VDICompositor.hpp (outsupsegs per list)
+ * 2. the first rank of each node, its leader, gathers the composited VDI from the window and
+ *    exchanges it with the other leaders, each receiving the lists owned by the ranks of its node
+ * 3. the leader receives directly into the window, from where every rank copies its own lists
+ *
+ * The result is laid out as that of VDIExchange, but with one block per node (sources()) rather
+ * than per rank. Every rank owns the lists it would with the equal shares of VDIExchange, which
+ * needs the ranks of each node to be consecutive in the communicator (e.g. mpirun --map-by core);
+ * where they are not, every rank is treated as a node of its own, i.e. the exchange is flat. With
+ * ranks_per_node > 0, ranks are grouped in runs of that many instead, to try this on one node.
+ *
+ * exchange(color, depth, prefix, nlists, supsegs, view, outsupsegs): exchange the dense VDI of all
+ *     nlists lists, supsegs supersegments, with view as for composite_vdis (first_list and tiles
+ *     are set here); call on all ranks, return this rank's lists from every node
+ *
+ * Supersegments of different ranks can be merged by the pre-compositing, so the result only equals
+ * that of the flat exchange where a node's supersegments for a list fit into outsupsegs. What the
+ * node sent to other nodes in the last exchange, and what its ranks would have with the flat one,
+ * is reported by internode_bytes() and flat_internode_bytes() on the leader.
+ *
+ * The windows are kept for every frame and grow, by GROWTH at a time, collectively on the node.
+ * Results stay valid until the next exchange.
+ */
+
+#ifndef NODE_EXCHANGE_HPP
+#define NODE_EXCHANGE_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <mpi.h>
+
+#include "VDIExchange.hpp"
+#include "VDICompositor.hpp"
+
+enum NodePhase {
+	NODE_SHARE     = 0, // writing the VDI into the node's window
+	NODE_COMPOSITE = 1, // compositing our share of the node's sub-VDIs
+	NODE_EXCHANGE  = 2, // leaders exchanging between nodes, the others waiting for it
+	NODE_SCATTER   = 3, // copying our lists out of the window
+	NNODEPHASES    = 4
+};
+
+class NodeExchange {
+
+	// a window with a part per rank of the node, each visible to all of them
+	struct Segment {
+		MPI_Win win;
+		size_t capacity;           // of our part
+		std::vector<char *> parts; // of each rank of the node
+	};
+
+	MPI_Comm comm, node, leaders; // leaders is MPI_COMM_NULL except on the first rank of each node
+	int rank, size;
+	int noderank, nodesize;
+	int nodeindex, nnodes;
+	std::vector<int> nodefirst;   // first rank of each node, then size
+	int nthreads;
+
+	Segment input, composited, received;
+	void reserve(Segment &seg, size_t bytes); // collective on the node
+	void publish(Segment &seg);              // make what was written visible to the node, collective
+
+	std::vector<float> fixedcolor, fixeddepth;   // our share composited, outsupsegs per list
+	std::vector<const float *> colors, depths;   // of each rank of the node, in the window
+	std::vector<const int32_t *> prefixes;
+	std::vector<int> counts;
+
+	// leader only
+	std::vector<int32_t> nodeprefix;
+	std::vector<float> sendcolor, senddepth;
+	std::vector<int> sendsupsegs, recvsupsegs, sendcounts[3], senddispls[3], recvcounts[3], recvdispls[3];
+
+	std::vector<float> color, depth;
+	std::vector<int32_t> prefix;
+	std::vector<int> supsegs;
+	DenseVDIs result;
+
+	size_t sentbytes, flatbytes;
+	double times[NNODEPHASES];
+
+	size_t node_first_list(int m, size_t nlists) const;
+
+public:
+
+	NodeExchange(MPI_Comm comm, int ranks_per_node = 0, int nthreads = 1);
+	~NodeExchange();
+
+	DenseVDIs exchange(const void *color, const void *depth, const int32_t *prefix, size_t nlists, size_t supsegs,
+		const CompositeView &view, int outsupsegs);
+
+	int sources() const { return nnodes; } // blocks in the result
+	int node_index() const { return nodeindex; }
+	int node_rank() const { return noderank; }
+	int node_size() const { return nodesize; }
+
+	size_t lists_of(int r, size_t nlists) const; // as in VDIExchange
+	size_t first_list(int r, size_t nlists) const;
+
+	size_t internode_bytes() const { return sentbytes; }      // sent to other nodes by the last exchange, 0 except on leaders
+	size_t flat_internode_bytes() const { return flatbytes; } // what the node's ranks would have sent to other nodes flat
+	const double *last_times() const { return times; }        // seconds per NodePhase of the last exchange
+	MPI_Comm communicator() const { return comm; }
+};
+
+#endif
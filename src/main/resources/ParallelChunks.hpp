@@ -0,0 +1,44 @@
+/*
+ * Splitting work over threads
+ *
+ * parallel_chunks(n, nthreads, fn) runs fn(begin, end, chunk) on nthreads contiguous chunks of
+ * [0, n), chunk 0 on the calling thread and the others on threads of their own, and returns once
+ * all are done. Fewer chunks are used if they would hold fewer than MINCHUNK elements each, so
+ * small inputs run inline; callers whose elements are expensive pass a smaller minimum.
+ */
+
+#ifndef PARALLEL_CHUNKS_HPP
+#define PARALLEL_CHUNKS_HPP
+
+#include <future>
+#include <vector>
+
+#define MINCHUNK (1 << 16) // minimum number of elements worth handing to a separate thread
+
+// number of chunks parallel_chunks will actually use
+inline int chunk_count(size_t n, int nthreads, size_t minchunk = MINCHUNK)
+{
+	if (nthreads < 1)
+		nthreads = 1;
+	if ((size_t) nthreads > n / minchunk + 1)
+		nthreads = (int) (n / minchunk + 1);
+	return nthreads;
+}
+
+template <typename F>
+void parallel_chunks(size_t n, int nthreads, F fn, size_t minchunk = MINCHUNK)
+{
+	nthreads = chunk_count(n, nthreads, minchunk);
+	size_t per = n / nthreads;
+
+	std::vector<std::future<void> > out;
+	for (int t = 1; t < nthreads; ++t)
+		out.push_back(std::async(std::launch::async, fn, t*per, (t == nthreads-1) ? n : (t+1)*per, t));
+
+	fn((size_t) 0, (nthreads == 1) ? n : per, 0);
+
+	for (size_t t = 0; t < out.size(); ++t)
+		out[t].get();
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Parallel prefix sums over per-pixel counts
+ *
+ *
+ *
+ */
+
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "PrefixScan.hpp"
+#include "ParallelChunks.hpp"
+
+static int64_t sum_chunk(const int32_t *in, size_t n)
+{
+	int64_t sum = 0;
+	for (size_t i = 0; i < n; ++i) // vectorized by the compiler
+		sum += in[i];
+	return sum;
+}
+
+// exclusive scan of one chunk starting from carry; uint32_t so that overflow wraps like the GPU does
+static void scan_chunk(const int32_t *in, int32_t *out, size_t n, uint32_t carry)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128i c = _mm_set1_epi32((int) carry);
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (in + i));
+		__m128i s = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+		s = _mm_add_epi32(s, _mm_slli_si128(s, 8)); // inclusive scan of the four lists
+		_mm_storeu_si128((__m128i *) (out + i), _mm_add_epi32(_mm_sub_epi32(s, x), c));
+		c = _mm_add_epi32(c, _mm_shuffle_epi32(s, _MM_SHUFFLE(3, 3, 3, 3)));
+	}
+	carry = (uint32_t) _mm_cvtsi128_si32(c);
+#endif
+	for (; i < n; ++i) {
+		uint32_t v = (uint32_t) in[i];
+		out[i] = (int32_t) carry;
+		carry += v;
+	}
+}
+
+int64_t exclusive_scan(const int32_t *in, int32_t *out, size_t n, int nthreads)
+{
+	int nchunks = chunk_count(n, nthreads);
+	std::vector<int64_t> sums(nchunks + 1, 0);
+
+	if (nchunks == 1) {
+		sums[1] = sum_chunk(in, n);
+		scan_chunk(in, out, n, 0);
+		return sums[1];
+	}
+
+	parallel_chunks(n, nchunks, [&](size_t begin, size_t end, int t) {
+		sums[t+1] = sum_chunk(in + begin, end - begin);
+	});
+	for (int t = 0; t < nchunks; ++t)
+		sums[t+1] += sums[t];
+	parallel_chunks(n, nchunks, [&](size_t begin, size_t end, int t) {
+		scan_chunk(in + begin, out + begin, end - begin, (uint32_t) sums[t]);
+	});
+	return sums[nchunks];
+}
+
+void rank_sums(const int32_t *scan, int64_t total, size_t n, int nranks, int32_t *counts)
+{
+	size_t per = n / nranks;
+	int64_t sofar = 0;
+	for (int i = 0; i < nranks - 1; ++i) {
+		counts[i] = (int32_t) (scan[per * (i+1)] - sofar);
+		sofar += counts[i];
+	}
+	counts[nranks-1] = (int32_t) (total - sofar);
+}
+
+size_t tile_count(size_t n, size_t tilelen)
+{
+	return (n + tilelen - 1) / tilelen;
+}
+
+void tile_sums(const int32_t *scan, int64_t total, size_t n, size_t tilelen, int32_t *sums)
+{
+	size_t ntiles = tile_count(n, tilelen);
+	for (size_t i = 0; i < ntiles; ++i) {
+		int64_t end = (i+1 < ntiles) ? scan[(i+1) * tilelen] : total;
+		sums[i] = (int32_t) (end - scan[i * tilelen]);
+	}
+}
@@ -0,0 +1,31 @@
+/*
+ * Parallel prefix sums over per-pixel counts
+ *
+ * Turns per-list counts (e.g. supersegments generated per pixel) into list offsets, and the
+ * offsets into the amounts each rank or tile will receive:
+ *
+ * exclusive_scan(in, out, n):               out[i] = in[0] + ... + in[i-1], returns the total
+ * rank_sums(scan, total, n, nranks, ..):    sum of in over the lists of each rank, split as in
+ *                                           DistributedVolumes: n/nranks lists each, the last
+ *                                           rank also taking the remainder
+ * tile_sums(scan, total, n, tilelen, ..):   sum of in over consecutive ranges of tilelen lists
+ *
+ * The scan works in two passes over one chunk per thread: chunk totals first, then each chunk
+ * is scanned starting from the sum of the chunks before it, four lists at a time with SSE2
+ * where available. out may be the same array as in. The partial sums are read off the scan,
+ * so they cost one lookup per rank or tile.
+ */
+
+#ifndef PREFIX_SCAN_HPP
+#define PREFIX_SCAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+int64_t exclusive_scan(const int32_t *in, int32_t *out, size_t n, int nthreads = 1);
+
+void rank_sums(const int32_t *scan, int64_t total, size_t n, int nranks, int32_t *counts);
+size_t tile_count(size_t n, size_t tilelen); // number of tiles tile_sums writes
+void tile_sums(const int32_t *scan, int64_t total, size_t n, size_t tilelen, int32_t *sums);
+
+#endif
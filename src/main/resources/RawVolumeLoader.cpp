@@ -0,0 +1,187 @@
+/*
+ * Loading raw volume files into memory
+ *
+ *
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // O_DIRECT
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "RawVolumeLoader.hpp"
+#include "ParallelChunks.hpp"
+
+#define TOUCH_PAGES 256 // pages per thread at least when faulting a mapping in
+
+namespace {
+
+struct Region {
+	size_t bytes;
+	bool mapped;
+};
+
+// what map_volume and read_volume handed out, for release_volume
+std::map<void *, Region> regions;
+std::mutex regionsLock;
+
+void remember(void *ptr, size_t bytes, bool mapped)
+{
+	std::lock_guard<std::mutex> lock(regionsLock);
+	Region r = {bytes, mapped};
+	regions[ptr] = r;
+}
+
+int madvice(int advice)
+{
+	switch (advice) {
+	case ADVISE_SEQUENTIAL: return MADV_SEQUENTIAL;
+	case ADVISE_RANDOM:     return MADV_RANDOM;
+	case ADVISE_WILLNEED:   return MADV_WILLNEED;
+	default:                return MADV_NORMAL;
+	}
+}
+
+// opens path for reading and checks that it holds at least bytes; -1 on failure, which is printed
+// unless O_DIRECT was refused (errno EINVAL)
+int open_volume(const char *path, size_t bytes, int flags)
+{
+	int fd = open(path, O_RDONLY | flags);
+	if (fd < 0) {
+		if (!((flags & O_DIRECT) && errno == EINVAL))
+			perror(path);
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < bytes) {
+		fprintf(stderr, "%s: %lld bytes, expected at least %zu\n", path, (long long) st.st_size, bytes);
+		close(fd);
+		errno = EFBIG;
+		return -1;
+	}
+	return fd;
+}
+
+}
+
+void *map_volume(const char *path, size_t bytes, int advice, int nthreads)
+{
+	int fd = open_volume(path, bytes, 0);
+	if (fd < 0)
+		return NULL;
+	void *ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file open
+	if (ptr == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	madvise(ptr, bytes, madvice(advice));
+
+	if (nthreads > 0) {
+		size_t page = (size_t) sysconf(_SC_PAGESIZE), pages = (bytes + page - 1) / page;
+		parallel_chunks(pages, nthreads, [&](size_t begin, size_t end, int) {
+			size_t len = (end - begin) * page, left = bytes - begin * page;
+			madvise((char *) ptr + begin * page, len < left ? len : left, MADV_WILLNEED);
+			unsigned sum = 0;
+			for (size_t p = begin; p < end; ++p)
+				sum += ((volatile const char *) ptr)[p * page];
+			(void) sum;
+		}, TOUCH_PAGES);
+	}
+
+	remember(ptr, bytes, true);
+	return ptr;
+}
+
+void *read_volume(const char *path, size_t bytes, int nthreads, size_t request, bool direct)
+{
+	// O_DIRECT needs aligned requests; the last one may then run past the end of the file, into the padding
+	request = (request + VOLUME_ALIGN - 1) / VOLUME_ALIGN * VOLUME_ALIGN;
+	if (request == 0)
+		request = VOLUME_REQUEST;
+	size_t padded = (bytes + VOLUME_ALIGN - 1) / VOLUME_ALIGN * VOLUME_ALIGN;
+
+	int fd = open_volume(path, bytes, direct ? O_DIRECT : 0);
+	if (fd < 0 && direct && errno == EINVAL) {
+		direct = false; // the file system does not support it
+		fd = open_volume(path, bytes, 0);
+	}
+	if (fd < 0)
+		return NULL;
+	if (!direct)
+		posix_fadvise(fd, 0, (off_t) bytes, POSIX_FADV_SEQUENTIAL);
+
+	void *ptr;
+	if (posix_memalign(&ptr, VOLUME_ALIGN, padded ? padded : VOLUME_ALIGN) != 0) {
+		perror("posix_memalign");
+		close(fd);
+		return NULL;
+	}
+
+	std::atomic<bool> failed(false);
+	size_t requests = (bytes + request - 1) / request;
+	parallel_chunks(requests, nthreads, [&](size_t begin, size_t end, int) {
+		for (size_t i = begin; i < end && !failed; ++i) {
+			size_t offset = i * request, want = (offset + request < bytes) ? request : bytes - offset;
+			size_t len = direct ? (want + VOLUME_ALIGN - 1) / VOLUME_ALIGN * VOLUME_ALIGN : want, done = 0;
+			while (done < want) {
+				ssize_t got = pread(fd, (char *) ptr + offset + done, len - done, (off_t) (offset + done));
+				if (got <= 0) {
+					if (got < 0)
+						perror("pread");
+					failed = true;
+					break;
+				}
+				done += got;
+			}
+		}
+	}, 1);
+	close(fd);
+
+	if (failed) {
+		fprintf(stderr, "%s: could not read %zu bytes\n", path, bytes);
+		free(ptr);
+		return NULL;
+	}
+	remember(ptr, bytes, false);
+	return ptr;
+}
+
+bool advise_volume(void *ptr, size_t offset, size_t bytes, int advice)
+{
+	size_t page = (size_t) sysconf(_SC_PAGESIZE), start = offset / page * page;
+	return madvise((char *) ptr + start, bytes + (offset - start), madvice(advice)) == 0;
+}
+
+void release_volume(void *ptr)
+{
+	if (ptr == NULL)
+		return;
+	Region r;
+	{
+		std::lock_guard<std::mutex> lock(regionsLock);
+		std::map<void *, Region>::iterator it = regions.find(ptr);
+		if (it == regions.end()) {
+			fprintf(stderr, "release_volume: %p was not loaded here\n", ptr);
+			return;
+		}
+		r = it->second;
+		regions.erase(it);
+	}
+	if (r.mapped)
+		munmap(ptr, r.bytes);
+	else
+		free(ptr);
+}
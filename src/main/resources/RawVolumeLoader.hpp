@@ -0,0 +1,44 @@
+/*
+ * Loading raw volume files into memory
+ *
+ * The volumes of a dataset are stored as raw voxels, one file per part, often several gigabytes
+ * each. Rather than streaming them through a small buffer and copying, a file is either mapped or
+ * read in parallel straight into its final buffer:
+ *
+ * map_volume(path, bytes, advice, nthreads): map the first bytes of the file (private, copy on
+ *     write) and tell the kernel how it will be read; with nthreads > 0, fault the pages in right
+ *     away with that many threads, each touching its own range after MADV_WILLNEED, so that reading
+ *     runs at disk bandwidth rather than one page fault at a time
+ * read_volume(path, bytes, nthreads, request, direct): read the file with nthreads threads issuing
+ *     preads of request bytes each into a buffer aligned to VOLUME_ALIGN, bypassing the page cache
+ *     with O_DIRECT if asked and the file system allows it
+ * advise_volume(ptr, offset, bytes, advice): a read-ahead hint for part of a mapping, e.g. the
+ *     part the next frame will sample
+ * release_volume(ptr): unmap or free what either of the above returned
+ *
+ * Both return NULL on failure, with the reason printed, and a file shorter than bytes is an error.
+ * Mapping is the cheapest when the volume is sampled once or the file is already cached; reading
+ * pays the copy but leaves the buffer independent of the file.
+ */
+
+#ifndef RAW_VOLUME_LOADER_HPP
+#define RAW_VOLUME_LOADER_HPP
+
+#include <cstddef>
+
+#define VOLUME_ALIGN 4096          // of buffers, offsets and request sizes for O_DIRECT
+#define VOLUME_REQUEST (8 << 20)   // default bytes per pread
+
+enum VolumeAdvice {
+	ADVISE_NORMAL     = 0,
+	ADVISE_SEQUENTIAL = 1, // aggressive read-ahead, pages dropped soon after
+	ADVISE_RANDOM     = 2, // no read-ahead
+	ADVISE_WILLNEED   = 3  // start reading now
+};
+
+void *map_volume(const char *path, size_t bytes, int advice = ADVISE_SEQUENTIAL, int nthreads = 0);
+void *read_volume(const char *path, size_t bytes, int nthreads = 1, size_t request = VOLUME_REQUEST, bool direct = false);
+bool advise_volume(void *ptr, size_t offset, size_t bytes, int advice);
+void release_volume(void *ptr);
+
+#endif
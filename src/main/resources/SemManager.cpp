@@ -5,8 +5,13 @@
  */
 
 #include <cstdlib>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <unistd.h>
 
 #include "SemManager.hpp"
+#include "TraceRecorder.hpp"
 
 #define PROJ_ID(rank, toggle) (2*(rank)+1+(toggle)) // generate proj_id to send to ftok (later should be more complex)
 
@@ -66,6 +71,7 @@ void SemManager::incr(int keyNo, int semNo)
 
 void SemManager::decr(int keyNo, int semNo)
 {
+	TRACE_SPAN_ARG("SemManager::decr", keyNo);
 	semops[0].sem_num = semNo;
     semops[0].sem_op  = -1;
    	semops[0].sem_flg = 0;
@@ -77,6 +83,7 @@ void SemManager::decr(int keyNo, int semNo)
 
 void SemManager::wait(int keyNo, int semNo, int value)
 {
+	TRACE_SPAN_ARG("SemManager::wait", keyNo);
 	TESTPRINT("waiting for semaphore %d of key %d to reach %d\n", semNo, keyNo, value); // test
 	if (value == 0) {
 		semops[0].sem_num = semNo;
@@ -109,6 +116,7 @@ void SemManager::waitgeq(int keyNo, int semNo, int value)
 {
 	if (value == 0)
 		return;
+	TRACE_SPAN_ARG("SemManager::waitgeq", keyNo);
 
 	TESTPRINT("waiting for semaphore %d of key %d to reach at least %d\n", semNo, keyNo, value); // test
 	// decrement by value, wait for zero (necessary if semaphore was initially higher than value, which in our case doesn't happen), then increment by value
@@ -122,4 +130,39 @@ void SemManager::waitgeq(int keyNo, int semNo, int value)
 		perror("semop"); std::exit(1);
 	}
 	TESTPRINT("waited for semaphore %d of key %d\n", semNo, keyNo); // test
-}
\ No newline at end of file
+}
+
+bool SemManager::waitgeq(int keyNo, int semNo, int value, long timeout_us)
+{
+	if (value == 0)
+		return true;
+	TRACE_SPAN_ARG("SemManager::waitgeq", keyNo);
+
+	TESTPRINT("waiting up to %ld us for semaphore %d of key %d to reach at least %d\n", timeout_us, semNo, keyNo, value); // test
+#ifdef __APPLE__
+	// no semtimedop, poll instead
+	for (long waited = 0; get(keyNo, semNo) < value; waited += 1000) {
+		if (waited >= timeout_us)
+			return false;
+		usleep(1000);
+	}
+#else
+	struct timespec timeout;
+	timeout.tv_sec  = timeout_us / 1000000;
+	timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+
+	semops[0].sem_num = semNo;
+	semops[0].sem_op  = -value;
+	semops[0].sem_flg = 0;
+	semops[1].sem_num = semNo;
+	semops[1].sem_op  = value;
+	semops[1].sem_flg = 0;
+	if (semtimedop(semids[keyNo], semops, 2, &timeout) == -1) {
+		if (errno == EAGAIN || errno == EINTR)
+			return false;
+		perror("semtimedop"); std::exit(1);
+	}
+#endif
+	TESTPRINT("waited for semaphore %d of key %d\n", semNo, keyNo); // test
+	return true;
+}
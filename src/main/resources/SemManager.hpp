@@ -52,6 +52,7 @@ public:
 
 	void wait(int keyNo, int semNo, int value = 0); // wait until semaphore equal to value (blocking)
 	void waitgeq(int keyNo, int semNo, int value); // wait until semaphore at least value
+	bool waitgeq(int keyNo, int semNo, int value, long timeout_us); // as above, but return false after timeout_us microseconds
 
 };
 
@@ -21,6 +21,7 @@
 #include <cstdlib>
 
 #include "ShmAllocator.hpp"
+#include "TraceRecorder.hpp"
 
 #define CONSEM 0   // index of semaphore for consumer
 #define PROSEM 1   // index of semaphore for producer
@@ -30,7 +31,7 @@
 
 #define TESTPRINT if (verbose) printf
 
-ShmAllocator::ShmAllocator(std::string pname, int rank, bool verbose) : sems(pname, rank, verbose, true), current_key(KEYINIT), verbose(verbose)
+ShmAllocator::ShmAllocator(std::string pname, int rank, bool verbose) : sems(pname, rank, verbose, true), metrics(METRICS_PRODUCER, pname, rank, sems), current_key(KEYINIT), verbose(verbose), deleting(0)
 {
 	for (int i = 0; i < NKEYS; ++i) {
 		shmids[i] = -1;
@@ -53,19 +54,25 @@ ShmAllocator::~ShmAllocator()
 		TESTPRINT("freed pointer %d\n", i);
 		// or call out.wait_for() for a given timeout duration, making out a class field and not a static variable for shm_free
 	}
+	while (deleting > 0)
+		usleep(100); // the last wait_del may still use the semaphores and counters
 	TESTPRINT("deleted ShmAllocator\n");
 }
 
 void *ShmAllocator::shm_alloc(size_t size)
 {
+	TRACE_SPAN_ARG("ShmAllocator::shm_alloc", size);
 	current_key &= 1; // -2 becomes 0
 
 	TESTPRINT("trying lock for %d\n", current_key);
 	if (!used[current_key].try_lock()) {   // if current key locked, toggle it
 		current_key ^= 1;
 		TESTPRINT("trying lock for %d\n", current_key);
-		if (!used[current_key].try_lock()) // try locking other key
+		if (!used[current_key].try_lock()) { // try locking other key
+			TRACE_INSTANT("ShmAllocator heap fallback", size);
+			metrics.add(METRIC_FALLBACKS);
 			return malloc(size); // allocate from heap memory if both keys used
+		}
 	}
 	TESTPRINT("locked %d\n", current_key);
 	TESTPRINT("rank:%d\tkey:%d\n", current_key, sems[current_key]); // test
@@ -90,6 +97,7 @@ void *ShmAllocator::shm_alloc(size_t size)
 	// increment semaphore for new key to signal consumer
 	if (sems.get(current_key, PROSEM) == 0) // using semaphore as mutex
         sems.incr(current_key, PROSEM);
+	metrics.frame(size);
 
     // return pointer
     return ptrs[current_key];
@@ -98,6 +106,7 @@ void *ShmAllocator::shm_alloc(size_t size)
 void ShmAllocator::shm_free(void *ptr)
 {
 	static std::future<void> out;
+	TRACE_SPAN("ShmAllocator::shm_free");
 
 	// return if null pointer
 	if (ptr == NULL)
@@ -125,16 +134,21 @@ void ShmAllocator::shm_free(void *ptr)
 	// decrement semaphore for key
 	if (sems.get(key, PROSEM) != 0)
     	sems.decr(key, PROSEM);
+	metrics.add(METRIC_RELEASES);
 
     // wait_del(key);
+    ++deleting;
     out = std::async(std::launch::async, &ShmAllocator::wait_del, this, key);
 }
 
 void ShmAllocator::wait_del(int key)
 {
+	TRACE_SPAN_ARG("ShmAllocator::wait_del", key);
 	// wait for consumer to stop using key
 	// TODO possibly call semtimedop here
+	uint64_t start = metrics_now();
 	sems.wait(key, CONSEM, 0); // need to check if this is busy waiting
+	metrics.waited(start);
 
 	// execute after waiting so that another allocate call to the key would not mess things up
 	// used[key] = false; // ensure that ptrs[key] and shmids[key] only change when used[key] is false
@@ -148,4 +162,5 @@ void ShmAllocator::wait_del(int key)
 
     // mark key as unused by consumer
     used[key].unlock();
+    --deleting;
 }
\ No newline at end of file
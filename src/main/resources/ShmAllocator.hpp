@@ -15,6 +15,8 @@
  *   - wait for consumer to release key
  *   - mark key as unused
  *   - delete shared memory
+ *
+ * Publishing, heap fallbacks and the waits for consumers are counted in a ShmMetrics block
  */
 
 #ifndef SHM_ALLOC_HPP_
@@ -22,14 +24,17 @@
 
 #include <string>
 #include <mutex>
+#include <atomic>
 
 #include "SemManager.hpp"
+#include "ShmMetrics.hpp"
 
 #define SHMINIT -1 // value of shmids[key] when no shared memory is associated to key
 
 class ShmAllocator {
 
 	SemManager sems;
+	ShmMetrics metrics;
 	bool verbose;
 
 	// bool used[NKEYS];   // whether each key is currently used (allocated and not yet deleted, incl. not released by consumer)
@@ -38,6 +43,7 @@ class ShmAllocator {
 	void *ptrs[NKEYS];  // pointers allocated for each key (NULL if not allocated)
 
 	int current_key;    // takes values 0 or 1; most recent memory allocated using keys[current_key]
+	std::atomic<int> deleting; // wait_del calls not yet done
 
     void wait_del(int key); // wait to delete ptrs[key], called from shm_free
 
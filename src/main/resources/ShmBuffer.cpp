@@ -1,20 +1,29 @@
 #include <iostream>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <cstdlib>
+#include <chrono>
 
 #include "ShmBuffer.hpp"
+#include "TraceRecorder.hpp"
 
 #define CONSEM 0   // index of semaphore for consumer
 #define PROSEM 1   // index of semaphore for producer
 #define KEYINIT -1 // initial value of current_key to signify no previous memory allocated
 #define NEXTKEY (1^current_key)
 #define PREVKEY NEXTKEY
+#define STALEWAIT 100 // us to wait for the producer to free a segment we have already read
 
-ShmBuffer::ShmBuffer(std::string pname, int rank, size_t size, bool verbose) : sems(pname, rank, verbose, false), size(size), current_key(KEYINIT), shmid(-1), verbose(verbose) // , ptr(NULL)
+ShmBuffer::ShmBuffer(std::string pname, int rank, size_t size, bool verbose) : sems(pname, rank, verbose, false), metrics(METRICS_CONSUMER, pname, rank, sems), size(size), current_key(KEYINIT), shmid(-1), verbose(verbose) // , ptr(NULL)
 {
-	for (int i = 0; i < NKEYS; ++i)
+	for (int i = 0; i < NKEYS; ++i) {
 		ptrs[i] = NULL;
+		lastids[i] = -1;
+		pins[i] = NULL;
+	}
+	pinsize = 0;
 	// find_active();
 }
 
@@ -24,6 +33,46 @@ ShmBuffer::~ShmBuffer()
 		detach(true);
 		detach(false);
 	}
+	for (int i = 0; i < NKEYS; ++i)
+		if (pins[i] != NULL)
+			munmap(pins[i], pinsize);
+}
+
+// reserve [addr, addr+len) without backing memory; addr NULL lets the kernel choose
+static void *reserve(void *addr, size_t len)
+{
+	int flags = MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE;
+	if (addr != NULL)
+		flags |= MAP_FIXED;
+	void *ptr = mmap(addr, len, PROT_NONE, flags, -1, 0);
+	if (ptr == MAP_FAILED) {
+		perror("mmap"); std::exit(1);
+	}
+	return ptr;
+}
+
+void ShmBuffer::pin()
+{
+	if (pinsize != 0)
+		return;
+
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	pinsize = (size + page - 1) / page * page;
+	for (int i = 0; i < NKEYS; ++i) {
+		pins[i] = reserve(NULL, pinsize);
+		if (verbose) std::cout << "pinned key " << i << " at " << pins[i] << std::endl; // test
+	}
+}
+
+bool ShmBuffer::fresh(int key)
+{
+	if (sems.get(key, PROSEM) == 0)
+		return false;
+
+	// the producer publishes the next segment before freeing the previous one, so for a moment
+	// both keys are marked; skip the one we already attached to until it has been replaced
+	int id = shmget(sems[key], 0, 0666);
+	return id != -1 && id != lastids[key];
 }
 
 void ShmBuffer::find_active() // move to attach(), should always be called before it
@@ -39,6 +88,7 @@ void ShmBuffer::find_active() // move to attach(), should always be called befor
 
 void *ShmBuffer::attach()
 {
+	TRACE_SPAN_ARG("ShmBuffer::attach", current_key);
 	if (ptrs[current_key] != NULL)
 		return ptrs[current_key];
 
@@ -53,15 +103,32 @@ void *ShmBuffer::attach()
 	}
 	if (verbose) std::cout << "shmid: " << shmid << std::endl; // test
 
-	// shmat to attach to shared memory
-	ptrs[current_key] = shmat(shmid, NULL, 0);
-	if (ptrs[current_key] == NULL) {
+	// shmat to attach to shared memory, replacing the reserved range if pinned
+	void *ptr;
+	struct shmid_ds ds;
+	bool stat = shmctl(shmid, IPC_STAT, &ds) == 0;
+	bool fits = pins[current_key] != NULL && stat && ds.shm_segsz <= pinsize;
+	if (fits) { // a larger segment would overrun the reserved range
+#ifdef SHM_REMAP
+		ptr = shmat(shmid, pins[current_key], SHM_REMAP);
+#else
+		munmap(pins[current_key], pinsize); // no atomic replacement, range is briefly unreserved
+		ptr = shmat(shmid, pins[current_key], 0);
+#endif
+	} else {
+		ptr = shmat(shmid, NULL, 0);
+	}
+	if (ptr == NULL || ptr == (void *) -1) {
 		perror("shmat"); std::exit(1);
 	}
+	ptrs[current_key] = ptr;
+	lastids[current_key] = shmid;
 
 	// increment consumer semaphore
 	if (sems.get(current_key, CONSEM) == 0) // using semaphore as mutex
 	    sems.incr(current_key, CONSEM); //TODO: Move this before shmget or even earlier
+	metrics.hold(current_key, true);
+	metrics.frame(stat ? ds.shm_segsz : size);
 
 	return ptrs[current_key];
 }
@@ -69,20 +136,27 @@ void *ShmBuffer::attach()
 void ShmBuffer::detach(bool current)
 {
 	int key = current ? current_key : PREVKEY;
+	TRACE_SPAN_ARG("ShmBuffer::detach", key);
 
 	if (ptrs[key] == NULL)
 		return;
 
-	// detach from shared memory
+	// detach from shared memory, keeping the pinned range reserved for the next segment of key
 	shmdt(ptrs[key]);
+	if (pins[key] != NULL && ptrs[key] == pins[key])
+		reserve(pins[key], pinsize);
 	ptrs[key] = NULL;
 
 	// release semaphore, alerting producer to delete shmid
 	sems.decr(key, CONSEM);
+	metrics.hold(key, false);
+	metrics.add(METRIC_RELEASES);
 }
 
 void ShmBuffer::update_key(bool wait) // should keep some sort of mutex for ptr, so that it is never read as null between detaching and attaching
 {
+	TRACE_SPAN_ARG("ShmBuffer::update_key", wait);
+	uint64_t start = metrics_now();
 	if (current_key == KEYINIT) { // called initially
 		std::cout << "looking for available memory" << std::endl; // test
 
@@ -94,10 +168,11 @@ void ShmBuffer::update_key(bool wait) // should keep some sort of mutex for ptr,
 	} else {
 		if (wait) {
 			if (verbose) std::cout << "waiting for memory " << NEXTKEY << std::endl; // test
-			sems.waitgeq(NEXTKEY, PROSEM, 1);
+			while (sems.waitgeq(NEXTKEY, PROSEM, 1), !fresh(NEXTKEY))
+				usleep(STALEWAIT);
 		} else {
 			if (verbose) std::cout << "checking for memory " << NEXTKEY << std::endl; // test
-			while (sems.get(NEXTKEY, PROSEM) == 0);
+			while (!fresh(NEXTKEY));
 		}
 		if (verbose) std::cout << "memory " << NEXTKEY << " available" << std::endl; // test
 
@@ -105,12 +180,48 @@ void ShmBuffer::update_key(bool wait) // should keep some sort of mutex for ptr,
 		// detach();
 		current_key = NEXTKEY;
 	}
+	metrics.waited(start);
 	// assert ptr == NULL
 
 	// attach to new key
 	// attach();
 }
 
+bool ShmBuffer::try_update_key(long timeout_us)
+{
+	TRACE_SPAN_ARG("ShmBuffer::try_update_key", timeout_us);
+	uint64_t start = metrics_now();
+	if (current_key == KEYINIT) {
+		for (long waited = 0; ; waited += 1000) {
+			find_active();
+			if (current_key != KEYINIT || waited >= timeout_us)
+				break;
+			usleep(1000); // no semaphore to wait on before the first segment, poll
+		}
+		metrics.waited(start);
+		metrics.add(METRIC_TIMEOUTS, current_key == KEYINIT);
+		return current_key != KEYINIT;
+	}
+
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+	while (!fresh(NEXTKEY)) {
+		long left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+		bool stale = left > 0 && sems.get(NEXTKEY, PROSEM) > 0; // still the segment we read last
+		if (left <= 0 || (!stale && !sems.waitgeq(NEXTKEY, PROSEM, 1, left))) {
+			metrics.waited(start);
+			metrics.add(METRIC_TIMEOUTS);
+			return false;
+		}
+		if (stale)
+			usleep(STALEWAIT);
+	}
+	metrics.waited(start);
+
+	if (verbose) std::cout << "memory " << NEXTKEY << " available" << std::endl; // test
+	current_key = NEXTKEY;
+	return true;
+}
+
 // ignore these for now
 
 /*
@@ -2,6 +2,11 @@
  * Shared memory consumer, storing and updating pointer to shared memory
  *
  * User program must attach before detaching
+ *
+ * pin(): reserve one address range per key, so that every segment of a key is attached at the same
+ * address; objects wrapping the memory of a key (e.g. JNI ByteBuffers) can then be created once and reused
+ *
+ * Segments attached to, waits for new ones and timeouts are counted in a ShmMetrics block
  */
 
 #ifndef SHM_BUFFER_HPP
@@ -10,10 +15,12 @@
 #include <future>
 
 #include "SemManager.hpp"
+#include "ShmMetrics.hpp"
 
 class ShmBuffer {
 
 	SemManager sems;
+	ShmMetrics metrics;
 	size_t size; // buffer size in bytes
 
 	bool verbose;
@@ -23,22 +30,33 @@ class ShmBuffer {
 	int current_key;    // takes values 0 or 1; most recent memory read from keys[current_key]
 	int shmid;          // the shared memory id used for current key (-1 if not used)
 	void *ptrs[NKEYS];  // pointers to shared memory, NULL if not allocated
+	int lastids[NKEYS]; // shmid last attached to for each key, so a segment is not read twice
+	void *pins[NKEYS];  // reserved address ranges segments are attached at, NULL if not pinned
+	size_t pinsize;     // length of each reserved range
 
 	std::future<void> out;
 
 	// void loop(); // event loop // this should be implemented in Kotlin
 
 	void find_active(); // find key used by producer and set current_key to it; if no key found set it to -1
+	bool fresh(int key); // whether the producer has published a segment under key that we have not attached to yet
 
 public:
 
 	ShmBuffer(std::string pname, int rank, size_t size, bool verbose = true);
 	~ShmBuffer();
 
+	void pin(); // reserve fixed addresses for both keys, call before the first attach
+	void *pinned(int key) const { return pins[key]; } // address segments of key are attached at, NULL if not pinned
+
 	void *attach(); // attach to current memory
 	void detach(bool current = true); // detach from current memory (true) or old memory (false)
 
 	void update_key(bool wait = true); // find new key to attach to, call before attaching
+	bool try_update_key(long timeout_us = 0); // like update_key, but return false if the producer has no new memory within timeout_us microseconds
+
+	int key() const { return current_key; } // key currently attached to, or -1 before the first update_key
+	size_t get_size() const { return size; }
 
 	// below should be implemented in Kotlin
 
@@ -0,0 +1,168 @@
+/*
+ * Live counters of shared memory producers and consumers
+ *
+ *
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+#include <sys/stat.h>
+
+#include "ShmMetrics.hpp"
+
+#define CONSEM 0   // index of semaphore for consumer, as in ShmAllocator.cpp
+
+#define PROJ_ID(rank, toggle) (2*(rank)+1+(toggle)) // as in SemManager.cpp
+
+namespace {
+
+bool running(int pid)
+{
+	return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+bool by_path(const MetricsSample &a, const MetricsSample &b)
+{
+	return a.path < b.path;
+}
+
+// whether a block of a running process uses key, as producer if role is METRICS_PRODUCER, held by a
+// consumer if METRICS_CONSUMER, either way if -1
+bool claimed(const std::vector<MetricsSample> &blocks, int key, int role)
+{
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		const MetricsBlock &b = blocks[i].block;
+		if (!blocks[i].alive || (role != -1 && b.role != role))
+			continue;
+		for (int k = 0; k < NKEYS; ++k)
+			if (b.keys[k] == key && (role != METRICS_CONSUMER || (b.held >> k & 1)))
+				return true;
+	}
+	return false;
+}
+
+// remove the segment and semaphore of key unless a process is attached to the segment
+bool remove_key(int key, FILE *report)
+{
+	bool removed = true;
+	int shmid = shmget(key, 0, 0);
+	struct shmid_ds ds;
+	if (shmid != -1 && shmctl(shmid, IPC_STAT, &ds) == 0) {
+		if (ds.shm_nattch == 0 && shmctl(shmid, IPC_RMID, NULL) == 0) {
+			if (report != NULL) fprintf(report, "removed segment %d of key 0x%x\n", shmid, key);
+		} else {
+			if (report != NULL) fprintf(report, "kept segment %d of key 0x%x, %lu attached\n", shmid, key, (unsigned long) ds.shm_nattch);
+			removed = false;
+		}
+	}
+	int semid = semget(key, 0, 0);
+	if (semid != -1 && semctl(semid, 0, IPC_RMID) == 0 && report != NULL)
+		fprintf(report, "removed semaphores %d of key 0x%x\n", semid, key);
+	return removed;
+}
+
+}
+
+bool metrics_scan(const char *dir, std::vector<MetricsSample> &out)
+{
+	DIR *d = opendir(dir);
+	if (d == NULL)
+		return false;
+	for (struct dirent *entry; (entry = readdir(d)) != NULL; ) {
+		if (strncmp(entry->d_name, METRICS_PREFIX, strlen(METRICS_PREFIX)) != 0)
+			continue;
+		MetricsSample s;
+		s.path = std::string(dir) + "/" + entry->d_name;
+
+		// a read is enough and, unlike a mapping, needs no address space per block
+		int fd = open(s.path.c_str(), O_RDONLY);
+		if (fd < 0)
+			continue;
+		MetricsBlock b;
+		ssize_t n = pread(fd, &b, sizeof(b), 0);
+		close(fd);
+		if (n != (ssize_t) sizeof(b) || metrics_block(&b, sizeof(b)) == NULL)
+			continue;
+		b.pname[sizeof(b.pname) - 1] = '\0';
+		s.block = b;
+		s.alive = running(b.pid);
+		out.push_back(s);
+	}
+	closedir(d);
+	std::sort(out.begin(), out.end(), by_path);
+	return true;
+}
+
+int metrics_reclaim(const char *dir, FILE *report)
+{
+	std::vector<MetricsSample> blocks;
+	if (!metrics_scan(dir, blocks)) {
+		perror(dir);
+		return 0;
+	}
+
+	int removed = 0;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		const MetricsBlock &b = blocks[i].block;
+		if (blocks[i].alive)
+			continue;
+
+		for (int k = 0; k < NKEYS; ++k) {
+			if (b.role == METRICS_PRODUCER && !claimed(blocks, b.keys[k], -1)) {
+				remove_key(b.keys[k], report);
+			} else if (b.role == METRICS_CONSUMER && (b.held >> k & 1) && !claimed(blocks, b.keys[k], METRICS_CONSUMER)) {
+				// the consumer semaphore is used as a flag, 1 while any consumer is attached
+				int semid = semget(b.keys[k], 0, 0);
+				union semun arg;
+				arg.val = 0;
+				if (semid != -1 && semctl(semid, CONSEM, GETVAL) > 0 && semctl(semid, CONSEM, SETVAL, arg) == 0 && report != NULL)
+					fprintf(report, "released key 0x%x held by exited consumer %d\n", b.keys[k], b.pid);
+			}
+		}
+		if (unlink(blocks[i].path.c_str()) == 0) {
+			++removed;
+			if (report != NULL) fprintf(report, "removed %s of exited %s %d\n", blocks[i].path.c_str(),
+				b.role == METRICS_PRODUCER ? "producer" : "consumer", b.pid);
+		}
+	}
+	return removed;
+}
+
+void metrics_keys(const std::string &pname, int rank, int keys[NKEYS])
+{
+	for (int i = 0; i < NKEYS; ++i)
+		keys[i] = ftok(pname.c_str(), PROJ_ID(rank, i));
+}
+
+bool metrics_reclaim_rank(const char *dir, const std::string &pname, int rank, FILE *report)
+{
+	std::vector<MetricsSample> blocks;
+	metrics_scan(dir, blocks);
+
+	int keys[NKEYS];
+	metrics_keys(pname, rank, keys);
+	bool all = true;
+	for (int k = 0; k < NKEYS; ++k) {
+		if (keys[k] == -1) {
+			perror(pname.c_str());
+			return false;
+		}
+		if (claimed(blocks, keys[k], -1)) {
+			if (report != NULL) fprintf(report, "kept key 0x%x of rank %d, in use by a running process\n", keys[k], rank);
+			all = false;
+			continue;
+		}
+		all = remove_key(keys[k], report) && all;
+	}
+	return all;
+}
@@ -0,0 +1,236 @@
+/*
+ * Live counters of shared memory producers and consumers
+ *
+ * Every ShmAllocator and ShmBuffer keeps a MetricsBlock of counters in a small file of its own,
+ * METRICS_DIR/insitu-stat.<pid>.<n> (INSITU_STAT_DIR overrides METRICS_DIR), removed again by its
+ * destructor. The block names the process, its role, pname, rank and SysV keys, and counts
+ *
+ * METRIC_FRAMES:      segments published (producer) or attached to (consumer)
+ * METRIC_RELEASES:    segments freed (producer) or detached from (consumer)
+ * METRIC_FALLBACKS:   shm_alloc calls served from the heap because both keys were in use
+ * METRIC_TIMEOUTS:    try_update_key calls that found no new segment in time
+ * METRIC_BYTES:       bytes of the segments published or attached to
+ * METRIC_WAITS, METRIC_WAIT_NS, METRIC_MAX_WAIT_NS: calls blocking on the other side, their total
+ *     and longest time; the producer waiting for consumers to release, the consumer for new segments
+ * METRIC_LAST_FRAME:  CLOCK_MONOTONIC ns of the last frame, for its age
+ *
+ * Updates are relaxed atomic additions to a mapped page, no system calls, so the blocks are always
+ * on; a reader samples them with a read of the file whenever it likes. A consumer also marks in held
+ * the keys whose consumer semaphore it holds, so that the ones a crashed consumer left behind can be
+ * released. Blocks, segments and semaphores of exited processes are reclaimed by insitu_stat -c
+ * (src/test/cpp), with the scanning and reclaiming in ShmMetrics.cpp:
+ *
+ * metrics_scan(dir, out):        the blocks in dir, read when called
+ * metrics_reclaim(dir):          release what processes that exited left behind, see below
+ * metrics_reclaim_rank(...):     remove the segments and semaphores of a pname and rank nobody uses
+ *
+ * A block that cannot be created, e.g. without /dev/shm, leaves the counters off.
+ */
+
+#ifndef SHM_METRICS_HPP
+#define SHM_METRICS_HPP
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "SemManager.hpp"
+
+#define METRICS_MAGIC "INSTAT01"
+#define METRICS_VERSION 1
+#ifdef __APPLE__
+#define METRICS_DIR "/tmp"
+#else
+#define METRICS_DIR "/dev/shm"
+#endif
+#define METRICS_PREFIX "insitu-stat."
+#define METRICS_COUNTERS 16 // slots, the ones in use below
+
+enum MetricsRole {
+	METRICS_PRODUCER = 0,
+	METRICS_CONSUMER = 1
+};
+
+enum MetricsCounter {
+	METRIC_FRAMES      = 0,
+	METRIC_RELEASES    = 1,
+	METRIC_FALLBACKS   = 2,
+	METRIC_TIMEOUTS    = 3,
+	METRIC_BYTES       = 4,
+	METRIC_WAITS       = 5,
+	METRIC_WAIT_NS     = 6,
+	METRIC_MAX_WAIT_NS = 7,
+	METRIC_LAST_FRAME  = 8
+};
+
+struct MetricsBlock {       // 256 bytes
+	char magic[8];
+	uint32_t version;
+	int32_t pid;
+	int32_t role;           // MetricsRole
+	int32_t rank;
+	int32_t keys[NKEYS];    // SysV keys of the segments and semaphores
+	uint32_t held;          // bit k set while a consumer holds the consumer semaphore of key k
+	uint32_t reserved0;
+	uint64_t created;       // ns, CLOCK_MONOTONIC
+	char pname[64];
+	uint64_t counters[METRICS_COUNTERS];
+	uint64_t reserved[2];
+};
+
+inline const char *metrics_dir()
+{
+	const char *dir = getenv("INSITU_STAT_DIR");
+	return (dir != NULL && dir[0] != '\0') ? dir : METRICS_DIR;
+}
+
+inline uint64_t metrics_now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ull + (uint64_t) t.tv_nsec;
+}
+
+// NULL unless base holds a block that fits into bytes
+inline const MetricsBlock *metrics_block(const void *base, size_t bytes)
+{
+	const MetricsBlock *b = (const MetricsBlock *) base;
+	if (base == NULL || bytes < sizeof(MetricsBlock) || memcmp(b->magic, METRICS_MAGIC, sizeof(b->magic)) != 0 || b->version != METRICS_VERSION)
+		return NULL;
+	return b;
+}
+
+class ShmMetrics {
+
+	MetricsBlock *block;    // NULL if the counters are off
+	std::string path;
+
+public:
+
+	ShmMetrics(int role, const std::string &pname, int rank, SemManager &sems) : block(NULL)
+	{
+		// pids are reused and a process can have many producers and consumers, so take the first free name
+		int fd = -1;
+		char name[512];
+		for (int n = 0; n < 1000 && fd < 0; ++n) {
+			snprintf(name, sizeof(name), "%s/%s%d.%d", metrics_dir(), METRICS_PREFIX, (int) getpid(), n);
+			fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+			if (fd < 0 && errno != EEXIST)
+				break;
+		}
+		if (fd < 0) {
+			perror("ShmMetrics");
+			return;
+		}
+		void *base = MAP_FAILED;
+		if (ftruncate(fd, sizeof(MetricsBlock)) == 0)
+			base = mmap(NULL, sizeof(MetricsBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED) {
+			perror("ShmMetrics");
+			unlink(name);
+			return;
+		}
+
+		MetricsBlock *b = (MetricsBlock *) base;
+		b->version = METRICS_VERSION;
+		b->pid = (int32_t) getpid();
+		b->role = role;
+		b->rank = rank;
+		for (int i = 0; i < NKEYS; ++i)
+			b->keys[i] = sems[i];
+		b->created = metrics_now();
+		strncpy(b->pname, pname.c_str(), sizeof(b->pname) - 1);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		memcpy(b->magic, METRICS_MAGIC, sizeof(b->magic)); // readers skip the block until here
+		block = b;
+		path = name;
+	}
+
+	~ShmMetrics()
+	{
+		if (block != NULL) {
+			munmap(block, sizeof(MetricsBlock));
+			unlink(path.c_str());
+		}
+	}
+
+	ShmMetrics(const ShmMetrics &) = delete;
+	ShmMetrics &operator=(const ShmMetrics &) = delete;
+
+	void add(int counter, uint64_t value = 1)
+	{
+		if (block != NULL)
+			__atomic_fetch_add(&block->counters[counter], value, __ATOMIC_RELAXED);
+	}
+
+	// a segment of bytes published or attached to
+	void frame(size_t bytes)
+	{
+		if (block == NULL)
+			return;
+		add(METRIC_FRAMES);
+		add(METRIC_BYTES, bytes);
+		__atomic_store_n(&block->counters[METRIC_LAST_FRAME], metrics_now(), __ATOMIC_RELAXED);
+	}
+
+	// a wait that began at start, from metrics_now()
+	void waited(uint64_t start)
+	{
+		if (block == NULL)
+			return;
+		uint64_t ns = metrics_now() - start;
+		add(METRIC_WAITS);
+		add(METRIC_WAIT_NS, ns);
+		uint64_t max = __atomic_load_n(&block->counters[METRIC_MAX_WAIT_NS], __ATOMIC_RELAXED);
+		while (ns > max && !__atomic_compare_exchange_n(&block->counters[METRIC_MAX_WAIT_NS], &max, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	}
+
+	void hold(int key, bool held)
+	{
+		if (block == NULL)
+			return;
+		if (held)
+			__atomic_fetch_or(&block->held, 1u << key, __ATOMIC_RELAXED);
+		else
+			__atomic_fetch_and(&block->held, ~(1u << key), __ATOMIC_RELAXED);
+	}
+
+	const char *file() const { return block != NULL ? path.c_str() : NULL; }
+};
+
+// a block as read by metrics_scan
+struct MetricsSample {
+	std::string path;
+	MetricsBlock block;     // a copy, as read from the file
+	bool alive;             // whether its process still runs
+};
+
+// the blocks in dir, sorted by path; false if dir cannot be read
+bool metrics_scan(const char *dir, std::vector<MetricsSample> &out);
+
+/*
+ * For every block of a process that exited: a producer's segments no process is attached to and its
+ * semaphores are removed, a consumer's hold on consumer semaphores is released so that the producer
+ * stops waiting, and the block is removed; keys that a running process has a block for are left
+ * alone, since a restarted producer or consumer of the same pname and rank uses the same keys.
+ * Prints what it does to report if not NULL, returns the number of blocks removed.
+ */
+int metrics_reclaim(const char *dir, FILE *report);
+
+// the keys of rank under pname, as SemManager makes them
+void metrics_keys(const std::string &pname, int rank, int keys[NKEYS]);
+
+// remove the segments and semaphores of rank under pname unless a running process has a block for
+// them or is attached; returns false if any were kept
+bool metrics_reclaim_rank(const char *dir, const std::string &pname, int rank, FILE *report);
+
+#endif
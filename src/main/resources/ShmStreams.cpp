@@ -0,0 +1,127 @@
+/*
+ * Handle-based shared memory streams for consumers
+ *
+ *
+ *
+ */
+
+#include <cstdlib>
+
+#include "ShmStreams.hpp"
+
+ShmStream::ShmStream(std::string pname, int rank, size_t size, bool verbose, bool pinned) : buf(pname, rank, size, verbose), attached(false), seq(0), pname(pname), rank(rank)
+{
+	for (int i = 0; i < NKEYS; ++i)
+		cookies[i] = NULL;
+	if (pinned)
+		buf.pin();
+}
+
+ShmFrame ShmStream::acquire(bool wait)
+{
+	ShmFrame frame;
+	frame.ptr = NULL;
+	frame.size = buf.get_size();
+	frame.slot = buf.key();
+	frame.seq = seq;
+
+	if (wait)
+		buf.update_key(true); // initially spins until the producer has published its first segment
+	else if (!buf.try_update_key(0)) // also before the first segment
+		return frame;
+
+	return attach_next();
+}
+
+ShmFrame ShmStream::try_acquire(long timeout_us)
+{
+	ShmFrame frame;
+	frame.ptr = NULL;
+	frame.size = buf.get_size();
+	frame.slot = buf.key();
+	frame.seq = seq;
+
+	if (!buf.try_update_key(timeout_us))
+		return frame;
+
+	return attach_next();
+}
+
+ShmFrame ShmStream::attach_next()
+{
+	ShmFrame frame;
+	attached = true;
+	frame.ptr = buf.attach();
+	frame.size = buf.get_size();
+	frame.slot = buf.key();
+	frame.seq = ++seq;
+	return frame;
+}
+
+void ShmStream::release()
+{
+	if (attached)
+		buf.detach(false);
+}
+
+void ShmStream::detach_all()
+{
+	if (attached) {
+		buf.detach(true);
+		buf.detach(false);
+	}
+}
+
+int ShmStreams::open(std::string pname, int rank, size_t size)
+{
+	std::shared_ptr<ShmStream> stream(new ShmStream(pname, rank, size, verbose));
+
+	std::lock_guard<std::mutex> guard(lock);
+	streams.push_back(stream);
+	grouped.push_back(false);
+	return (int) streams.size() - 1;
+}
+
+std::shared_ptr<ShmStream> ShmStreams::get(int handle)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (handle < 0 || handle >= (int) streams.size())
+		return std::shared_ptr<ShmStream>();
+	return streams[handle];
+}
+
+std::shared_ptr<ShmStream> ShmStreams::close(int handle)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	std::shared_ptr<ShmStream> stream;
+	if (handle < 0 || handle >= (int) streams.size() || grouped[handle])
+		return stream;
+	stream.swap(streams[handle]);
+	return stream;
+}
+
+bool ShmStreams::join_group(const std::vector<int> &handles, std::vector<std::shared_ptr<ShmStream> > &out)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	out.clear();
+	for (size_t i = 0; i < handles.size(); ++i) {
+		int h = handles[i];
+		if (h < 0 || h >= (int) streams.size() || !streams[h] || grouped[h]) {
+			for (size_t j = 0; j < i; ++j)
+				grouped[handles[j]] = false;
+			out.clear();
+			return false;
+		}
+		grouped[h] = true;
+		out.push_back(streams[h]);
+	}
+	return true;
+}
+
+void ShmStreams::leave_group(const std::vector<int> &handles)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	for (size_t i = 0; i < handles.size(); ++i)
+		if (handles[i] >= 0 && handles[i] < (int) grouped.size())
+			grouped[handles[i]] = false;
+}
@@ -0,0 +1,92 @@
+/*
+ * Handle-based shared memory streams for consumers
+ *
+ * A stream is one field of one producer rank, i.e. the segments an ShmAllocator(pname, rank)
+ * publishes, read through its own ShmBuffer. Any number of streams can be open at once:
+ *
+ * ShmStreams::open(pname, rank, size): create a stream, return a handle (never reused)
+ * ShmStreams::get(handle):             look up a stream, NULL if the handle is not open
+ * ShmStreams::close(handle):           remove a stream; it is destroyed once the last user lets go
+ * ShmStreams::join_group(handles, out): mark streams as served by a group (see StreamWaiter)
+ * ShmStreams::leave_group(handles):     unmark them once the group has stopped
+ *
+ * ShmStream::acquire(wait):            switch to the producer's latest segment and attach to it
+ * ShmStream::try_acquire(timeout_us):  same, giving up after a timeout, also before the first segment
+ * ShmStream::release():                detach from the previous segment, letting the producer free it
+ *
+ * Streams pin their slots (see ShmBuffer::pin), so each slot is always mapped at the same address
+ * and anything wrapping its memory, kept in cookies, only has to be created once.
+ *
+ * The table and each stream have their own mutex, so threads consuming different streams never
+ * contend; callers hold ShmStream::lock around acquire/release and around any use of cookies. The
+ * stream lock is recursive, so that code called while a frame is reported under it can take it again.
+ * A stream in a group cannot be closed until the group has left it, since its waiter thread keeps
+ * acquiring frames and its cookies with them.
+ */
+
+#ifndef SHM_STREAMS_HPP
+#define SHM_STREAMS_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+
+#include "ShmBuffer.hpp"
+
+struct ShmFrame {
+	void *ptr;   // start of the segment, NULL if there is no new frame
+	size_t size; // segment size in bytes
+	int slot;    // which of the producer's NKEYS keys the segment belongs to
+	long seq;    // number of frames acquired on the stream, including this one
+};
+
+class ShmStream {
+
+	ShmBuffer buf;
+	bool attached; // whether the first segment has been found
+	long seq;
+
+	ShmFrame attach_next(); // attach to the key just found by the buffer
+
+public:
+
+	std::recursive_mutex lock;
+	void *cookies[NKEYS]; // owner data per slot, e.g. objects wrapping the slot's memory, NULL initially
+
+	const std::string pname;
+	const int rank;
+
+	ShmStream(std::string pname, int rank, size_t size, bool verbose = false, bool pinned = true);
+
+	ShmFrame acquire(bool wait = true); // ptr is NULL if wait is false and the producer has no new frame
+	ShmFrame try_acquire(long timeout_us); // ptr is NULL if the producer has no new frame within timeout_us microseconds
+	void release();                     // detach from the segment before the current one
+	void detach_all();                  // detach from both segments, e.g. before closing
+
+	size_t size() const { return buf.get_size(); }
+};
+
+class ShmStreams {
+
+	std::mutex lock;
+	std::vector<std::shared_ptr<ShmStream> > streams; // indexed by handle, NULL once closed
+	std::vector<bool> grouped;                        // whether a group serves the stream
+
+	bool verbose;
+
+public:
+
+	ShmStreams(bool verbose = false) : verbose(verbose) {}
+
+	int open(std::string pname, int rank, size_t size);
+	std::shared_ptr<ShmStream> get(int handle);
+	std::shared_ptr<ShmStream> close(int handle); // returns the stream for final cleanup, NULL if not open or in a group
+
+	// fill out with the streams of handles and mark them as grouped; false, changing nothing, if a
+	// handle is not open, is already in a group or is given twice
+	bool join_group(const std::vector<int> &handles, std::vector<std::shared_ptr<ShmStream> > &out);
+	void leave_group(const std::vector<int> &handles);
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Waiter thread for a group of shared memory streams
+ *
+ *
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "StreamWaiter.hpp"
+
+StreamWaiter::StreamWaiter(const std::vector<std::shared_ptr<ShmStream> > &streams, FrameCallback on_frame, size_t capacity,
+		std::function<void()> on_start, std::function<void()> on_stop) : streams(streams), on_frame(on_frame), on_start(on_start), on_stop(on_stop), ndropped(0),
+		queued(streams.size(), 0), held(streams.size(), 0), handed(streams.size(), 0), done(streams.size(), 0), running(true)
+{
+	if (capacity > 0)
+		queue.reset(new SpscRing<StreamEvent>(capacity));
+	waiter = std::thread(&StreamWaiter::run, this);
+}
+
+StreamWaiter::~StreamWaiter()
+{
+	stop();
+}
+
+void StreamWaiter::stop()
+{
+	running = false;
+	if (waiter.joinable())
+		waiter.join();
+}
+
+size_t StreamWaiter::poll(StreamEvent *events, size_t max)
+{
+	if (!queue)
+		return 0;
+
+	// the consumer is done with the frames returned last time
+	{
+		std::lock_guard<std::mutex> guard(acklock);
+		for (size_t i = 0; i < handed.size(); ++i)
+			done[i] = std::max(done[i], handed[i]);
+	}
+	acked.notify_one();
+
+	size_t n = 0;
+	while (n < max && queue->pop(events[n])) {
+		handed[events[n].index] = events[n].seq;
+		++n;
+	}
+	return n;
+}
+
+bool StreamWaiter::finished(int index, long seq, long timeout_us)
+{
+	std::unique_lock<std::mutex> guard(acklock);
+	return acked.wait_for(guard, std::chrono::microseconds(timeout_us), [&]() { return done[index] >= seq; });
+}
+
+bool StreamWaiter::check(int index, long timeout_us)
+{
+	ShmStream &stream = *streams[index];
+	if (held[index] != 0 && !finished(index, held[index], timeout_us))
+		return false; // the stream already holds two frames
+
+	std::lock_guard<std::recursive_mutex> guard(stream.lock); // also while reporting, so that nothing detaches the frame meanwhile
+	if (held[index] != 0) {
+		stream.release();
+		held[index] = 0;
+	}
+	ShmFrame frame = stream.try_acquire(timeout_us);
+	if (frame.ptr == NULL)
+		return false;
+
+	// the frame before stays attached while the consumer may still read it
+	if (queued[index] != 0 && !finished(index, queued[index], 0))
+		held[index] = queued[index];
+	else
+		stream.release();
+
+	StreamEvent event;
+	event.index = index;
+	event.slot = frame.slot;
+	event.seq = frame.seq;
+	event.flags = on_frame ? on_frame(index, stream, frame) : 0;
+
+	queued[index] = 0;
+	if (queue && queue->push(event))
+		queued[index] = frame.seq;
+	else if (queue)
+		++ndropped;
+	return true;
+}
+
+void StreamWaiter::run()
+{
+	if (on_start)
+		on_start();
+
+	int n = (int) streams.size();
+	std::vector<long> seqs(n, 0);
+	while (running && n > 0) {
+		// report whatever is ready without blocking
+		bool any = false;
+		for (int i = 0; i < n; ++i) {
+			if (check(i, 0)) {
+				++seqs[i];
+				any = true;
+			}
+		}
+		if (any)
+			continue;
+
+		// otherwise block on the stream furthest behind, the fields of a time step arrive together
+		int next = 0;
+		for (int i = 1; i < n; ++i)
+			if (seqs[i] < seqs[next])
+				next = i;
+		if (check(next, WAITSLICE))
+			++seqs[next];
+	}
+
+	// leave each stream with only its current frame, as if consumed directly
+	for (int i = 0; i < n; ++i) {
+		if (held[i] != 0) {
+			std::lock_guard<std::recursive_mutex> guard(streams[i]->lock);
+			streams[i]->release();
+			held[i] = 0;
+		}
+	}
+
+	if (on_stop)
+		on_stop();
+}
@@ -0,0 +1,127 @@
+/*
+ * Waiter thread for a group of shared memory streams
+ *
+ * One thread waits on the producer semaphores of all streams of a group, instead of the consumer
+ * polling each stream from its own thread. Every new frame is reported through on_frame, called on
+ * the waiter thread, and, if the group has a queue, pushed as a StreamEvent into a lock-free
+ * single-producer single-consumer ring that one other thread (e.g. the render thread) drains with
+ * poll(). on_start and on_stop run on the waiter thread before the first and after the last frame.
+ * on_frame is called with the stream's lock held.
+ *
+ * Without a queue, the waiter releases frame n-1 of a stream as soon as it has acquired frame n, so
+ * a frame stays valid until on_frame returns. With a queue, the frames of the events poll() returns
+ * stay valid until the next call of poll(): a stream's frame is only released once poll() has been
+ * called again after returning its event, and the waiter takes no new frame of a stream while it
+ * still holds two. A consumer that stops polling thus makes the producers of the group fall back to
+ * heap memory, rather than have frames it may still read rewritten. Frames whose events were dropped
+ * are released as without a queue. While a group is running its streams must not be acquired or
+ * released by anyone else.
+ */
+
+#ifndef STREAM_WAITER_HPP
+#define STREAM_WAITER_HPP
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "ShmStreams.hpp"
+
+#define WAITSLICE 5000 // microseconds to block on one stream before checking the others and whether to stop
+
+struct StreamEvent {
+	int index; // position of the stream in the group
+	int slot;
+	long seq;
+	int flags; // returned by on_frame
+};
+
+// fixed-capacity ring, one thread pushes and one thread pops
+template <typename T>
+class SpscRing {
+
+	std::vector<T> items;
+	size_t mask;
+	std::atomic<size_t> head; // next item to pop, written by the consumer
+	std::atomic<size_t> tail; // next free item, written by the producer
+
+public:
+
+	SpscRing(size_t capacity) : head(0), tail(0)
+	{
+		size_t n = 1;
+		while (n < capacity)
+			n <<= 1;
+		items.resize(n);
+		mask = n - 1;
+	}
+
+	bool push(const T &item) // false if full
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) > mask)
+			return false;
+		items[t & mask] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T &item) // false if empty
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		item = items[h & mask];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+class StreamWaiter {
+
+public:
+
+	typedef std::function<int(int index, ShmStream &stream, const ShmFrame &frame)> FrameCallback;
+
+private:
+
+	std::vector<std::shared_ptr<ShmStream> > streams;
+	FrameCallback on_frame;
+	std::function<void()> on_start, on_stop;
+
+	std::unique_ptr<SpscRing<StreamEvent> > queue; // NULL if the group has no queue
+	std::atomic<long> ndropped;
+
+	// frames still attached for the consumer, by seq per stream, 0 if none
+	std::vector<long> queued;   // waiter: the current frame, if its event was queued
+	std::vector<long> held;     // waiter: the frame before it, not yet released
+	std::vector<long> handed;   // poller: the last frame returned by poll()
+	std::mutex acklock;
+	std::condition_variable acked;
+	std::vector<long> done;     // the last frame the consumer is done with, under acklock
+
+	std::atomic<bool> running;
+	std::thread waiter;
+
+	void run();
+	bool check(int index, long timeout_us); // acquire and report the next frame of a stream, false if there is none
+	bool finished(int index, long seq, long timeout_us); // whether the consumer is done with frame seq, waiting up to timeout_us
+
+public:
+
+	// capacity 0 means no queue; callbacks may be empty
+	StreamWaiter(const std::vector<std::shared_ptr<ShmStream> > &streams, FrameCallback on_frame, size_t capacity = 0,
+			std::function<void()> on_start = std::function<void()>(), std::function<void()> on_stop = std::function<void()>());
+	~StreamWaiter();
+
+	void stop(); // stop and join the waiter thread, releasing all but the current frame of each stream; returns within about 2 WAITSLICE
+
+	size_t poll(StreamEvent *events, size_t max); // drain up to max queued events, return how many; see above
+	long dropped() const { return ndropped.load(); } // events not queued because the queue was full
+};
+
+#endif
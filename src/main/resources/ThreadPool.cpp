@@ -0,0 +1,41 @@
+/*
+ * A fixed set of worker threads for short tasks
+ *
+ *
+ *
+ */
+
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(int nthreads) : stopping(false)
+{
+	for (int t = 0; t < nthreads; ++t)
+		workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	ready.notify_all();
+	for (size_t t = 0; t < workers.size(); ++t)
+		workers[t].join();
+}
+
+void ThreadPool::work()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			ready.wait(guard, [this]() { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+				return; // stopping, and nothing left to run
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,65 @@
+/*
+ * A fixed set of worker threads for short tasks
+ *
+ * parallel_chunks starts threads per call, which is fine for a split that lasts a frame but not
+ * for the many small tasks of an exchange, e.g. compressing or decompressing one chunk of one
+ * message each. The pool keeps its threads for its lifetime and runs tasks in submission order:
+ *
+ * ThreadPool::submit(fn): queue fn(), return a future that becomes ready once it has run
+ *
+ * A pool of 0 threads runs each task inside submit, so single-core nodes need no special case.
+ * Exceptions thrown by a task are passed on to whoever gets its future. Pending tasks are run
+ * before the destructor returns.
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > tasks;
+	std::mutex lock;
+	std::condition_variable ready;
+	bool stopping;
+
+	void work();
+
+public:
+
+	explicit ThreadPool(int nthreads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	template <typename F>
+	std::future<void> submit(F fn)
+	{
+		std::shared_ptr<std::packaged_task<void()> > task = std::make_shared<std::packaged_task<void()> >(fn);
+		std::future<void> done = task->get_future();
+		if (workers.empty()) {
+			(*task)();
+			return done;
+		}
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			tasks.push_back([task]() { (*task)(); });
+		}
+		ready.notify_one();
+		return done;
+	}
+
+	int size() const { return (int) workers.size(); }
+};
+
+#endif
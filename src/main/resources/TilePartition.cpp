@@ -0,0 +1,86 @@
+/*
+ * Assignment of screen tiles to compositing ranks
+ *
+ *
+ *
+ */
+
+#include <algorithm>
+
+#include "TilePartition.hpp"
+#include "PrefixScan.hpp"
+
+TilePartition::TilePartition(size_t nlists, size_t tilelen, int nranks) : nlists(nlists), tilelen(tilelen), nranks(nranks)
+{
+	owners.assign(::tile_count(nlists, tilelen), 0);
+	tiles.resize(nranks);
+	lists.assign(nranks, 0);
+	loads.assign(nranks, 0);
+}
+
+size_t TilePartition::tile_lists(size_t tile) const
+{
+	return (tile == owners.size() - 1) ? nlists - tile * tilelen : tilelen;
+}
+
+void TilePartition::balance(const int64_t *costs, int method)
+{
+	size_t ntiles = owners.size();
+	int64_t total = 0;
+	for (size_t t = 0; t < ntiles; ++t)
+		total += costs[t];
+
+	if (method == PARTITION_GREEDY) {
+		std::vector<size_t> byCost(ntiles);
+		for (size_t t = 0; t < ntiles; ++t)
+			byCost[t] = t;
+		std::stable_sort(byCost.begin(), byCost.end(), [costs](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+		// ties go to the rank with fewer lists, then the lower rank, so empty tiles spread evenly
+		std::vector<int64_t> load(nranks, 0);
+		std::vector<size_t> count(nranks, 0);
+		for (size_t i = 0; i < ntiles; ++i) {
+			int best = 0;
+			for (int r = 1; r < nranks; ++r)
+				if (load[r] < load[best] || (load[r] == load[best] && count[r] < count[best]))
+					best = r;
+			owners[byCost[i]] = best;
+			load[best] += costs[byCost[i]];
+			count[best] += tile_lists(byCost[i]);
+		}
+	} else if (method == PARTITION_CONTIGUOUS && total > 0) {
+		// tile t goes to the rank whose share of the total contains the middle of its cost
+		int64_t before = 0;
+		for (size_t t = 0; t < ntiles; ++t) {
+			int r = (int) ((2 * before + costs[t]) * nranks / (2 * total));
+			owners[t] = std::min(r, nranks - 1);
+			before += costs[t];
+		}
+	} else {
+		size_t per = ntiles / nranks;
+		for (size_t t = 0; t < ntiles; ++t)
+			owners[t] = (per == 0) ? (int) std::min(t, (size_t) nranks - 1) : (int) std::min(t / per, (size_t) nranks - 1);
+	}
+
+	for (int r = 0; r < nranks; ++r) {
+		tiles[r].clear();
+		lists[r] = 0;
+		loads[r] = 0;
+	}
+	for (size_t t = 0; t < ntiles; ++t) {
+		int r = owners[t];
+		tiles[r].push_back((int32_t) t);
+		lists[r] += tile_lists(t);
+		loads[r] += costs[t];
+	}
+}
+
+double TilePartition::imbalance() const
+{
+	int64_t total = 0, max = 0;
+	for (int r = 0; r < nranks; ++r) {
+		total += loads[r];
+		max = std::max(max, loads[r]);
+	}
+	return total ? (double) max * nranks / total : 1.0;
+}
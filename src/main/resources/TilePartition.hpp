@@ -0,0 +1,59 @@
+/*
+ * Assignment of screen tiles to compositing ranks
+ *
+ * The lists (pixels) of a VDI, in column-major order, are cut into tiles of tilelen consecutive
+ * lists, the last one possibly shorter, and each tile is composited by one rank. Given the cost of
+ * each tile, e.g. the supersegments all ranks generated for it, the tiles are assigned with:
+ *
+ * PARTITION_ROWS:       tilelen-aligned equal shares, regardless of cost
+ * PARTITION_CONTIGUOUS: one contiguous run of tiles per rank, cut where the cumulative cost crosses
+ *                       multiples of total / nranks; as lists are in column order, this is a
+ *                       space-filling split into column strips of equal cost
+ * PARTITION_GREEDY:     most expensive tile first, each to the least loaded rank, so a rank's tiles
+ *                       need not be adjacent
+ *
+ * Every rank computes the same assignment from the same costs, so none needs to be sent.
+ */
+
+#ifndef TILE_PARTITION_HPP
+#define TILE_PARTITION_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+enum PartitionMethod {
+	PARTITION_ROWS       = 0,
+	PARTITION_CONTIGUOUS = 1,
+	PARTITION_GREEDY     = 2
+};
+
+class TilePartition {
+
+	size_t nlists, tilelen;
+	int nranks;
+
+	std::vector<int> owners;                  // per tile
+	std::vector<std::vector<int32_t> > tiles; // per rank, ascending
+	std::vector<size_t> lists;                // per rank
+	std::vector<int64_t> loads;               // per rank
+
+public:
+
+	TilePartition(size_t nlists, size_t tilelen, int nranks);
+
+	void balance(const int64_t *costs, int method);
+
+	size_t list_count() const { return nlists; }
+	size_t tile_count() const { return owners.size(); }
+	size_t tile_length() const { return tilelen; }
+	size_t tile_lists(size_t tile) const; // lists in a tile, tilelen except for the last
+	int owner(size_t tile) const { return owners[tile]; }
+
+	const std::vector<int32_t> &tiles_of(int r) const { return tiles[r]; }
+	size_t lists_of(int r) const { return lists[r]; }
+	int64_t load_of(int r) const { return loads[r]; }
+	double imbalance() const; // largest load over the mean, 1 is perfect
+};
+
+#endif
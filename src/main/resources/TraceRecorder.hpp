@@ -0,0 +1,351 @@
+/*
+ * Hot-path tracing into shared memory
+ *
+ * Printing inside the frame loop changes the timings it reports. Instead, the shared memory classes
+ * and the JNI bridges mark their spans with
+ *
+ * TRACE_SPAN(name):                  from here to the end of the enclosing block
+ * TRACE_SPAN_ARG(name, payload):     same, with an integer argument, e.g. bytes or a key
+ * TRACE_INSTANT(name, payload):      a single point in time
+ * TRACE_COUNTER(name, value):        a sampled value, e.g. a queue length
+ *
+ * which cost a pointer check while tracing is off. Tracing is on in a process once trace_open is
+ * called, or by itself when INSITU_TRACE is set in its environment, its value naming the process.
+ * Each process then maps a segment of its own, TRACE_DIR/insitu-trace.<pid>.<n> (INSITU_TRACE_DIR
+ * overrides TRACE_DIR), laid out as
+ *
+ *     TraceHeader | TRACE_NAMES names of TRACE_NAMELEN | TRACE_RINGS rings of TRACE_EVENTS events
+ *
+ * Every thread that records gets a ring of its own, so writing an event is a store into the ring and
+ * a release-store of its head, without locks or system calls; once full, a ring overwrites its
+ * oldest events. Times are CLOCK_MONOTONIC, common to all processes of a node, so the segments
+ * outlive their processes and insitu_trace (src/test/cpp) merges all of them into one Chrome trace /
+ * Perfetto JSON file, showing where a frame's time goes from producer to renderer. Readers copy a
+ * ring with trace_snapshot, which drops the events overwritten while it copied.
+ *
+ * Only the pages of rings in use are touched. Building with -DINSITU_NO_TRACE, or before C++11,
+ * removes the macros altogether.
+ */
+
+#ifndef TRACE_RECORDER_HPP
+#define TRACE_RECORDER_HPP
+
+#if __cplusplus >= 201103L && !defined(INSITU_NO_TRACE)
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define TRACE_MAGIC "INTRACE1"
+#define TRACE_VERSION 1
+#define TRACE_DIR "/dev/shm"
+#define TRACE_PREFIX "insitu-trace."
+#define TRACE_RINGS 64      // threads per process that can record
+#define TRACE_EVENTS 8192   // events per ring, a power of two
+#define TRACE_NAMES 512     // distinct event names per process
+#define TRACE_NAMELEN 64    // bytes per name, including the terminating zero
+
+enum TraceKind {
+	TRACE_SPAN_EVENT    = 0,
+	TRACE_INSTANT_EVENT = 1,
+	TRACE_COUNTER_EVENT = 2
+};
+
+struct TraceEvent {         // 32 bytes
+	uint64_t start;         // ns, CLOCK_MONOTONIC
+	uint64_t duration;      // ns, 0 but for spans
+	int64_t payload;
+	uint32_t name;          // index into the segment's names
+	uint32_t kind;          // TraceKind
+};
+
+struct TraceRing {          // 64 bytes and the events
+	uint64_t head;          // events ever written, stored with release semantics
+	uint32_t tid;
+	uint32_t reserved[13];
+	TraceEvent events[TRACE_EVENTS];
+};
+
+struct TraceHeader {        // 128 bytes
+	char magic[8];
+	uint32_t version;
+	int32_t pid;
+	uint32_t nrings, nevents, nnames, namelen;
+	uint32_t rings;         // rings handed out to threads
+	uint32_t names;         // names registered, stored with release semantics
+	char process[80];
+	uint64_t reserved;
+};
+
+inline size_t trace_segment_bytes()
+{
+	return sizeof(TraceHeader) + (size_t) TRACE_NAMES * TRACE_NAMELEN + (size_t) TRACE_RINGS * sizeof(TraceRing);
+}
+
+inline const char *trace_dir()
+{
+	const char *dir = getenv("INSITU_TRACE_DIR");
+	return (dir != NULL && dir[0] != '\0') ? dir : TRACE_DIR;
+}
+
+inline uint64_t trace_now()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ull + (uint64_t) t.tv_nsec;
+}
+
+inline uint32_t trace_tid()
+{
+#ifdef __linux__
+	return (uint32_t) syscall(SYS_gettid);
+#else
+	static uint32_t next = 0;
+	return __atomic_add_fetch(&next, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+// the segment of this process, one per library that includes this header
+struct TraceState {
+	std::mutex lock;
+	std::vector<std::string> names; // registered so far, also before the segment existed
+	TraceHeader *header;
+	char *namebase;
+	TraceRing *rings;       // NULL while tracing is off, set last
+	bool checked;           // whether INSITU_TRACE was looked at
+	std::string path;
+	TraceState() : header(NULL), namebase(NULL), rings(NULL), checked(false) {}
+};
+
+inline TraceState &trace_state()
+{
+	static TraceState state;
+	return state;
+}
+
+inline bool trace_active()
+{
+	return __atomic_load_n(&trace_state().rings, __ATOMIC_ACQUIRE) != NULL;
+}
+
+// with the lock held
+inline void trace_publish_name(TraceState &s, uint32_t i)
+{
+	if (s.header == NULL || i >= TRACE_NAMES)
+		return;
+	strncpy(s.namebase + (size_t) i * TRACE_NAMELEN, s.names[i].c_str(), TRACE_NAMELEN - 1);
+	if (i + 1 > s.header->names)
+		__atomic_store_n(&s.header->names, i + 1, __ATOMIC_RELEASE);
+}
+
+// start tracing into a new segment, or rename the process if it is already on
+inline bool trace_open(const char *process)
+{
+	TraceState &s = trace_state();
+	std::lock_guard<std::mutex> guard(s.lock);
+	s.checked = true;
+	if (s.header != NULL) {
+		strncpy(s.header->process, process, sizeof(s.header->process) - 1);
+		return true;
+	}
+
+	// a pid can be reused and several libraries of one process trace, so take the first free name
+	int fd = -1;
+	char path[512];
+	for (int n = 0; n < 100 && fd < 0; ++n) {
+		snprintf(path, sizeof(path), "%s/%s%d.%d", trace_dir(), TRACE_PREFIX, (int) getpid(), n);
+		fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0666);
+		if (fd < 0 && errno != EEXIST)
+			break;
+	}
+	if (fd < 0) {
+		perror("trace_open");
+		return false;
+	}
+	size_t bytes = trace_segment_bytes();
+	if (ftruncate(fd, (off_t) bytes) != 0) {
+		perror("trace_open");
+		close(fd);
+		unlink(path);
+		return false;
+	}
+	void *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		perror("trace_open");
+		unlink(path);
+		return false;
+	}
+
+	TraceHeader *h = (TraceHeader *) base;
+	memcpy(h->magic, TRACE_MAGIC, sizeof(h->magic));
+	h->version = TRACE_VERSION;
+	h->pid = (int32_t) getpid();
+	h->nrings = TRACE_RINGS;
+	h->nevents = TRACE_EVENTS;
+	h->nnames = TRACE_NAMES;
+	h->namelen = TRACE_NAMELEN;
+	strncpy(h->process, process, sizeof(h->process) - 1);
+	s.header = h;
+	s.namebase = (char *) base + sizeof(TraceHeader);
+	s.path = path;
+	for (uint32_t i = 0; i < s.names.size(); ++i)
+		trace_publish_name(s, i);
+	__atomic_store_n(&s.rings, (TraceRing *) (s.namebase + (size_t) TRACE_NAMES * TRACE_NAMELEN), __ATOMIC_RELEASE);
+	return true;
+}
+
+// the index of an event name, registered once per call site by the macros
+inline uint32_t trace_name(const char *name)
+{
+	TraceState &s = trace_state();
+	bool check;
+	{
+		std::lock_guard<std::mutex> guard(s.lock);
+		check = !s.checked;
+		s.checked = true;
+	}
+	const char *process = check ? getenv("INSITU_TRACE") : NULL;
+	if (process != NULL && process[0] != '\0')
+		trace_open(process);
+
+	std::lock_guard<std::mutex> guard(s.lock);
+	for (uint32_t i = 0; i < s.names.size(); ++i)
+		if (s.names[i] == name)
+			return i;
+	s.names.push_back(name);
+	trace_publish_name(s, (uint32_t) s.names.size() - 1);
+	return (uint32_t) s.names.size() - 1;
+}
+
+// this thread's ring, NULL if tracing is off or all rings are taken
+inline TraceRing *trace_ring()
+{
+	static thread_local TraceRing *ring = NULL;
+	static thread_local bool claimed = false;
+	if (ring != NULL || claimed)
+		return ring;
+
+	TraceState &s = trace_state();
+	TraceRing *rings = __atomic_load_n(&s.rings, __ATOMIC_ACQUIRE);
+	if (rings == NULL)
+		return NULL;
+	claimed = true;
+	uint32_t i = __atomic_fetch_add(&s.header->rings, 1, __ATOMIC_RELAXED);
+	if (i < TRACE_RINGS) {
+		ring = rings + i;
+		ring->tid = trace_tid();
+	}
+	return ring;
+}
+
+inline void trace_event(uint32_t name, uint32_t kind, uint64_t start, uint64_t duration, int64_t payload)
+{
+	TraceRing *r = trace_ring();
+	if (r == NULL)
+		return;
+	uint64_t head = r->head; // only this thread writes the ring
+	TraceEvent &e = r->events[head & (TRACE_EVENTS - 1)];
+	e.start = start;
+	e.duration = duration;
+	e.payload = payload;
+	e.name = name;
+	e.kind = kind;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+class TraceSpan {
+
+	uint32_t name;
+	int64_t payload;
+	uint64_t start;         // 0 while tracing is off
+
+public:
+
+	explicit TraceSpan(uint32_t name, int64_t payload = 0) : name(name), payload(payload), start(trace_active() ? trace_now() : 0) {}
+	~TraceSpan()
+	{
+		if (start != 0)
+			trace_event(name, TRACE_SPAN_EVENT, start, trace_now() - start, payload);
+	}
+
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+// NULL unless base holds a trace segment that fits into bytes
+inline const TraceHeader *trace_segment(const void *base, size_t bytes)
+{
+	const TraceHeader *h = (const TraceHeader *) base;
+	if (base == NULL || bytes < sizeof(TraceHeader) || memcmp(h->magic, TRACE_MAGIC, sizeof(h->magic)) != 0 || h->version != TRACE_VERSION)
+		return NULL;
+	if (h->nevents == 0 || (h->nevents & (h->nevents - 1)) != 0 || h->namelen == 0
+			|| sizeof(TraceHeader) + (size_t) h->nnames * h->namelen + (size_t) h->nrings * (64 + (size_t) h->nevents * sizeof(TraceEvent)) > bytes)
+		return NULL;
+	return h;
+}
+
+inline const char *trace_segment_name(const TraceHeader *h, uint32_t i)
+{
+	return (i < h->nnames && i < __atomic_load_n(&h->names, __ATOMIC_ACQUIRE)) ? (const char *) (h + 1) + (size_t) i * h->namelen : "?";
+}
+
+inline const TraceRing *trace_segment_ring(const TraceHeader *h, uint32_t i)
+{
+	return (const TraceRing *) ((const char *) (h + 1) + (size_t) h->nnames * h->namelen + (size_t) i * (64 + (size_t) h->nevents * sizeof(TraceEvent)));
+}
+
+// append the events of a ring of nevents to out, oldest first; returns how many were lost to overwriting
+inline uint64_t trace_snapshot(const TraceRing *ring, uint32_t nevents, std::vector<TraceEvent> &out)
+{
+	uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint64_t first = (head > nevents) ? head - nevents : 0;
+	size_t at = out.size();
+	for (uint64_t i = first; i < head; ++i)
+		out.push_back(ring->events[i & (nevents - 1)]);
+
+	// the writer may have reused slots meanwhile, up to and including the one after its new head
+	uint64_t now = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint64_t valid = (now + 1 > nevents) ? now + 1 - nevents : 0;
+	if (valid > first) {
+		size_t drop = (size_t) ((valid < head ? valid : head) - first);
+		out.erase(out.begin() + at, out.begin() + at + drop);
+		first += drop;
+	}
+	return first;
+}
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_ID(name) static const uint32_t TRACE_CONCAT(trace_name_, __LINE__) = trace_name(name)
+
+#define TRACE_SPAN_ARG(name, payload) TRACE_ID(name); \
+	TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(TRACE_CONCAT(trace_name_, __LINE__), trace_active() ? (int64_t) (payload) : 0)
+#define TRACE_SPAN(name) TRACE_SPAN_ARG(name, 0)
+#define TRACE_INSTANT(name, payload) do { TRACE_ID(name); \
+	if (trace_active()) trace_event(TRACE_CONCAT(trace_name_, __LINE__), TRACE_INSTANT_EVENT, trace_now(), 0, (int64_t) (payload)); } while (0)
+#define TRACE_COUNTER(name, value) do { TRACE_ID(name); \
+	if (trace_active()) trace_event(TRACE_CONCAT(trace_name_, __LINE__), TRACE_COUNTER_EVENT, trace_now(), 0, (int64_t) (value)); } while (0)
+
+#else
+
+#define TRACE_SPAN_ARG(name, payload)
+#define TRACE_SPAN(name)
+#define TRACE_INSTANT(name, payload) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+
+#endif
+
+#endif
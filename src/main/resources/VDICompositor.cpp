@@ -0,0 +1,328 @@
+/*
+ * CPU compositing of VDIs
+ *
+ *
+ *
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "VDICompositor.hpp"
+#include "ParallelChunks.hpp"
+
+#define MINLISTS 256 // lists per thread, each takes a few thousand operations
+#define INFDEPTH 100000.0f
+
+namespace {
+
+// a colour, blended as in the shader
+struct RGBA {
+#ifdef __SSE__
+	__m128 v;
+#else
+	float v[4];
+#endif
+};
+
+inline RGBA rgba(const float *c)
+{
+	RGBA r;
+#ifdef __SSE__
+	r.v = _mm_loadu_ps(c);
+#else
+	memcpy(r.v, c, sizeof(r.v));
+#endif
+	return r;
+}
+
+inline RGBA zero()
+{
+	RGBA r;
+#ifdef __SSE__
+	r.v = _mm_setzero_ps();
+#else
+	memset(r.v, 0, sizeof(r.v));
+#endif
+	return r;
+}
+
+inline void store(const RGBA &c, float *out)
+{
+#ifdef __SSE__
+	_mm_storeu_ps(out, c.v);
+#else
+	memcpy(out, c.v, sizeof(c.v));
+#endif
+}
+
+inline float alpha(const RGBA &c)
+{
+#ifdef __SSE__
+	return _mm_cvtss_f32(_mm_shuffle_ps(c.v, c.v, _MM_SHUFFLE(3, 3, 3, 3)));
+#else
+	return c.v[3];
+#endif
+}
+
+// rgb * s and a
+inline RGBA scale_rgb(const RGBA &c, float s, float a)
+{
+	RGBA r;
+#ifdef __SSE__
+	r.v = _mm_mul_ps(c.v, _mm_set_ps(0, s, s, s));
+	r.v = _mm_add_ps(r.v, _mm_set_ps(a, 0, 0, 0));
+#else
+	for (int i = 0; i < 3; ++i)
+		r.v[i] = c.v[i] * s;
+	r.v[3] = a;
+#endif
+	return r;
+}
+
+// front to back: acc.rgb + (1 - acc.a) * c.rgb * a, acc.a + (1 - acc.a) * a
+inline RGBA blend(const RGBA &acc, const RGBA &c, float a)
+{
+	float t = (1.0f - alpha(acc)) * a;
+	RGBA r;
+#ifdef __SSE__
+	__m128 src = _mm_move_ss(_mm_shuffle_ps(c.v, c.v, _MM_SHUFFLE(2, 1, 0, 0)), _mm_set_ss(1.0f)); // 1, r, g, b
+	src = _mm_shuffle_ps(src, src, _MM_SHUFFLE(0, 3, 2, 1));                                       // r, g, b, 1
+	r.v = _mm_add_ps(acc.v, _mm_mul_ps(src, _mm_set1_ps(t)));
+#else
+	for (int i = 0; i < 3; ++i)
+		r.v[i] = acc.v[i] + c.v[i] * t;
+	r.v[3] = acc.v[3] + t;
+#endif
+	return r;
+}
+
+// distance between the premultiplied colours
+inline float diff_premultiplied(const RGBA &a, const RGBA &b)
+{
+#ifdef __SSE__
+	__m128 d = _mm_sub_ps(_mm_mul_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 3, 3, 3))),
+	                      _mm_mul_ps(b.v, _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 3, 3, 3))));
+	d = _mm_mul_ps(d, d);
+	float s[4];
+	_mm_storeu_ps(s, d);
+	return std::sqrt(s[0] + s[1] + s[2]);
+#else
+	float s = 0;
+	for (int i = 0; i < 3; ++i) {
+		float d = a.v[i] * a.v[3] - b.v[i] * b.v[3];
+		s += d * d;
+	}
+	return std::sqrt(s);
+#endif
+}
+
+inline float adjust_opacity(float a, float steplength)
+{
+	return 1.0f - std::pow(1.0f - a, steplength);
+}
+
+// world space positions along the ray of one pixel, invViewProjection * (ndc_x, ndc_y, depth, 1)
+struct Ray {
+	float base[4], dir[4];
+
+	Ray(const float *m, float x, float y)
+	{
+		for (int i = 0; i < 4; ++i) {
+			base[i] = m[i] * x + m[4 + i] * y + m[12 + i];
+			dir[i] = m[8 + i];
+		}
+	}
+
+	float distance(float d0, float d1) const
+	{
+		float w0 = 1.0f / (base[3] + d0 * dir[3]), w1 = 1.0f / (base[3] + d1 * dir[3]), s = 0;
+		for (int i = 0; i < 3; ++i) {
+			float d = (base[i] + d1 * dir[i]) * w1 - (base[i] + d0 * dir[i]) * w0;
+			s += d * d;
+		}
+		return std::sqrt(s);
+	}
+};
+
+struct Sample {
+	float start, end;
+	RGBA color;
+	float alpha;      // opacity over the length of the sample
+	bool transparent; // a gap between input supersegments
+};
+
+// merge the supersegments of all sources front to back, the last sample marks the end of the list
+void merge(const float *const *colors, const float *const *depths, const int *counts, int nsources, const Ray &ray, std::vector<Sample> &samples)
+{
+	int front[MAXSOURCES] = {0};
+	samples.clear();
+
+	while (true) {
+		float low = INFDEPTH;
+		int src = -1;
+		for (int j = 0; j < nsources; ++j) {
+			if (front[j] >= counts[j])
+				continue;
+			float d = depths[j][2 * front[j]];
+			if (d < low && d != 0) {
+				low = d;
+				src = j;
+			}
+		}
+
+		Sample s;
+		s.transparent = false;
+		if (src < 0) {
+			s.start = s.end = s.alpha = 0;
+			s.color = zero();
+			samples.push_back(s);
+			return;
+		}
+
+		s.start = low;
+		s.end = depths[src][2 * front[src] + 1];
+		s.color = rgba(colors[src] + 4 * front[src]);
+		s.alpha = adjust_opacity(alpha(s.color), ray.distance(s.start, s.end));
+		if (s.alpha < 0.000001f)
+			s.alpha = 0.000001f;
+		++front[src];
+
+		if (!samples.empty() && s.start > samples.back().end) {
+			Sample gap;
+			gap.start = samples.back().end;
+			gap.end = s.start;
+			gap.color = zero();
+			gap.alpha = 0;
+			gap.transparent = true;
+			samples.push_back(gap);
+		}
+		samples.push_back(s);
+	}
+}
+
+// run over the samples with a termination threshold, writing the supersegments if color is given; returns the number of terminations
+int supersegments(const std::vector<Sample> &samples, const Ray &ray, float thresh, int outsupsegs, float *color, float *depth)
+{
+	bool open = false;
+	float segstart = 0, segend = 0, segend_opaque = 0; // the last excluding trailing gaps
+	RGBA acc = zero();
+	int terminations = 0, written = 0;
+
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const Sample &s = samples[i];
+		bool complete = (i == samples.size() - 1);
+
+		if (open) {
+			float a = alpha(acc);
+			RGBA adjusted = scale_rgb(acc, 1.0f / a, adjust_opacity(a, 1.0f / ray.distance(segstart, segend)));
+
+			if (diff_premultiplied(adjusted, s.color) >= thresh || complete) {
+				++terminations;
+				open = false;
+				if (color != NULL && written < outsupsegs) {
+					adjusted = scale_rgb(acc, 1.0f / a, adjust_opacity(a, 1.0f / ray.distance(segstart, segend_opaque)));
+					store(adjusted, color + 4 * written);
+					depth[2 * written] = segstart;
+					depth[2 * written + 1] = segend_opaque;
+					++written;
+				}
+			} else {
+				acc = blend(acc, s.color, s.alpha);
+				segend = s.end;
+				if (!s.transparent)
+					segend_opaque = s.end;
+			}
+		}
+
+		if (!open && !s.transparent && !complete) {
+			segstart = s.start;
+			segend = segend_opaque = s.end;
+			acc = scale_rgb(s.color, s.alpha, s.alpha);
+			open = true;
+		}
+	}
+
+	if (color != NULL) {
+		memset(color + 4 * written, 0, 4 * (outsupsegs - written) * sizeof(float));
+		memset(depth + 2 * written, 0, 2 * (outsupsegs - written) * sizeof(float));
+	}
+	return terminations;
+}
+
+// bisect the threshold until the number of supersegments is within SUPSEG_DELTA below outsupsegs, then write them
+void composite_list(const std::vector<Sample> &samples, const Ray &ray, int outsupsegs, float *color, float *depth)
+{
+	float low = 0, high = MAX_THRESH, mid = (low + high) / 2;
+
+	while (true) {
+		int n = supersegments(samples, ray, mid, outsupsegs, NULL, NULL);
+		if (std::fabs(high - low) < 0.000001f) {
+			mid = (n == 0) ? low : high; // err on fewer supersegments, unless there would be none
+			break;
+		} else if (n > outsupsegs) {
+			low = mid;
+		} else if (n < outsupsegs - SUPSEG_DELTA) {
+			high = mid;
+		} else {
+			break;
+		}
+		mid = (low + high) / 2;
+	}
+
+	supersegments(samples, ray, mid, outsupsegs, color, depth);
+}
+
+}
+
+void composite_vdis(const SubVDIs &in, const CompositeView &view, int outsupsegs, float *color, float *depth, int nthreads)
+{
+	int nsources = in.nsources < MAXSOURCES ? in.nsources : MAXSOURCES;
+
+	// where each source's block starts
+	std::vector<size_t> blocks(nsources, 0);
+	for (int j = 1; j < nsources; ++j)
+		blocks[j] = blocks[j-1] + ((in.prefix || in.prefixes) ? (size_t) in.supsegs[j-1] : in.lists * in.insupsegs);
+
+	parallel_chunks(in.lists, nthreads, [&](size_t begin, size_t end, int) {
+		std::vector<Sample> samples;
+		const float *colors[MAXSOURCES], *depths[MAXSOURCES];
+		int counts[MAXSOURCES];
+
+		for (size_t l = begin; l < end; ++l) {
+			for (int j = 0; j < nsources; ++j) {
+				size_t first;
+				if (in.prefixes) {
+					const int32_t *p = in.prefixes[j];
+					first = p[l] - p[0];
+					counts[j] = (int) ((l + 1 < in.lists) ? p[l+1] - p[l] : in.supsegs[j] - (p[l] - p[0]));
+					colors[j] = in.colors[j] + 4 * first;
+					depths[j] = in.depths[j] + 2 * first;
+					continue;
+				}
+				if (in.prefix) {
+					const int32_t *p = in.prefix + j * in.lists;
+					first = blocks[j] + (p[l] - p[0]);
+					counts[j] = (int) ((l + 1 < in.lists) ? p[l+1] - p[l] : in.supsegs[j] - (p[l] - p[0]));
+				} else {
+					first = blocks[j] + l * in.insupsegs;
+					counts[j] = in.insupsegs;
+				}
+				colors[j] = in.color + 4 * first;
+				depths[j] = in.depth + 2 * first;
+			}
+
+			size_t global = view.tiles ? view.tiles[l / view.tilelen] * view.tilelen + l % view.tilelen : view.first_list + l;
+			float x = (float) (global / view.height), y = (float) (global % view.height);
+			Ray ray(view.invViewProjection, x / view.width * 2.0f - 1.0f, y / view.height * 2.0f - 1.0f);
+
+			merge(colors, depths, counts, nsources, ray, samples);
+			composite_list(samples, ray, outsupsegs, color + 4 * l * outsupsegs, depth + 2 * l * outsupsegs);
+		}
+	}, MINLISTS);
+}
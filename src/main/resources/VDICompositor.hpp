@@ -0,0 +1,60 @@
+/*
+ * CPU compositing of VDIs
+ *
+ * The same merge as VDICompositor.comp, for nodes without a GPU and as a reference in tests. Each
+ * rank composites the lists (pixels) it owns from the sub-VDIs all ranks sent it, i.e. from what
+ * distributeVDIs or distributeDenseVDIs received: one block per source rank, each block holding
+ * the supersegments of this rank's lists, list after list. Lists are numbered column major
+ * (x * height + y), and a rank owns either a contiguous range of them or, with a tile partition
+ * (see TilePartition.hpp), the lists of the tiles it was assigned, tile after tile.
+ *
+ * composite_vdis(in, view, outsupsegs, color, depth): write outsupsegs supersegments per list,
+ *     RGBA colours and start/end depths, unused ones zero
+ *
+ * Per list, the supersegments of all sources are merged front to back once, with transparent
+ * gaps inserted between them, and the threshold search of the shader then runs over the merged
+ * samples. Colours are blended four channels at a time with SSE where available; lists are split
+ * between nthreads threads.
+ */
+
+#ifndef VDI_COMPOSITOR_HPP
+#define VDI_COMPOSITOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#define MAXSOURCES 50      // as in the shader
+#define SUPSEG_DELTA 3     // up to this many supersegments fewer than asked for are acceptable
+#define MAX_THRESH 1.732f  // upper bound of the termination threshold, sqrt(3)
+
+struct SubVDIs {
+	const float *color;     // RGBA per supersegment
+	const float *depth;     // start and end NDC depth per supersegment, 0 marks an empty one
+	int nsources;
+	size_t lists;           // owned by this rank, per source
+
+	// dense VDIs, as received by distributeDenseVDIs: prefix holds lists prefix sums per source,
+	// offset by the source's sum over the lists before ours, supsegs the supersegments from each source
+	const int32_t *prefix;
+	const int *supsegs;
+
+	int insupsegs;          // VDIs with a fixed number of supersegments per list (prefix NULL)
+
+	// dense VDIs not back to back, e.g. in shared memory: where each source's colours, depths and
+	// prefix sums for our lists start, used instead of color, depth and prefix unless NULL
+	const float *const *colors;
+	const float *const *depths;
+	const int32_t *const *prefixes;
+};
+
+struct CompositeView {
+	int width, height;           // of the whole image
+	size_t first_list;           // global index of this rank's first list, without tiles
+	const int32_t *tiles;        // the tiles received, ascending, as in DenseVDIs; NULL for a contiguous range
+	size_t tilelen;
+	float invViewProjection[16]; // column major, as the VDI was generated with
+};
+
+void composite_vdis(const SubVDIs &in, const CompositeView &view, int outsupsegs, float *color, float *depth, int nthreads = 1);
+
+#endif
@@ -0,0 +1,345 @@
+/*
+ * Chunked, indexed container file for VDI time series
+ *
+ *
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "VDIContainer.hpp"
+#include "ParallelChunks.hpp"
+
+#define COLOR_FLOATS 4
+#define DEPTH_FLOATS 2
+#define SUPSEG_BYTES ((COLOR_FLOATS + DEPTH_FLOATS) * sizeof(float))
+
+namespace {
+
+inline size_t aligned(size_t bytes, size_t to)
+{
+	return (bytes + to - 1) / to * to;
+}
+
+// where the counts, colours and depths of a raw tile chunk of n lists start
+struct TileLayout {
+	const int32_t *counts;
+	const float *color, *depth;
+
+	TileLayout(const char *chunk, size_t n, size_t supsegs)
+	{
+		counts = (const int32_t *) chunk;
+		color = (const float *) (chunk + aligned(n * sizeof(int32_t), 16));
+		depth = color + COLOR_FLOATS * supsegs;
+	}
+};
+
+}
+
+VDIContainerWriter::VDIContainerWriter(const char *path, int width, int height, size_t tilelen, int codec, int level, int nthreads)
+	: level(level), nthreads(nthreads), end(CONTAINER_PAGE)
+{
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CONTAINER_MAGIC, sizeof(header.magic));
+	header.version = CONTAINER_VERSION;
+	header.width = (uint32_t) width;
+	header.height = (uint32_t) height;
+	header.tilelen = (uint32_t) (tilelen ? tilelen : lists());
+	header.ntiles = (uint32_t) ((lists() + header.tilelen - 1) / header.tilelen);
+	if (!codec_available(codec)) {
+		fprintf(stderr, "VDIContainerWriter: %s not built in, storing tiles raw\n", codec_name(codec));
+		codec = CODEC_NONE;
+	}
+	header.codec = (uint32_t) codec;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		perror(path);
+	else if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header))
+		perror("pwrite");
+}
+
+VDIContainerWriter::~VDIContainerWriter()
+{
+	if (fd >= 0)
+		close();
+}
+
+bool VDIContainerWriter::put(const void *data, size_t bytes)
+{
+	const char *p = (const char *) data;
+	for (size_t done = 0; done < bytes; ) {
+		ssize_t n = pwrite(fd, p + done, bytes - done, (off_t) (end + done));
+		if (n < 0) {
+			perror("pwrite");
+			return false;
+		}
+		done += n;
+	}
+	end = aligned(end + bytes, CHUNK_ALIGN);
+	return true;
+}
+
+// list(l, count, color, depth) gives the supersegments of list l
+template <typename F>
+bool VDIContainerWriter::append(F list, const void *meta, size_t metabytes)
+{
+	if (fd < 0)
+		return false;
+
+	FrameEntry frame = {end, metabytes, 0};
+	if (metabytes > 0 && !put(meta, metabytes))
+		return false;
+
+	size_t ntiles = header.ntiles, tilelen = header.tilelen, first = tiles.size();
+	tiles.resize(first + ntiles);
+	chunks.resize(ntiles);
+	parallel_chunks(ntiles, nthreads, [&](size_t begin, size_t stop, int) {
+		std::vector<char> raw;
+		for (size_t t = begin; t < stop; ++t) {
+			size_t from = t * tilelen, n = (from + tilelen < lists()) ? tilelen : lists() - from, supsegs = 0;
+			for (size_t l = from; l < from + n; ++l) {
+				int count;
+				const float *c, *d;
+				list(l, count, c, d);
+				supsegs += count;
+			}
+			raw.resize(aligned(n * sizeof(int32_t), 16) + supsegs * SUPSEG_BYTES);
+			TileLayout out(raw.data(), n, supsegs);
+			int32_t *counts = (int32_t *) out.counts;
+			float *color = (float *) out.color, *depth = (float *) out.depth;
+			for (size_t l = from; l < from + n; ++l) {
+				int count;
+				const float *c, *d;
+				list(l, count, c, d);
+				counts[l - from] = count;
+				memcpy(color, c, count * COLOR_FLOATS * sizeof(float));
+				memcpy(depth, d, count * DEPTH_FLOATS * sizeof(float));
+				color += count * COLOR_FLOATS;
+				depth += count * DEPTH_FLOATS;
+			}
+
+			TileEntry &e = tiles[first + t];
+			e.raw = (uint32_t) raw.size();
+			e.supsegs = (uint32_t) supsegs;
+			e.flags = 0;
+			size_t packed = 0;
+			if (header.codec != CODEC_NONE) {
+				chunks[t].resize(chunk_bound(header.codec, raw.size()));
+				packed = compress_chunk(header.codec, level, raw.data(), raw.size(), chunks[t].data(), chunks[t].size());
+			}
+			if (packed > 0) {
+				chunks[t].resize(packed);
+				e.flags = TILE_COMPRESSED;
+			} else {
+				chunks[t].swap(raw);
+			}
+			e.stored = (uint32_t) chunks[t].size();
+		}
+	}, 1);
+
+	for (size_t t = 0; t < ntiles; ++t) {
+		tiles[first + t].offset = end;
+		frame.supsegs += tiles[first + t].supsegs;
+		if (!put(chunks[t].data(), chunks[t].size()))
+			return false;
+	}
+	frames.push_back(frame);
+	return true;
+}
+
+bool VDIContainerWriter::append_dense(const float *color, const float *depth, const int32_t *prefix, size_t supsegs, const void *meta, size_t metabytes)
+{
+	size_t n = lists();
+	return append([&](size_t l, int &count, const float *&c, const float *&d) {
+		size_t first = prefix[l] - prefix[0];
+		count = (int) (((l + 1 < n) ? (size_t) (prefix[l+1] - prefix[0]) : supsegs) - first);
+		c = color + COLOR_FLOATS * first;
+		d = depth + DEPTH_FLOATS * first;
+	}, meta, metabytes);
+}
+
+bool VDIContainerWriter::append_fixed(const float *color, const float *depth, int maxsupsegs, const void *meta, size_t metabytes)
+{
+	return append([&](size_t l, int &count, const float *&c, const float *&d) {
+		c = color + l * maxsupsegs * COLOR_FLOATS;
+		d = depth + l * maxsupsegs * DEPTH_FLOATS;
+		count = 0;
+		while (count < maxsupsegs && d[count * DEPTH_FLOATS] != 0)
+			++count;
+	}, meta, metabytes);
+}
+
+bool VDIContainerWriter::close()
+{
+	if (fd < 0)
+		return false;
+	header.frames = frames.size();
+	header.index = end;
+	bool ok = put(frames.data(), frames.size() * sizeof(FrameEntry)) && put(tiles.data(), tiles.size() * sizeof(TileEntry));
+	if (ok && pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+		perror("pwrite");
+		ok = false;
+	}
+	::close(fd);
+	fd = -1;
+	return ok;
+}
+
+VDIContainerReader::VDIContainerReader() : base(NULL), bytes(0), header(NULL), frameindex(NULL), tileindex(NULL)
+{
+}
+
+VDIContainerReader::~VDIContainerReader()
+{
+	close();
+}
+
+bool VDIContainerReader::open(const char *path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(ContainerHeader)) {
+		fprintf(stderr, "%s: not a VDI container\n", path);
+		::close(fd);
+		return false;
+	}
+	void *ptr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (ptr == MAP_FAILED) {
+		perror("mmap");
+		return false;
+	}
+	base = (const char *) ptr;
+	bytes = (size_t) st.st_size;
+
+	const ContainerHeader *h = (const ContainerHeader *) base;
+	if (memcmp(h->magic, CONTAINER_MAGIC, sizeof(h->magic)) != 0 || h->version != CONTAINER_VERSION) {
+		fprintf(stderr, "%s: not a VDI container of version %d\n", path, CONTAINER_VERSION);
+		close();
+		return false;
+	}
+	size_t tiles = aligned(h->index + h->frames * sizeof(FrameEntry), CHUNK_ALIGN);
+	if (h->index == 0 || tiles + h->frames * h->ntiles * sizeof(TileEntry) > bytes) {
+		fprintf(stderr, "%s: incomplete, it was not closed\n", path);
+		close();
+		return false;
+	}
+	header = h;
+	frameindex = (const FrameEntry *) (base + h->index);
+	tileindex = (const TileEntry *) (base + tiles);
+	if (!valid()) {
+		fprintf(stderr, "%s: corrupt index\n", path);
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool VDIContainerReader::valid() const
+{
+	size_t tilelen = header->tilelen;
+	if (tilelen == 0 || header->ntiles != (lists() + tilelen - 1) / tilelen)
+		return false;
+	for (size_t f = 0; f < header->frames; ++f) {
+		const FrameEntry &fe = frameindex[f];
+		if (fe.metaoffset > bytes || fe.metabytes > bytes - fe.metaoffset)
+			return false;
+		for (size_t t = 0; t < header->ntiles; ++t) {
+			// read_lists trusts the entries, so every chunk has to lie in the file and decode to its layout
+			const TileEntry &e = entry(f, t);
+			size_t from = t * tilelen, n = (from + tilelen < lists()) ? tilelen : lists() - from;
+			if (e.offset > bytes || e.stored > bytes - e.offset
+				|| e.raw != aligned(n * sizeof(int32_t), 16) + (size_t) e.supsegs * SUPSEG_BYTES
+				|| (!(e.flags & TILE_COMPRESSED) && e.stored != e.raw))
+				return false;
+		}
+	}
+	return true;
+}
+
+void VDIContainerReader::close()
+{
+	if (base != NULL)
+		munmap((void *) base, bytes);
+	base = NULL;
+	header = NULL;
+	bytes = 0;
+}
+
+const void *VDIContainerReader::metadata(size_t frame, size_t *metabytes) const
+{
+	*metabytes = frameindex[frame].metabytes;
+	return *metabytes ? base + frameindex[frame].metaoffset : NULL;
+}
+
+size_t VDIContainerReader::stored_bytes(size_t frame) const
+{
+	size_t total = 0;
+	for (size_t t = 0; t < header->ntiles; ++t)
+		total += entry(frame, t).stored;
+	return total;
+}
+
+size_t VDIContainerReader::range_bound(size_t frame, size_t first, size_t n) const
+{
+	if (header == NULL || frame >= header->frames || n == 0 || first + n > lists())
+		return 0;
+	size_t total = 0;
+	for (size_t t = first / header->tilelen; t <= (first + n - 1) / header->tilelen; ++t)
+		total += entry(frame, t).supsegs;
+	return total;
+}
+
+size_t VDIContainerReader::read_tile(size_t frame, size_t tile, int32_t *counts, float *color, float *depth) const
+{
+	size_t first = tile * header->tilelen;
+	return read_lists(frame, first, (first + header->tilelen < lists()) ? header->tilelen : lists() - first, counts, color, depth);
+}
+
+size_t VDIContainerReader::read_lists(size_t frame, size_t first, size_t n, int32_t *counts, float *color, float *depth) const
+{
+	if (header == NULL || frame >= header->frames || n == 0 || first + n > lists())
+		return 0;
+
+	size_t tilelen = header->tilelen, total = 0;
+	std::vector<char> decoded;
+	for (size_t t = first / tilelen; t <= (first + n - 1) / tilelen; ++t) {
+		const TileEntry &e = entry(frame, t);
+		const char *chunk = base + e.offset;
+		if (e.flags & TILE_COMPRESSED) {
+			decoded.resize(e.raw);
+			if (!decompress_chunk(header->codec, chunk, e.stored, decoded.data(), e.raw)) {
+				fprintf(stderr, "VDIContainerReader: tile %zu of frame %zu is corrupt\n", t, frame);
+				return 0;
+			}
+			chunk = decoded.data();
+		}
+
+		size_t from = t * tilelen, tilelists = (from + tilelen < lists()) ? tilelen : lists() - from;
+		size_t a = (first > from) ? first - from : 0, b = (first + n < from + tilelists) ? first + n - from : tilelists;
+		TileLayout tl(chunk, tilelists, e.supsegs);
+		size_t skip = 0, take = 0;
+		for (size_t l = 0; l < a; ++l)
+			skip += tl.counts[l];
+		for (size_t l = a; l < b; ++l)
+			take += tl.counts[l];
+
+		memcpy(counts + (from + a - first), tl.counts + a, (b - a) * sizeof(int32_t));
+		memcpy(color + COLOR_FLOATS * total, tl.color + COLOR_FLOATS * skip, take * COLOR_FLOATS * sizeof(float));
+		memcpy(depth + DEPTH_FLOATS * total, tl.depth + DEPTH_FLOATS * skip, take * DEPTH_FLOATS * sizeof(float));
+		total += take;
+	}
+	return total;
+}
@@ -0,0 +1,135 @@
+/*
+ * Chunked, indexed container file for VDI time series
+ *
+ * VDI dumps used to be flat files per buffer (colours, depths, prefix sums), which have to be read
+ * whole even to look at a few pixels. A container holds any number of frames of one resolution,
+ * each cut into tiles of tilelen consecutive lists (pixels, column major as everywhere else), and
+ * stores every tile as a chunk of its own:
+ *
+ *     header, CONTAINER_PAGE bytes | per frame: metadata, tile chunks | index | (end)
+ *
+ * A tile chunk holds the supersegment count of each of its lists, padded to 16 bytes, then their
+ * RGBA colours and start/end depths, as a dense VDI (see VDIExchange.hpp). With a codec, each chunk
+ * is compressed on its own (ChunkCodec.hpp), and kept raw if that does not make it smaller. Chunks
+ * start at multiples of CHUNK_ALIGN, and the index lists for every frame its metadata and
+ * supersegment total, and for every tile where its chunk is, its stored and raw size and its
+ * supersegment count. The index is written last and the header points to it, so a container that
+ * was not closed is recognized as incomplete.
+ *
+ * VDIContainerWriter appends frames, from dense VDIs (prefix sums over all lists) or from fixed
+ * ones (maxsupsegs per list, up to the first empty supersegment), with an opaque metadata blob
+ * each, e.g. what VDIDataIO writes. Tiles are encoded with nthreads threads.
+ *
+ * VDIContainerReader maps the file and reads only the tiles asked for: raw chunks are copied
+ * straight out of the mapping, so only their pages are read from disk, compressed ones are
+ * decompressed as a whole. read_lists takes any range of lists and returns it dense.
+ *
+ * Failures are printed and reported by a false or 0 result.
+ */
+
+#ifndef VDI_CONTAINER_HPP
+#define VDI_CONTAINER_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "ChunkCodec.hpp"
+
+#define CONTAINER_MAGIC "VDICONT1"
+#define CONTAINER_VERSION 1
+#define CONTAINER_PAGE 4096 // the header takes a page, so the first chunk starts page aligned
+#define CHUNK_ALIGN 64
+#define TILE_COMPRESSED 1   // flag of a tile entry
+
+struct ContainerHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t width, height;
+	uint32_t tilelen;
+	uint32_t ntiles;        // per frame
+	uint32_t codec;
+	uint64_t frames;
+	uint64_t index;         // offset of the index, 0 while writing
+};
+
+struct FrameEntry {
+	uint64_t metaoffset, metabytes;
+	uint64_t supsegs;
+};
+
+struct TileEntry {
+	uint64_t offset;
+	uint32_t stored, raw;   // bytes in the file and decompressed
+	uint32_t supsegs;
+	uint32_t flags;
+};
+
+class VDIContainerWriter {
+
+	int fd;
+	ContainerHeader header;
+	int level, nthreads;
+	uint64_t end;           // where the next chunk goes
+	std::vector<FrameEntry> frames;
+	std::vector<TileEntry> tiles;
+	std::vector<std::vector<char> > chunks; // a frame's tiles, encoded
+
+	size_t lists() const { return (size_t) header.width * header.height; }
+	bool put(const void *data, size_t bytes);
+	template <typename F> bool append(F list, const void *meta, size_t metabytes);
+
+public:
+
+	VDIContainerWriter(const char *path, int width, int height, size_t tilelen, int codec = CODEC_NONE, int level = 0, int nthreads = 1);
+	~VDIContainerWriter();
+
+	bool ok() const { return fd >= 0; }
+
+	// prefix over all lists as in VDIExchange, supsegs in total
+	bool append_dense(const float *color, const float *depth, const int32_t *prefix, size_t supsegs, const void *meta = NULL, size_t metabytes = 0);
+	// maxsupsegs per list, a list's supersegments those before its first empty one
+	bool append_fixed(const float *color, const float *depth, int maxsupsegs, const void *meta = NULL, size_t metabytes = 0);
+
+	bool close(); // write the index and point the header to it; called by the destructor if need be
+};
+
+class VDIContainerReader {
+
+	const char *base;
+	size_t bytes;
+	const ContainerHeader *header;
+	const FrameEntry *frameindex;
+	const TileEntry *tileindex;
+
+	const TileEntry &entry(size_t frame, size_t tile) const { return tileindex[frame * header->ntiles + tile]; }
+	bool valid() const; // whether the index fits the header and the file
+
+public:
+
+	VDIContainerReader();
+	~VDIContainerReader();
+
+	bool open(const char *path);
+	void close();
+
+	int width() const { return (int) header->width; }
+	int height() const { return (int) header->height; }
+	size_t lists() const { return (size_t) header->width * header->height; }
+	size_t tilelen() const { return header->tilelen; }
+	size_t ntiles() const { return header->ntiles; }
+	size_t frames() const { return header ? (size_t) header->frames : 0; }
+	int codec() const { return (int) header->codec; }
+
+	const void *metadata(size_t frame, size_t *metabytes) const;
+	size_t frame_supersegments(size_t frame) const { return frameindex[frame].supsegs; }
+	size_t tile_supersegments(size_t frame, size_t tile) const { return entry(frame, tile).supsegs; }
+	size_t stored_bytes(size_t frame) const; // of the frame's tiles in the file
+	size_t range_bound(size_t frame, size_t first, size_t n) const; // supersegments of the tiles holding these lists
+
+	// the supersegments of the lists first to first + n, dense: counts per list, then colours and depths; returns how many
+	size_t read_lists(size_t frame, size_t first, size_t n, int32_t *counts, float *color, float *depth) const;
+	size_t read_tile(size_t frame, size_t tile, int32_t *counts, float *color, float *depth) const;
+};
+
+#endif
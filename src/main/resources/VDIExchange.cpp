@@ -0,0 +1,566 @@
+/*
+ * All-to-all exchange of dense VDIs between rendering ranks
+ *
+ *
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include "VDIExchange.hpp"
+#include "PrefixScan.hpp"
+
+#define COLORBUF  0
+#define DEPTHBUF  1
+#define PREFIXBUF 2
+#define RANGEBUF  3
+
+#define TAG_BASE 0x5d1 // plus stream, plus 2 per slot, so exchanges in flight at once do not mix
+#define SMOOTHING 0.25 // weight of the newest measurement in the running estimates
+
+VDIExchange::VDIExchange(MPI_Comm comm, int depth) : comm(comm), next(0), tilelen(0), method(PARTITION_ROWS),
+		bandwidth(0), encoderate(0), rawtotal(0), wiretotal(0), started(0), quantize(false), depthbound(0), frames(0)
+{
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	sendsupsegs.assign(size, 0);
+	recvsupsegs.assign(size, 0);
+
+	slots.resize(depth < 1 ? 1 : depth);
+	for (size_t s = 0; s < slots.size(); ++s) {
+		Slot &slot = slots[s];
+		slot.busy = slot.done = false;
+		slot.recvsupsegs.assign(size, 0);
+		for (int b = 0; b < NSTREAMS; ++b) {
+			slot.sendcounts[b].assign(size, 0);
+			slot.senddispls[b].assign(size, 0);
+			slot.recvcounts[b].assign(size, 0);
+			slot.recvdispls[b].assign(size, 0);
+			slot.recv[b].ptr = slot.stage[b].ptr = NULL;
+			slot.recv[b].capacity = slot.stage[b].capacity = 0;
+			slot.reqs[b] = MPI_REQUEST_NULL;
+		}
+		slot.p2p = false;
+		for (int b = COLORBUF; b <= DEPTHBUF; ++b) {
+			slot.sendwire[b].assign(size, RAW_MESSAGE);
+			slot.recvwire[b].assign(size, RAW_MESSAGE);
+			slot.encdispls[b].assign(size, 0);
+			slot.wiredispls[b].assign(size, 0);
+		}
+		slot.encoded.ptr = slot.received.ptr = slot.levels.ptr = slot.decoded.ptr = NULL;
+		slot.encoded.capacity = slot.received.capacity = slot.levels.capacity = slot.decoded.capacity = 0;
+		slot.quantized = false;
+		slot.wirebytes = 0;
+		slot.landed = 0;
+		for (int p = 0; p < NPHASES; ++p)
+			slot.times[p] = 0;
+	}
+	for (int p = 0; p < NPHASES; ++p)
+		totals[p] = 0;
+	last = slots[0].times;
+	ratio[COLORBUF] = ratio[DEPTHBUF] = 0;
+
+#if MPI_VERSION >= 4
+	MPI_Alltoall_init(sendsupsegs.data(), 1, MPI_INT, recvsupsegs.data(), 1, MPI_INT, comm, MPI_INFO_NULL, &countreq);
+#endif
+}
+
+VDIExchange::~VDIExchange()
+{
+	for (size_t s = 0; s < slots.size(); ++s) {
+		if (slots[s].busy) {
+			MPI_Waitall(NSTREAMS, slots[s].reqs, MPI_STATUSES_IGNORE);
+			MPI_Waitall((int) slots[s].messages.size(), slots[s].messages.data(), MPI_STATUSES_IGNORE);
+			for (size_t i = 0; i < slots[s].decoding.size(); ++i)
+				slots[s].decoding[i].wait();
+		}
+		if (slots[s].encoded.ptr != NULL)
+			MPI_Free_mem(slots[s].encoded.ptr);
+		if (slots[s].received.ptr != NULL)
+			MPI_Free_mem(slots[s].received.ptr);
+		if (slots[s].levels.ptr != NULL)
+			MPI_Free_mem(slots[s].levels.ptr);
+		if (slots[s].decoded.ptr != NULL)
+			MPI_Free_mem(slots[s].decoded.ptr);
+		for (int b = 0; b < NSTREAMS; ++b) {
+			if (slots[s].recv[b].ptr != NULL)
+				MPI_Free_mem(slots[s].recv[b].ptr);
+			if (slots[s].stage[b].ptr != NULL)
+				MPI_Free_mem(slots[s].stage[b].ptr);
+		}
+	}
+#if MPI_VERSION >= 4
+	MPI_Request_free(&countreq);
+#endif
+}
+
+bool VDIExchange::grow(Buffer &buf, size_t bytes)
+{
+	if (bytes <= buf.capacity && buf.ptr != NULL)
+		return false;
+
+	if (buf.ptr != NULL)
+		MPI_Free_mem(buf.ptr);
+	buf.capacity = (size_t) (bytes * GROWTH) + 1;
+	if (MPI_Alloc_mem((MPI_Aint) buf.capacity, MPI_INFO_NULL, &buf.ptr) != MPI_SUCCESS) {
+		perror("MPI_Alloc_mem"); std::exit(1);
+	}
+	return true;
+}
+
+size_t VDIExchange::first_list(int r, size_t nlists) const
+{
+	return (nlists / size) * r;
+}
+
+size_t VDIExchange::lists_of(int r, size_t nlists) const
+{
+	return (r == size - 1) ? nlists - first_list(r, nlists) : nlists / size;
+}
+
+bool VDIExchange::idle() const
+{
+	for (size_t s = 0; s < slots.size(); ++s)
+		if (slots[s].busy)
+			return false;
+	return true;
+}
+
+void VDIExchange::set_partition(size_t len, int m)
+{
+	tilelen = len;
+	method = m;
+	partition.reset();
+}
+
+bool VDIExchange::set_compression(int c, int level, size_t chunkbytes, int nthreads)
+{
+	if (!codec_available(c))
+		return false;
+	if (c == CODEC_NONE) {
+		codec.reset();
+		pool.reset();
+	} else {
+		codec.reset(new ChunkCodec(c, level, chunkbytes));
+		pool.reset(new ThreadPool(nthreads));
+	}
+	ratio[COLORBUF] = ratio[DEPTHBUF] = 0;
+	encoderate = 0;
+	started = 0;
+	return true;
+}
+
+// sending raw takes bytes / bandwidth, compressed ratio * bytes / bandwidth plus compressing them on all threads
+bool VDIExchange::worth_compressing(int b, size_t bytes) const
+{
+	if (ratio[b] <= 0 || bandwidth <= 0 || encoderate <= 0)
+		return true; // measure first
+	double threads = pool->size() > 0 ? pool->size() : 1;
+	return (1 - ratio[b]) * bytes / bandwidth > bytes / (encoderate * threads);
+}
+
+// compress what is worth it, exchange the encoded sizes and post a receive and a send per rank and stream
+void VDIExchange::post_messages(Slot &slot, int s, const void *const *send)
+{
+	double t0 = MPI_Wtime();
+	bool probe = started % PROBE_FRAMES == 0;
+	size_t encbytes = 0;
+	for (int b = COLORBUF; b <= DEPTHBUF; ++b) {
+		for (int r = 0; r < size; ++r) {
+			size_t bytes = slot.sendcounts[b][r];
+			bool compress = r != rank && bytes >= MIN_COMPRESSED && (probe || worth_compressing(b, bytes));
+			slot.sendwire[b][r] = compress ? 0 : RAW_MESSAGE;
+			slot.encdispls[b][r] = encbytes;
+			if (compress)
+				encbytes += codec->bound(bytes);
+		}
+	}
+	grow(slot.encoded, encbytes);
+
+	// all chunks of all messages at once, so that few large messages still use every thread
+	std::vector<std::future<void> > pending;
+	size_t rawin[2] = {0, 0}, encout[2] = {0, 0};
+	for (int b = COLORBUF; b <= DEPTHBUF; ++b)
+		for (int r = 0; r < size; ++r)
+			if (slot.sendwire[b][r] != RAW_MESSAGE)
+				codec->encode((const char *) send[b] + slot.senddispls[b][r], slot.sendcounts[b][r], slot.encoded.ptr + slot.encdispls[b][r], *pool, pending);
+	for (size_t i = 0; i < pending.size(); ++i)
+		pending[i].get();
+	for (int b = COLORBUF; b <= DEPTHBUF; ++b) {
+		for (int r = 0; r < size; ++r) {
+			if (slot.sendwire[b][r] == RAW_MESSAGE)
+				continue;
+			slot.sendwire[b][r] = (int) codec->finish(slot.encoded.ptr + slot.encdispls[b][r], slot.sendcounts[b][r]);
+			rawin[b] += slot.sendcounts[b][r];
+			encout[b] += slot.sendwire[b][r];
+		}
+	}
+	double t1 = MPI_Wtime();
+
+	for (int b = COLORBUF; b <= DEPTHBUF; ++b) {
+		if (rawin[b] == 0)
+			continue;
+		double measured = (double) encout[b] / rawin[b];
+		ratio[b] = ratio[b] > 0 ? (1 - SMOOTHING) * ratio[b] + SMOOTHING * measured : measured;
+	}
+	if (rawin[COLORBUF] + rawin[DEPTHBUF] > 0 && t1 > t0) {
+		double measured = (rawin[COLORBUF] + rawin[DEPTHBUF]) / ((t1 - t0) * (pool->size() > 0 ? pool->size() : 1));
+		encoderate = encoderate > 0 ? (1 - SMOOTHING) * encoderate + SMOOTHING * measured : measured;
+	}
+	for (int b = COLORBUF; b <= DEPTHBUF; ++b) {
+		for (int r = 0; r < size; ++r) {
+			if (r == rank)
+				continue;
+			rawtotal += slot.sendcounts[b][r];
+			wiretotal += (slot.sendwire[b][r] == RAW_MESSAGE) ? slot.sendcounts[b][r] : slot.sendwire[b][r];
+		}
+	}
+
+	// sizes first
+	std::vector<int> sendsizes(2 * size), recvsizes(2 * size);
+	for (int r = 0; r < size; ++r)
+		for (int b = COLORBUF; b <= DEPTHBUF; ++b)
+			sendsizes[2 * r + b] = slot.sendwire[b][r];
+	MPI_Alltoall(sendsizes.data(), 2, MPI_INT, recvsizes.data(), 2, MPI_INT, comm);
+
+	size_t wire = 0;
+	slot.wirebytes = 0;
+	for (int b = COLORBUF; b <= DEPTHBUF; ++b) {
+		for (int r = 0; r < size; ++r) {
+			slot.recvwire[b][r] = recvsizes[2 * r + b];
+			slot.wiredispls[b][r] = wire;
+			if (slot.recvwire[b][r] != RAW_MESSAGE)
+				wire += slot.recvwire[b][r];
+			if (r != rank)
+				slot.wirebytes += (slot.recvwire[b][r] == RAW_MESSAGE) ? slot.recvcounts[b][r] : slot.recvwire[b][r];
+		}
+	}
+	grow(slot.received, wire);
+
+	slot.messages.assign(4 * size, MPI_REQUEST_NULL);
+	slot.decoding.clear();
+	slot.landed = 0;
+	for (int b = COLORBUF; b <= DEPTHBUF; ++b) {
+		int tag = TAG_BASE + b + 2 * s;
+		for (int r = 0; r < size; ++r) {
+			if (r == rank) {
+				memcpy(slot.recv[b].ptr + slot.recvdispls[b][r], (const char *) send[b] + slot.senddispls[b][r], slot.sendcounts[b][r]);
+				continue;
+			}
+			if (slot.recvwire[b][r] != RAW_MESSAGE)
+				MPI_Irecv(slot.received.ptr + slot.wiredispls[b][r], slot.recvwire[b][r], MPI_BYTE, r, tag, comm, &slot.messages[b * size + r]);
+			else if (slot.recvcounts[b][r] > 0)
+				MPI_Irecv(slot.recv[b].ptr + slot.recvdispls[b][r], slot.recvcounts[b][r], MPI_BYTE, r, tag, comm, &slot.messages[b * size + r]);
+
+			if (slot.sendwire[b][r] != RAW_MESSAGE)
+				MPI_Isend(slot.encoded.ptr + slot.encdispls[b][r], slot.sendwire[b][r], MPI_BYTE, r, tag, comm, &slot.messages[(2 + b) * size + r]);
+			else if (slot.sendcounts[b][r] > 0)
+				MPI_Isend((const char *) send[b] + slot.senddispls[b][r], slot.sendcounts[b][r], MPI_BYTE, r, tag, comm, &slot.messages[(2 + b) * size + r]);
+		}
+	}
+	++started;
+}
+
+// a receive or send completed; compressed messages are decompressed right away, on the pool
+void VDIExchange::arrived(Slot &slot, int index)
+{
+	if (index >= 2 * size)
+		return;
+	int b = index / size, r = index % size;
+	if (slot.recvwire[b][r] != RAW_MESSAGE)
+		codec->decode(slot.received.ptr + slot.wiredispls[b][r], slot.recvcounts[b][r], slot.recv[b].ptr + slot.recvdispls[b][r], *pool, slot.decoding);
+}
+
+// drive the point to point messages, returning whether all arrived and were decompressed
+bool VDIExchange::decoded(Slot &slot, bool block)
+{
+	std::vector<int> indices(slot.messages.size());
+	while (true) {
+		int n = 0;
+		if (block)
+			MPI_Waitsome((int) slot.messages.size(), slot.messages.data(), &n, indices.data(), MPI_STATUSES_IGNORE);
+		else
+			MPI_Testsome((int) slot.messages.size(), slot.messages.data(), &n, indices.data(), MPI_STATUSES_IGNORE);
+		if (n == MPI_UNDEFINED)
+			break; // all complete
+		if (n == 0 && !block)
+			return false;
+		for (int i = 0; i < n; ++i)
+			arrived(slot, indices[i]);
+	}
+
+	if (slot.landed == 0) {
+		slot.landed = MPI_Wtime();
+		if (slot.wirebytes >= MIN_COMPRESSED && slot.landed > slot.posted) {
+			double measured = slot.wirebytes / (slot.landed - slot.posted);
+			bandwidth = bandwidth > 0 ? (1 - SMOOTHING) * bandwidth + SMOOTHING * measured : measured;
+		}
+	}
+
+	for (size_t i = 0; i < slot.decoding.size(); ++i) {
+		if (block)
+			slot.decoding[i].wait();
+		else if (slot.decoding[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+	}
+	return true;
+}
+
+void VDIExchange::set_depth_quantization(bool enabled)
+{
+	quantize = enabled;
+}
+
+// the depths for each rank against the ranges of its lists, the blocks of colours, depths and prefix sums line up
+void VDIExchange::quantize_blocks(Slot &slot, const void *const *send)
+{
+	depthbound = 0;
+	for (int r = 0; r < size; ++r) {
+		size_t first = slot.senddispls[DEPTHBUF][r] / DEPTH_QBYTES, lists = slot.sendcounts[PREFIXBUF][r] / sizeof(int32_t);
+		if (lists == 0)
+			continue;
+		float bound = quantize_depths((const float *) send[DEPTHBUF] + 2 * first, (const int32_t *) send[PREFIXBUF] + slot.senddispls[PREFIXBUF][r] / sizeof(int32_t),
+				lists, slot.sendcounts[DEPTHBUF][r] / DEPTH_QBYTES, (uint16_t *) slot.levels.ptr + 2 * first, (float *) slot.stage[RANGEBUF].ptr + 2 * (slot.senddispls[RANGEBUF][r] / RANGE_BYTES));
+		depthbound = std::max(depthbound, bound);
+	}
+}
+
+void VDIExchange::dequantize_blocks(Slot &slot)
+{
+	size_t lists = slot.result.lists;
+	if (lists == 0)
+		return;
+	for (int r = 0; r < size; ++r) {
+		size_t first = slot.recvdispls[DEPTHBUF][r] / DEPTH_QBYTES;
+		dequantize_depths((const uint16_t *) slot.recv[DEPTHBUF].ptr + 2 * first, (const float *) slot.recv[RANGEBUF].ptr + 2 * r * lists,
+				(const int32_t *) slot.recv[PREFIXBUF].ptr + r * lists, lists, slot.recvsupsegs[r], (float *) slot.decoded.ptr + 2 * first);
+	}
+}
+
+// cost of each tile over all ranks, then who composites which tile and how much we send each rank
+void VDIExchange::partition_tiles(const int32_t *prefix, size_t nlists, const int *supsegcounts)
+{
+	size_t ntiles = tile_count(nlists, tilelen);
+	if (!partition || partition->list_count() != nlists)
+		partition.reset(new TilePartition(nlists, tilelen, size));
+
+	int64_t total = 0;
+	for (int r = 0; r < size; ++r)
+		total += supsegcounts[r];
+	tilesums.resize(ntiles);
+	tile_sums(prefix, total + prefix[0], nlists, tilelen, tilesums.data());
+
+	tilecosts.assign(tilesums.begin(), tilesums.end());
+	MPI_Allreduce(MPI_IN_PLACE, tilecosts.data(), (int) ntiles, MPI_INT64_T, MPI_SUM, comm);
+	partition->balance(tilecosts.data(), method);
+
+	for (int r = 0; r < size; ++r) {
+		const std::vector<int32_t> &tiles = partition->tiles_of(r);
+		sendsupsegs[r] = 0;
+		for (size_t i = 0; i < tiles.size(); ++i)
+			sendsupsegs[r] += tilesums[tiles[i]];
+	}
+}
+
+// copy the tiles for each rank together, rebasing the prefix sums to where each list ends up in the rank's block
+void VDIExchange::pack(Slot &slot, const void *color, const void *depth, const int32_t *prefix)
+{
+	char *c = slot.stage[COLORBUF].ptr, *d = slot.stage[DEPTHBUF].ptr;
+	int32_t *p = (int32_t *) slot.stage[PREFIXBUF].ptr;
+	for (int r = 0; r < size; ++r) {
+		const std::vector<int32_t> &tiles = partition->tiles_of(r);
+		int32_t offset = 0;
+		for (size_t i = 0; i < tiles.size(); ++i) {
+			size_t first = tiles[i] * tilelen, lists = partition->tile_lists(tiles[i]);
+			size_t from = prefix[first] - prefix[0], n = tilesums[tiles[i]];
+			memcpy(c, (const char *) color + from * COLOR_BYTES, n * COLOR_BYTES);
+			memcpy(d, (const char *) depth + from * DEPTH_BYTES, n * DEPTH_BYTES);
+			for (size_t l = 0; l < lists; ++l)
+				p[l] = prefix[first + l] - prefix[first] + offset;
+			c += n * COLOR_BYTES;
+			d += n * DEPTH_BYTES;
+			p += lists;
+			offset += (int32_t) n;
+		}
+	}
+}
+
+DenseVDIs VDIExchange::exchange(const void *color, const void *depth, const int32_t *prefix, size_t nlists, const int *supsegcounts)
+{
+	// the caller's data stays untouched until we return, no need to stage it
+	int s = start(color, depth, prefix, nlists, supsegcounts, false);
+	if (s < 0) { // all slots in flight, the oldest is the next one round robin
+		wait(next);
+		s = start(color, depth, prefix, nlists, supsegcounts, false);
+	}
+	return wait(s);
+}
+
+int VDIExchange::start(const void *color, const void *depth, const int32_t *prefix, size_t nlists, const int *supsegcounts, bool stage)
+{
+	if (slots[next].busy)
+		return -1;
+	int s = next;
+	next = (next + 1) % (int) slots.size();
+	Slot &slot = slots[s];
+
+	double t0 = MPI_Wtime();
+
+	// how much each rank sends us
+	if (tilelen)
+		partition_tiles(prefix, nlists, supsegcounts);
+	else
+		memcpy(sendsupsegs.data(), supsegcounts, size * sizeof(int));
+#if MPI_VERSION >= 4
+	MPI_Start(&countreq);
+	MPI_Wait(&countreq, MPI_STATUS_IGNORE);
+#else
+	MPI_Alltoall(sendsupsegs.data(), 1, MPI_INT, recvsupsegs.data(), 1, MPI_INT, comm);
+#endif
+	slot.recvsupsegs = recvsupsegs;
+	double t1 = MPI_Wtime();
+
+	// byte counts and displacements; supersegments for a rank follow those for the ranks before it
+	slot.quantized = quantize;
+	const int elbytes[2] = {COLOR_BYTES, quantize ? DEPTH_QBYTES : DEPTH_BYTES};
+	const int listbytes[NSTREAMS] = {0, 0, sizeof(int32_t), quantize ? RANGE_BYTES : 0};
+	size_t sent = 0, recvd = 0, listssent = 0;
+	size_t mylists = tilelen ? partition->lists_of(rank) : lists_of(rank, nlists);
+	for (int r = 0; r < size; ++r) {
+		for (int b = COLORBUF; b <= DEPTHBUF; ++b) {
+			slot.sendcounts[b][r] = sendsupsegs[r] * elbytes[b];
+			slot.senddispls[b][r] = (int) (sent * elbytes[b]);
+			slot.recvcounts[b][r] = recvsupsegs[r] * elbytes[b];
+			slot.recvdispls[b][r] = (int) (recvd * elbytes[b]);
+		}
+		sent  += sendsupsegs[r];
+		recvd += recvsupsegs[r];
+
+		size_t lists = tilelen ? partition->lists_of(r) : lists_of(r, nlists);
+		for (int b = PREFIXBUF; b < NSTREAMS; ++b) {
+			slot.sendcounts[b][r] = (int) (lists * listbytes[b]);
+			slot.senddispls[b][r] = (int) (listssent * listbytes[b]);
+			slot.recvcounts[b][r] = (int) (mylists * listbytes[b]);
+			slot.recvdispls[b][r] = (int) (r * mylists * listbytes[b]);
+		}
+		listssent += lists;
+	}
+
+	// staged depths are floats, quantized ones go to slot.levels
+	size_t sendbytes[NSTREAMS] = {sent * COLOR_BYTES, sent * DEPTH_BYTES, nlists * sizeof(int32_t), nlists * listbytes[RANGEBUF]};
+	size_t recvbytes[NSTREAMS] = {recvd * COLOR_BYTES, recvd * elbytes[DEPTHBUF], size * mylists * sizeof(int32_t), size * mylists * listbytes[RANGEBUF]};
+	bool moved = false;
+	for (int b = 0; b < NSTREAMS; ++b)
+		moved = grow(slot.recv[b], recvbytes[b]) || moved;
+	if (quantize)
+		moved = grow(slot.decoded, recvd * DEPTH_BYTES) || moved;
+	double t2 = MPI_Wtime();
+
+	const void *send[NSTREAMS] = {color, depth, prefix, NULL};
+	if (tilelen) {
+		for (int b = 0; b < RANGEBUF; ++b) {
+			grow(slot.stage[b], sendbytes[b]);
+			send[b] = slot.stage[b].ptr;
+		}
+		pack(slot, color, depth, prefix);
+		slot.tiles = partition->tiles_of(rank);
+	} else if (stage) {
+		for (int b = 0; b < RANGEBUF; ++b) {
+			if (b == DEPTHBUF && quantize)
+				continue; // quantizing copies them anyway
+			grow(slot.stage[b], sendbytes[b]);
+			memcpy(slot.stage[b].ptr, send[b], sendbytes[b]);
+			send[b] = slot.stage[b].ptr;
+		}
+	}
+	if (quantize) {
+		grow(slot.levels, sent * DEPTH_QBYTES);
+		grow(slot.stage[RANGEBUF], sendbytes[RANGEBUF]);
+		quantize_blocks(slot, send);
+		send[DEPTHBUF] = slot.levels.ptr;
+		send[RANGEBUF] = slot.stage[RANGEBUF].ptr;
+	}
+	double t3 = MPI_Wtime();
+
+	slot.p2p = codec.get() != NULL;
+	if (slot.p2p) {
+		post_messages(slot, s, send);
+		t3 = MPI_Wtime(); // the compression is part of staging
+	}
+	for (int b = slot.p2p ? PREFIXBUF : 0; b < (quantize ? NSTREAMS : RANGEBUF); ++b)
+		MPI_Ialltoallv(send[b], slot.sendcounts[b].data(), slot.senddispls[b].data(), MPI_BYTE,
+				slot.recv[b].ptr, slot.recvcounts[b].data(), slot.recvdispls[b].data(), MPI_BYTE, comm, &slot.reqs[b]);
+	slot.posted = MPI_Wtime();
+
+	slot.times[PHASE_COUNTS] = t1 - t0;
+	slot.times[PHASE_LAYOUT] = t2 - t1;
+	slot.times[PHASE_STAGE]  = t3 - t2;
+	slot.times[PHASE_POST]   = slot.posted - t3;
+	slot.times[PHASE_FLIGHT] = slot.times[PHASE_WAIT] = 0;
+
+	slot.result.color = slot.recv[COLORBUF].ptr;
+	slot.result.depth = quantize ? slot.decoded.ptr : slot.recv[DEPTHBUF].ptr;
+	slot.result.prefix = (int32_t *) slot.recv[PREFIXBUF].ptr;
+	slot.result.supersegments = recvd;
+	slot.result.lists = mylists;
+	slot.result.recvsupsegs = slot.recvsupsegs.data();
+	slot.result.reallocated = moved;
+	slot.result.tiles = tilelen ? slot.tiles.data() : NULL;
+	slot.result.ntiles = tilelen ? slot.tiles.size() : 0;
+	slot.result.tilelen = tilelen;
+
+	slot.busy = true;
+	slot.done = false;
+	return s;
+}
+
+bool VDIExchange::test(int s)
+{
+	Slot &slot = slots[s];
+	if (!slot.busy || slot.done)
+		return true;
+
+	int flag;
+	MPI_Testall(NSTREAMS, slot.reqs, &flag, MPI_STATUSES_IGNORE);
+	if (slot.p2p && !decoded(slot, false))
+		flag = 0;
+	if (flag) {
+		slot.done = true;
+		slot.times[PHASE_FLIGHT] = MPI_Wtime() - slot.posted;
+	}
+	return flag != 0;
+}
+
+DenseVDIs VDIExchange::wait(int s)
+{
+	Slot &slot = slots[s];
+	if (slot.busy) {
+		double t0 = MPI_Wtime();
+		if (!slot.done) {
+			if (slot.p2p)
+				decoded(slot, true);
+			MPI_Waitall(NSTREAMS, slot.reqs, MPI_STATUSES_IGNORE);
+			double t1 = MPI_Wtime();
+			slot.times[PHASE_WAIT] = t1 - t0;
+			slot.times[PHASE_FLIGHT] = t1 - slot.posted;
+		}
+		slot.busy = slot.done = false;
+
+		if (slot.quantized) {
+			double t1 = MPI_Wtime();
+			dequantize_blocks(slot);
+			slot.times[PHASE_WAIT] += MPI_Wtime() - t1;
+		}
+
+		for (int p = 0; p < NPHASES; ++p)
+			totals[p] += slot.times[p];
+		++frames;
+		last = slot.times;
+	}
+	return slot.result;
+}
@@ -0,0 +1,216 @@
+/*
+ * All-to-all exchange of dense VDIs between rendering ranks
+ *
+ * In a dense VDI the supersegments of all lists (pixels) are stored back to back, list after list,
+ * and the exclusive prefix sum over the per-list counts gives where each list starts. The lists are
+ * split between ranks for compositing as in DistributedVolumes: n/size lists each, the last rank
+ * also taking the remainder. Since each rank's lists are contiguous, so are the supersegments it is
+ * sent, and the exchange is one all-to-all each for colours, depths and prefix sums:
+ *
+ * VDIExchange::exchange(color, depth, prefix, n, counts): send counts[r] supersegments to each rank
+ *     r, return what was received, ordered by source rank
+ *
+ * or, to overlap the exchange with other work, e.g. generating the next frame:
+ *
+ * VDIExchange::start(color, depth, prefix, n, counts): post the exchange, return its slot
+ * VDIExchange::test(slot):                             check for completion, driving progress
+ * VDIExchange::wait(slot):                             block until complete, return what was received
+ *
+ * The exchange has a fixed number of slots (the pipeline depth), each with its own receive buffers,
+ * counts and MPI requests, so up to that many exchanges can be in flight; start returns -1 when all
+ * are. Slots are started and waited in the same order on every rank. Unless told otherwise start
+ * copies the send data into staging buffers of the slot, so the caller may overwrite it right away.
+ *
+ * By default the lists are split between ranks in equal shares. After set_partition(tilelen, method)
+ * they are cut into tiles instead, which are assigned by their cost, the supersegments of all ranks
+ * summed with an all-reduce, as in TilePartition.hpp. The send data is then packed by destination
+ * into the staging buffers, with the prefix sums rebased to the packed data, and the result lists
+ * the tiles received, in ascending order. Only the sum of the supersegment counts passed is used.
+ *
+ * After set_compression(codec, level, chunkbytes, nthreads) colours and depths are sent point to
+ * point instead, one message per rank and stream, each either as is or chunked and compressed on a
+ * thread pool as in ChunkCodec.hpp. The encoded sizes are exchanged first, so every receive can be
+ * posted with its exact size, and each message is decompressed as soon as it arrives, while the
+ * others are still in flight. Whether to compress is decided per message: messages to ourselves
+ * and below MIN_COMPRESSED are sent as is, the others only if the bytes saved on the wire, at the
+ * bandwidth measured over previous exchanges, take longer to send than compressing them at the
+ * measured rate takes. Every PROBE_FRAMES exchanges all are compressed, to keep the ratio current.
+ *
+ * After set_depth_quantization(true) depths are sent as 16-bit levels within the range of their
+ * list, as in DepthCodec.hpp, with the ranges in a fourth stream laid out like the prefix sums,
+ * and turned back into floats once received. This halves the depth traffic at an error reported
+ * by depth_error(); the result is as without quantization.
+ *
+ * All buffers are allocated with MPI_Alloc_mem (so they can be registered with the interconnect
+ * once) and reused for every frame; they only grow, by GROWTH at a time. The per-rank counts are
+ * exchanged with a persistent collective where MPI 4 is available. A result stays valid until its
+ * slot is started again.
+ */
+
+#ifndef VDI_EXCHANGE_HPP
+#define VDI_EXCHANGE_HPP
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <mpi.h>
+
+#include "TilePartition.hpp"
+#include "ChunkCodec.hpp"
+#include "ThreadPool.hpp"
+#include "DepthCodec.hpp"
+
+#define COLOR_BYTES 16 // RGBA32F per supersegment
+#define DEPTH_BYTES 8  // start and end depth per supersegment
+#define GROWTH 1.25    // buffers are allocated this much larger than needed
+#define NSTREAMS 4     // colours, depths, prefix sums, depth ranges
+
+#define MIN_COMPRESSED (1 << 16) // smaller messages are sent as is, their latency dominates
+#define PROBE_FRAMES 16          // compress every message this often, to keep measuring the ratio
+#define RAW_MESSAGE (-1)         // encoded size of a message sent as is
+
+enum ExchangePhase {
+	PHASE_COUNTS = 0, // exchanging supersegment counts and tile costs, partitioning
+	PHASE_LAYOUT = 1, // computing displacements, growing buffers
+	PHASE_STAGE  = 2, // copying (packing, for tiles; compressing) send data into the slot
+	PHASE_POST   = 3, // posting the non-blocking all-to-alls
+	PHASE_FLIGHT = 4, // from posting until completion was first seen by test or wait
+	PHASE_WAIT   = 5, // blocked in wait
+	NPHASES      = 6
+};
+
+struct DenseVDIs {
+	void *color;
+	void *depth;
+	int32_t *prefix;            // prefix sums for this rank's lists, one block per source rank
+	size_t supersegments;       // received in total
+	size_t lists;               // owned by this rank, i.e. prefix holds lists ints per source
+	const int *recvsupsegs;     // supersegments received from each rank
+	bool reallocated;           // whether the receive buffers of the slot moved since its previous exchange
+
+	const int32_t *tiles;       // with a partition, the tiles received, ascending; NULL otherwise
+	size_t ntiles;
+	size_t tilelen;
+};
+
+class VDIExchange {
+
+	struct Buffer {
+		char *ptr;
+		size_t capacity;
+	};
+
+	struct Slot {
+		bool busy;
+		bool done;
+
+		// per rank and stream: bytes and byte displacements, kept until the requests complete
+		std::vector<int> recvsupsegs;
+		std::vector<int> sendcounts[NSTREAMS], senddispls[NSTREAMS], recvcounts[NSTREAMS], recvdispls[NSTREAMS];
+
+		Buffer recv[NSTREAMS];
+		Buffer stage[NSTREAMS];
+		MPI_Request reqs[NSTREAMS];
+
+		std::vector<int32_t> tiles; // ours for this exchange, the partition may change before it completes
+
+		// with compression, colours and depths go point to point, one message per rank and stream
+		bool p2p;
+		std::vector<int> sendwire[2], recvwire[2]; // encoded bytes per rank, RAW_MESSAGE if sent as is
+		std::vector<size_t> encdispls[2], wiredispls[2];
+		Buffer encoded, received;                  // messages to send, at their bound offsets, and received
+		std::vector<MPI_Request> messages;         // receives per stream and rank, then sends
+		std::vector<std::future<void> > decoding;  // a task per compressed chunk received
+		size_t wirebytes;                          // received from other ranks
+		double landed;                             // MPI_Wtime when the last message was seen to arrive, 0 before
+
+		bool quantized;
+		Buffer levels, decoded; // quantized depths to send, received depths as floats
+
+		double posted;          // MPI_Wtime after posting
+		double times[NPHASES];
+		DenseVDIs result;
+	};
+
+	MPI_Comm comm;
+	int rank, size;
+
+	std::vector<int> sendsupsegs, recvsupsegs; // arguments of the count exchange
+#if MPI_VERSION >= 4
+	MPI_Request countreq; // persistent all-to-all of sendsupsegs into recvsupsegs
+#endif
+
+	std::vector<Slot> slots;
+	int next; // slot the next start uses, slots are used round robin
+
+	size_t tilelen;   // 0 for equal shares
+	int method;
+	std::unique_ptr<TilePartition> partition;
+	std::vector<int32_t> tilesums;
+	std::vector<int64_t> tilecosts;
+
+	void partition_tiles(const int32_t *prefix, size_t nlists, const int *supsegcounts);
+	void pack(Slot &slot, const void *color, const void *depth, const int32_t *prefix);
+
+	std::unique_ptr<ChunkCodec> codec; // NULL without compression
+	std::unique_ptr<ThreadPool> pool;
+	double ratio[2];   // encoded over raw bytes per stream, 0 until measured
+	double bandwidth;  // bytes per second received from other ranks, 0 until measured
+	double encoderate; // raw bytes compressed per second per thread, 0 until measured
+	size_t rawtotal, wiretotal;
+	long started;
+
+	bool worth_compressing(int stream, size_t bytes) const;
+	void post_messages(Slot &slot, int s, const void *const *send);
+	void arrived(Slot &slot, int index);
+	bool decoded(Slot &slot, bool block);
+
+	bool quantize;
+	float depthbound;
+	void quantize_blocks(Slot &slot, const void *const *send);
+	void dequantize_blocks(Slot &slot);
+
+	const double *last;
+	double totals[NPHASES];
+	long frames;
+
+	static bool grow(Buffer &buf, size_t bytes); // returns whether it reallocated
+
+public:
+
+	VDIExchange(MPI_Comm comm, int depth = 1);
+	~VDIExchange();
+
+	DenseVDIs exchange(const void *color, const void *depth, const int32_t *prefix, size_t nlists, const int *supsegcounts);
+
+	int start(const void *color, const void *depth, const int32_t *prefix, size_t nlists, const int *supsegcounts, bool stage = true);
+	bool test(int slot);
+	DenseVDIs wait(int slot);
+
+	// assign tiles of tilelen lists by cost from the next start on, 0 to return to equal shares; call on all ranks while idle
+	void set_partition(size_t tilelen, int method = PARTITION_GREEDY);
+	const TilePartition *current_partition() const { return partition.get(); }
+
+	// compress colours and depths with codec from the next start on, CODEC_NONE to stop; call on all
+	// ranks while idle, with the same arguments; false if the codec was not built in
+	bool set_compression(int codec, int level = 0, size_t chunkbytes = CHUNK_BYTES, int nthreads = 0);
+	double wire_ratio() const { return rawtotal ? (double) wiretotal / rawtotal : 1.0; } // bytes sent over bytes to send, so far
+	double bandwidth_estimate() const { return bandwidth; }
+
+	// send depths as 16-bit levels within each list's range, from the next start on; call on all ranks while idle
+	void set_depth_quantization(bool enabled);
+	float depth_error() const { return depthbound; } // largest error of the depths quantized by the last start
+
+	int depth() const { return (int) slots.size(); }
+	bool idle() const; // no exchange in flight
+
+	size_t lists_of(int r, size_t nlists) const; // lists owned by rank r with equal shares
+	size_t first_list(int r, size_t nlists) const;
+
+	const double *last_times() const { return last; } // seconds per phase of the exchange waited for last
+	double mean_time(int phase) const { return frames ? totals[phase] / frames : 0; }
+	MPI_Comm communicator() const { return comm; }
+};
+
+#endif
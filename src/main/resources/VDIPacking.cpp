@@ -0,0 +1,185 @@
+/*
+ * Packing of fixed-size VDIs for transport
+ *
+ *
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "VDIPacking.hpp"
+#include "ParallelChunks.hpp"
+
+#define COLOR_FLOATS 4
+#define DEPTH_FLOATS 2
+
+namespace {
+
+inline size_t mask_words(size_t nlists)
+{
+	return (nlists + 63) / 64;
+}
+
+inline size_t aligned(size_t bytes)
+{
+	return (bytes + 15) & ~(size_t) 15;
+}
+
+// where the counts, colours and depths of a packed run start
+struct Layout {
+	const uint64_t *mask;
+	const uint8_t *counts;
+	const float *color, *depth;
+	size_t occupied, supsegs;
+
+	Layout(const char *in, size_t nlists)
+	{
+		size_t words = mask_words(nlists);
+		mask = (const uint64_t *) in;
+		counts = (const uint8_t *) (mask + words);
+		occupied = supsegs = 0;
+		for (size_t w = 0; w < words; ++w)
+			occupied += __builtin_popcountll(mask[w]);
+		for (size_t i = 0; i < occupied; ++i)
+			supsegs += counts[i];
+		color = (const float *) (in + aligned(words * sizeof(uint64_t) + occupied));
+		depth = color + COLOR_FLOATS * supsegs;
+	}
+};
+
+// fn(list, count) for each list holding supersegments, in order, skipping empty runs of 64 at once
+template <typename F>
+void for_occupied(const Layout &p, size_t nlists, F fn)
+{
+	size_t i = 0;
+	for (size_t w = 0; w < mask_words(nlists); ++w) {
+		for (uint64_t bits = p.mask[w]; bits != 0; bits &= bits - 1)
+			fn(w * 64 + __builtin_ctzll(bits), p.counts[i++]);
+	}
+}
+
+}
+
+size_t packed_bound(size_t nlists, int maxsupsegs)
+{
+	return aligned(mask_words(nlists) * sizeof(uint64_t) + nlists) + nlists * maxsupsegs * (COLOR_FLOATS + DEPTH_FLOATS) * sizeof(float);
+}
+
+size_t pack_vdi(const float *color, const float *depth, size_t nlists, int maxsupsegs, char *out)
+{
+	size_t words = mask_words(nlists);
+	uint64_t *mask = (uint64_t *) out;
+	uint8_t *counts = (uint8_t *) (mask + words);
+	memset(mask, 0, words * sizeof(uint64_t));
+
+	size_t occupied = 0;
+	for (size_t l = 0; l < nlists; ++l) {
+		const float *d = depth + l * maxsupsegs * DEPTH_FLOATS;
+		int n = 0;
+		while (n < maxsupsegs && d[n * DEPTH_FLOATS] != 0)
+			++n;
+		if (n > 0) {
+			mask[l / 64] |= (uint64_t) 1 << (l % 64);
+			counts[occupied++] = (uint8_t) n;
+		}
+	}
+
+	Layout p(out, nlists);
+	float *c = (float *) p.color, *d = (float *) p.depth;
+	for_occupied(p, nlists, [&](size_t l, int n) {
+		memcpy(c, color + l * maxsupsegs * COLOR_FLOATS, n * COLOR_FLOATS * sizeof(float));
+		memcpy(d, depth + l * maxsupsegs * DEPTH_FLOATS, n * DEPTH_FLOATS * sizeof(float));
+		c += n * COLOR_FLOATS;
+		d += n * DEPTH_FLOATS;
+	});
+	return (const char *) (p.depth + DEPTH_FLOATS * p.supsegs) - out;
+}
+
+void unpack_vdi(const char *in, size_t nlists, int maxsupsegs, float *color, float *depth)
+{
+	memset(color, 0, nlists * maxsupsegs * COLOR_FLOATS * sizeof(float));
+	memset(depth, 0, nlists * maxsupsegs * DEPTH_FLOATS * sizeof(float));
+
+	Layout p(in, nlists);
+	const float *c = p.color, *d = p.depth;
+	for_occupied(p, nlists, [&](size_t l, int n) {
+		memcpy(color + l * maxsupsegs * COLOR_FLOATS, c, n * COLOR_FLOATS * sizeof(float));
+		memcpy(depth + l * maxsupsegs * DEPTH_FLOATS, d, n * DEPTH_FLOATS * sizeof(float));
+		c += n * COLOR_FLOATS;
+		d += n * DEPTH_FLOATS;
+	});
+}
+
+size_t unpack_dense(const char *in, size_t nlists, int32_t *counts, float *color, float *depth)
+{
+	memset(counts, 0, nlists * sizeof(int32_t));
+	Layout p(in, nlists);
+	for_occupied(p, nlists, [&](size_t l, int n) { counts[l] = n; });
+	memcpy(color, p.color, p.supsegs * COLOR_FLOATS * sizeof(float));
+	memcpy(depth, p.depth, p.supsegs * DEPTH_FLOATS * sizeof(float));
+	return p.supsegs;
+}
+
+SparseVDIExchange::SparseVDIExchange(MPI_Comm comm, int nthreads) : comm(comm), nthreads(nthreads), lists(0), rawtotal(0), senttotal(0)
+{
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	sendbytes.assign(size, 0);
+	senddispls.assign(size, 0);
+	recvbytes.assign(size, 0);
+	recvdispls.assign(size, 0);
+	for (int p = 0; p < NPACKING; ++p)
+		times[p] = 0;
+}
+
+void SparseVDIExchange::exchange(const float *c, const float *d, size_t nlists, int maxsupsegs)
+{
+	if (maxsupsegs > MAX_PACKED_SUPSEGS) {
+		fprintf(stderr, "SparseVDIExchange: at most %d supersegments per list\n", MAX_PACKED_SUPSEGS); std::exit(1);
+	}
+	double t0 = MPI_Wtime();
+
+	// each share packed at its bound, the displacements skip the gaps
+	lists = nlists / size;
+	size_t bound = packed_bound(lists, maxsupsegs);
+	packed.resize(bound * size);
+	parallel_chunks(size, nthreads, [&](size_t begin, size_t end, int) {
+		for (size_t r = begin; r < end; ++r) {
+			size_t first = r * lists;
+			sendbytes[r] = (int) pack_vdi(c + first * maxsupsegs * COLOR_FLOATS, d + first * maxsupsegs * DEPTH_FLOATS, lists, maxsupsegs, packed.data() + r * bound);
+			senddispls[r] = (int) (r * bound);
+		}
+	}, 1);
+	for (int r = 0; r < size; ++r) {
+		if (r == rank)
+			continue;
+		rawtotal += lists * maxsupsegs * (COLOR_FLOATS + DEPTH_FLOATS) * sizeof(float);
+		senttotal += sendbytes[r];
+	}
+	double t1 = MPI_Wtime();
+
+	MPI_Alltoall(sendbytes.data(), 1, MPI_INT, recvbytes.data(), 1, MPI_INT, comm);
+	size_t total = 0;
+	for (int r = 0; r < size; ++r) {
+		recvdispls[r] = (int) total;
+		total += recvbytes[r];
+	}
+	received.resize(total);
+	MPI_Alltoallv(packed.data(), sendbytes.data(), senddispls.data(), MPI_BYTE, received.data(), recvbytes.data(), recvdispls.data(), MPI_BYTE, comm);
+	double t2 = MPI_Wtime();
+
+	size_t slab = lists * maxsupsegs;
+	color.resize(size * slab * COLOR_FLOATS);
+	depth.resize(size * slab * DEPTH_FLOATS);
+	parallel_chunks(size, nthreads, [&](size_t begin, size_t end, int) {
+		for (size_t r = begin; r < end; ++r)
+			unpack_vdi(received.data() + recvdispls[r], lists, maxsupsegs, color.data() + r * slab * COLOR_FLOATS, depth.data() + r * slab * DEPTH_FLOATS);
+	}, 1);
+	double t3 = MPI_Wtime();
+
+	times[PACKING_PACK] = t1 - t0;
+	times[PACKING_EXCHANGE] = t2 - t1;
+	times[PACKING_UNPACK] = t3 - t2;
+}
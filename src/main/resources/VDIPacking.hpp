@@ -0,0 +1,81 @@
+/*
+ * Packing of fixed-size VDIs for transport
+ *
+ * A non-dense VDI is a slab of maxsupsegs supersegments for every list (pixel), RGBA colours and
+ * start/end depths, although outside the projection of a rank's sub-volume most lists are empty.
+ * Packed, a run of lists only keeps what it holds:
+ *
+ *     uint64 bitmask, bit l set if list l holds supersegments | uint8 supersegments per set list |
+ *     padding to 16 bytes | their colours, list after list | their depths, list after list
+ *
+ * The supersegments of a list are those before its first empty one (start depth 0), which is also
+ * where the compositors stop reading it. Packed lists are dense VDIs as in VDIExchange.hpp already,
+ * so they can be expanded back into the slab or taken over as they are:
+ *
+ * pack_vdi(color, depth, nlists, maxsupsegs, out):      returns the bytes written, at most packed_bound
+ * unpack_vdi(in, nlists, maxsupsegs, color, depth):     expand into a slab, empty supersegments zero
+ * unpack_dense(in, nlists, counts, color, depth):       supersegments per list and the packed data,
+ *                                                       returns the supersegment count
+ *
+ * SparseVDIExchange::exchange(color, depth, nlists, maxsupsegs) is the all-to-all of distributeVDIs
+ * with packed lists: the slab is split in equal shares of nlists / size lists, as there, each share
+ * packed for its rank, the packed sizes exchanged and then the data, and what is received expanded
+ * into the set of sub-VDIs the compositor expects, one slab of the rank's lists per source rank.
+ * The bytes on the wire then grow with what is visible rather than with the screen resolution.
+ */
+
+#ifndef VDI_PACKING_HPP
+#define VDI_PACKING_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <mpi.h>
+
+#define MAX_PACKED_SUPSEGS 255 // counts are single bytes
+
+enum PackingPhase {
+	PACKING_PACK     = 0, // packing the share of each rank
+	PACKING_EXCHANGE = 1, // exchanging sizes and data
+	PACKING_UNPACK   = 2, // expanding what was received
+	NPACKING         = 3
+};
+
+size_t packed_bound(size_t nlists, int maxsupsegs);
+size_t pack_vdi(const float *color, const float *depth, size_t nlists, int maxsupsegs, char *out);
+void unpack_vdi(const char *in, size_t nlists, int maxsupsegs, float *color, float *depth);
+size_t unpack_dense(const char *in, size_t nlists, int32_t *counts, float *color, float *depth);
+
+class SparseVDIExchange {
+
+	MPI_Comm comm;
+	int rank, size;
+	int nthreads;
+
+	std::vector<int> sendbytes, senddispls, recvbytes, recvdispls;
+	std::vector<char> packed, received;
+	std::vector<float> color, depth; // the set of sub-VDIs
+	size_t lists;
+
+	size_t rawtotal, senttotal;
+	double times[NPACKING];
+
+public:
+
+	SparseVDIExchange(MPI_Comm comm, int nthreads = 1);
+
+	// color holds 4 and depth 2 floats per supersegment, maxsupsegs per list, for nlists lists
+	void exchange(const float *color, const float *depth, size_t nlists, int maxsupsegs);
+
+	// one slab of lists_per_source() lists per source rank, valid until the next exchange
+	const float *set_color() const { return color.data(); }
+	const float *set_depth() const { return depth.data(); }
+	size_t lists_per_source() const { return lists; }
+
+	const int *received_bytes() const { return recvbytes.data(); } // packed, from each rank
+	double packed_ratio() const { return rawtotal ? (double) senttotal / rawtotal : 1.0; } // bytes sent over slab bytes, so far
+	const double *last_times() const { return times; } // seconds per PackingPhase of the last exchange
+	MPI_Comm communicator() const { return comm; }
+};
+
+#endif
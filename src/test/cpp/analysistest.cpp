@@ -0,0 +1,92 @@
+// Check analysis kernels against scalar loops, for each data type and thread count
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "AnalysisKernels.hpp"
+
+#define N 1000003 // not a multiple of LANES or of the thread count
+#define NBINS 17
+#define TOL 1e-6
+
+int failures = 0;
+
+void check(bool ok, const char *what, int dtype, int nthreads)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << " for dtype " << dtype << " with " << nthreads << " threads" << std::endl;
+		++failures;
+	}
+}
+
+bool close(double a, double b)
+{
+	return std::fabs(a - b) <= TOL * (1 + std::fabs(b));
+}
+
+template <typename T>
+void test(int dtype, double scale)
+{
+	std::vector<T> x(N);
+	srand(42);
+	for (int i = 0; i < N; ++i)
+		x[i] = (T) (scale * (rand() / (double) RAND_MAX));
+
+	// scalar reference
+	double min = x[0], max = x[0], sum = 0;
+	for (int i = 0; i < N; ++i) {
+		if (x[i] < min) min = x[i];
+		if (x[i] > max) max = x[i];
+		sum += x[i];
+	}
+	double mean = sum / N, var = 0;
+	for (int i = 0; i < N; ++i)
+		var += (x[i] - mean) * (x[i] - mean);
+	var /= N;
+
+	double lo = min + (max - min) / 4, hi = max - (max - min) / 4, thresh = (min + max) / 2;
+	uint64_t ref[NBINS] = {0};
+	size_t above = 0;
+	for (int i = 0; i < N; ++i) {
+		double v = x[i];
+		if (v >= thresh) ++above;
+		if (v < lo || v > hi) continue;
+		int b = (int) ((v - lo) * (NBINS / (hi - lo)));
+		ref[b == NBINS ? NBINS-1 : b]++;
+	}
+
+	for (int nthreads = 1; nthreads <= 4; nthreads *= 2) {
+		FieldStats st = field_stats(x.data(), dtype, N, nthreads);
+		check(st.count == N, "count", dtype, nthreads);
+		check(st.min == min && st.max == max, "min/max", dtype, nthreads);
+		check(close(st.mean, mean), "mean", dtype, nthreads);
+		check(close(st.var, var), "variance", dtype, nthreads);
+
+		uint64_t bins[NBINS] = {0};
+		field_histogram(x.data(), dtype, N, lo, hi, NBINS, bins, nthreads);
+		bool same = true;
+		for (int b = 0; b < NBINS; ++b)
+			same = same && (bins[b] == ref[b]);
+		check(same, "histogram", dtype, nthreads);
+
+		check(field_threshold(x.data(), dtype, N, thresh, nthreads) == above, "threshold", dtype, nthreads);
+	}
+}
+
+int main()
+{
+	test<uint8_t>(DTYPE_UINT8, 255);
+	test<uint16_t>(DTYPE_UINT16, 65535);
+	test<float>(DTYPE_FLOAT, 1000);
+	test<double>(DTYPE_DOUBLE, -1e6);
+
+	FieldStats empty = field_stats(NULL, DTYPE_FLOAT, 0);
+	check(empty.count == 0, "empty input", DTYPE_FLOAT, 1);
+
+	if (failures == 0)
+		std::cout << "analysis kernels passed" << std::endl;
+	return failures != 0;
+}
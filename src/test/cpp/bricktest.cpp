@@ -0,0 +1,104 @@
+// Publish time steps of two volume bricks with BrickPublisher and read them through a ShmStream in the
+// same process: a step must not be visible as a brick table before it is published, and afterwards its
+// descriptors and voxels must be those written, in place in the pinned slots
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "BrickPublisher.hpp"
+#include "ShmStreams.hpp"
+
+#define PNAME "/tmp"
+#define RANK 11
+#define STEPS 4
+#define NTHREADS 2
+#define FREEWAIT 20000 // us for the allocator to delete released segments before the next step
+
+int failures = 0;
+
+void check(bool ok, const char *what, long step)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << " in step " << step << std::endl;
+		++failures;
+	}
+}
+
+uint16_t density(long step, size_t i)
+{
+	return (uint16_t) (i * 7 + step * 1000);
+}
+
+float field(long step, size_t i)
+{
+	return 0.5f * i - step;
+}
+
+int main()
+{
+	int dims[][3] = {{33, 20, 17}, {64, 64, 64}};
+	int origins[][3] = {{0, 0, 0}, {31, 0, 0}};
+	int extents[][6] = {{0, 0, 0, 32, 19, 16}, {31, 0, 0, 94, 63, 63}};
+	int domain[] = {0, 0, 0, 94, 63, 63};
+
+	BrickPublisher pub(PNAME, RANK);
+	check(pub.add_brick(BRICK_UINT16, dims[0], 1, origins[0], extents[0]) == 0, "adding a brick", 0);
+	check(pub.add_brick(BRICK_FLOAT32, dims[1], 0, origins[1], extents[1]) == 1, "adding a brick", 0);
+	std::cerr << "(a complaint about an unknown type expected)" << std::endl;
+	check(pub.add_brick(17, dims[1], 0, origins[1], extents[1]) == -1, "rejecting an unknown type", 0);
+	pub.set_domain(domain);
+
+	ShmStream stream(PNAME, RANK, pub.segment_bytes());
+	size_t n0 = (size_t) dims[0][0] * dims[0][1] * dims[0][2], n1 = (size_t) dims[1][0] * dims[1][1] * dims[1][2];
+	std::vector<float> src(n1);
+	void *slots[NKEYS] = {NULL};
+
+	for (long step = 1; step <= STEPS; ++step) {
+		check(pub.begin_step(step) != NULL, "beginning", step);
+		std::lock_guard<std::recursive_mutex> guard(stream.lock);
+		ShmFrame frame = stream.acquire(true);
+		check(frame.ptr != NULL && brick_table(frame.ptr, frame.size) == NULL, "table visible before publishing", step);
+
+		uint16_t *b0 = (uint16_t *) pub.brick(0);
+		for (size_t i = 0; i < n0; ++i)
+			b0[i] = density(step, i);
+		for (size_t i = 0; i < n1; ++i)
+			src[i] = field(step, i);
+		check(pub.copy_brick(1, src.data(), NTHREADS), "copying a brick", step);
+		pub.publish();
+
+		const BrickTableHeader *table = brick_table(frame.ptr, frame.size);
+		check(table != NULL && table->step == step && table->nbricks == 2 && table->bytes == pub.segment_bytes()
+			&& memcmp(table->domain, domain, sizeof(domain)) == 0, "table", step);
+		if (table == NULL)
+			continue;
+		const BrickDescriptor *d = brick_descriptors(table);
+		check(d[0].dtype == BRICK_UINT16 && d[0].ghost == 1 && d[0].bytes == 2 * n0 && d[1].dtype == BRICK_FLOAT32
+			&& d[1].bytes == 4 * n1 && memcmp(d[1].dims, dims[1], sizeof(dims[1])) == 0
+			&& memcmp(d[1].origin, origins[1], sizeof(origins[1])) == 0 && memcmp(d[0].extent, extents[0], sizeof(extents[0])) == 0,
+			"descriptors", step);
+
+		const uint16_t *v0 = (const uint16_t *) brick_voxels(table, 0);
+		const float *v1 = (const float *) brick_voxels(table, 1);
+		bool ok = true;
+		for (size_t i = 0; i < n0 && ok; ++i)
+			ok = v0[i] == density(step, i);
+		for (size_t i = 0; i < n1 && ok; ++i)
+			ok = v1[i] == field(step, i);
+		check(ok, "voxels", step);
+
+		if (slots[frame.slot] == NULL)
+			slots[frame.slot] = frame.ptr;
+		check(slots[frame.slot] == frame.ptr, "slot moved", step);
+		stream.release();
+		usleep(FREEWAIT);
+	}
+
+	stream.detach_all();
+	if (failures == 0)
+		std::cout << "brick publishing passed" << std::endl;
+	return failures != 0;
+}
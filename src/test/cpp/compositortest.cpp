@@ -0,0 +1,177 @@
+// Check the CPU VDI compositor on synthetic sub-VDIs: a single supersegment passes through, dense and
+// fixed-size inputs give the same result, and the result does not depend on the thread count.
+// With -b, also measure throughput for several resolutions and supersegment counts.
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <stdint.h>
+
+#include "VDICompositor.hpp"
+
+#define NSOURCES 4
+#define WIDTH 256
+#define HEIGHT 144
+#define INSUPSEGS 10
+#define OUTSUPSEGS 20
+#define TOL 1e-4
+
+int failures = 0;
+
+void check(bool ok, const char *what)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+// Vulkan style perspective with NDC depth in [0, 1], inverted analytically
+void inverse_projection(float *m, int width, int height)
+{
+	float f = 1.0f / std::tan(0.5f * 50.0f * 3.14159265f / 180.0f), aspect = (float) width / height;
+	float near = 0.1f, far = 20.0f, A = far / (near - far), B = near * far / (near - far);
+	memset(m, 0, 16 * sizeof(float));
+	m[0] = aspect / f;
+	m[5] = 1.0f / f;
+	m[11] = 1.0f / B;
+	m[14] = -1.0f;
+	m[15] = A / B;
+}
+
+// every source sends each list up to insupsegs supersegments in its own depth range, padded with empty ones
+struct Input {
+	std::vector<float> color, depth;       // fixed size layout
+	std::vector<float> dcolor, ddepth;     // dense layout
+	std::vector<int32_t> prefix;
+	std::vector<int> supsegs;
+};
+
+void generate(Input &in, size_t lists, int insupsegs)
+{
+	in.color.assign(NSOURCES * lists * insupsegs * 4, 0);
+	in.depth.assign(NSOURCES * lists * insupsegs * 2, 0);
+	in.dcolor.clear();
+	in.ddepth.clear();
+	in.prefix.resize(NSOURCES * lists);
+	in.supsegs.assign(NSOURCES, 0);
+
+	srand(7);
+	for (int j = 0; j < NSOURCES; ++j) {
+		int32_t offset = rand() % 1000; // the source's sum over lists before ours
+		for (size_t l = 0; l < lists; ++l) {
+			in.prefix[j * lists + l] = offset + in.supsegs[j];
+			int n = rand() % (insupsegs + 1);
+			float d = 0.5f + 0.1f * j;
+			for (int k = 0; k < n; ++k) {
+				float start = d + 0.09f * k / insupsegs, end = start + 0.05f / insupsegs;
+				float c[] = {rand() / (float) RAND_MAX, rand() / (float) RAND_MAX, rand() / (float) RAND_MAX, 0.02f + 0.3f * rand() / (float) RAND_MAX};
+				size_t s = (j * lists + l) * insupsegs + k;
+				memcpy(&in.color[4 * s], c, sizeof(c));
+				in.depth[2 * s] = start;
+				in.depth[2 * s + 1] = end;
+				in.dcolor.insert(in.dcolor.end(), c, c + 4);
+				in.ddepth.push_back(start);
+				in.ddepth.push_back(end);
+			}
+			in.supsegs[j] += n;
+		}
+	}
+}
+
+SubVDIs fixed_input(const Input &in, size_t lists, int insupsegs)
+{
+	SubVDIs s = {in.color.data(), in.depth.data(), NSOURCES, lists, NULL, NULL, insupsegs, NULL, NULL, NULL};
+	return s;
+}
+
+SubVDIs dense_input(const Input &in, size_t lists)
+{
+	SubVDIs s = {in.dcolor.data(), in.ddepth.data(), NSOURCES, lists, in.prefix.data(), in.supsegs.data(), 0, NULL, NULL, NULL};
+	return s;
+}
+
+void single_supersegment(CompositeView view)
+{
+	float color[] = {0.2f, 0.4f, 0.6f, 0.5f}, depth[] = {0.7f, 0.75f};
+	SubVDIs in = {color, depth, 1, 1, NULL, NULL, 1, NULL, NULL, NULL};
+	std::vector<float> outc(4 * OUTSUPSEGS, -1), outd(2 * OUTSUPSEGS, -1);
+	composite_vdis(in, view, OUTSUPSEGS, outc.data(), outd.data());
+
+	bool ok = outd[0] == depth[0] && outd[1] == depth[1] && outd[2] == 0 && outc[4] == 0;
+	for (int i = 0; i < 4; ++i)
+		ok = ok && std::fabs(outc[i] - color[i]) < TOL;
+	check(ok, "single supersegment");
+}
+
+void benchmark(int nthreads)
+{
+	int sizes[][2] = {{640, 360}, {1280, 720}, {1920, 1080}};
+	int supsegs[] = {5, 10, 20};
+	std::cout << "width\theight\tsupersegments\tms\tMlists/s" << std::endl;
+	for (int r = 0; r < 3; ++r) {
+		for (int s = 0; s < 3; ++s) {
+			CompositeView view;
+			view.width = sizes[r][0];
+			view.height = sizes[r][1];
+			view.first_list = 0;
+			view.tiles = NULL;
+			inverse_projection(view.invViewProjection, view.width, view.height);
+			size_t lists = (size_t) view.width * view.height / NSOURCES;
+
+			Input in;
+			generate(in, lists, supsegs[s]);
+			std::vector<float> outc(4 * lists * supsegs[s]), outd(2 * lists * supsegs[s]);
+
+			auto t0 = std::chrono::steady_clock::now();
+			composite_vdis(dense_input(in, lists), view, supsegs[s], outc.data(), outd.data(), nthreads);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+			std::cout << view.width << "\t" << view.height << "\t" << supsegs[s] << "\t" << ms << "\t" << lists / ms / 1e3 << std::endl;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	CompositeView view;
+	view.width = WIDTH;
+	view.height = HEIGHT;
+	view.tiles = NULL;
+	inverse_projection(view.invViewProjection, WIDTH, HEIGHT);
+
+	view.first_list = 3 * HEIGHT + 5;
+	single_supersegment(view);
+
+	// the lists of the second of NSOURCES ranks
+	size_t lists = WIDTH * HEIGHT / NSOURCES;
+	view.first_list = lists;
+	Input in;
+	generate(in, lists, INSUPSEGS);
+
+	std::vector<float> refc(4 * lists * OUTSUPSEGS), refd(2 * lists * OUTSUPSEGS);
+	composite_vdis(fixed_input(in, lists, INSUPSEGS), view, OUTSUPSEGS, refc.data(), refd.data());
+
+	bool ordered = true;
+	for (size_t l = 0; l < lists; ++l) {
+		const float *d = &refd[2 * l * OUTSUPSEGS];
+		for (int k = 0; k < OUTSUPSEGS && d[2 * k] != 0; ++k)
+			ordered = ordered && d[2 * k] < d[2 * k + 1] && (k == 0 || d[2 * k] >= d[2 * k - 1]);
+	}
+	check(ordered, "supersegments front to back");
+
+	for (int nthreads = 1; nthreads <= 8; nthreads *= 2) {
+		std::vector<float> outc(refc.size(), -1), outd(refd.size(), -1);
+		composite_vdis(dense_input(in, lists), view, OUTSUPSEGS, outc.data(), outd.data(), nthreads);
+		check(outc == refc && outd == refd, "dense input");
+	}
+
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+		benchmark(argc > 2 ? atoi(argv[2]) : 4);
+
+	if (failures == 0)
+		std::cout << "compositor passed" << std::endl;
+	return failures != 0;
+}
@@ -0,0 +1,204 @@
+// Write synthetic VDI frames, dense and fixed-size, into containers, raw and with each codec built in,
+// and check that whole frames, single tiles and ranges of lists across tiles read back intact, with their
+// metadata, and that a container that was not closed or whose index is corrupt is refused
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include "VDIContainer.hpp"
+
+#define WIDTH 96
+#define HEIGHT 80
+#define TILELEN 1000 // not dividing the lists
+#define MAXSUPSEGS 6
+#define FRAMES 3
+#define NTHREADS 3
+
+int failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+struct Frame {
+	std::vector<int32_t> counts, prefix;
+	std::vector<float> color, depth;
+};
+
+// supersegments of list l in frame f, many empty lists; colours repeat so that they compress
+void generate(Frame &fr, int f)
+{
+	size_t nlists = (size_t) WIDTH * HEIGHT;
+	fr.counts.resize(nlists);
+	fr.prefix.resize(nlists);
+	fr.color.clear();
+	fr.depth.clear();
+	for (size_t l = 0; l < nlists; ++l) {
+		fr.prefix[l] = (int32_t) (fr.depth.size() / 2);
+		fr.counts[l] = ((l / 50 + f) % 3 == 0) ? 0 : (int) ((l * 7 + f) % MAXSUPSEGS) + 1;
+		for (int k = 0; k < fr.counts[l]; ++k) {
+			float c[] = {0.25f * (k % 4), 0.5f, (float) f, 0.75f}, d[] = {0.1f + 0.01f * k + 1e-6f * l, 0.105f + 0.01f * k + 1e-6f * l};
+			fr.color.insert(fr.color.end(), c, c + 4);
+			fr.depth.insert(fr.depth.end(), d, d + 2);
+		}
+	}
+}
+
+// lists first to first + n of a frame, dense
+bool same(const Frame &fr, size_t first, size_t n, const std::vector<int32_t> &counts, const std::vector<float> &color, const std::vector<float> &depth, size_t supsegs)
+{
+	size_t from = fr.prefix[first], to = (first + n < fr.prefix.size()) ? (size_t) fr.prefix[first + n] : fr.depth.size() / 2;
+	return supsegs == to - from && memcmp(counts.data(), &fr.counts[first], n * sizeof(int32_t)) == 0
+		&& memcmp(color.data(), &fr.color[4 * from], (to - from) * 4 * sizeof(float)) == 0
+		&& memcmp(depth.data(), &fr.depth[2 * from], (to - from) * 2 * sizeof(float)) == 0;
+}
+
+void roundtrip(int codec, const std::vector<Frame> &frames, const char *path)
+{
+	std::string name = codec_name(codec);
+	size_t nlists = (size_t) WIDTH * HEIGHT, raw = 0;
+	{
+		VDIContainerWriter w(path, WIDTH, HEIGHT, TILELEN, codec, 0, NTHREADS);
+		check(w.ok(), name + ": creating the container");
+		for (int f = 0; f < FRAMES; ++f) {
+			const Frame &fr = frames[f];
+			std::string meta = "frame " + std::to_string(f);
+			if (f == 1) {
+				// the same frame as a fixed-size VDI, with junk after the first empty supersegment
+				std::vector<float> color(nlists * MAXSUPSEGS * 4, 0), depth(nlists * MAXSUPSEGS * 2, 0);
+				for (size_t l = 0; l < nlists; ++l) {
+					memcpy(&color[l * MAXSUPSEGS * 4], &fr.color[4 * fr.prefix[l]], fr.counts[l] * 4 * sizeof(float));
+					memcpy(&depth[l * MAXSUPSEGS * 2], &fr.depth[2 * fr.prefix[l]], fr.counts[l] * 2 * sizeof(float));
+					if (fr.counts[l] + 1 < MAXSUPSEGS)
+						depth[(l * MAXSUPSEGS + fr.counts[l] + 1) * 2] = 9.0f;
+				}
+				check(w.append_fixed(color.data(), depth.data(), MAXSUPSEGS, meta.data(), meta.size()), name + ": appending a fixed frame");
+			} else {
+				check(w.append_dense(fr.color.data(), fr.depth.data(), fr.prefix.data(), fr.depth.size() / 2, meta.data(), meta.size()), name + ": appending a dense frame");
+			}
+			raw += fr.depth.size() / 2 * 24 + nlists * 4;
+		}
+
+		VDIContainerReader early;
+		std::cerr << "(a complaint about an incomplete container expected)" << std::endl;
+		check(!early.open(path), name + ": a container that was not closed was opened");
+		check(w.close(), name + ": closing the container");
+	}
+
+	VDIContainerReader r;
+	check(r.open(path), name + ": opening the container");
+	if (r.frames() != FRAMES || r.width() != WIDTH || r.height() != HEIGHT || r.ntiles() != (nlists + TILELEN - 1) / TILELEN) {
+		check(false, name + ": header");
+		return;
+	}
+
+	size_t stored = 0;
+	std::vector<int32_t> counts(nlists);
+	std::vector<float> color(nlists * MAXSUPSEGS * 4), depth(nlists * MAXSUPSEGS * 2);
+	for (int f = 0; f < FRAMES; ++f) {
+		const Frame &fr = frames[f];
+		std::string meta = "frame " + std::to_string(f), what = name + ": frame " + std::to_string(f);
+		size_t metabytes;
+		const char *m = (const char *) r.metadata(f, &metabytes);
+		check(metabytes == meta.size() && m != NULL && memcmp(m, meta.data(), metabytes) == 0, what + " metadata");
+		check(r.frame_supersegments(f) == fr.depth.size() / 2, what + " supersegment total");
+
+		size_t n = r.read_lists(f, 0, nlists, counts.data(), color.data(), depth.data());
+		check(same(fr, 0, nlists, counts, color, depth, n), what + " read whole");
+
+		size_t tile = r.ntiles() - 1, first = tile * TILELEN;
+		n = r.read_tile(f, tile, counts.data(), color.data(), depth.data());
+		check(same(fr, first, nlists - first, counts, color, depth, n), what + " last tile");
+
+		srand(f);
+		for (int i = 0; i < 20; ++i) {
+			size_t a = rand() % nlists, len = 1 + rand() % (3 * TILELEN);
+			if (a + len > nlists)
+				len = nlists - a;
+			n = r.read_lists(f, a, len, counts.data(), color.data(), depth.data());
+			check(same(fr, a, len, counts, color, depth, n), what + " range " + std::to_string(a) + "+" + std::to_string(len));
+		}
+		stored += r.stored_bytes(f);
+	}
+	check(r.read_lists(FRAMES, 0, 1, counts.data(), color.data(), depth.data()) == 0, name + ": reading past the last frame");
+	std::cout << name << ": " << stored << " bytes of tiles for " << raw << " bytes of dense VDIs" << std::endl;
+}
+
+// overwrite bytes of the file at offset, returning what was there
+std::vector<char> patch(const char *path, size_t offset, const void *bytes, size_t n)
+{
+	std::vector<char> was(n);
+	int fd = open(path, O_RDWR);
+	check(fd >= 0 && pread(fd, was.data(), n, offset) == (ssize_t) n && pwrite(fd, bytes, n, offset) == (ssize_t) n, "patching the container");
+	close(fd);
+	return was;
+}
+
+// a raw container with one damage at a time to its header and index
+void corrupt(const Frame &fr, const char *path)
+{
+	{
+		VDIContainerWriter w(path, WIDTH, HEIGHT, TILELEN, CODEC_NONE, 0, NTHREADS);
+		w.append_dense(fr.color.data(), fr.depth.data(), fr.prefix.data(), fr.depth.size() / 2, NULL, 0);
+		check(w.close(), "closing the container to corrupt");
+	}
+	ContainerHeader h;
+	int fd = open(path, O_RDONLY);
+	check(pread(fd, &h, sizeof(h), 0) == (ssize_t) sizeof(h), "reading the header");
+	close(fd);
+	size_t tiles = (h.index + sizeof(FrameEntry) + CHUNK_ALIGN - 1) / CHUNK_ALIGN * CHUNK_ALIGN, last = tiles + (h.ntiles - 1) * sizeof(TileEntry);
+
+	struct Damage {
+		const char *what;
+		size_t offset;
+		uint64_t value;
+		size_t n;
+	} damages[] = {
+		{"a tile length of 0", offsetof(ContainerHeader, tilelen), 0, sizeof(uint32_t)},
+		{"a tile past the end", last + offsetof(TileEntry, offset), h.index, sizeof(uint64_t)},
+		{"a raw tile stored shorter than it is", last + offsetof(TileEntry, stored), 8, sizeof(uint32_t)},
+		{"a tile decoding to more than its lists", last + offsetof(TileEntry, raw), 1u << 30, sizeof(uint32_t)}
+	};
+	VDIContainerReader r;
+	check(r.open(path), "opening the container to corrupt");
+	r.close();
+	std::cerr << "(complaints about corrupt indexes expected)" << std::endl;
+	for (size_t d = 0; d < sizeof(damages) / sizeof(damages[0]); ++d) {
+		std::vector<char> was = patch(path, damages[d].offset, &damages[d].value, damages[d].n);
+		check(!r.open(path), std::string("a container with ") + damages[d].what + " was opened");
+		patch(path, damages[d].offset, was.data(), was.size());
+	}
+	check(r.open(path), "opening the repaired container");
+}
+
+int main()
+{
+	std::vector<Frame> frames(FRAMES);
+	for (int f = 0; f < FRAMES; ++f)
+		generate(frames[f], f);
+
+	char path[] = "/tmp/containertestXXXXXX";
+	int fd = mkstemp(path);
+	close(fd);
+	int codecs[] = {CODEC_NONE, CODEC_LZ4, CODEC_ZSTD};
+	for (int c = 0; c < 3; ++c)
+		if (codec_available(codecs[c]))
+			roundtrip(codecs[c], frames, path);
+	corrupt(frames[0], path);
+	unlink(path);
+
+	if (failures == 0)
+		std::cout << "container passed" << std::endl;
+	return failures != 0;
+}
@@ -0,0 +1,143 @@
+// Bit-shuffle elements of every size and back; encode time steps of a float field, a uint16 grid and
+// particle positions with every codec built in, decode them and compare, with keyframes where they are
+// due; check that a decoder that missed a step waits for the next keyframe, and that a step of another
+// size or a forced keyframe starts over; then time a larger field
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#include "DeltaCodec.hpp"
+
+#define STEPS 20
+#define KEYINT 8
+#define NTHREADS 2
+#define CHUNK 4096 // several chunks per step
+#define BIG (1 << 24) // floats in the timed field
+
+int failures = 0;
+
+void check(bool ok, const char *what, const char *name)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << " of " << name << std::endl;
+		++failures;
+	}
+}
+
+void shuffle(int elsize)
+{
+	size_t n = 77;
+	std::vector<uint8_t> v(n * elsize), s(v.size()), back(v.size());
+	for (size_t i = 0; i < v.size(); ++i)
+		v[i] = (i % elsize == 0) ? (uint8_t) (i * 37) : 0; // only the low byte of each element set
+	bitshuffle(v.data(), n, elsize, s.data());
+	bitunshuffle(s.data(), n, elsize, back.data());
+	check(back == v, "bit-shuffling", "elements");
+
+	// the planes of the zero bytes are zero, and bit 0 of the first 8 elements is plane 0
+	bool zeros = true;
+	for (size_t i = n / 8 * 8; i < n / 8 * 8 * elsize; ++i)
+		zeros = zeros && s[i] == 0;
+	uint8_t plane0 = 0;
+	for (int j = 0; j < 8; ++j)
+		plane0 |= (v[j * elsize] & 1) << j;
+	check(zeros && s[0] == plane0, "bit planes", "elements");
+}
+
+// steps of a field, the first of each step produced by make(step, data)
+template <typename T, typename F>
+void stream(const char *name, size_t n, int mode, int codec, F make)
+{
+	DeltaEncoder enc(sizeof(T), codec, 0, KEYINT, NTHREADS, mode, CHUNK);
+	DeltaDecoder dec(NTHREADS);
+	std::vector<T> v(n);
+	std::vector<char> msg(enc.bound(n * sizeof(T)));
+	size_t keybytes = 0, deltabytes = 0;
+
+	for (int step = 0; step < STEPS; ++step) {
+		make(step, v.data());
+		size_t bytes = enc.encode(v.data(), n * sizeof(T), msg.data());
+		const DeltaHeader *h = delta_header(msg.data(), bytes);
+		check(bytes > 0 && h != NULL && h->seq == (uint64_t) step && h->keyframe == (step % KEYINT == 0), "encoding", name);
+		(step % KEYINT == 0 ? keybytes : deltabytes) += bytes;
+
+		// steps 3 and 4 do not reach the decoder, which can only go on at step 8
+		if (step == 3 || step == 4)
+			continue;
+		bool ok = dec.decode(msg.data(), bytes);
+		if (step > 4 && step < KEYINT) {
+			check(!ok, "decoding after a gap", name);
+			continue;
+		}
+		check(ok && dec.step() == (uint64_t) step && dec.size() == n * sizeof(T)
+			&& memcmp(dec.data(), v.data(), n * sizeof(T)) == 0, "decoding", name);
+	}
+
+	// forced keyframes and steps of another size
+	enc.keyframe();
+	size_t bytes = enc.encode(v.data(), n * sizeof(T), msg.data());
+	check(delta_header(msg.data(), bytes)->keyframe && dec.decode(msg.data(), bytes), "forced keyframe", name);
+	bytes = enc.encode(v.data(), (n - 3) * sizeof(T), msg.data());
+	check(delta_header(msg.data(), bytes)->keyframe && dec.decode(msg.data(), bytes)
+		&& memcmp(dec.data(), v.data(), (n - 3) * sizeof(T)) == 0, "resized step", name);
+
+	std::cout << name << " with " << codec_name(codec) << ": keyframes " << (double) keybytes / (STEPS / KEYINT + 1) / (n * sizeof(T))
+		<< ", deltas " << (double) deltabytes / (STEPS - STEPS / KEYINT - 1) / (n * sizeof(T)) << " of the raw size" << std::endl;
+}
+
+int main()
+{
+	for (int elsize = 1; elsize <= 8; elsize *= 2)
+		shuffle(elsize);
+
+	const size_t n = 12345;
+	int codecs[] = {CODEC_NONE, CODEC_LZ4, CODEC_ZSTD};
+	for (int c = 0; c < 3; ++c) {
+		if (!codec_available(codecs[c]))
+			continue;
+		stream<float>("float field", n, DELTA_XOR, codecs[c], [&](int step, float *v) {
+			for (size_t i = 0; i < n; ++i)
+				v[i] = std::sin(0.01f * i) + 0.001f * step * (i % 97 == 0);
+		});
+		stream<uint16_t>("uint16 grid", n, DELTA_SUB, codecs[c], [&](int step, uint16_t *v) {
+			for (size_t i = 0; i < n; ++i)
+				v[i] = (uint16_t) (i * 3 + step * (i % 5));
+		});
+		stream<float>("particle positions", 3 * n, DELTA_XOR, codecs[c], [&](int step, float *v) {
+			for (size_t i = 0; i < 3 * n; ++i)
+				v[i] = (float) (i % 101) + 0.01f * step * (float) (i % 7);
+		});
+	}
+
+	DeltaDecoder dec;
+	const char junk[64] = "not a frame";
+	std::cerr << "(a complaint about a frame expected)" << std::endl;
+	check(!dec.decode(junk, sizeof(junk)), "rejecting", "junk");
+
+	std::vector<float> v(BIG);
+	for (size_t i = 0; i < v.size(); ++i)
+		v[i] = std::sin(0.001f * i);
+	DeltaEncoder enc(sizeof(float), CODEC_NONE, 0, KEYINT, NTHREADS);
+	DeltaDecoder big(NTHREADS);
+	std::vector<char> msg(enc.bound(v.size() * sizeof(float)));
+	enc.encode(v.data(), v.size() * sizeof(float), msg.data());
+	big.decode(msg.data(), msg.size());
+	for (size_t i = 0; i < v.size(); i += 3)
+		v[i] += 1e-3f;
+	auto start = std::chrono::steady_clock::now();
+	size_t bytes = enc.encode(v.data(), v.size() * sizeof(float), msg.data());
+	auto mid = std::chrono::steady_clock::now();
+	check(big.decode(msg.data(), bytes) && memcmp(big.data(), v.data(), v.size() * sizeof(float)) == 0, "decoding", "large field");
+	auto end = std::chrono::steady_clock::now();
+	double mb = v.size() * sizeof(float) / 1e6;
+	std::cout << "delta step of " << mb << " MB encoded at " << mb / std::chrono::duration<double>(mid - start).count()
+		<< " MB/s, decoded at " << mb / std::chrono::duration<double>(end - mid).count() << " MB/s" << std::endl;
+
+	if (failures == 0)
+		std::cout << "delta coding passed" << std::endl;
+	return failures != 0;
+}
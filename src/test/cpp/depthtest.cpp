@@ -0,0 +1,74 @@
+// Quantize synthetic supersegment depths and check the error bound, that empty ones stay exact and that
+// start and end keep their order, then time encoding and decoding
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "DepthCodec.hpp"
+
+#define N (1280*720 + 3) // lists, the last ones not filling a vector
+#define MAXCOUNT 20      // supersegments per list
+
+int main()
+{
+	std::vector<int32_t> prefix(N);
+	std::vector<float> depth;
+	srand(42);
+	for (int l = 0; l < N; ++l) {
+		prefix[l] = (int32_t) (depth.size() / 2);
+		int n = rand() % (MAXCOUNT + 1);
+		float d = 0.1f + 0.8f * rand() / RAND_MAX, len = (l % 7 == 0) ? 0 : 0.05f * rand() / RAND_MAX; // some lists of a single depth
+		for (int k = 0; k < n; ++k) {
+			bool empty = (k == n - 1) && (l % 5 == 0);
+			float start = d + len * k / n, end = d + len * (k + 1) / n;
+			depth.push_back(empty ? 0 : start);
+			depth.push_back(empty ? 0 : end);
+		}
+	}
+	size_t supsegs = depth.size() / 2;
+
+	std::vector<uint16_t> q(depth.size());
+	std::vector<float> ranges(2 * N), out(depth.size(), -1.0f);
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	float bound = quantize_depths(depth.data(), prefix.data(), N, supsegs, q.data(), ranges.data());
+	auto t1 = std::chrono::high_resolution_clock::now();
+	dequantize_depths(q.data(), ranges.data(), prefix.data(), N, supsegs, out.data());
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	int failures = 0;
+	float maxerr = 0;
+	for (int l = 0; l < N; ++l) {
+		size_t first = prefix[l], last = (l + 1 < N) ? prefix[l+1] : supsegs;
+		float listbound = (ranges[2 * l + 1] - ranges[2 * l]) / DEPTH_STEPS / 2 * 1.001f + 1e-7f;
+		for (size_t i = 2 * first; i < 2 * last; ++i) {
+			float err = std::fabs(out[i] - depth[i]);
+			maxerr = std::max(maxerr, err);
+			if ((depth[i] == 0) != (out[i] == 0) || err > listbound) {
+				std::cout << "FAILED: list " << l << " depth " << depth[i] << " came back as " << out[i] << std::endl;
+				++failures;
+			}
+			if (i % 2 == 1 && depth[i] != 0 && out[i] < out[i-1]) {
+				std::cout << "FAILED: list " << l << " supersegment ends before it starts" << std::endl;
+				++failures;
+			}
+		}
+		if (failures > 10)
+			break;
+	}
+	if (maxerr > bound * 1.001f + 1e-7f) {
+		std::cout << "FAILED: largest error " << maxerr << " above the bound " << bound << std::endl;
+		++failures;
+	}
+
+	std::cout << supsegs << " supersegments, largest error " << maxerr << " (bound " << bound << "), encoding "
+		<< std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, decoding "
+		<< std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms" << std::endl;
+	if (failures == 0)
+		std::cout << "depth quantization passed" << std::endl;
+	return failures != 0;
+}
@@ -0,0 +1,219 @@
+// Exchange synthetic dense VDIs between all ranks and check what every rank receives, first with
+// blocking exchanges, then with two exchanges in flight at once, then with tiles assigned by cost,
+// then compressed with each codec built in, then with quantized depths; run with mpirun
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <mpi.h>
+
+#include "VDIExchange.hpp"
+
+#define LISTSPER 1000 // lists per rank, plus a remainder for the last one
+#define FRAMES 4
+#define DEPTH 2       // pipeline depth of the asynchronous run
+#define TILELEN 64
+#define CODEC_CHUNK 4096 // several chunks per message
+#define CODEC_THREADS 2
+
+int rank, size;
+size_t nlists;
+
+struct Frame {
+	std::vector<int32_t> prefix;
+	std::vector<float> color, depth;
+	std::vector<int> counts;
+};
+
+// supersegments rank r generates for list l in frame f, frames grow to exercise reallocation; the first
+// quarter of the screen is busier
+int count(int r, size_t l, int f)
+{
+	return (int) ((l * 7 + r + f) % (5 + 2*f) + (l < nlists / 4 ? 6 : 0));
+}
+
+// colour (source, list, index, frame), depth (list, index)
+void generate(Frame &fr, int f)
+{
+	fr.prefix.resize(nlists);
+	fr.color.clear();
+	fr.depth.clear();
+	fr.counts.assign(size, 0);
+	for (size_t l = 0; l < nlists; ++l) {
+		fr.prefix[l] = (int32_t) (fr.color.size() / 4);
+		for (int k = 0; k < count(rank, l, f); ++k) {
+			float c[] = {(float) rank, (float) l, (float) k, (float) f}, d[] = {(float) l, (float) k};
+			fr.color.insert(fr.color.end(), c, c + 4);
+			fr.depth.insert(fr.depth.end(), d, d + 2);
+		}
+		int owner = (int) (l / (nlists / size));
+		fr.counts[owner < size ? owner : size - 1] += count(rank, l, f);
+	}
+}
+
+// walk the blocks of each source in order; with tiles, prefix sums start at 0 in each block. Depths may be off by tol
+bool check(const VDIExchange &ex, const DenseVDIs &got, int f, float tol = 0)
+{
+	size_t first = ex.first_list(rank, nlists), seg = 0;
+	bool ok = got.lists == (got.tiles ? ex.current_partition()->lists_of(rank) : ex.lists_of(rank, nlists));
+	for (int s = 0; s < size && ok; ++s) {
+		int32_t base = 0;
+		for (size_t l = 0; l < first && !got.tiles; ++l)
+			base += count(s, l, f);
+		for (size_t j = 0; j < got.lists && ok; ++j) {
+			size_t l = got.tiles ? got.tiles[j / got.tilelen] * got.tilelen + j % got.tilelen : first + j;
+			ok = got.prefix[s * got.lists + j] == base;
+			for (int k = 0; k < count(s, l, f) && ok; ++k, ++seg) {
+				float *c = (float *) got.color + 4 * seg, *d = (float *) got.depth + 2 * seg;
+				ok = c[0] == s && c[1] == l && c[2] == k && c[3] == f && std::fabs(d[0] - l) <= tol && std::fabs(d[1] - k) <= tol;
+			}
+			base += count(s, l, f);
+		}
+	}
+	return ok && seg == got.supersegments;
+}
+
+int main(int argc, char **argv)
+{
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	nlists = (size_t) LISTSPER * size + 7;
+	int failures = 0;
+	Frame fr;
+	{
+		VDIExchange ex(MPI_COMM_WORLD);
+		for (int f = 0; f < FRAMES; ++f) {
+			generate(fr, f);
+			if (!check(ex, ex.exchange(fr.color.data(), fr.depth.data(), fr.prefix.data(), nlists, fr.counts.data()), f)) {
+				std::cout << "FAILED: rank " << rank << " frame " << f << std::endl;
+				++failures;
+			}
+		}
+		if (rank == 0)
+			std::cout << "mean blocking exchange time: " << (ex.mean_time(PHASE_POST) + ex.mean_time(PHASE_WAIT)) * 1e3 << " ms" << std::endl;
+	}
+	{
+		// keep DEPTH frames in flight, regenerating into the same send buffers right after each start
+		VDIExchange ex(MPI_COMM_WORLD, DEPTH);
+		std::vector<std::pair<int, int> > inflight; // slot, frame
+		for (int f = 0; f < FRAMES + DEPTH - 1; ++f) {
+			if (f < FRAMES) {
+				generate(fr, f);
+				int s = ex.start(fr.color.data(), fr.depth.data(), fr.prefix.data(), nlists, fr.counts.data());
+				if (s < 0) {
+					std::cout << "FAILED: rank " << rank << " no free slot for frame " << f << std::endl;
+					++failures;
+					break;
+				}
+				inflight.push_back(std::make_pair(s, f));
+				std::fill(fr.color.begin(), fr.color.end(), -1.0f); // staged, must not be seen
+				ex.test(s);
+			}
+			if (inflight.size() == DEPTH || f >= FRAMES) {
+				int g = inflight.front().second;
+				if (!check(ex, ex.wait(inflight.front().first), g)) {
+					std::cout << "FAILED: rank " << rank << " asynchronous frame " << g << std::endl;
+					++failures;
+				}
+				inflight.erase(inflight.begin());
+			}
+		}
+		if (!ex.idle()) {
+			std::cout << "FAILED: rank " << rank << " exchange still in flight" << std::endl;
+			++failures;
+		}
+		if (rank == 0)
+			std::cout << "mean asynchronous exchange time in flight: " << ex.mean_time(PHASE_FLIGHT) * 1e3 << " ms, waiting: " << ex.mean_time(PHASE_WAIT) * 1e3 << " ms" << std::endl;
+	}
+
+	{
+		// tiles assigned by cost must balance better than equal shares
+		VDIExchange ex(MPI_COMM_WORLD, DEPTH);
+		double imbalance[3];
+		for (int method = PARTITION_ROWS; method <= PARTITION_GREEDY; ++method) {
+			ex.set_partition(TILELEN, method);
+			for (int f = 0; f < FRAMES; ++f) {
+				generate(fr, f);
+				int s = ex.start(fr.color.data(), fr.depth.data(), fr.prefix.data(), nlists, fr.counts.data());
+				std::fill(fr.color.begin(), fr.color.end(), -1.0f);
+				if (!check(ex, ex.wait(s), f)) {
+					std::cout << "FAILED: rank " << rank << " tiles by method " << method << " frame " << f << std::endl;
+					++failures;
+				}
+			}
+			imbalance[method] = ex.current_partition()->imbalance();
+		}
+		if (size > 1 && (imbalance[PARTITION_CONTIGUOUS] >= imbalance[PARTITION_ROWS] || imbalance[PARTITION_GREEDY] >= imbalance[PARTITION_ROWS])) {
+			std::cout << "FAILED: rank " << rank << " tiles by cost are not better balanced" << std::endl;
+			++failures;
+		}
+		if (rank == 0)
+			std::cout << "largest load over mean, equal shares: " << imbalance[PARTITION_ROWS] << ", contiguous: " << imbalance[PARTITION_CONTIGUOUS]
+				<< ", greedy: " << imbalance[PARTITION_GREEDY] << std::endl;
+	}
+
+	for (int codec = CODEC_LZ4; codec <= CODEC_ZSTD; ++codec) {
+		// the colours to other ranks are compressed, the depths are below MIN_COMPRESSED and go as is;
+		// with tiles, depths are also quantized
+		VDIExchange ex(MPI_COMM_WORLD, DEPTH);
+		if (!ex.set_compression(codec, 0, CODEC_CHUNK, CODEC_THREADS)) {
+			if (rank == 0)
+				std::cout << codec_name(codec) << " not built in, skipped" << std::endl;
+			continue;
+		}
+		for (int tiled = 0; tiled <= 1; ++tiled) {
+			ex.set_partition(tiled ? TILELEN : 0);
+			ex.set_depth_quantization(tiled);
+			for (int f = 0; f < FRAMES; ++f) {
+				generate(fr, f);
+				int s = ex.start(fr.color.data(), fr.depth.data(), fr.prefix.data(), nlists, fr.counts.data());
+				std::fill(fr.color.begin(), fr.color.end(), -1.0f);
+				while (!ex.test(s))
+					;
+				if (!check(ex, ex.wait(s), f, tiled ? (float) nlists / DEPTH_STEPS / 2 * 1.01f : 0)) {
+					std::cout << "FAILED: rank " << rank << " " << codec_name(codec) << (tiled ? " tiled" : "") << " frame " << f << std::endl;
+					++failures;
+				}
+			}
+		}
+		if (size > 1 && ex.wire_ratio() >= 1.0) {
+			std::cout << "FAILED: rank " << rank << " " << codec_name(codec) << " sent no fewer bytes" << std::endl;
+			++failures;
+		}
+		if (rank == 0)
+			std::cout << codec_name(codec) << ": bytes sent over bytes to send " << ex.wire_ratio() << ", staging and compressing "
+				<< ex.mean_time(PHASE_STAGE) * 1e3 << " ms, in flight " << ex.mean_time(PHASE_FLIGHT) * 1e3 << " ms" << std::endl;
+	}
+
+	{
+		// the depths of a list span at most [0, nlists], and depths of 0 must stay exact
+		VDIExchange ex(MPI_COMM_WORLD, DEPTH);
+		ex.set_depth_quantization(true);
+		float tol = (float) nlists / DEPTH_STEPS / 2 * 1.01f;
+		for (int tiled = 0; tiled <= 1; ++tiled) {
+			ex.set_partition(tiled ? TILELEN : 0);
+			for (int f = 0; f < FRAMES; ++f) {
+				generate(fr, f);
+				int s = ex.start(fr.color.data(), fr.depth.data(), fr.prefix.data(), nlists, fr.counts.data());
+				std::fill(fr.depth.begin(), fr.depth.end(), -1.0f);
+				if (ex.depth_error() > tol || !check(ex, ex.wait(s), f, tol)) {
+					std::cout << "FAILED: rank " << rank << " quantized depths" << (tiled ? " tiled" : "") << " frame " << f << std::endl;
+					++failures;
+				}
+			}
+		}
+		if (rank == 0)
+			std::cout << "quantized depths: largest error " << ex.depth_error() << ", mean exchange time in flight " << ex.mean_time(PHASE_FLIGHT) * 1e3 << " ms" << std::endl;
+	}
+
+	int total;
+	MPI_Reduce(&failures, &total, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+	if (rank == 0 && total == 0)
+		std::cout << "exchange passed" << std::endl;
+	MPI_Finalize();
+	return failures != 0;
+}
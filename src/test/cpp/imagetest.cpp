@@ -0,0 +1,106 @@
+// Composite synthetic images of all ranks with each schedule and compare with blending them serially at
+// the root, in an order that differs from rank order; run with mpirun
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <stdint.h>
+#include <mpi.h>
+
+#include "ImageCompositor.hpp"
+
+#define WIDTH 97  // pixels not divisible by the group sizes
+#define HEIGHT 61
+#define BENCHWIDTH 1280
+#define BENCHHEIGHT 720
+
+int rank, size;
+
+// premultiplied, so colour never exceeds alpha
+void generate(std::vector<uint8_t> &image, int r, size_t pixels)
+{
+	image.resize(pixels * 4);
+	for (size_t i = 0; i < pixels; ++i) {
+		uint8_t a = (uint8_t) ((i * 31 + r * 57) % 256);
+		for (int c = 0; c < 3; ++c)
+			image[4 * i + c] = (uint8_t) ((i * (c + 3) + r * 11) % (a + 1));
+		image[4 * i + 3] = a;
+	}
+}
+
+// a visibility order that is neither rank order nor its reverse
+float distance_of(int r)
+{
+	return (float) ((r * 5 + 3) % size) + 0.5f * (r % 2);
+}
+
+int test(int schedule, int radix)
+{
+	ImageCompositor comp(MPI_COMM_WORLD, WIDTH, HEIGHT, schedule, radix);
+	size_t pixels = WIDTH * HEIGHT;
+	std::vector<uint8_t> image, out(pixels * 4);
+	generate(image, rank, pixels);
+	comp.composite(image.data(), distance_of(rank), out.data());
+
+	if (rank != 0)
+		return 0;
+
+	const std::vector<int> &order = comp.visibility_order();
+	bool sorted = true;
+	for (int p = 1; p < size; ++p)
+		sorted = sorted && distance_of(order[p-1]) <= distance_of(order[p]);
+
+	// blending is associative only up to rounding, one step per round
+	std::vector<uint8_t> ref, next;
+	generate(ref, order[0], pixels);
+	for (int p = 1; p < size; ++p) {
+		generate(next, order[p], pixels);
+		blend_over(ref.data(), next.data(), ref.data(), pixels);
+	}
+	int maxdiff = 0;
+	for (size_t i = 0; i < ref.size(); ++i)
+		maxdiff = std::max(maxdiff, std::abs((int) ref[i] - (int) out[i]));
+
+	if (!sorted || maxdiff > size) {
+		std::cout << "FAILED: schedule " << schedule << " radix " << radix << ", sorted " << sorted << ", largest difference " << maxdiff << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+void benchmark(int schedule)
+{
+	ImageCompositor comp(MPI_COMM_WORLD, BENCHWIDTH, BENCHHEIGHT, schedule);
+	std::vector<uint8_t> image, out(rank == 0 ? (size_t) BENCHWIDTH * BENCHHEIGHT * 4 : 0);
+	generate(image, rank, (size_t) BENCHWIDTH * BENCHHEIGHT);
+	comp.composite(image.data(), distance_of(rank), out.data());
+
+	if (rank == 0) {
+		std::cout << "schedule " << schedule << ", rounds:";
+		for (size_t i = 0; i < comp.rounds().size(); ++i)
+			std::cout << " k=" << comp.rounds()[i] << " " << comp.round_times()[i] * 1e3 << " ms";
+		std::cout << ", gather " << comp.round_times().back() * 1e3 << " ms" << std::endl;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	int failures = 0;
+	failures += test(SCHEDULE_AUTO, RADIX);
+	failures += test(SCHEDULE_DIRECT_SEND, RADIX);
+	failures += test(SCHEDULE_BINARY_SWAP, RADIX);
+	for (int radix = 2; radix <= 8; radix *= 2)
+		failures += test(SCHEDULE_RADIX_K, radix);
+
+	for (int schedule = SCHEDULE_DIRECT_SEND; schedule <= SCHEDULE_RADIX_K; ++schedule)
+		benchmark(schedule);
+
+	if (rank == 0 && failures == 0)
+		std::cout << "image compositing passed" << std::endl;
+	MPI_Finalize();
+	return failures != 0;
+}
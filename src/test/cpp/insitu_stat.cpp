@@ -0,0 +1,132 @@
+// Show the counters of all shared memory producers and consumers on this node, top-style, and
+// reclaim what exited processes left behind; replaces sem_get, sem_reset and remove_shmem
+//
+// insitu_stat [-d dir] [-i ms] [-n samples] [-c] [-r pname:rank]...
+//     -d: read the blocks in dir instead of INSITU_STAT_DIR or /dev/shm
+//     -i: sample every ms milliseconds, 1000 by default
+//     -n: stop after this many samples, 1 if stdout is not a terminal
+//     -c: reclaim the blocks, segments and semaphores of processes that exited, then stop
+//     -r: remove the segments and semaphores of a rank unless a running process uses them, then stop
+//
+// Rates are over the last interval. Waits are those of the producer for its consumers to release and
+// of the consumer for new segments; age is the time since the last frame. The semaphores of each key
+// are shown as consumer/producer value, - if there are none.
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+
+#include "ShmMetrics.hpp"
+
+#define CONSEM 0
+#define PROSEM 1
+
+void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-d dir] [-i ms] [-n samples] [-c] [-r pname:rank]...\n", prog);
+	exit(1);
+}
+
+// the semaphores of key as consumer/producer
+std::string semaphores(int key)
+{
+	int semid = semget(key, 0, 0);
+	if (semid == -1)
+		return "-";
+	char s[32];
+	snprintf(s, sizeof(s), "%d/%d", semctl(semid, CONSEM, GETVAL), semctl(semid, PROSEM, GETVAL));
+	return s;
+}
+
+void show(const std::vector<MetricsSample> &blocks, std::map<std::string, MetricsBlock> &last, double seconds)
+{
+	uint64_t now = metrics_now();
+	printf("%-8s %-8s %-12s %4s %10s %8s %9s %6s %6s %9s %9s %9s %-7s %-7s\n", "PID", "ROLE", "PNAME", "RANK",
+		"FRAMES", "FPS", "MB/S", "FALLBK", "TMOUT", "WAIT MS", "MAX MS", "AGE MS", "KEY 0", "KEY 1");
+
+	std::map<std::string, MetricsBlock> next;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		const MetricsBlock &b = blocks[i].block;
+		const uint64_t *c = b.counters;
+
+		// rates since the last sample of the block, or since it was created
+		std::map<std::string, MetricsBlock>::const_iterator prev = last.find(blocks[i].path);
+		double frames = c[METRIC_FRAMES], bytes = c[METRIC_BYTES], span = (now - b.created) / 1e9;
+		if (prev != last.end() && seconds > 0) {
+			frames -= prev->second.counters[METRIC_FRAMES];
+			bytes -= prev->second.counters[METRIC_BYTES];
+			span = seconds;
+		}
+		next[blocks[i].path] = b;
+
+		char age[32] = "-";
+		if (c[METRIC_LAST_FRAME] != 0)
+			snprintf(age, sizeof(age), "%.1f", (now - c[METRIC_LAST_FRAME]) / 1e6);
+		double wait = c[METRIC_WAITS] ? c[METRIC_WAIT_NS] / 1e6 / c[METRIC_WAITS] : 0;
+		printf("%-8d %-8s %-12.12s %4d %10llu %8.1f %9.1f %6llu %6llu %9.2f %9.2f %9s %-7s %-7s%s\n", b.pid,
+			b.role == METRICS_PRODUCER ? "producer" : "consumer", b.pname, b.rank, (unsigned long long) c[METRIC_FRAMES],
+			span > 0 ? frames / span : 0, span > 0 ? bytes / span / 1e6 : 0, (unsigned long long) c[METRIC_FALLBACKS],
+			(unsigned long long) c[METRIC_TIMEOUTS], wait, c[METRIC_MAX_WAIT_NS] / 1e6, age, semaphores(b.keys[0]).c_str(),
+			semaphores(b.keys[1]).c_str(), blocks[i].alive ? "" : " exited");
+	}
+	last.swap(next);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir = metrics_dir();
+	long interval = 1000, samples = isatty(STDOUT_FILENO) ? -1 : 1;
+	bool clean = false;
+	std::vector<std::string> ranks;
+	int opt;
+	while ((opt = getopt(argc, argv, "d:i:n:cr:")) != -1) {
+		switch (opt) {
+		case 'd': dir = optarg; break;
+		case 'i': interval = atol(optarg); break;
+		case 'n': samples = atol(optarg); break;
+		case 'c': clean = true; break;
+		case 'r': ranks.push_back(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (interval <= 0)
+		usage(argv[0]);
+
+	if (clean || !ranks.empty()) {
+		bool ok = true;
+		if (clean)
+			printf("%d blocks of exited processes reclaimed\n", metrics_reclaim(dir, stdout));
+		for (size_t i = 0; i < ranks.size(); ++i) {
+			size_t colon = ranks[i].rfind(':');
+			if (colon == std::string::npos)
+				usage(argv[0]);
+			ok = metrics_reclaim_rank(dir, ranks[i].substr(0, colon), atoi(ranks[i].c_str() + colon + 1), stdout) && ok;
+		}
+		return ok ? 0 : 1;
+	}
+
+	std::map<std::string, MetricsBlock> last;
+	uint64_t then = 0;
+	for (long n = 0; samples < 0 || n < samples; ++n) {
+		if (n > 0)
+			usleep(interval * 1000);
+		std::vector<MetricsSample> blocks;
+		if (!metrics_scan(dir, blocks)) {
+			perror(dir);
+			return 1;
+		}
+		uint64_t now = metrics_now();
+		if (isatty(STDOUT_FILENO))
+			printf("\033[H\033[2J");
+		show(blocks, last, then ? (now - then) / 1e9 : 0);
+		fflush(stdout);
+		then = now;
+	}
+	return 0;
+}
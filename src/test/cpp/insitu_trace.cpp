@@ -0,0 +1,185 @@
+// Merge the trace segments of all processes on this node into one Chrome trace / Perfetto JSON file,
+// to open in chrome://tracing or ui.perfetto.dev
+//
+// insitu_trace [-o file] [-d dir] [-c]
+//     -o: write to file instead of stdout
+//     -d: read the segments in dir instead of INSITU_TRACE_DIR or /dev/shm
+//     -c: remove the segments of processes that have exited once they are written
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "TraceRecorder.hpp"
+
+void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-o file] [-d dir] [-c]\n", prog);
+	exit(1);
+}
+
+void quoted(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s != '\0'; ++s) {
+		unsigned char c = (unsigned char) *s;
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(out, "\\u%04x", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+// ns to the us of the format, keeping the ns as decimals
+void micros(FILE *out, uint64_t ns)
+{
+	fprintf(out, "%llu.%03u", (unsigned long long) (ns / 1000), (unsigned) (ns % 1000));
+}
+
+struct Writer {
+	FILE *out;
+	bool first;
+
+	void begin()
+	{
+		fprintf(out, "%s\n", first ? "" : ",");
+		first = false;
+	}
+
+	void metadata(const char *what, int pid, uint32_t tid, const char *name)
+	{
+		begin();
+		fprintf(out, "{\"ph\":\"M\",\"name\":\"%s\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", what, pid, tid);
+		quoted(out, name);
+		fprintf(out, "}}");
+	}
+
+	void event(const TraceHeader *h, uint32_t tid, const TraceEvent &e)
+	{
+		const char *name = trace_segment_name(h, e.name);
+		begin();
+		fprintf(out, "{\"name\":");
+		quoted(out, name);
+		fprintf(out, ",\"pid\":%d,\"tid\":%u,\"ts\":", h->pid, tid);
+		micros(out, e.start);
+		switch (e.kind) {
+		case TRACE_SPAN_EVENT:
+			fprintf(out, ",\"ph\":\"X\",\"dur\":");
+			micros(out, e.duration);
+			fprintf(out, ",\"args\":{\"payload\":%lld}}", (long long) e.payload);
+			break;
+		case TRACE_INSTANT_EVENT:
+			fprintf(out, ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"payload\":%lld}}", (long long) e.payload);
+			break;
+		default:
+			fprintf(out, ",\"ph\":\"C\",\"args\":{");
+			quoted(out, name);
+			fprintf(out, ":%lld}}", (long long) e.payload);
+		}
+	}
+};
+
+bool by_start(const TraceEvent &a, const TraceEvent &b)
+{
+	return a.start < b.start;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *file = NULL, *dir = trace_dir();
+	bool clean = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:d:c")) != -1) {
+		switch (opt) {
+		case 'o': file = optarg; break;
+		case 'd': dir = optarg; break;
+		case 'c': clean = true; break;
+		default: usage(argv[0]);
+		}
+	}
+
+	DIR *d = opendir(dir);
+	if (d == NULL) {
+		perror(dir);
+		return 1;
+	}
+	std::vector<std::string> paths;
+	for (struct dirent *entry; (entry = readdir(d)) != NULL; )
+		if (strncmp(entry->d_name, TRACE_PREFIX, strlen(TRACE_PREFIX)) == 0)
+			paths.push_back(std::string(dir) + "/" + entry->d_name);
+	closedir(d);
+	std::sort(paths.begin(), paths.end());
+
+	Writer w = {stdout, true};
+	if (file != NULL && (w.out = fopen(file, "w")) == NULL) {
+		perror(file);
+		return 1;
+	}
+	fprintf(w.out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	size_t segments = 0, events = 0;
+	uint64_t lost = 0;
+	for (size_t p = 0; p < paths.size(); ++p) {
+		int fd = open(paths[p].c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			perror(paths[p].c_str());
+			if (fd >= 0)
+				close(fd);
+			continue;
+		}
+		void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		const TraceHeader *h = (base == MAP_FAILED) ? NULL : trace_segment(base, st.st_size);
+		if (h == NULL) {
+			fprintf(stderr, "%s: not a trace segment\n", paths[p].c_str());
+			if (base != MAP_FAILED)
+				munmap(base, st.st_size);
+			continue;
+		}
+
+		char process[sizeof(h->process) + 1] = {0};
+		memcpy(process, h->process, sizeof(h->process));
+		w.metadata("process_name", h->pid, 0, process);
+		uint32_t nrings = std::min(__atomic_load_n(&h->rings, __ATOMIC_ACQUIRE), h->nrings);
+		std::vector<TraceEvent> ring;
+		for (uint32_t r = 0; r < nrings; ++r) {
+			const TraceRing *tr = trace_segment_ring(h, r);
+			char thread[32];
+			snprintf(thread, sizeof(thread), "thread %u", tr->tid);
+			w.metadata("thread_name", h->pid, tr->tid, thread);
+
+			ring.clear();
+			lost += trace_snapshot(tr, h->nevents, ring);
+			std::stable_sort(ring.begin(), ring.end(), by_start); // spans are written when they end
+			for (size_t i = 0; i < ring.size(); ++i)
+				w.event(h, tr->tid, ring[i]);
+			events += ring.size();
+		}
+		bool exited = kill(h->pid, 0) != 0 && errno == ESRCH;
+		munmap(base, st.st_size);
+		++segments;
+
+		if (clean && exited && unlink(paths[p].c_str()) != 0)
+			perror(paths[p].c_str());
+	}
+
+	fprintf(w.out, "\n]}\n");
+	if (file != NULL)
+		fclose(w.out);
+	fprintf(stderr, "%zu events of %zu processes, %llu overwritten\n", events, segments, (unsigned long long) lost);
+	return 0;
+}
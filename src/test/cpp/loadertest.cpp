@@ -0,0 +1,78 @@
+// Write a raw volume file, load it by mapping and by reading with several threads, with and without
+// O_DIRECT, and check that every byte arrives; a file shorter than asked for must fail
+
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "RawVolumeLoader.hpp"
+
+#define BYTES (48 * 1024 * 1024 + 1234) // not a multiple of the alignment
+#define REQUEST (1 << 20)
+#define NTHREADS 4
+
+int failures = 0;
+
+void check(bool ok, const char *what)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+uint8_t voxel(size_t i)
+{
+	return (uint8_t) ((i * 2654435761u) >> 13);
+}
+
+bool intact(const void *ptr, size_t bytes)
+{
+	const uint8_t *p = (const uint8_t *) ptr;
+	for (size_t i = 0; i < bytes; ++i)
+		if (p[i] != voxel(i))
+			return false;
+	return true;
+}
+
+int main()
+{
+	char path[] = "/tmp/loadertestXXXXXX";
+	int fd = mkstemp(path);
+	std::vector<uint8_t> data(BYTES);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = voxel(i);
+	check(fd >= 0 && write(fd, data.data(), data.size()) == (ssize_t) data.size(), "writing the volume");
+	close(fd);
+
+	void *mapped = map_volume(path, BYTES, ADVISE_SEQUENTIAL, 0);
+	check(mapped != NULL && intact(mapped, BYTES), "mapped");
+	check(mapped != NULL && advise_volume(mapped, 12345, 1 << 20, ADVISE_WILLNEED), "read-ahead hint");
+	release_volume(mapped);
+
+	void *touched = map_volume(path, BYTES, ADVISE_NORMAL, NTHREADS);
+	check(touched != NULL && intact(touched, BYTES), "mapped and faulted in");
+	if (touched != NULL)
+		((uint8_t *) touched)[0] ^= 1; // private, must not reach the file
+	release_volume(touched);
+
+	void *read = read_volume(path, BYTES, NTHREADS, REQUEST, false);
+	check(read != NULL && intact(read, BYTES), "read");
+	release_volume(read);
+
+	void *direct = read_volume(path, BYTES, NTHREADS, REQUEST, true);
+	check(direct != NULL && intact(direct, BYTES), "read with O_DIRECT");
+	release_volume(direct);
+
+	std::cerr << "(two complaints about a short file expected)" << std::endl;
+	check(map_volume(path, BYTES + 1) == NULL, "mapping past the end of the file");
+	check(read_volume(path, BYTES + 1) == NULL, "reading past the end of the file");
+
+	unlink(path);
+	if (failures == 0)
+		std::cout << "raw volume loading passed" << std::endl;
+	return failures != 0;
+}
@@ -0,0 +1,107 @@
+// Compute macro cells of bricks of every type, with sizes that do not divide into whole cells, and
+// compare min, max and occupancy under a transfer function with a transparent range against a direct
+// computation over each cell's voxels; then time a larger brick
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdint.h>
+
+#include "MacroCells.hpp"
+#include "BrickPublisher.hpp"
+
+#define NTHREADS 3
+#define TFLEN 64
+#define BIG 256 // voxels along each axis of the timed brick
+
+int failures = 0;
+
+template <typename T>
+T voxel(size_t x, size_t y, size_t z)
+{
+	return (T) (((x * 7 + y * 13 + z * 29) * 2654435761u >> 11) % 200) - (T) 50 * (std::numeric_limits<T>::min() < 0);
+}
+
+template <typename T>
+void run(int dtype, const char *name, const int dims[3], int cellsize)
+{
+	std::vector<T> v((size_t) dims[0] * dims[1] * dims[2]);
+	for (int z = 0; z < dims[2]; ++z)
+		for (int y = 0; y < dims[1]; ++y)
+			for (int x = 0; x < dims[0]; ++x)
+				v[((size_t) z * dims[1] + y) * dims[0] + x] = voxel<T>(x, y, z);
+
+	int cells[3];
+	size_t n = macro_grid_dims(dims, cellsize, cells);
+	std::vector<float> minmax(2 * n);
+	if (!macro_minmax(v.data(), dtype, dims, cellsize, minmax.data(), NTHREADS)) {
+		std::cout << "FAILED: " << name << " not supported" << std::endl;
+		++failures;
+		return;
+	}
+
+	// opaque only between 60 and 90
+	std::vector<float> alpha(TFLEN);
+	float lo = -50, hi = 200;
+	for (int i = 0; i < TFLEN; ++i) {
+		float value = lo + (hi - lo) * i / (TFLEN - 1);
+		alpha[i] = (value >= 60 && value <= 90) ? 0.5f : 0;
+	}
+	std::vector<uint8_t> occupied(n);
+	size_t count = macro_occupancy(minmax.data(), n, alpha.data(), TFLEN, lo, hi, occupied.data());
+
+	bool ok = true;
+	size_t expected_count = 0;
+	for (int cz = 0; cz < cells[2]; ++cz) for (int cy = 0; cy < cells[1]; ++cy) for (int cx = 0; cx < cells[0]; ++cx) {
+		size_t c = ((size_t) cz * cells[1] + cy) * cells[0] + cx;
+		T mn = voxel<T>(cx * cellsize, cy * cellsize, cz * cellsize), mx = mn;
+		for (int z = cz * cellsize; z <= std::min(cz * cellsize + cellsize, dims[2] - 1); ++z)
+			for (int y = cy * cellsize; y <= std::min(cy * cellsize + cellsize, dims[1] - 1); ++y)
+				for (int x = cx * cellsize; x <= std::min(cx * cellsize + cellsize, dims[0] - 1); ++x) {
+					T t = voxel<T>(x, y, z);
+					mn = std::min(mn, t);
+					mx = std::max(mx, t);
+				}
+		ok = ok && minmax[2*c] == (float) mn && minmax[2*c+1] == (float) mx;
+		// a cell is visible if it reaches past the transparent entries next to the opaque range
+		float step = (hi - lo) / (TFLEN - 1);
+		bool visible = (float) mx > 60 - step && (float) mn < 90 + step;
+		bool sure = (float) mx >= 60 && (float) mn <= 90;
+		ok = ok && (occupied[c] || !sure) && (!occupied[c] || visible);
+		expected_count += occupied[c];
+	}
+	if (!ok || count != expected_count) {
+		std::cout << "FAILED: macro cells of " << name << " bricks" << std::endl;
+		++failures;
+	}
+}
+
+int main()
+{
+	int shapes[][3] = {{37, 20, 9}, {1, 17, 16}, {64, 33, 2}};
+	int sizes[] = {8, 4, 16};
+	for (int s = 0; s < 3; ++s) {
+		run<uint8_t>(BRICK_UINT8, "uint8", shapes[s], sizes[s]);
+		run<uint16_t>(BRICK_UINT16, "uint16", shapes[s], sizes[s]);
+		run<int16_t>(BRICK_INT16, "int16", shapes[s], sizes[s]);
+		run<float>(BRICK_FLOAT32, "float", shapes[s], sizes[s]);
+		run<double>(BRICK_FLOAT64, "double", shapes[s], sizes[s]);
+	}
+
+	int big[] = {BIG, BIG, BIG}, cells[3];
+	std::vector<uint16_t> v((size_t) BIG * BIG * BIG);
+	for (size_t i = 0; i < v.size(); ++i)
+		v[i] = (uint16_t) (i * 2654435761u >> 16);
+	std::vector<float> minmax(2 * macro_grid_dims(big, MACRO_CELL, cells));
+	auto start = std::chrono::steady_clock::now();
+	macro_minmax(v.data(), BRICK_UINT16, big, MACRO_CELL, minmax.data(), NTHREADS);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << BIG << "^3 uint16 voxels into " << cells[0] << "^3 macro cells in " << ms << " ms" << std::endl;
+
+	if (failures == 0)
+		std::cout << "macro cells passed" << std::endl;
+	return failures != 0;
+}
@@ -0,0 +1,179 @@
+// Publish frames with a ShmAllocator to a ShmBuffer on another thread and check the counters of both
+// blocks, a heap fallback and a timeout included, and that the blocks go with their objects; then let
+// child processes exit without cleaning up, as a producer and as a consumer holding a key of ours,
+// and check that metrics_reclaim removes what they left behind and only that
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/sem.h>
+#include <sys/wait.h>
+
+#include "ShmAllocator.hpp"
+#include "ShmBuffer.hpp"
+#include "ShmMetrics.hpp"
+
+#define PNAME "/tmp"
+#define RANK 16       // the streaming test
+#define ORPHAN 17     // the producer that exits
+#define HELD 18       // the producer whose consumer exits
+#define LOOSE 19      // semaphores without a block
+#define STEPS 10
+#define SIZE 100000
+#define FREEWAIT 20000 // us for the allocator to delete released segments before the next step
+
+int failures = 0;
+
+void check(bool ok, const char *what)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+const MetricsBlock *find(const std::vector<MetricsSample> &blocks, int pid, int role, int rank)
+{
+	for (size_t i = 0; i < blocks.size(); ++i)
+		if (blocks[i].block.pid == pid && blocks[i].block.role == role && blocks[i].block.rank == rank)
+			return &blocks[i].block;
+	return NULL;
+}
+
+bool key_exists(int key)
+{
+	return semget(key, 0, 0) != -1 || shmget(key, 0, 0) != -1;
+}
+
+void stream(const char *dir)
+{
+	ShmAllocator alloc(PNAME, RANK);
+	std::atomic<long> consumed(0);
+	size_t bytes = 0;
+	void *extra = NULL;
+
+	std::thread consumer([&]() {
+		ShmBuffer buf(PNAME, RANK, SIZE, false); // at most the size of any segment
+		for (long step = 1; step <= STEPS; ++step) {
+			buf.update_key();
+			volatile long *p = (volatile long *) buf.attach();
+			while (p[0] == 0)
+				usleep(100); // published before it is written
+			check(p[0] == step, "frame contents");
+			if (step > 1)
+				buf.detach(false);
+			consumed = step;
+		}
+		check(!buf.try_update_key(1000), "timing out");
+
+		std::vector<MetricsSample> blocks;
+		metrics_scan(dir, blocks);
+		const MetricsBlock *b = find(blocks, getpid(), METRICS_CONSUMER, RANK);
+		check(b != NULL && b->counters[METRIC_FRAMES] == STEPS && b->counters[METRIC_RELEASES] == STEPS - 1
+			&& b->counters[METRIC_BYTES] == STEPS * SIZE + STEPS * (STEPS + 1) / 2 && b->counters[METRIC_TIMEOUTS] == 1 && b->counters[METRIC_WAITS] == STEPS + 1
+			&& b->held == (1u << buf.key()) && b->counters[METRIC_LAST_FRAME] != 0, "consumer counters");
+		buf.detach(true);
+		consumed = STEPS + 1;
+	});
+
+	void *prev = NULL;
+	for (long step = 1; step <= STEPS; ++step) {
+		size_t size = SIZE + step;
+		long *p = (long *) alloc.shm_alloc(size);
+		p[0] = step;
+		bytes += size;
+		if (step == STEPS)
+			extra = alloc.shm_alloc(SIZE); // both keys in use, from the heap
+		alloc.shm_free(prev);
+		prev = p;
+		while (consumed < step)
+			usleep(1000);
+		usleep(FREEWAIT);
+	}
+
+	while (consumed <= STEPS)
+		usleep(1000);
+
+	std::vector<MetricsSample> blocks;
+	check(metrics_scan(dir, blocks), "scanning");
+	const MetricsBlock *b = find(blocks, getpid(), METRICS_PRODUCER, RANK);
+	check(b != NULL && b->counters[METRIC_FRAMES] == STEPS && b->counters[METRIC_BYTES] == bytes
+		&& b->counters[METRIC_FALLBACKS] == 1 && b->counters[METRIC_RELEASES] == STEPS - 1
+		&& b->counters[METRIC_WAITS] == STEPS - 1 && b->counters[METRIC_MAX_WAIT_NS] * (STEPS - 1) >= b->counters[METRIC_WAIT_NS],
+		"producer counters");
+
+	alloc.shm_free(extra);
+	alloc.shm_free(prev);
+	consumer.join();
+}
+
+void orphans(const char *dir)
+{
+	// children that exit without destructors, before any thread is started
+	pid_t child = fork();
+	if (child == 0) {
+		ShmAllocator *alloc = new ShmAllocator(PNAME, ORPHAN);
+		alloc->shm_alloc(SIZE);
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+
+	ShmAllocator held(PNAME, HELD);
+	void *p = held.shm_alloc(SIZE);
+	child = fork();
+	if (child == 0) {
+		ShmBuffer *buf = new ShmBuffer(PNAME, HELD, SIZE, false);
+		buf->update_key();
+		buf->attach();
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+	int orphan[NKEYS], keys[NKEYS], loose[NKEYS];
+	metrics_keys(PNAME, ORPHAN, orphan);
+	metrics_keys(PNAME, HELD, keys);
+	metrics_keys(PNAME, LOOSE, loose);
+	{
+		SemManager sems(PNAME, LOOSE, false, false); // leaves its semaphores
+	}
+
+	std::vector<MetricsSample> blocks;
+	metrics_scan(dir, blocks);
+	check(blocks.size() == 3 && find(blocks, child, METRICS_CONSUMER, HELD) != NULL
+		&& semctl(semget(keys[0], 0, 0), 0, GETVAL) == 1 && key_exists(orphan[0]), "blocks of exited processes");
+	check(!metrics_reclaim_rank(dir, PNAME, HELD, NULL), "keeping the keys of a running producer");
+	check(metrics_reclaim(dir, NULL) == 2, "reclaiming");
+	check(!key_exists(orphan[0]) && !key_exists(orphan[1]) && key_exists(keys[0]) && semctl(semget(keys[0], 0, 0), 0, GETVAL) == 0,
+		"what exited processes left behind");
+	blocks.clear();
+	metrics_scan(dir, blocks);
+	check(blocks.size() == 1 && blocks[0].alive, "blocks of running processes");
+	check(key_exists(loose[0]) && metrics_reclaim_rank(dir, PNAME, LOOSE, NULL) && !key_exists(loose[0]) && !key_exists(loose[1]),
+		"removing the keys of a rank");
+	held.shm_free(p); // returns at once now that the consumer's hold is gone
+}
+
+int main()
+{
+	char dir[] = "/tmp/metricstestXXXXXX";
+	check(mkdtemp(dir) != NULL, "making a directory");
+	setenv("INSITU_STAT_DIR", dir, 1);
+
+	orphans(dir);
+	stream(dir);
+	std::vector<MetricsSample> blocks;
+	metrics_scan(dir, blocks);
+	check(blocks.empty(), "removing blocks with their objects");
+
+	rmdir(dir);
+	if (failures == 0)
+		std::cout << "metrics passed" << std::endl;
+	return failures != 0;
+}
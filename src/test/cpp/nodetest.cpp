@@ -0,0 +1,139 @@
+// Exchange synthetic dense VDIs through the node-aware exchange, once with the ranks grouped by node and
+// once in pairs as if every two ranks were a node, and check that every rank receives, from each node,
+// the supersegments of all its ranks for its lists; then check that pre-compositing a node's sub-VDIs
+// into fewer supersegments cuts the bytes sent between nodes. Run with mpirun -np 4.
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <mpi.h>
+
+#include "NodeExchange.hpp"
+
+#define HEIGHT 64
+#define COLUMNS 16   // per rank
+#define MAXCOUNT 3   // supersegments per rank and list, few enough to come through unmerged
+#define OUTSUPSEGS 16
+#define HEAVY 12     // supersegments per rank and list in the byte count
+#define NTHREADS 2
+#define TOL 1e-3
+
+int rank, size;
+
+int count(int r, size_t l)
+{
+	return (int) ((l + r) % (MAXCOUNT + 1));
+}
+
+// supersegment k of rank r: disjoint from all others, with a gap after it
+float start(int r, int k, size_t l)
+{
+	return 0.1f + 0.01f * (l % 5) + 0.02f * (MAXCOUNT * r + k);
+}
+
+void generate(std::vector<float> &color, std::vector<float> &depth, std::vector<int32_t> &prefix, size_t nlists, int heavy)
+{
+	color.clear();
+	depth.clear();
+	prefix.resize(nlists);
+	for (size_t l = 0; l < nlists; ++l) {
+		prefix[l] = (int32_t) (depth.size() / 2);
+		int n = heavy ? heavy : count(rank, l);
+		for (int k = 0; k < n; ++k) {
+			float s = heavy ? 0.1f + 0.8f * (heavy * rank + k) / (heavy * size) : start(rank, k, l);
+			float c[] = {0.1f + 0.2f * rank, 0.1f * k, (float) (l % 3) / 3, 0.5f}, d[] = {s, s + 0.01f};
+			color.insert(color.end(), c, c + 4);
+			depth.insert(depth.end(), d, d + 2);
+		}
+	}
+}
+
+// every node's block holds the supersegments of its ranks for each of our lists, in depth order
+bool check(const NodeExchange &ex, const DenseVDIs &got, size_t nlists, int pernode)
+{
+	size_t first = ex.first_list(rank, nlists), seg = 0;
+	bool ok = got.lists == ex.lists_of(rank, nlists) && ex.sources() == size / pernode;
+	const float *c = (const float *) got.color, *d = (const float *) got.depth;
+	for (int m = 0; m < ex.sources() && ok; ++m) {
+		const int32_t *p = got.prefix + m * got.lists;
+		for (size_t j = 0; j < got.lists && ok; ++j) {
+			int n = (j + 1 < got.lists) ? p[j+1] - p[j] : got.recvsupsegs[m] - (p[j] - p[0]);
+			size_t l = first + j;
+			int expected = 0;
+			for (int r = m * pernode; r < (m + 1) * pernode; ++r) {
+				for (int k = 0; k < count(r, l) && ok; ++k, ++expected, ++seg) {
+					float s = start(r, k, l);
+					ok = expected < n && d[2 * seg] == s && d[2 * seg + 1] == s + 0.01f
+						&& std::fabs(c[4 * seg] - (0.1f + 0.2f * r)) < TOL && std::fabs(c[4 * seg + 1] - 0.1f * k) < TOL
+						&& std::fabs(c[4 * seg + 3] - 0.5f) < TOL;
+				}
+			}
+			ok = ok && n == expected;
+		}
+	}
+	return ok && seg == got.supersegments;
+}
+
+int run(int ranks_per_node, const CompositeView &view, size_t nlists)
+{
+	int failures = 0;
+	NodeExchange ex(MPI_COMM_WORLD, ranks_per_node, NTHREADS);
+	int pernode = ranks_per_node > 0 ? ranks_per_node : ex.node_size();
+	std::vector<float> color, depth;
+	std::vector<int32_t> prefix;
+
+	generate(color, depth, prefix, nlists, 0);
+	DenseVDIs got = ex.exchange(color.data(), depth.data(), prefix.data(), nlists, depth.size() / 2, view, OUTSUPSEGS);
+	if (!check(ex, got, nlists, pernode)) {
+		std::cout << "FAILED: rank " << rank << " with " << pernode << " ranks per node received wrong supersegments" << std::endl;
+		++failures;
+	}
+
+	// twice the node's ranks' supersegments per list into half as many
+	generate(color, depth, prefix, nlists, HEAVY);
+	ex.exchange(color.data(), depth.data(), prefix.data(), nlists, depth.size() / 2, view, HEAVY);
+	unsigned long long bytes[] = {ex.internode_bytes(), ex.flat_internode_bytes()}, totals[2];
+	MPI_Allreduce(bytes, totals, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	double ratio = totals[1] ? (double) totals[0] / totals[1] : 1.0;
+	if (ex.sources() > 1 && pernode > 1 && ratio > 0.75) {
+		std::cout << "FAILED: rank " << rank << " sent " << ratio << " of the flat exchange's bytes between nodes" << std::endl;
+		++failures;
+	}
+	if (rank == 0) {
+		const double *t = ex.last_times();
+		std::cout << ex.sources() << " nodes of " << pernode << " ranks: bytes between nodes over flat " << ratio
+			<< ", share " << t[NODE_SHARE] * 1e3 << " ms, composite " << t[NODE_COMPOSITE] * 1e3 << " ms, exchange "
+			<< t[NODE_EXCHANGE] * 1e3 << " ms, scatter " << t[NODE_SCATTER] * 1e3 << " ms" << std::endl;
+	}
+	return failures;
+}
+
+int main(int argc, char **argv)
+{
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	CompositeView view;
+	view.width = COLUMNS * size;
+	view.height = HEIGHT;
+	view.first_list = 0;
+	view.tiles = NULL;
+	view.tilelen = 0;
+	memset(view.invViewProjection, 0, sizeof(view.invViewProjection));
+	for (int i = 0; i < 4; ++i)
+		view.invViewProjection[5 * i] = 1.0f;
+	size_t nlists = (size_t) view.width * view.height;
+
+	int failures = run(0, view, nlists);
+	if (size % 2 == 0)
+		failures += run(2, view, nlists);
+
+	int total;
+	MPI_Reduce(&failures, &total, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+	if (rank == 0 && total == 0)
+		std::cout << "node exchange passed" << std::endl;
+	MPI_Finalize();
+	return failures != 0;
+}
@@ -0,0 +1,110 @@
+// Exchange synthetic fixed-size VDIs, mostly empty, packed and check that every rank receives the slabs of
+// all others intact and that fewer bytes were sent; run with mpirun
+
+#include <iostream>
+#include <vector>
+#include <mpi.h>
+
+#include "VDIPacking.hpp"
+
+#define LISTSPER 4096 // lists per rank
+#define MAXSUPSEGS 8
+#define NTHREADS 2
+
+int rank, size;
+
+// supersegments rank r generated for list l: a quarter of the lists, in runs, some full and some with a gap
+int count(int r, size_t l)
+{
+	if ((l / 37 + r) % 4 != 0)
+		return 0;
+	return (int) ((l * 3 + r) % (MAXSUPSEGS + 1));
+}
+
+void generate(std::vector<float> &color, std::vector<float> &depth, size_t nlists)
+{
+	color.assign(nlists * MAXSUPSEGS * 4, 0.0f);
+	depth.assign(nlists * MAXSUPSEGS * 2, 0.0f);
+	for (size_t l = 0; l < nlists; ++l) {
+		int n = count(rank, l);
+		for (int k = 0; k < n; ++k) {
+			float *c = &color[(l * MAXSUPSEGS + k) * 4], *d = &depth[(l * MAXSUPSEGS + k) * 2];
+			c[0] = (float) rank; c[1] = (float) l; c[2] = (float) k; c[3] = 0.5f;
+			d[0] = 1.0f + l; d[1] = 1.0f + k;
+		}
+		// junk after a gap is not part of the list
+		if (n > 0 && n < MAXSUPSEGS - 1) {
+			color[(l * MAXSUPSEGS + n + 1) * 4] = 7.0f;
+			depth[(l * MAXSUPSEGS + n + 1) * 2] = 7.0f;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	size_t nlists = (size_t) LISTSPER * size;
+	std::vector<float> color, depth;
+	generate(color, depth, nlists);
+
+	int failures = 0;
+	SparseVDIExchange ex(MPI_COMM_WORLD, NTHREADS);
+	ex.exchange(color.data(), depth.data(), nlists, MAXSUPSEGS);
+
+	size_t lists = ex.lists_per_source();
+	bool ok = lists == LISTSPER;
+	for (int s = 0; s < size && ok; ++s) {
+		for (size_t j = 0; j < lists && ok; ++j) {
+			size_t l = rank * lists + j;
+			for (int k = 0; k < MAXSUPSEGS && ok; ++k) {
+				const float *c = ex.set_color() + ((s * lists + j) * MAXSUPSEGS + k) * 4, *d = ex.set_depth() + ((s * lists + j) * MAXSUPSEGS + k) * 2;
+				if (k < count(s, l))
+					ok = c[0] == s && c[1] == l && c[2] == k && c[3] == 0.5f && d[0] == 1.0f + l && d[1] == 1.0f + k;
+				else
+					ok = c[0] == 0 && c[3] == 0 && d[0] == 0 && d[1] == 0;
+			}
+		}
+	}
+	if (!ok) {
+		std::cout << "FAILED: rank " << rank << " received slabs differ" << std::endl;
+		++failures;
+	}
+
+	// our own share, as a dense VDI
+	std::vector<char> packed(packed_bound(lists, MAXSUPSEGS));
+	pack_vdi(color.data() + rank * lists * MAXSUPSEGS * 4, depth.data() + rank * lists * MAXSUPSEGS * 2, lists, MAXSUPSEGS, packed.data());
+	std::vector<int32_t> counts(lists);
+	std::vector<float> densecolor(lists * MAXSUPSEGS * 4), densedepth(lists * MAXSUPSEGS * 2);
+	size_t supsegs = unpack_dense(packed.data(), lists, counts.data(), densecolor.data(), densedepth.data()), seg = 0;
+	ok = true;
+	for (size_t j = 0; j < lists && ok; ++j) {
+		size_t l = rank * lists + j;
+		ok = counts[j] == count(rank, l);
+		for (int k = 0; k < counts[j] && ok; ++k, ++seg)
+			ok = densecolor[4 * seg + 1] == l && densecolor[4 * seg + 2] == k && densedepth[2 * seg] == 1.0f + l;
+	}
+	if (!ok || seg != supsegs) {
+		std::cout << "FAILED: rank " << rank << " dense unpacking" << std::endl;
+		++failures;
+	}
+
+	if (size > 1 && ex.packed_ratio() >= 0.5) {
+		std::cout << "FAILED: rank " << rank << " sent " << ex.packed_ratio() << " of the slab" << std::endl;
+		++failures;
+	}
+	if (rank == 0) {
+		const double *t = ex.last_times();
+		std::cout << "bytes sent over slab bytes: " << ex.packed_ratio() << ", pack " << t[PACKING_PACK] * 1e3 << " ms, exchange "
+			<< t[PACKING_EXCHANGE] * 1e3 << " ms, unpack " << t[PACKING_UNPACK] * 1e3 << " ms" << std::endl;
+	}
+
+	int total;
+	MPI_Reduce(&failures, &total, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+	if (rank == 0 && total == 0)
+		std::cout << "packing passed" << std::endl;
+	MPI_Finalize();
+	return failures != 0;
+}
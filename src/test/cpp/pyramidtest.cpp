@@ -0,0 +1,208 @@
+// Build pyramids of bricks of every type with both filters and odd dimensions and compare every level
+// against a direct computation from the level below; check that an update of a few slices gives the
+// same levels as a full rebuild; publish two coarser levels as streams of their own and read them
+// through ShmStreams on a consumer thread; then time a larger brick
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "BrickPyramid.hpp"
+#include "ShmStreams.hpp"
+
+#define LEVELS 4
+#define NTHREADS 3
+#define RANK 12
+#define STEPS 3
+#define FREEWAIT 20000 // us for the allocator to delete released segments before the next step
+#define BIG 256 // voxels along each axis of the timed brick
+
+int failures = 0;
+
+void check(bool ok, const char *what, const char *name)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << " of " << name << " bricks" << std::endl;
+		++failures;
+	}
+}
+
+template <typename T>
+T voxel(size_t x, size_t y, size_t z, long step)
+{
+	return (T) ((((x * 7 + y * 13 + z * 29 + step) * 2654435761u) >> 11) % 200) - (T) 50 * (std::numeric_limits<T>::min() < 0);
+}
+
+template <typename T>
+bool close(T a, T b)
+{
+	return a == b || std::abs((double) a - (double) b) <= 1e-5 * std::max(1.0, std::abs((double) b));
+}
+
+// one level from the one below, voxel by voxel
+template <typename T>
+std::vector<T> reference(const std::vector<T> &src, const int dims[3], int filter)
+{
+	int out[3];
+	std::vector<T> dst(pyramid_level_dims(dims, 1, out));
+	for (int z = 0; z < out[2]; ++z) for (int y = 0; y < out[1]; ++y) for (int x = 0; x < out[0]; ++x) {
+		double sum = 0;
+		T mx = std::numeric_limits<T>::lowest();
+		for (int k = 0; k < 8; ++k) {
+			int sx = std::min(2 * x + (k & 1), dims[0] - 1), sy = std::min(2 * y + (k >> 1 & 1), dims[1] - 1);
+			int sz = std::min(2 * z + (k >> 2), dims[2] - 1);
+			T v = src[((size_t) sz * dims[1] + sy) * dims[0] + sx];
+			sum += v;
+			mx = std::max(mx, v);
+		}
+		T mean = std::numeric_limits<T>::is_integer ? (T) std::floor((sum + 4) / 8) : (T) (sum / 8);
+		dst[((size_t) z * out[1] + y) * out[0] + x] = (filter == PYRAMID_MAX) ? mx : mean;
+	}
+	return dst;
+}
+
+template <typename T>
+void run(int dtype, const char *name, const int dims[3], int filter)
+{
+	std::vector<T> v((size_t) dims[0] * dims[1] * dims[2]);
+	for (int z = 0; z < dims[2]; ++z)
+		for (int y = 0; y < dims[1]; ++y)
+			for (int x = 0; x < dims[0]; ++x)
+				v[((size_t) z * dims[1] + y) * dims[0] + x] = voxel<T>(x, y, z, 0);
+
+	int origin[] = {0, 0, 0}, extent[] = {0, 0, 0, dims[0] - 1, dims[1] - 1, dims[2] - 1};
+	BrickPyramid pyramid(LEVELS, filter, NTHREADS);
+	int i = pyramid.add_brick(dtype, dims, 0, origin, extent);
+	check(i == 0 && pyramid.update(i, v.data()), "building", name);
+
+	std::vector<T> below = v;
+	int d[3], ld[3];
+	for (int k = 0; k < 3; ++k)
+		d[k] = dims[k];
+	bool ok = true;
+	for (int l = 1; l < LEVELS; ++l) {
+		std::vector<T> expected = reference(below, d, filter);
+		size_t n = pyramid.level_dims(i, l, ld);
+		const T *level = (const T *) pyramid.level(i, l);
+		ok = ok && n == expected.size();
+		for (size_t j = 0; j < n && ok; ++j)
+			ok = close(level[j], expected[j]);
+		below.assign(level, level + n);
+		memcpy(d, ld, sizeof(d));
+	}
+	check(ok, filter == PYRAMID_MAX ? "max pyramid" : "box pyramid", name);
+
+	// change slices 3 and 4 only
+	for (int z = 3; z < 5; ++z)
+		for (size_t j = 0; j < (size_t) dims[0] * dims[1]; ++j)
+			v[(size_t) z * dims[0] * dims[1] + j] = voxel<T>(j, z, 0, 1);
+	BrickPyramid full(LEVELS, filter, NTHREADS);
+	full.add_brick(dtype, dims, 0, origin, extent);
+	full.update(0, v.data());
+	check(pyramid.update(i, v.data(), 3, 5), "updating", name);
+	for (int l = 1; l < LEVELS; ++l)
+		ok = ok && memcmp(pyramid.level(i, l), full.level(0, l), pyramid.level_dims(i, l, ld) * sizeof(T)) == 0;
+	check(ok, "incremental update", name);
+}
+
+// publish levels 1 and 2 of two bricks and read them back on another thread, as a consumer process would
+void publish()
+{
+	int dims[][3] = {{33, 20, 17}, {30, 20, 17}};
+	int origins[][3] = {{0, 0, 0}, {32, 0, 0}};
+	int extents[][6] = {{0, 0, 0, 32, 19, 16}, {32, 0, 0, 61, 19, 16}};
+	int domain[] = {0, 0, 0, 61, 19, 16};
+
+	BrickPyramid pyramid(3, PYRAMID_BOX, NTHREADS);
+	pyramid.add_brick(BRICK_UINT16, dims[0], 1, origins[0], extents[0]);
+	pyramid.add_brick(BRICK_UINT8, dims[1], 0, origins[1], extents[1]);
+	pyramid.set_domain(domain);
+	std::vector<std::string> pnames = {"/tmp", "/"};
+	check(pyramid.publish_levels(pnames, RANK), "publishing levels", "published");
+
+	std::vector<uint16_t> b0((size_t) dims[0][0] * dims[0][1] * dims[0][2]);
+	std::vector<uint8_t> b1((size_t) dims[1][0] * dims[1][1] * dims[1][2]);
+	std::atomic<long> consumed(0);
+
+	std::thread consumer([&]() {
+		ShmStream s1(pnames[0], RANK, pyramid.segment_bytes(1)), s2(pnames[1], RANK, pyramid.segment_bytes(2));
+		ShmStream *streams[] = {&s1, &s2};
+		for (long step = 1; step <= STEPS; ++step) {
+			for (int l = 1; l <= 2; ++l) {
+				ShmStream &s = *streams[l-1];
+				std::lock_guard<std::recursive_mutex> guard(s.lock);
+				ShmFrame frame = s.acquire(true);
+				const BrickTableHeader *table = NULL;
+				while ((table = brick_table(frame.ptr, frame.size)) == NULL)
+					usleep(100);
+
+				const BrickDescriptor *d = brick_descriptors(table);
+				int ld[3];
+				bool ok = table->step == step && table->nbricks == 2 && table->domain[3] == (l == 1 ? 30 : 15)
+					&& d[0].ghost == 1 && d[1].origin[0] == (32 >> l) && d[1].extent[3] == (l == 1 ? 30 : 15);
+				for (int i = 0; i < 2; ++i) {
+					size_t n = pyramid.level_dims(i, l, ld);
+					ok = ok && memcmp(d[i].dims, ld, sizeof(ld)) == 0
+						&& memcmp(brick_voxels(table, i), pyramid.level(i, l), n * brick_type_size(d[i].dtype)) == 0;
+				}
+				check(ok, l == 1 ? "level 1 stream" : "level 2 stream", "published");
+				s.release();
+			}
+			consumed = step;
+		}
+		s1.detach_all();
+		s2.detach_all();
+	});
+
+	for (long step = 1; step <= STEPS; ++step) {
+		for (size_t j = 0; j < b0.size(); ++j)
+			b0[j] = (uint16_t) (j * 7 + step * 1000);
+		for (size_t j = 0; j < b1.size(); ++j)
+			b1[j] = (uint8_t) (j * 3 + step);
+		pyramid.update(0, b0.data());
+		pyramid.update(1, b1.data());
+		check(pyramid.publish(step), "publishing", "published");
+		while (consumed < step)
+			usleep(1000);
+		usleep(FREEWAIT);
+	}
+	consumer.join();
+}
+
+int main()
+{
+	int shapes[][3] = {{37, 20, 9}, {1, 17, 16}, {64, 33, 7}};
+	for (int s = 0; s < 3; ++s) {
+		for (int filter = PYRAMID_BOX; filter <= PYRAMID_MAX; ++filter) {
+			run<uint8_t>(BRICK_UINT8, "uint8", shapes[s], filter);
+			run<uint16_t>(BRICK_UINT16, "uint16", shapes[s], filter);
+			run<int16_t>(BRICK_INT16, "int16", shapes[s], filter);
+			run<float>(BRICK_FLOAT32, "float", shapes[s], filter);
+			run<double>(BRICK_FLOAT64, "double", shapes[s], filter);
+		}
+	}
+	publish();
+
+	int big[] = {BIG, BIG, BIG}, origin[] = {0, 0, 0}, extent[] = {0, 0, 0, BIG - 1, BIG - 1, BIG - 1};
+	std::vector<uint16_t> v((size_t) BIG * BIG * BIG);
+	for (size_t i = 0; i < v.size(); ++i)
+		v[i] = (uint16_t) (i * 2654435761u >> 16);
+	BrickPyramid pyramid(LEVELS, PYRAMID_BOX, NTHREADS);
+	pyramid.add_brick(BRICK_UINT16, big, 0, origin, extent);
+	auto start = std::chrono::steady_clock::now();
+	pyramid.update(0, v.data());
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << BIG << "^3 uint16 voxels into " << LEVELS - 1 << " coarser levels in " << ms << " ms" << std::endl;
+
+	if (failures == 0)
+		std::cout << "brick pyramids passed" << std::endl;
+	return failures != 0;
+}
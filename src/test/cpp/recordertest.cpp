@@ -0,0 +1,147 @@
+// Record frames of varying size with FrameRecorder and read the file back: with enough buffers every
+// frame must arrive intact and in order; with two buffers and frames submitted faster than they are
+// written, frames are dropped rather than submit waiting, the records kept are still intact and in
+// order, and with DROP_OLDEST the last frame is always kept
+
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FrameRecorder.hpp"
+
+#define MAXFRAME (1 << 20)
+#define FRAMES 50
+#define BURST 200  // frames submitted back to back against two buffers
+#define NWRITERS 2
+
+int failures = 0;
+
+void check(bool ok, const char *what)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+size_t frame_bytes(long seq)
+{
+	return (size_t) (MAXFRAME - 4099 * seq) % MAXFRAME + 1;
+}
+
+uint8_t value(long seq, size_t i)
+{
+	return (uint8_t) ((i * 2654435761u + seq * 40503u) >> 11);
+}
+
+void fill(std::vector<uint8_t> &frame, long seq)
+{
+	frame.resize(frame_bytes(seq));
+	for (size_t i = 0; i < frame.size(); ++i)
+		frame[i] = value(seq, i);
+}
+
+// read every record of the file, check it against what was submitted and return the sequence numbers in file order
+std::vector<long> scan(const char *path, const char *name)
+{
+	std::vector<long> seqs;
+	FrameRecording recording;
+	if (!recording.open(path))
+		return seqs;
+	for (size_t f = 0; f < recording.frames(); ++f) {
+		const RecordHeader &h = recording.header(f);
+		const uint8_t *payload = (const uint8_t *) recording.data(f);
+		bool ok = h.bytes == frame_bytes(h.seq) && h.record % RECORD_ALIGN == 0
+			&& h.stream == (uint32_t) (h.seq % 3) && h.rank == 7 && h.slot == (int) (h.seq % 2) && strcmp(h.name, name) == 0;
+		for (size_t i = 0; ok && i < h.bytes; ++i)
+			ok = payload[i] == value(h.seq, i);
+		if (!ok) {
+			std::cout << "FAILED: record " << f << std::endl;
+			++failures;
+			break;
+		}
+		seqs.push_back(h.seq);
+	}
+	return seqs;
+}
+
+bool increasing(const std::vector<long> &seqs)
+{
+	for (size_t i = 1; i < seqs.size(); ++i)
+		if (seqs[i] <= seqs[i-1])
+			return false;
+	return true;
+}
+
+void burst(const char *path, int policy, const char *what)
+{
+	std::vector<std::vector<uint8_t> > frames(BURST);
+	for (long s = 0; s < BURST; ++s)
+		fill(frames[s], s);
+
+	FrameRecorder rec(path, MAXFRAME, 2 * FrameRecorder::record_bytes(MAXFRAME), 1, policy);
+	check(rec.ok() && rec.nbuffers() == 2, what);
+	long accepted = 0;
+	bool last = false;
+	for (long s = 0; s < BURST; ++s) {
+		last = rec.submit(frames[s].data(), frames[s].size(), (int) (s % 3), s, 7, (int) (s % 2), "burst");
+		accepted += last;
+	}
+	rec.close();
+
+	std::vector<long> seqs = scan(path, "burst");
+	check(rec.recorded() + rec.dropped() == BURST && rec.failed() == 0, "every frame either recorded or dropped");
+	check((long) seqs.size() == rec.recorded() && increasing(seqs), "records kept in order");
+	if (policy == DROP_NEWEST)
+		check(accepted == rec.recorded() && !seqs.empty() && seqs[0] == 0, "the first frame kept when dropping the newest");
+	else
+		check(last && !seqs.empty() && seqs.back() == BURST - 1, "the last frame kept when dropping the oldest");
+	std::cout << what << ": " << rec.recorded() << " of " << BURST << " frames recorded, " << rec.dropped() << " dropped" << std::endl;
+}
+
+int main()
+{
+	char path[] = "/tmp/recordertestXXXXXX";
+	int fd = mkstemp(path);
+	check(fd >= 0, "creating the file");
+	close(fd);
+
+	{
+		FrameRecorder rec(path, MAXFRAME, FRAMES * FrameRecorder::record_bytes(MAXFRAME), NWRITERS, DROP_NEWEST);
+		check(rec.ok() && rec.nbuffers() == FRAMES, "allocating the buffers");
+		std::vector<uint8_t> frame;
+		for (long s = 0; s < FRAMES; ++s) {
+			fill(frame, s);
+			check(rec.submit(frame.data(), frame.size(), (int) (s % 3), s, 7, (int) (s % 2), "frames"), "submitting a frame");
+		}
+		std::cerr << "(a complaint about an oversized frame expected)" << std::endl;
+		frame.resize(MAXFRAME + 1);
+		check(!rec.submit(frame.data(), frame.size(), 0, FRAMES, 7, 0, "frames"), "dropping an oversized frame");
+		rec.flush();
+		check(rec.recorded() == FRAMES && rec.dropped() == 1, "recording every frame");
+		rec.close();
+
+		std::vector<long> seqs = scan(path, "frames");
+		check(seqs.size() == FRAMES && increasing(seqs), "reading every frame back in order");
+		off_t size = 0;
+		fd = open(path, O_RDONLY);
+		if (fd >= 0) {
+			size = lseek(fd, 0, SEEK_END);
+			close(fd);
+		}
+		check((unsigned long long) size == rec.written_bytes(), "file size");
+		std::cout << FRAMES << " frames recorded, " << (rec.direct_io() ? "with" : "without") << " O_DIRECT" << std::endl;
+	}
+
+	burst(path, DROP_NEWEST, "dropping the newest");
+	burst(path, DROP_OLDEST, "dropping the oldest");
+
+	unlink(path);
+	if (failures == 0)
+		std::cout << "frame recording passed" << std::endl;
+	return failures != 0;
+}
@@ -0,0 +1,70 @@
+// Check the prefix scan and the partial sums read off it against scalar loops, for several thread counts
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "PrefixScan.hpp"
+
+#define N (1280*720 + 3) // not a multiple of the vector width or of the thread count
+#define MAXCOUNT 20      // supersegments per list
+#define NRANKS 3
+#define TILELEN 4096
+
+int failures = 0;
+
+void check(bool ok, const char *what, int nthreads)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << " with " << nthreads << " threads" << std::endl;
+		++failures;
+	}
+}
+
+int main()
+{
+	std::vector<int32_t> in(N);
+	srand(42);
+	for (int i = 0; i < N; ++i)
+		in[i] = rand() % (MAXCOUNT + 1);
+
+	// scalar reference
+	std::vector<int32_t> ref(N);
+	int64_t total = 0;
+	for (int i = 0; i < N; ++i) {
+		ref[i] = (int32_t) total;
+		total += in[i];
+	}
+	int32_t rankref[NRANKS] = {0};
+	for (int i = 0; i < N; ++i)
+		rankref[i / (N / NRANKS) < NRANKS ? i / (N / NRANKS) : NRANKS - 1] += in[i];
+	std::vector<int32_t> tileref(tile_count(N, TILELEN), 0);
+	for (int i = 0; i < N; ++i)
+		tileref[i / TILELEN] += in[i];
+
+	for (int nthreads = 1; nthreads <= 8; nthreads *= 2) {
+		std::vector<int32_t> out(N, -1);
+		check(exclusive_scan(in.data(), out.data(), N, nthreads) == total, "total", nthreads);
+		check(out == ref, "exclusive scan", nthreads);
+
+		int32_t ranks[NRANKS];
+		rank_sums(out.data(), total, N, NRANKS, ranks);
+		bool ok = true;
+		for (int r = 0; r < NRANKS; ++r)
+			ok = ok && ranks[r] == rankref[r];
+		check(ok, "rank sums", nthreads);
+
+		std::vector<int32_t> tiles(tileref.size());
+		tile_sums(out.data(), total, N, TILELEN, tiles.data());
+		check(tiles == tileref, "tile sums", nthreads);
+
+		std::vector<int32_t> inplace(in);
+		exclusive_scan(inplace.data(), inplace.data(), N, nthreads);
+		check(inplace == ref, "in place scan", nthreads);
+	}
+
+	if (failures == 0)
+		std::cout << "prefix scan passed" << std::endl;
+	return failures != 0;
+}
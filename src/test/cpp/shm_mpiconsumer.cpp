@@ -10,6 +10,7 @@
 #include <mpi.h>
 
 #include "ShmBuffer.hpp"
+#include "AnalysisKernels.hpp"
 
 #define SIZE 1000
 #define UPDPER 5000
@@ -18,6 +19,7 @@
 #define COPYSTR true
 #define SHMRANK (rank)
 #define SYNCHRONIZE true
+#define NTHREADS 1 // threads used by the analysis kernels
 
 #define BARRIER() do { if (SYNCHRONIZE) MPI_Barrier(MPI_COMM_WORLD); } while (0)
 
@@ -34,13 +36,10 @@ int update()
 {
 	static int cnt = 0;
 
-	// move each entry in array based on bits of cnt
-	float sum = 0;
-	for (int i = 0; i < SIZE/sizeof(float); ++i) {
-		sum += str[i]*((i*i+1)&3);
-	}
+	// analyse the frame in place
+	FieldStats st = field_stats(str, DTYPE_FLOAT, SIZE/sizeof(float), NTHREADS);
 	if (cnt % PRINTPER == 0)
-		std::cout << "val: " << str[5] << std::endl;
+		std::cout << "val: " << str[5] << "\tmin: " << st.min << "\tmax: " << st.max << "\tmean: " << st.mean << std::endl;
 
 	++cnt;
 
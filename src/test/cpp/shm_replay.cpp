@@ -0,0 +1,190 @@
+// Replay producer: publishes frames recorded by FrameRecorder through ShmAllocator, in place of a live
+// simulation, so that consumers and the JNI path see the same data at the same times on every run.
+//
+// mpirun -np N ./shm_replay [-s scale] [-f steps per second] [-l loops] [-d delay in ms] recording...
+//
+// Every rank reads all recordings and publishes the frames of the recorded ranks r with r % N equal
+// to its own rank, each under its recorded rank and pname, as shm_mpiproducer would: allocate the
+// next segment, copy the frame in, free the previous one. Frame k of a stream is due at
+//
+//     start + scale * (time of frame k - time of the first frame of all recordings)   (default, -s 1)
+//     start + (seq of frame k - first seq) / fps                                     (with -f)
+//
+// where start is common to all ranks after a barrier and the delay, so the schedule depends only on
+// the recordings and the options, never on how long publishing takes; a frame that is late is
+// published at once and counted, without shifting the frames after it. -s 0 publishes as fast as
+// possible. With -l, the recordings are played again, each loop one period after the previous one.
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <mpi.h>
+
+#include "ShmAllocator.hpp"
+#include "FrameRecorder.hpp"
+
+#define LATE_US 1000       // a frame published later than this after it was due counts as late
+#define DEFAULT_PNAME "/tmp"
+
+int rank, size;
+
+struct Frame {
+	const FrameRecording *recording;
+	size_t index;
+	double due;        // seconds after start
+	std::string pname;
+	int shmrank;
+};
+
+double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+void sleep_until(double t)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t) t;
+	ts.tv_nsec = (long) ((t - ts.tv_sec) * 1e9);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+		;
+}
+
+void usage(const char *name)
+{
+	if (rank == 0)
+		fprintf(stderr, "usage: %s [-s scale] [-f steps per second] [-l loops] [-d delay in ms] recording...\n", name);
+	MPI_Finalize();
+	std::exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	MPI_Init(&argc, &argv);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	double scale = 1, fps = 0, delay = 0;
+	int loops = 1, opt;
+	while ((opt = getopt(argc, argv, "s:f:l:d:")) != -1) {
+		switch (opt) {
+		case 's': scale = atof(optarg); break;
+		case 'f': fps = atof(optarg); break;
+		case 'l': loops = atoi(optarg); break;
+		case 'd': delay = atof(optarg) / 1000; break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind >= argc || scale < 0 || fps < 0 || loops < 1)
+		usage(argv[0]);
+
+	std::vector<FrameRecording> recordings(argc - optind);
+	for (int i = optind; i < argc; ++i) {
+		if (!recordings[i - optind].open(argv[i])) {
+			MPI_Finalize();
+			return 1;
+		}
+	}
+
+	// the origin of the schedule, from all recordings so that it is the same on every rank
+	int64_t first_time = 0;
+	long first_seq = 0, last_seq = 0;
+	double span = 0;
+	bool any = false;
+	for (size_t r = 0; r < recordings.size(); ++r) {
+		for (size_t f = 0; f < recordings[r].frames(); ++f) {
+			const RecordHeader &h = recordings[r].header(f);
+			if (!any || h.time_us < first_time)
+				first_time = h.time_us;
+			if (!any || h.seq < first_seq)
+				first_seq = h.seq;
+			if (!any || h.seq > last_seq)
+				last_seq = h.seq;
+			any = true;
+		}
+	}
+	long steps = last_seq - first_seq + 1;
+
+	std::vector<Frame> frames;
+	for (size_t r = 0; r < recordings.size(); ++r) {
+		for (size_t f = 0; f < recordings[r].frames(); ++f) {
+			const RecordHeader &h = recordings[r].header(f);
+			double due = fps > 0 ? (h.seq - first_seq) / fps : scale * 1e-6 * (h.time_us - first_time);
+			span = std::max(span, due);
+			int shmrank = h.rank >= 0 ? h.rank : 0;
+			if (shmrank % size != rank)
+				continue;
+			Frame frame = {&recordings[r], f, due, h.name[0] ? h.name : DEFAULT_PNAME, shmrank};
+			frames.push_back(frame);
+		}
+	}
+	std::stable_sort(frames.begin(), frames.end(), [](const Frame &a, const Frame &b) { return a.due < b.due; });
+	// one more step after the last frame, at the mean step of the recording
+	double period = span + (steps > 1 ? span / (steps - 1) : 0);
+
+	// one allocator per stream, as the producer has one per field
+	std::map<std::pair<std::string, int>, ShmAllocator *> allocs;
+	std::map<std::pair<std::string, int>, void *> current;
+	for (size_t i = 0; i < frames.size(); ++i) {
+		std::pair<std::string, int> key(frames[i].pname, frames[i].shmrank);
+		if (allocs.count(key) == 0) {
+			allocs[key] = new ShmAllocator(key.first, key.second);
+			current[key] = NULL;
+		}
+	}
+	std::cout << "rank " << rank << " replaying " << frames.size() << " frames of " << allocs.size() << " streams, "
+		<< loops << " times, period " << period << " s" << std::endl;
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	double start = now() + delay;
+	bool paced = fps > 0 || scale > 0;
+	long late = 0;
+	double maxlate = 0;
+	unsigned long long bytes = 0;
+	for (int loop = 0; loop < loops; ++loop) {
+		for (size_t i = 0; i < frames.size(); ++i) {
+			const Frame &frame = frames[i];
+			double due = start + loop * period + frame.due;
+			if (paced) {
+				sleep_until(due);
+				double lag = now() - due;
+				if (lag > LATE_US * 1e-6)
+					++late;
+				maxlate = std::max(maxlate, lag);
+			}
+
+			std::pair<std::string, int> key(frame.pname, frame.shmrank);
+			const RecordHeader &h = frame.recording->header(frame.index);
+			void *ptr = allocs[key]->shm_alloc(h.bytes);
+			memcpy(ptr, frame.recording->data(frame.index), h.bytes);
+			allocs[key]->shm_free(current[key]);
+			current[key] = ptr;
+			bytes += h.bytes;
+		}
+	}
+	double elapsed = now() - start;
+
+	std::cout << "rank " << rank << " published " << frames.size() * loops << " frames, " << bytes / 1048576.0 << " MiB in "
+		<< elapsed << " s";
+	if (paced)
+		std::cout << ", " << late << " late by more than " << LATE_US << " us, at most " << maxlate * 1e3 << " ms";
+	std::cout << std::endl;
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	for (std::map<std::pair<std::string, int>, ShmAllocator *>::iterator it = allocs.begin(); it != allocs.end(); ++it) {
+		it->second->shm_free(current[it->first]);
+		delete it->second;
+	}
+
+	MPI_Finalize();
+	return 0;
+}
@@ -0,0 +1,249 @@
+// Publish frames with ShmAllocator and read them back through several ShmStreams in one process,
+// first by acquiring them directly, after polling before the first frame, then through a StreamWaiter group
+// whose streams cannot be closed or grouped again while it runs, and to a poller much slower than the producer
+
+#include <iostream>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+#include "ShmAllocator.hpp"
+#include "ShmStreams.hpp"
+#include "StreamWaiter.hpp"
+
+#define NSTREAMS 2
+#define SIZE 4096
+#define FRAMES 5
+#define RANK 7
+#define PNAME(i) ((i) ? "/tmp" : "/")
+#define FREEWAIT 20000 // us for the allocator to delete released segments before the next frame
+#define GROUPRANK 8
+#define POLLWAIT 2000000 // us to wait for the waiter to report a frame
+#define SLOWRANK 9
+#define SLOWPOLLS 10
+#define SLOWPOLL 30000 // us the slow poller spends on the events of each poll
+#define PUBLISH 1000   // us between the frames of its producer
+
+// publish FRAMES frames on each stream and check that a StreamWaiter reports each of them once, in order
+static int group_test()
+{
+	ShmAllocator *alloc[NSTREAMS];
+	ShmStreams streams;
+	std::vector<std::shared_ptr<ShmStream> > members, again;
+	std::vector<int> handles;
+	int failures = 0;
+
+	for (int i = 0; i < NSTREAMS; ++i) {
+		alloc[i] = new ShmAllocator(PNAME(i), GROUPRANK);
+		handles.push_back(streams.open(PNAME(i), GROUPRANK, SIZE));
+	}
+	std::vector<int> twice(2, handles[0]);
+	if (streams.join_group(twice, again) || !streams.join_group(handles, members) || streams.join_group(std::vector<int>(1, handles[1]), again)) {
+		std::cout << "FAILED: joining groups" << std::endl;
+		++failures;
+	}
+
+	// frames are signalled on shm_alloc, before the producer fills them, so contents are checked after polling
+	std::atomic<void *> latest[NSTREAMS];
+	std::atomic<int> calls(0), started(0), stopped(0);
+	for (int i = 0; i < NSTREAMS; ++i)
+		latest[i] = NULL;
+	StreamWaiter waiter(members,
+			[&latest, &calls](int index, ShmStream &, const ShmFrame &frame) {
+				latest[index] = frame.ptr;
+				++calls;
+				return 0;
+			},
+			16, [&started]() { ++started; }, [&stopped]() { ++stopped; });
+
+	int *frame[NSTREAMS] = {NULL};
+	for (int f = 1; f <= FRAMES; ++f) {
+		for (int i = 0; i < NSTREAMS; ++i) {
+			int *old = frame[i];
+			frame[i] = (int *) alloc[i]->shm_alloc(SIZE);
+			for (int k = 0; k < SIZE / (int) sizeof(int); ++k)
+				frame[i][k] = 1000*i + f;
+			alloc[i]->shm_free(old);
+
+			StreamEvent event;
+			size_t n = 0;
+			for (long waited = 0; n == 0 && waited < POLLWAIT; waited += 1000) {
+				n = waiter.poll(&event, 1);
+				if (n == 0)
+					usleep(1000);
+			}
+			if (n == 0 || event.index != i || event.seq != f || ((int *) latest[i].load())[SIZE / sizeof(int) - 1] != 1000*i + f) {
+				std::cout << "FAILED: group stream " << i << " frame " << f << std::endl;
+				++failures;
+			}
+		}
+		usleep(FREEWAIT);
+	}
+
+	StreamEvent extra;
+	if (waiter.poll(&extra, 1) != 0 || waiter.dropped() != 0) {
+		std::cout << "FAILED: group reported extra frames" << std::endl;
+		++failures;
+	}
+	if (streams.close(handles[0])) {
+		std::cout << "FAILED: closed a stream of a running group" << std::endl;
+		++failures;
+	}
+	waiter.stop();
+	streams.leave_group(handles);
+	if (calls != NSTREAMS * FRAMES || started != 1 || stopped != 1) {
+		std::cout << "FAILED: group callbacks" << std::endl;
+		++failures;
+	}
+
+	for (int i = 0; i < NSTREAMS; ++i) {
+		std::shared_ptr<ShmStream> stream = streams.close(handles[i]);
+		if (!stream) {
+			std::cout << "FAILED: closing stream " << i << " after its group" << std::endl;
+			++failures;
+		}
+		members[i]->detach_all();
+		alloc[i]->shm_free(frame[i]);
+		delete alloc[i];
+	}
+	return failures;
+}
+
+// publish frames far faster than a queue is drained and check that the frames of the events of each
+// poll stay mapped and unchanged until the next one
+static int slow_poll_test()
+{
+	ShmAllocator alloc(PNAME(0), SLOWRANK);
+	ShmStreams streams;
+	std::vector<std::shared_ptr<ShmStream> > members;
+	int failures = 0;
+	streams.join_group(std::vector<int>(1, streams.open(PNAME(0), SLOWRANK, SIZE)), members);
+
+	std::atomic<void *> slots[NKEYS]; // slots are pinned, so a slot's frames are always at the same address
+	for (int i = 0; i < NKEYS; ++i)
+		slots[i] = NULL;
+	StreamWaiter waiter(members, [&slots](int, ShmStream &, const ShmFrame &frame) { slots[frame.slot] = frame.ptr; return 0; }, 16);
+
+	std::atomic<bool> publishing(true);
+	std::thread producer([&alloc, &publishing]() {
+		int *prev = NULL;
+		for (int f = 1; publishing; ++f) {
+			int *p = (int *) alloc.shm_alloc(SIZE); // from the heap while the consumer holds both keys
+			for (int k = 0; k < SIZE / (int) sizeof(int); ++k)
+				p[k] = f;
+			alloc.shm_free(prev);
+			prev = p;
+			usleep(PUBLISH);
+		}
+		alloc.shm_free(prev);
+	});
+
+	long seen = 0, lastseq = 0;
+	int lastvalue = 0;
+	for (int p = 0; p < SLOWPOLLS; ++p) {
+		StreamEvent events[16];
+		size_t n = waiter.poll(events, 16);
+		usleep(SLOWPOLL);
+		for (size_t i = 0; i < n; ++i) {
+			const int *frame = (const int *) slots[events[i].slot].load();
+			bool same = true;
+			for (int k = 1; k < SIZE / (int) sizeof(int); ++k)
+				same = same && frame[k] == frame[0];
+			if (events[i].seq <= lastseq || frame[0] <= lastvalue || !same) {
+				std::cout << "FAILED: slow poller frame " << events[i].seq << " changed" << std::endl;
+				++failures;
+			}
+			lastseq = events[i].seq;
+			lastvalue = frame[0];
+			++seen;
+		}
+	}
+	if (seen < SLOWPOLLS / 2 || waiter.dropped() != 0) {
+		std::cout << "FAILED: slow poller got " << seen << " frames, " << waiter.dropped() << " dropped" << std::endl;
+		++failures;
+	}
+
+	waiter.stop();
+	publishing = false;
+	members[0]->detach_all(); // lets the producer free its last frames
+	producer.join();
+	return failures;
+}
+
+int main()
+{
+	ShmAllocator *alloc[NSTREAMS];
+	ShmStreams streams;
+	int handles[NSTREAMS];
+	int failures = 0;
+
+	for (int i = 0; i < NSTREAMS; ++i) {
+		alloc[i] = new ShmAllocator(PNAME(i), RANK);
+		handles[i] = streams.open(PNAME(i), RANK, SIZE);
+	}
+
+	// polling before the producer has published anything returns at once
+	for (int i = 0; i < NSTREAMS; ++i) {
+		std::shared_ptr<ShmStream> stream = streams.get(handles[i]);
+		std::lock_guard<std::recursive_mutex> guard(stream->lock);
+		if (stream->acquire(false).ptr != NULL) {
+			std::cout << "FAILED: stream " << i << " returned a frame before any was published" << std::endl;
+			++failures;
+		}
+	}
+
+	// streams are interleaved: ShmAllocator::shm_free only returns once the segment freed before it has been released
+	int *frame[NSTREAMS] = {NULL};
+	void *slotptr[NSTREAMS][NKEYS] = {{NULL}}; // address each slot was first seen at, slots are pinned
+	for (int f = 1; f <= FRAMES; ++f) {
+		for (int i = 0; i < NSTREAMS; ++i) {
+			// publish frame f, then free the previous one
+			int *old = frame[i];
+			frame[i] = (int *) alloc[i]->shm_alloc(SIZE);
+			for (int k = 0; k < SIZE / (int) sizeof(int); ++k)
+				frame[i][k] = 1000*i + f;
+			alloc[i]->shm_free(old);
+
+			std::shared_ptr<ShmStream> stream = streams.get(handles[i]);
+			std::lock_guard<std::recursive_mutex> guard(stream->lock);
+
+			ShmFrame fr = stream->acquire(true);
+			if (fr.ptr == NULL || fr.seq != f || ((int *) fr.ptr)[SIZE / sizeof(int) - 1] != 1000*i + f) {
+				std::cout << "FAILED: stream " << i << " frame " << f << std::endl;
+				++failures;
+			}
+			if (slotptr[i][fr.slot] == NULL)
+				slotptr[i][fr.slot] = fr.ptr;
+			if (fr.ptr != slotptr[i][fr.slot]) {
+				std::cout << "FAILED: stream " << i << " slot " << fr.slot << " moved" << std::endl;
+				++failures;
+			}
+			if (stream->acquire(false).ptr != NULL) { // nothing newer published yet
+				std::cout << "FAILED: stream " << i << " returned a frame twice" << std::endl;
+				++failures;
+			}
+			stream->release();
+		}
+		usleep(FREEWAIT);
+	}
+
+	for (int i = 0; i < NSTREAMS; ++i)
+		streams.close(handles[i]);
+	if (streams.get(handles[0])) {
+		std::cout << "FAILED: closed handle still valid" << std::endl;
+		++failures;
+	}
+
+	for (int i = 0; i < NSTREAMS; ++i) {
+		alloc[i]->shm_free(frame[i]);
+		delete alloc[i];
+	}
+
+	failures += group_test();
+	failures += slow_poll_test();
+
+	if (failures == 0)
+		std::cout << "streams passed" << std::endl;
+	return failures != 0;
+}
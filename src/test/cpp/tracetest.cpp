@@ -0,0 +1,176 @@
+// Trace into a segment in a directory of our own and read it back through a second mapping, as
+// insitu_trace does: spans, instants and counters of several threads arrive in their own rings and in
+// order, a ring that overflows keeps its newest events, a reader copying a ring that is being written
+// never sees an overwritten event, and ShmAllocator's spans are there; then time a span
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "TraceRecorder.hpp"
+#include "ShmAllocator.hpp"
+
+#define NTHREADS 4
+#define SPANS 1000
+#define RANK 14
+#define TIMED 1000000 // spans in the timed loop
+
+int failures = 0;
+
+void check(bool ok, const char *what)
+{
+	if (!ok) {
+		std::cout << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+// the segment as another process sees it
+const TraceHeader *map_segment(const std::string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	void *base = mmap(NULL, trace_segment_bytes(), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	return (base == MAP_FAILED) ? NULL : trace_segment(base, trace_segment_bytes());
+}
+
+uint32_t find_name(const TraceHeader *h, const char *name)
+{
+	for (uint32_t i = 0; i < h->names; ++i)
+		if (strcmp(trace_segment_name(h, i), name) == 0)
+			return i;
+	return UINT32_MAX;
+}
+
+void record(int t, std::atomic<int> &done)
+{
+	for (int i = 0; i < SPANS; ++i) {
+		TRACE_SPAN_ARG("tracetest span", t * SPANS + i);
+		if (i % 10 == 0)
+			TRACE_INSTANT("tracetest instant", i);
+	}
+	TRACE_COUNTER("tracetest counter", t);
+	++done;
+}
+
+int main()
+{
+	char dir[] = "/tmp/tracetestXXXXXX";
+	check(mkdtemp(dir) != NULL, "making a directory");
+	setenv("INSITU_TRACE_DIR", dir, 1);
+
+	{
+		TRACE_SPAN("tracetest before"); // recorded nowhere, but its name is kept
+	}
+	check(!trace_active() && trace_ring() == NULL, "tracing off");
+	check(trace_open("tracetest") && trace_active(), "opening");
+
+	std::string path = std::string(dir) + "/" + TRACE_PREFIX + std::to_string(getpid()) + ".0";
+	const TraceHeader *h = map_segment(path);
+	check(h != NULL && h->pid == getpid() && strcmp(h->process, "tracetest") == 0, "segment");
+	if (h == NULL)
+		return 1;
+	check(find_name(h, "tracetest before") != UINT32_MAX, "names registered before opening");
+
+	std::atomic<int> done(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < NTHREADS; ++t)
+		threads.push_back(std::thread(record, t, std::ref(done)));
+	for (int t = 0; t < NTHREADS; ++t)
+		threads[t].join();
+
+	uint32_t span = find_name(h, "tracetest span"), instant = find_name(h, "tracetest instant"), counter = find_name(h, "tracetest counter");
+	check(h->rings == NTHREADS, "a ring per thread");
+	bool seen[NTHREADS] = {false};
+	for (uint32_t r = 0; r < h->rings && r < NTHREADS; ++r) {
+		std::vector<TraceEvent> events;
+		check(trace_snapshot(trace_segment_ring(h, r), h->nevents, events) == 0, "keeping all events");
+		bool ok = events.size() == SPANS + SPANS / 10 + 1 && events.back().name == counter && events.back().kind == TRACE_COUNTER_EVENT;
+		int t = (int) events.back().payload;
+		ok = ok && t >= 0 && t < NTHREADS && !seen[t];
+		long next = t * SPANS;
+		uint64_t last = 0;
+		for (size_t i = 0; ok && i + 1 < events.size(); ++i) {
+			const TraceEvent &e = events[i];
+			if (e.kind == TRACE_INSTANT_EVENT) {
+				ok = e.name == instant && e.payload == next - t * SPANS;
+			} else {
+				ok = e.kind == TRACE_SPAN_EVENT && e.name == span && e.payload == next++ && e.start >= last;
+				last = e.start + e.duration;
+			}
+		}
+		check(ok && next == (t + 1) * SPANS, "events of a thread");
+		if (ok)
+			seen[t] = true;
+	}
+
+	// overflow, and a reader copying the ring while it is written
+	std::atomic<bool> writing(true);
+	std::thread writer([&]() {
+		for (long i = 0; i < 400 * TRACE_EVENTS; ++i)
+			TRACE_INSTANT("tracetest overflow", i);
+		writing = false;
+	});
+	bool consistent = true;
+	long snapshots = 0;
+	while (h->rings <= NTHREADS)
+		usleep(10);
+	const TraceRing *ring = trace_segment_ring(h, NTHREADS);
+	do {
+		std::vector<TraceEvent> events;
+		uint64_t first = trace_snapshot(ring, h->nevents, events);
+		for (size_t i = 0; i < events.size(); ++i)
+			consistent = consistent && events[i].payload == (int64_t) (first + i);
+		++snapshots;
+	} while (writing);
+	writer.join();
+	std::vector<TraceEvent> events;
+	uint64_t lost = trace_snapshot(ring, h->nevents, events);
+	check(consistent, "copying a ring being written");
+	// the slot after the head counts as being written, even once the writer is done
+	check(lost + events.size() == 400 * TRACE_EVENTS && events.size() == TRACE_EVENTS - 1
+		&& events.back().payload == 400 * TRACE_EVENTS - 1, "overflowing");
+
+	// the allocator's own spans, on this thread's ring
+	{
+		ShmAllocator alloc("/tmp", RANK);
+		void *p = alloc.shm_alloc(4096);
+		check(p != NULL, "allocating");
+		alloc.shm_free(p);
+	}
+	uint32_t spans = find_name(h, "ShmAllocator::shm_alloc");
+	bool found = false;
+	for (uint32_t r = 0; r < h->rings; ++r) {
+		std::vector<TraceEvent> events;
+		trace_snapshot(trace_segment_ring(h, r), h->nevents, events);
+		for (size_t i = 0; i < events.size(); ++i)
+			found = found || (events[i].name == spans && events[i].kind == TRACE_SPAN_EVENT && events[i].payload == 4096);
+	}
+	check(spans != UINT32_MAX && found, "ShmAllocator spans");
+
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < TIMED; ++i) {
+		TRACE_SPAN_ARG("tracetest timed", i);
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / TIMED;
+	std::cout << "span recorded in " << ns << " ns, " << snapshots << " ring copies during the overflow" << std::endl;
+
+	unlink(path.c_str());
+	rmdir(dir);
+	if (failures == 0)
+		std::cout << "trace recorder passed" << std::endl;
+	return failures != 0;
+}
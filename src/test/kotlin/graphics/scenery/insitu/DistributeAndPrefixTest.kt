@@ -110,12 +110,64 @@ class DistributeAndPrefixTest: SceneryBase("PrefixTest", windowWidth = 1280, win
         logger.info("Finished init")
     }
 
+    val scanner = PrefixScanner()
+    var serialPrefix: ByteBuffer? = null
+
+    /**
+     * Checks [InSituScan] against a serial loop on random counts of the same size as the frame, including
+     * the per-rank split used by dense VDI distribution, and logs its throughput for several thread counts.
+     */
+    fun checkCpuScan(iterations: Int = 20) {
+        val n = windowWidth * windowHeight
+        val numRanks = 4
+        val counts = MemoryUtil.memAlloc(n * 4)
+        val countsIntBuff = counts.asIntBuffer()
+        val random = java.util.Random(42)
+        for(i in 0 until n) {
+            countsIntBuff.put(i, random.nextInt(maxSupersegments + 1))
+        }
+
+        val expected = IntArray(n)
+        val expectedRanks = IntArray(numRanks)
+        var total = 0
+        for(i in 0 until n) {
+            expected[i] = total
+            total += countsIntBuff.get(i)
+            expectedRanks[minOf(i / (n / numRanks), numRanks - 1)] += countsIntBuff.get(i)
+        }
+
+        var threads = 1
+        while(threads <= Runtime.getRuntime().availableProcessors()) {
+            PrefixScanner(threads).use { cpuScanner ->
+                val rankCounts = IntArray(numRanks)
+                cpuScanner.scan(counts, n, rankCounts)
+                val prefixIntBuff = cpuScanner.prefix!!.asIntBuffer()
+                val correct = cpuScanner.total == total.toLong() && rankCounts.contentEquals(expectedRanks) &&
+                    (0 until n).all { prefixIntBuff.get(it) == expected[it] }
+                if(!correct) {
+                    logger.error("CPU prefix sum with $threads threads is wrong")
+                }
+
+                val time = measureNanoTime {
+                    for(i in 1..iterations) {
+                        cpuScanner.scan(counts, n, rankCounts)
+                    }
+                } / iterations
+                logger.info("CPU prefix sum with $threads threads: ${time/1e3} us, ${2.0 * n * 4 / time} GB/s")
+            }
+            threads *= 2
+        }
+        MemoryUtil.memFree(counts)
+    }
+
     fun manageTextures() {
         var distributionBuff: ByteBuffer?
         var prefixBuff: ByteBuffer?
 
         logger.info("in manage textures")
 
+        checkCpuScan()
+
         while(renderer?.firstImageReady == false) {
             Thread.sleep(50)
         }
@@ -149,7 +201,8 @@ class DistributeAndPrefixTest: SceneryBase("PrefixTest", windowWidth = 1280, win
             val distributionIntBuff = distributionBuff!!.asIntBuffer()
 
             val prefixTime = measureNanoTime {
-                prefixBuff = MemoryUtil.memAlloc(1280*720 * 4)
+                prefixBuff = serialPrefix ?: MemoryUtil.memAlloc(1280*720 * 4)
+                serialPrefix = prefixBuff
                 val prefixIntBuff = prefixBuff!!.asIntBuffer()
 
                 prefixIntBuff.put(0, distributionIntBuff.get(0))
@@ -164,6 +217,18 @@ class DistributeAndPrefixTest: SceneryBase("PrefixTest", windowWidth = 1280, win
 
             logger.info("Prefix array was calculated in ${prefixTime/1e9}s")
 
+            // the native scan is exclusive, the loop above inclusive
+            val nativeTime = measureNanoTime {
+                scanner.scan(distributionBuff!!, 1280*720)
+            }
+            val nativeIntBuff = scanner.prefix!!.asIntBuffer()
+            val inclusiveIntBuff = prefixBuff!!.asIntBuffer()
+            val mismatch = (0 until 1280*720).firstOrNull { nativeIntBuff.get(it) + distributionIntBuff.get(it) != inclusiveIntBuff.get(it) }
+            if(mismatch != null) {
+                logger.error("Native prefix sum differs from the serial one at $mismatch")
+            }
+            logger.info("Native prefix sum was calculated in ${nativeTime/1e9}s")
+
             SystemHelpers.dumpToFile(distributionBuff!!, "distribution")
             SystemHelpers.dumpToFile(prefixBuff!!, "prefix")
 
@@ -0,0 +1,333 @@
+// Save as "DistributedVolumes.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include <iostream>    // C++ standard IO header
+#include "DistributedVolumes.h"  // Generated
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <mpi.h>
+
+#include "VDIExchange.hpp"
+#include "ImageCompositor.hpp"
+#include "VDIPacking.hpp"
+#include "NodeExchange.hpp"
+
+#define VERBOSE false
+
+// The receive buffers are owned by the exchange and reused across frames, so the colPointer,
+// depthPointer and prefixPointer arguments (receive buffers of hosts that register their own
+// natives) are not used. mpiPointer points to the MPI_Comm to exchange over, 0 for MPI_COMM_WORLD.
+// Likewise compositeImages composites into a buffer of its own, over the communicator of mpiPointer.
+
+std::unique_ptr<VDIExchange> dense;
+jmethodID uploadDense = NULL;
+jmethodID bufferLimit = NULL;
+
+// set by setDenseCompression, applied to every exchange created
+int codec = CODEC_NONE, codecLevel = 0, codecThreads = 0;
+size_t codecChunk = CHUNK_BYTES;
+bool quantizeDepths = false;
+
+std::unique_ptr<NodeExchange> nodes;
+std::vector<int32_t> paddedPrefix; // prefix sums of the node exchange, with empty blocks up to commSize
+std::vector<int> paddedSupsegs;
+
+std::unique_ptr<SparseVDIExchange> sparse;
+jmethodID upload = NULL;
+
+std::unique_ptr<ImageCompositor> images;
+std::vector<uint8_t> composited; // the image at rank 0, empty elsewhere
+size_t compositorPixels = 0;     // pixels images was made for, over its communicator
+jmethodID distanceToCamera = NULL;
+jmethodID displayComposited = NULL;
+
+static MPI_Comm comm_of(jlong mpiPointer)
+{
+	return mpiPointer ? *(MPI_Comm *) mpiPointer : MPI_COMM_WORLD;
+}
+
+// looks up uploadForCompositingDense once; false if a Java exception is pending
+static bool find_upload(JNIEnv *env, jobject thisObj)
+{
+	if (uploadDense == NULL) {
+		jclass cls = env->GetObjectClass(thisObj);
+		uploadDense = env->GetMethodID(cls, "uploadForCompositingDense", "(Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;[I[I)V");
+		env->DeleteLocalRef(cls);
+		if (uploadDense == NULL)
+			return false; // NoSuchMethodError pending
+
+		jclass buf = env->FindClass("java/nio/Buffer");
+		bufferLimit = env->GetMethodID(buf, "limit", "()I");
+		env->DeleteLocalRef(buf);
+	}
+	return true;
+}
+
+// (re)creates the exchange if the communicator or pipeline depth changed; false if a Java exception is pending
+static bool prepare(JNIEnv *env, jobject thisObj, MPI_Comm comm, int depth)
+{
+	if (!dense || dense->communicator() != comm || (dense->depth() != depth && dense->idle())) {
+		dense.reset(new VDIExchange(comm, depth));
+		dense->set_compression(codec, codecLevel, codecChunk, codecThreads);
+		dense->set_depth_quantization(quantizeDepths);
+	}
+	return find_upload(env, thisObj);
+}
+
+static int start(JNIEnv *env, jobject subVDIColor, jobject subVDIDepth, jobject prefixSums, jintArray supersegmentCounts, jint commSize, bool stage)
+{
+	std::vector<jint> counts(commSize);
+	env->GetIntArrayRegion(supersegmentCounts, 0, commSize, counts.data());
+
+	void *color = env->GetDirectBufferAddress(subVDIColor);
+	void *depth = env->GetDirectBufferAddress(subVDIDepth);
+	int32_t *prefix = (int32_t *) env->GetDirectBufferAddress(prefixSums);
+	size_t nlists = (size_t) env->CallIntMethod(prefixSums, bufferLimit) / sizeof(int32_t); // the prefix buffer is reused, so may be larger
+
+	return dense->start(color, depth, prefix, nlists, counts.data(), stage);
+}
+
+// hand what was received to uploadForCompositingDense, one block per rank
+static void upload_dense(JNIEnv *env, jobject thisObj, const DenseVDIs &got, jint commSize)
+{
+	// views of exactly the received data, the memory behind them is the same every frame unless it grew
+	jobject colorBuf = env->NewDirectByteBuffer(got.color, (jlong) (got.supersegments * COLOR_BYTES));
+	jobject depthBuf = env->NewDirectByteBuffer(got.depth, (jlong) (got.supersegments * DEPTH_BYTES));
+	jobject prefixBuf = env->NewDirectByteBuffer(got.prefix, (jlong) (commSize * got.lists * sizeof(int32_t)));
+
+	std::vector<jint> colorCounts(commSize), depthCounts(commSize);
+	for (int r = 0; r < commSize; ++r) {
+		colorCounts[r] = got.recvsupsegs[r] * COLOR_BYTES;
+		depthCounts[r] = got.recvsupsegs[r] * DEPTH_BYTES;
+	}
+	jintArray colorArr = env->NewIntArray(commSize);
+	jintArray depthArr = env->NewIntArray(commSize);
+	env->SetIntArrayRegion(colorArr, 0, commSize, colorCounts.data());
+	env->SetIntArrayRegion(depthArr, 0, commSize, depthCounts.data());
+
+	env->CallVoidMethod(thisObj, uploadDense, colorBuf, depthBuf, prefixBuf, colorArr, depthArr);
+
+	env->DeleteLocalRef(colorBuf);
+	env->DeleteLocalRef(depthBuf);
+	env->DeleteLocalRef(prefixBuf);
+	env->DeleteLocalRef(colorArr);
+	env->DeleteLocalRef(depthArr);
+}
+
+// wait for the exchange in slot and upload what was received
+static void finish(JNIEnv *env, jobject thisObj, int slot, jint commSize)
+{
+	DenseVDIs got = dense->wait(slot);
+
+	if (VERBOSE) {
+		const double *t = dense->last_times();
+		std::cout << "dense exchange: counts " << t[PHASE_COUNTS] << " layout " << t[PHASE_LAYOUT] << " stage " << t[PHASE_STAGE]
+			<< " post " << t[PHASE_POST] << " flight " << t[PHASE_FLIGHT] << " wait " << t[PHASE_WAIT] << std::endl;
+	}
+	upload_dense(env, thisObj, got, commSize);
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_distributeDenseVDIs(JNIEnv *env, jobject thisObj, jobject subVDIColor, jobject subVDIDepth,
+		jobject prefixSums, jintArray supersegmentCounts, jint commSize, jlong colPointer, jlong depthPointer, jlong prefixPointer, jlong mpiPointer) {
+	if (!prepare(env, thisObj, comm_of(mpiPointer), dense ? dense->depth() : 1))
+		return;
+
+	// the caller's buffers stay untouched until we return, no need to stage them
+	int slot = start(env, subVDIColor, subVDIDepth, prefixSums, supersegmentCounts, commSize, false);
+	if (slot < 0) {
+		std::cerr << "distributeDenseVDIs: asynchronous exchanges still in flight" << std::endl;
+		return;
+	}
+	finish(env, thisObj, slot, commSize);
+}
+
+// Post the exchange of a frame and return its handle, or -1 if pipelineDepth exchanges are already in
+// flight. The data is staged, so the caller may reuse its buffers (generate the next frame) right away.
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_DistributedVolumes_startDenseExchange(JNIEnv *env, jobject thisObj, jobject subVDIColor, jobject subVDIDepth,
+		jobject prefixSums, jintArray supersegmentCounts, jint commSize, jint pipelineDepth, jlong mpiPointer) {
+	if (!prepare(env, thisObj, comm_of(mpiPointer), pipelineDepth))
+		return -1;
+	return start(env, subVDIColor, subVDIDepth, prefixSums, supersegmentCounts, commSize, true);
+}
+
+// whether the exchange has completed; calling this while waiting on other work drives its progress
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_DistributedVolumes_testDenseExchange(JNIEnv *env, jobject thisObj, jint handle) {
+	return dense && dense->test(handle);
+}
+
+// wait for the exchange and call uploadForCompositingDense with what was received; handles are finished in the order started
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_finishDenseExchange(JNIEnv *env, jobject thisObj, jint handle, jint commSize) {
+	if (dense)
+		finish(env, thisObj, handle, commSize);
+}
+
+// seconds spent in each phase of the dense exchange finished last, indexed by ExchangePhase
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_denseExchangeTimings(JNIEnv *env, jobject thisObj, jdoubleArray timings) {
+	if (!dense)
+		return;
+	jsize n = env->GetArrayLength(timings);
+	env->SetDoubleArrayRegion(timings, 0, n < NPHASES ? n : NPHASES, dense->last_times());
+}
+
+// compress colours and depths in the dense exchange from the next frame on, codec as in ChunkCodec.hpp,
+// chunkBytes 0 for the default; false if the codec was not built in. Call on all ranks, between frames.
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_DistributedVolumes_setDenseCompression(JNIEnv *env, jobject thisObj, jint kind, jint level, jint chunkBytes, jint threads) {
+	if (!codec_available(kind))
+		return false;
+	codec = kind;
+	codecLevel = level;
+	codecChunk = chunkBytes > 0 ? (size_t) chunkBytes : CHUNK_BYTES;
+	codecThreads = threads;
+	if (dense && dense->idle())
+		dense->set_compression(codec, codecLevel, codecChunk, codecThreads);
+	return true;
+}
+
+// send depths as 16-bit levels within each pixel's depth range from the next frame on; call on all ranks, between frames
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_setDenseDepthQuantization(JNIEnv *env, jobject thisObj, jboolean enabled) {
+	quantizeDepths = enabled;
+	if (dense && dense->idle())
+		dense->set_depth_quantization(quantizeDepths);
+}
+
+// largest error of a depth this rank quantized for the last exchange, in NDC
+JNIEXPORT jfloat JNICALL Java_graphics_scenery_insitu_DistributedVolumes_denseDepthError(JNIEnv *env, jobject thisObj) {
+	return dense ? dense->depth_error() : 0.0f;
+}
+
+// distributeDenseVDIs in two levels, see NodeExchange.hpp: the ranks of each node composite their sub-VDIs into
+// maxOutputSupersegments per list in shared memory, and only one rank per node exchanges with the other nodes.
+// The result holds a block per node; it is padded with empty blocks to commSize for uploadForCompositingDense
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_distributeNodeVDIs(JNIEnv *env, jobject thisObj, jobject subVDIColor, jobject subVDIDepth,
+		jobject prefixSums, jint totalSupersegments, jfloatArray invViewProjection, jint windowWidth, jint windowHeight, jint maxOutputSupersegments,
+		jint commSize, jlong mpiPointer) {
+	MPI_Comm comm = comm_of(mpiPointer);
+	if (!nodes || nodes->communicator() != comm)
+		nodes.reset(new NodeExchange(comm, 0, (int) std::thread::hardware_concurrency()));
+	if (!find_upload(env, thisObj))
+		return;
+
+	CompositeView view;
+	view.width = windowWidth;
+	view.height = windowHeight;
+	view.first_list = 0;
+	view.tiles = NULL;
+	view.tilelen = 0;
+	env->GetFloatArrayRegion(invViewProjection, 0, 16, view.invViewProjection);
+
+	size_t nlists = (size_t) windowWidth * windowHeight;
+	DenseVDIs got = nodes->exchange(env->GetDirectBufferAddress(subVDIColor), env->GetDirectBufferAddress(subVDIDepth),
+		(const int32_t *) env->GetDirectBufferAddress(prefixSums), nlists, (size_t) totalSupersegments, view, maxOutputSupersegments);
+
+	if (VERBOSE) {
+		const double *t = nodes->last_times();
+		std::cout << "node exchange: share " << t[NODE_SHARE] << " composite " << t[NODE_COMPOSITE] << " exchange " << t[NODE_EXCHANGE]
+			<< " scatter " << t[NODE_SCATTER] << ", bytes between nodes " << nodes->internode_bytes() << " of " << nodes->flat_internode_bytes() << std::endl;
+	}
+
+	paddedPrefix.assign((size_t) commSize * got.lists, 0);
+	std::copy(got.prefix, got.prefix + nodes->sources() * got.lists, paddedPrefix.begin());
+	paddedSupsegs.assign(commSize, 0);
+	std::copy(got.recvsupsegs, got.recvsupsegs + nodes->sources(), paddedSupsegs.begin());
+	got.prefix = paddedPrefix.data();
+	got.recvsupsegs = paddedSupsegs.data();
+	upload_dense(env, thisObj, got, commSize);
+}
+
+// The exchange of distributeVDIs for non-dense VDIs, with each rank's share of lists packed so that empty ones
+// take a bit; what is received is expanded into the set of sub-VDIs and handed to uploadForCompositing
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_distributeSparseVDIs(JNIEnv *env, jobject thisObj, jobject subVDIColor, jobject subVDIDepth,
+		jint windowWidth, jint windowHeight, jint maxSupersegments, jlong mpiPointer) {
+	MPI_Comm comm = comm_of(mpiPointer);
+	if (!sparse || sparse->communicator() != comm)
+		sparse.reset(new SparseVDIExchange(comm, (int) std::thread::hardware_concurrency()));
+	if (upload == NULL) {
+		jclass cls = env->GetObjectClass(thisObj);
+		upload = env->GetMethodID(cls, "uploadForCompositing", "(Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)V");
+		env->DeleteLocalRef(cls);
+		if (upload == NULL)
+			return; // NoSuchMethodError pending
+	}
+
+	const float *color = (const float *) env->GetDirectBufferAddress(subVDIColor);
+	const float *depth = (const float *) env->GetDirectBufferAddress(subVDIDepth);
+	sparse->exchange(color, depth, (size_t) windowWidth * windowHeight, maxSupersegments);
+
+	if (VERBOSE) {
+		const double *t = sparse->last_times();
+		std::cout << "sparse exchange: pack " << t[PACKING_PACK] << " exchange " << t[PACKING_EXCHANGE] << " unpack " << t[PACKING_UNPACK]
+			<< ", bytes sent over slab bytes " << sparse->packed_ratio() << std::endl;
+	}
+
+	int commSize;
+	MPI_Comm_size(comm, &commSize);
+	size_t supsegs = (size_t) commSize * sparse->lists_per_source() * maxSupersegments;
+	jobject colorBuf = env->NewDirectByteBuffer((void *) sparse->set_color(), (jlong) (supsegs * 4 * sizeof(float)));
+	jobject depthBuf = env->NewDirectByteBuffer((void *) sparse->set_depth(), (jlong) (supsegs * 2 * sizeof(float)));
+	env->CallVoidMethod(thisObj, upload, colorBuf, depthBuf);
+	env->DeleteLocalRef(colorBuf);
+	env->DeleteLocalRef(depthBuf);
+}
+
+// blend the images of all ranks front to back and show the result at rank 0; the order comes from distanceToCamera.
+// myRank and commSize must be those of the communicator of mpiPointer, else an IllegalArgumentException is thrown
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_compositeImages(JNIEnv *env, jobject thisObj, jobject subImage, jint myRank, jint commSize, jlong mpiPointer) {
+	MPI_Comm comm = comm_of(mpiPointer);
+	int rank, size;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+	if (rank != myRank || size != commSize) {
+		jclass cls = env->FindClass("java/lang/IllegalArgumentException");
+		env->ThrowNew(cls, "compositeImages: myRank and commSize are not those of the communicator");
+		env->DeleteLocalRef(cls);
+		return;
+	}
+
+	size_t pixels = (size_t) env->GetDirectBufferCapacity(subImage) / 4;
+	if (!images || images->communicator() != comm || compositorPixels != pixels) {
+		images.reset(new ImageCompositor(comm, (int) pixels, 1));
+		compositorPixels = pixels;
+		if (myRank == 0)
+			composited.resize(pixels * 4);
+	}
+
+	if (distanceToCamera == NULL) {
+		jclass cls = env->GetObjectClass(thisObj);
+		distanceToCamera = env->GetMethodID(cls, "distanceToCamera", "()F");
+		displayComposited = env->GetMethodID(cls, "displayComposited", "(Ljava/nio/ByteBuffer;)V");
+		env->DeleteLocalRef(cls);
+		if (distanceToCamera == NULL || displayComposited == NULL)
+			return; // NoSuchMethodError pending
+	}
+
+	jfloat distance = env->CallFloatMethod(thisObj, distanceToCamera);
+	images->composite((const uint8_t *) env->GetDirectBufferAddress(subImage), distance, composited.data());
+
+	if (VERBOSE && myRank == 0) {
+		const std::vector<double> &t = images->round_times();
+		std::cout << "image compositing:";
+		for (size_t i = 0; i + 1 < t.size(); ++i)
+			std::cout << " k=" << images->rounds()[i] << " " << t[i];
+		std::cout << " gather " << t.back() << std::endl;
+	}
+
+	if (myRank == 0) {
+		jobject image = env->NewDirectByteBuffer(composited.data(), (jlong) composited.size());
+		env->CallVoidMethod(thisObj, displayComposited, image);
+		env->DeleteLocalRef(image);
+	}
+}
+
+// seconds spent in each round of the last image compositing, then in the gather; returns the number of values
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_DistributedVolumes_imageCompositingTimings(JNIEnv *env, jobject thisObj, jdoubleArray timings) {
+	if (!images)
+		return 0;
+	const std::vector<double> &t = images->round_times();
+	jsize n = env->GetArrayLength(timings);
+	if ((size_t) n > t.size())
+		n = (jsize) t.size();
+	env->SetDoubleArrayRegion(timings, 0, n, t.data());
+	return n;
+}
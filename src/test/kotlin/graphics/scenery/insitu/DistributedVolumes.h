@@ -0,0 +1,109 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class DistributedVolumes */
+
+#ifndef _Included_DistributedVolumes
+#define _Included_DistributedVolumes
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     DistributedVolumes
+ * Method:    distributeDenseVDIs
+ * Signature: (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;[IIJJJJ)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_distributeDenseVDIs
+  (JNIEnv *, jobject, jobject, jobject, jobject, jintArray, jint, jlong, jlong, jlong, jlong);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    startDenseExchange
+ * Signature: (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;[IIIJ)I
+ */
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_DistributedVolumes_startDenseExchange
+  (JNIEnv *, jobject, jobject, jobject, jobject, jintArray, jint, jint, jlong);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    testDenseExchange
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_DistributedVolumes_testDenseExchange
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    finishDenseExchange
+ * Signature: (II)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_finishDenseExchange
+  (JNIEnv *, jobject, jint, jint);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    denseExchangeTimings
+ * Signature: ([D)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_denseExchangeTimings
+  (JNIEnv *, jobject, jdoubleArray);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    setDenseCompression
+ * Signature: (IIII)Z
+ */
+JNIEXPORT jboolean JNICALL Java_graphics_scenery_insitu_DistributedVolumes_setDenseCompression
+  (JNIEnv *, jobject, jint, jint, jint, jint);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    setDenseDepthQuantization
+ * Signature: (Z)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_setDenseDepthQuantization
+  (JNIEnv *, jobject, jboolean);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    denseDepthError
+ * Signature: ()F
+ */
+JNIEXPORT jfloat JNICALL Java_graphics_scenery_insitu_DistributedVolumes_denseDepthError
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    distributeSparseVDIs
+ * Signature: (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;IIIJ)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_distributeSparseVDIs
+  (JNIEnv *, jobject, jobject, jobject, jint, jint, jint, jlong);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    distributeNodeVDIs
+ * Signature: (Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;Ljava/nio/ByteBuffer;I[FIIIIJ)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_distributeNodeVDIs
+  (JNIEnv *, jobject, jobject, jobject, jobject, jint, jfloatArray, jint, jint, jint, jint, jlong);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    compositeImages
+ * Signature: (Ljava/nio/ByteBuffer;IIJ)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_DistributedVolumes_compositeImages
+  (JNIEnv *, jobject, jobject, jint, jint, jlong);
+
+/*
+ * Class:     DistributedVolumes
+ * Method:    imageCompositingTimings
+ * Signature: ([D)I
+ */
+JNIEXPORT jint JNICALL Java_graphics_scenery_insitu_DistributedVolumes_imageCompositingTimings
+  (JNIEnv *, jobject, jdoubleArray);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
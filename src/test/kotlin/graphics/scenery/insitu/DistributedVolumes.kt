@@ -29,7 +29,6 @@ import java.io.FileOutputStream
 import java.lang.Math
 import java.nio.ByteBuffer
 import java.nio.ByteOrder
-import java.nio.IntBuffer
 import java.util.concurrent.atomic.AtomicInteger
 import kotlin.concurrent.thread
 import kotlin.math.ceil
@@ -111,6 +110,12 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
 
     val maxSupersegments = 20
     var maxOutputSupersegments = 20
+    val pipelineDepth = 1 // dense VDI exchanges in flight; above 1, the next frame is generated while the last one is exchanged
+    val exchangeCodec = 0 // compression of the dense VDI exchange: 0 none, 1 LZ4, 2 zstd, see ChunkCodec.hpp
+    val exchangeCodecLevel = 0
+    val sparseTransport = false // non-dense VDIs: send only the pixels holding supersegments, see VDIPacking.hpp
+    val quantizeDepths = false // send supersegment depths as 16 bits within each pixel's depth range, see DepthCodec.hpp
+    val nodeAwareExchange = false // composite the sub-VDIs of a node in shared memory, one rank per node exchanges, see NodeExchange.hpp
 
     data class Timer(var start: Long, var end: Long)
 
@@ -140,7 +145,6 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
     var allToAllPrefixPointer = 0L
     var gatherColorPointer = 0L
     var gatherDepthPointer = 0L
-    var imagePointer = 0L
 
     var volumesCreated = false
     var volumeManagerInitialized = false
@@ -165,9 +169,23 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
         colPointer: Long, depthPointer: Long, mpiPointer: Long)
     private external fun distributeDenseVDIs(subVDIColor: ByteBuffer, subVDIDepth: ByteBuffer, prefixSums: ByteBuffer, supersegmentCounts: IntArray, commSize: Int,
                                         colPointer: Long, depthPointer: Long, prefixPointer: Long, mpiPointer: Long)
+    private external fun startDenseExchange(subVDIColor: ByteBuffer, subVDIDepth: ByteBuffer, prefixSums: ByteBuffer, supersegmentCounts: IntArray, commSize: Int,
+                                            pipelineDepth: Int, mpiPointer: Long): Int
+    private external fun testDenseExchange(handle: Int): Boolean
+    private external fun finishDenseExchange(handle: Int, commSize: Int)
+    private external fun denseExchangeTimings(timings: DoubleArray)
+    private external fun setDenseCompression(codec: Int, level: Int, chunkBytes: Int, threads: Int): Boolean
+    private external fun setDenseDepthQuantization(enabled: Boolean)
+    private external fun denseDepthError(): Float
+    private external fun distributeNodeVDIs(subVDIColor: ByteBuffer, subVDIDepth: ByteBuffer, prefixSums: ByteBuffer, totalSupersegments: Int,
+                                            invViewProjection: FloatArray, windowWidth: Int, windowHeight: Int, maxOutputSupersegments: Int,
+                                            commSize: Int, mpiPointer: Long)
+    private external fun distributeSparseVDIs(subVDIColor: ByteBuffer, subVDIDepth: ByteBuffer, windowWidth: Int, windowHeight: Int, maxSupersegments: Int,
+                                              mpiPointer: Long)
     private external fun gatherCompositedVDIs(compositedVDIColor: ByteBuffer, compositedVDIDepth: ByteBuffer, compositedVDILen: Int, root: Int, myRank: Int, commSize: Int,
         colPointer: Long, depthPointer: Long, vo: Int, mpiPointer: Long)
-    private external fun compositeImages(subImage: ByteBuffer, myRank: Int, commSize: Int, imagePointer: Long)
+    private external fun compositeImages(subImage: ByteBuffer, myRank: Int, commSize: Int, mpiPointer: Long)
+    private external fun imageCompositingTimings(timings: DoubleArray): Int
     private external fun reduceAcrossPEs(value: Double) : Double
 
     @Suppress("unused")
@@ -641,6 +659,7 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
         }
 
         val colorTexture = volumes[0]?.volumeManager?.material()?.textures?.get("OutputRender")!!
+        val compositingTimings = DoubleArray(32) // seconds per round of the last compositeImages, then the gather
 
         rotateCamera(90f)
 
@@ -655,7 +674,9 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
             val imageBuffer = colorTexture.contents!!
 
             if (imageBuffer.remaining() == windowWidth * windowHeight * 4) {
-                compositeImages(imageBuffer, rank, commSize, imagePointer) //this function will call a java fn that will place the image on the screen
+                compositeImages(imageBuffer, rank, commSize, mpiPointer) //this function will call a java fn that will place the image on the screen
+                val rounds = imageCompositingTimings(compositingTimings)
+                logger.debug("Image compositing rounds (s): ${compositingTimings.take(rounds).joinToString()}")
             } else {
                 logger.error("Not compositing because image size: ${imageBuffer.remaining()} expected: ${windowHeight * windowWidth * 4}")
             }
@@ -663,6 +684,20 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
         }
     }
 
+    /**
+     * Distance from the camera to the centre of this rank's volumes, which orders the images of all ranks
+     * for compositeImages. The volumes extend from their position along the positive axes.
+     */
+    @Suppress("unused")
+    fun distanceToCamera(): Float {
+        val eye = cam.spatial().position
+        val distances = volumes.values.filterNotNull().map { volume ->
+            val extent = Vector3f(volume.getDimensions()).mul(pixelToWorld * 0.5f)
+            Vector3f(volume.spatial().position).add(extent).distance(eye)
+        }
+        return distances.minOrNull() ?: Float.MAX_VALUE
+    }
+
     @Suppress("unused")
     fun displayComposited(compositedImage: ByteBuffer) {
 
@@ -791,8 +826,16 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
         var compositedDepth = compositor.material().textures["CompositedVDIDepth"]!!
 
         var prefixBuffer: ByteBuffer? = null
-        var prefixIntBuff: IntBuffer? = null
         var totalSupersegmentsGenerated = 0
+        val prefixScanner = PrefixScanner()
+        val supersegmentCounts = IntArray(commSize)
+        val exchangeTimings = DoubleArray(6) // seconds per phase of the dense exchange finished last, see VDIExchange.hpp
+        val pendingExchanges = ArrayDeque<Pair<Int, Matrix4f>>() // handles of exchanges in flight, with the views they were generated for
+
+        if(exchangeCodec != 0 && !setDenseCompression(exchangeCodec, exchangeCodecLevel, 0, Runtime.getRuntime().availableProcessors() / 2)) {
+            logger.warn("Codec $exchangeCodec was not built into the native exchange, sending VDIs uncompressed")
+        }
+        setDenseDepthQuantization(quantizeDepths)
 
         var viewUsedForGeneration = cam.spatial().getTransformation()
 
@@ -807,21 +850,12 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
                 }
 
                 val numGeneratedBuff = numGeneratedTexture.contents
-                val numGeneratedIntBuffer = numGeneratedBuff!!.asIntBuffer()
-
-                //todo: check for errors in numGeneratedIntBuffer buffer
+                //todo: check for errors in numGeneratedBuff buffer
 
                 val prefixTime = measureNanoTime {
-                    prefixBuffer = MemoryUtil.memAlloc(windowWidth * windowHeight * 4)
-                    prefixIntBuff = prefixBuffer!!.asIntBuffer()
-
-                    prefixIntBuff!!.put(0, 0)
-
-                    for(i in 1 until windowWidth * windowHeight) {
-                        prefixIntBuff!!.put(i, prefixIntBuff!!.get(i-1) + numGeneratedIntBuffer.get(i-1))
-                    }
-
-                    totalSupersegmentsGenerated = prefixIntBuff!!.get(windowWidth*windowHeight-1) + numGeneratedIntBuffer.get(windowWidth*windowHeight-1)
+                    // the scan also splits the supersegments between ranks for distributeDenseVDIs
+                    prefixBuffer = prefixScanner.scan(numGeneratedBuff!!, windowWidth * windowHeight, supersegmentCounts)
+                    totalSupersegmentsGenerated = prefixScanner.total.toInt()
                 }
                 logger.debug("Prefix sum took ${prefixTime/1e9} to compute")
 
@@ -881,8 +915,11 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
 //                    vdiData.metadata.view = cam.spatial().getTransformation()
 //                }
 
-                runThreshSearch = true
-                viewUsedForGeneration = cam.spatial().getTransformation()
+                // when pipelining, the next generation was already started together with the exchange
+                if(pipelineDepth == 1) {
+                    runThreshSearch = true
+                    viewUsedForGeneration = cam.spatial().getTransformation()
+                }
             }
 
 //            logger.info("distributed: ${vdisDistributed.get()} and composited: ${vdisComposited.get()}")
@@ -926,6 +963,7 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
 
             start = System.nanoTime()
             while((vdisGenerated.get() <= generatedSoFar)) {
+                pendingExchanges.forEach { testDenseExchange(it.first) }
                 Thread.sleep(5)
             }
             end = System.nanoTime() - start
@@ -952,29 +990,51 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
                 logger.info("File dumped")
                 cnt_sub++
             }
-            val supersegmentCounts = IntArray(commSize)
 
-            val totalLists = windowHeight * windowWidth
-
-            var supersegmentsSoFar = 0
-
-            for(i in 0 until (commSize-1)) {
-                supersegmentCounts[i] = prefixIntBuff!!.get((totalLists / commSize) * (i + 1)) - supersegmentsSoFar
+            for(i in 0 until commSize) {
                 logger.debug("Rank: $rank will send ${supersegmentCounts[i]} supersegments to process $i")
-                supersegmentsSoFar += supersegmentCounts[i];
             }
 
-            supersegmentCounts[commSize-1] = totalSupersegmentsGenerated - supersegmentsSoFar
-            logger.debug("Rank: $rank will send ${supersegmentCounts[commSize-1]} supersegments to process ${commSize-1}")
-
             logger.debug("Total supersegments generated by rank $rank: $totalSupersegmentsGenerated")
 
             start = System.nanoTime()
-            distributeDenseVDIs(subVDIColorBuffer!!, subVDIDepthBuffer!!, prefixBuffer!!, supersegmentCounts, commSize, allToAllColorPointer,
-                allToAllDepthPointer, allToAllPrefixPointer, mpiPointer)
+            if(nodeAwareExchange) {
+                val invViewProjection = Matrix4f(vdiData.metadata.projection).applyVulkanCoordinateSystem()
+                    .mul(vdiData.metadata.view).invert().get(FloatArray(16))
+                distributeNodeVDIs(subVDIColorBuffer!!, subVDIDepthBuffer!!, prefixBuffer!!, totalSupersegmentsGenerated, invViewProjection,
+                    windowWidth, windowHeight, maxOutputSupersegments, commSize, mpiPointer)
+            } else if(pipelineDepth == 1) {
+                distributeDenseVDIs(subVDIColorBuffer!!, subVDIDepthBuffer!!, prefixBuffer!!, supersegmentCounts, commSize, allToAllColorPointer,
+                    allToAllDepthPointer, allToAllPrefixPointer, mpiPointer)
+            } else {
+                // the exchange copies the sub VDI, so the next one can be generated while this one is in flight
+                val handle = startDenseExchange(subVDIColorBuffer!!, subVDIDepthBuffer!!, prefixBuffer!!, supersegmentCounts, commSize,
+                    pipelineDepth, mpiPointer)
+                val generatedView = viewUsedForGeneration
+                viewUsedForGeneration = cam.spatial().getTransformation()
+                runThreshSearch = true
+                if(handle < 0) {
+                    logger.error("No free slot for the dense VDI exchange!")
+                    continue
+                }
+                pendingExchanges.addLast(handle to generatedView)
+
+                if(pendingExchanges.size < pipelineDepth) {
+                    continue
+                }
+                val (oldest, view) = pendingExchanges.removeFirst()
+                finishDenseExchange(oldest, commSize)
+                vdiData.metadata.view = view
+            }
             end = System.nanoTime() - start
 
             logger.info("Distributing VDIs took: ${end/1e9}")
+            denseExchangeTimings(exchangeTimings)
+            logger.debug("Exchange phases (s): counts ${exchangeTimings[0]}, layout ${exchangeTimings[1]}, stage ${exchangeTimings[2]}, " +
+                "post ${exchangeTimings[3]}, in flight ${exchangeTimings[4]}, wait ${exchangeTimings[5]}")
+            if(quantizeDepths) {
+                logger.debug("Largest error of the quantized depths: ${denseDepthError()}")
+            }
             logger.debug("Back in the management function")
 
             start = System.nanoTime()
@@ -1005,7 +1065,9 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
             logger.debug("Gather took: ${end/1e9}")
 
 
-            vdiData.metadata.view = viewUsedForGeneration
+            if(pipelineDepth == 1) {
+                vdiData.metadata.view = viewUsedForGeneration
+            }
             if(saveFinal && (rank == 0)) {
                 val file = FileOutputStream(File(basePath + "${dataset}vdi_${windowWidth}_${windowHeight}_${maxSupersegments}_${vo.toInt()}_dump$vdisGathered"))
                 VDIDataIO.write(vdiData, file)
@@ -1176,8 +1238,12 @@ class DistributedVolumes: SceneryBase("DistributedVolumeRenderer", windowWidth =
 //            logger.info("For distributed the color buffer isdirect: ${subVDIColorBuffer!!.isDirect()} and depthbuffer: ${subVDIDepthBuffer!!.isDirect()}")
 
             start = System.nanoTime()
-            distributeVDIs(subVDIColorBuffer!!, subVDIDepthBuffer!!, windowHeight * windowWidth * maxSupersegments * 4 / commSize, commSize, allToAllColorPointer,
-            allToAllDepthPointer, mpiPointer)
+            if(sparseTransport) {
+                distributeSparseVDIs(subVDIColorBuffer!!, subVDIDepthBuffer!!, windowWidth, windowHeight, maxSupersegments, mpiPointer)
+            } else {
+                distributeVDIs(subVDIColorBuffer!!, subVDIDepthBuffer!!, windowHeight * windowWidth * maxSupersegments * 4 / commSize, commSize, allToAllColorPointer,
+                allToAllDepthPointer, mpiPointer)
+            }
             end = System.nanoTime() - start
 
             logger.info("Distributing VDIs took: ${end/1e9}")
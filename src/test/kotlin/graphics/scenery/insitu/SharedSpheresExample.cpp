@@ -8,7 +8,7 @@
 #include <sys/types.h>
 using namespace std;
 
-#include "ShmBuffer.hpp"
+#include "ShmStreams.hpp"
 
 #define PNAME(isProp) ((isProp) ? "/home" : "/")
 
@@ -18,9 +18,19 @@ using namespace std;
 #define SIZE(i) (i ? 6*NUMPARS*sizeof(DTYPE) : 3*NUMPARS*sizeof(DTYPE))
 #define VERBOSE true
 
-ShmBuffer *buf[] = {NULL, NULL};
+ShmStreams streams(VERBOSE);
+int handles[] = {-1, -1}; // stream per field, reopened when the rank changes
 DTYPE *str[] = {NULL, NULL};
-int myRank = -1;
+jobject views[2][NKEYS]; // buffer per field and slot (global references), valid while the stream is open
+
+static void drop_views(JNIEnv *env, int i)
+{
+	for (int k = 0; k < NKEYS; ++k) {
+		if (views[i][k] != NULL)
+			env->DeleteGlobalRef(views[i][k]);
+		views[i][k] = NULL;
+	}
+}
 
 // Implementation of the native method sayHello()
 JNIEXPORT int JNICALL Java_graphics_scenery_insitu_SharedSpheresExample_sayHello(JNIEnv *env, jobject thisObj) {
@@ -38,37 +48,48 @@ JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_SharedSpheresExample_getS
 
 	int i = (int) isProp;
 
-	if (buf[i] == NULL || myRank != worldRank) {
-		myRank = worldRank;
-		if (buf[i] != NULL)
-			delete buf[i];
-		buf[i] = new ShmBuffer(PNAME(i), myRank, SIZE(i), VERBOSE); // TODO make size changeable later
+	std::shared_ptr<ShmStream> stream = streams.get(handles[i]);
+	if (!stream || stream->rank != worldRank) {
+		streams.close(handles[i]);
+		drop_views(env, i);
+		handles[i] = streams.open(PNAME(i), worldRank, SIZE(i)); // TODO make size changeable later
+		stream = streams.get(handles[i]);
 	}
 
-	buf[i]->update_key(true);
-	str[i] = (DTYPE *) buf[i]->attach();
+	std::lock_guard<std::recursive_mutex> guard(stream->lock);
+	ShmFrame frame = stream->acquire(true);
+	str[i] = (DTYPE *) frame.ptr;
 
 	if (VERBOSE)
 		std::cout<<"Hello! We are in SimData! Data read from memory:" << str[i][0] << std::endl;
 
-	jobject bb = (env)->NewDirectByteBuffer((void*) str[i], SIZE(i));
+	// slots are pinned, so each needs only one buffer; rebuild only if the slot could not be pinned
+	jobject &bb = views[i][frame.slot];
+	if (bb == NULL || env->GetDirectBufferAddress(bb) != frame.ptr) {
+		if (bb != NULL)
+			env->DeleteGlobalRef(bb);
+		jobject local = (env)->NewDirectByteBuffer((void*) str[i], SIZE(i));
+		bb = env->NewGlobalRef(local);
+		env->DeleteLocalRef(local);
+	}
 
-	return bb;
+	return env->NewLocalRef(bb);
 }
 
 JNIEXPORT void JNICALL Java_graphics_scenery_insitu_SharedSpheresExample_deleteShm (JNIEnv *env, jobject thisObj, jboolean isProp) {
-	int i = (int) isProp;
+	std::shared_ptr<ShmStream> stream = streams.get(handles[(int) isProp]);
 
-	if (buf[i] != NULL)
-		buf[i]->detach(false); // detach from old
+	if (stream) {
+		std::lock_guard<std::recursive_mutex> guard(stream->lock);
+		stream->release(); // detach from old
+	}
 }
 
 JNIEXPORT void JNICALL Java_graphics_scenery_insitu_SharedSpheresExample_terminate (JNIEnv *env, jobject thisObj) {
 	for (int i = 0; i < 2; ++i) {
-		if (buf[i] != NULL) {
-			buf[i]->detach(true); // detach from current
-			delete buf[i];
-			buf[i] = NULL;
-		}
+		streams.close(handles[i]); // detaches from current and old once the stream is deleted
+		drop_views(env, i);
+		handles[i] = -1;
+		str[i] = NULL;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+// Save as "JNIBenchmark.cpp"
+#include <jni.h>       // JNI header provided by JDK
+#include <iostream>    // C++ standard IO header
+#include "JNIBenchmark.h"  // Generated
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+// native memory wrapped by the buffers handed out, and a copy target for array regions
+char *scratch = NULL;
+size_t scratchsize = 0;
+jfloat *copybuf = NULL;
+jobject scratchbuf = NULL; // global reference, like the per-slot buffers of InSituStreams
+
+static inline long now_ns()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_scratchInit(JNIEnv *env, jobject thisObj, jlong size) {
+	scratchsize = (size_t) size;
+	scratch = (char *) malloc(scratchsize);
+	copybuf = (jfloat *) malloc(scratchsize);
+	if (scratch == NULL || copybuf == NULL) { perror("malloc"); exit(1); }
+	memset(scratch, 0, scratchsize);
+
+	jobject bb = env->NewDirectByteBuffer(scratch, (jlong) scratchsize);
+	scratchbuf = env->NewGlobalRef(bb);
+	env->DeleteLocalRef(bb);
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_scratchTerm(JNIEnv *env, jobject thisObj) {
+	if (scratchbuf != NULL)
+		env->DeleteGlobalRef(scratchbuf);
+	scratchbuf = NULL;
+	free(scratch);
+	free(copybuf);
+	scratch = NULL;
+	copybuf = NULL;
+}
+
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_nop(JNIEnv *env, jobject thisObj) {
+}
+
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_newBuffer(JNIEnv *env, jobject thisObj, jlong size) {
+	return env->NewDirectByteBuffer(scratch, size);
+}
+
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_cachedBuffer(JNIEnv *env, jobject thisObj) {
+	return env->NewLocalRef(scratchbuf);
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_bufferAddress(JNIEnv *env, jobject thisObj, jobject buffer) {
+	char *ptr = (char *) env->GetDirectBufferAddress(buffer);
+	jlong cap = env->GetDirectBufferCapacity(buffer);
+	return (jlong) (ptr + cap);
+}
+
+// the read functions touch the first and last element, so the cost is that of access, not of computation
+
+JNIEXPORT jfloat JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_readCritical(JNIEnv *env, jobject thisObj, jfloatArray arr) {
+	jsize len = env->GetArrayLength(arr);
+	jfloat *data = (jfloat *) env->GetPrimitiveArrayCritical(arr, NULL);
+	jfloat res = data[0] + data[len-1];
+	env->ReleasePrimitiveArrayCritical(arr, data, JNI_ABORT);
+	return res;
+}
+
+JNIEXPORT jfloat JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_readElements(JNIEnv *env, jobject thisObj, jfloatArray arr) {
+	jsize len = env->GetArrayLength(arr);
+	jfloat *data = env->GetFloatArrayElements(arr, NULL); // usually a copy
+	jfloat res = data[0] + data[len-1];
+	env->ReleaseFloatArrayElements(arr, data, JNI_ABORT);
+	return res;
+}
+
+JNIEXPORT jfloat JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_readRegion(JNIEnv *env, jobject thisObj, jfloatArray arr) {
+	jsize len = env->GetArrayLength(arr);
+	env->GetFloatArrayRegion(arr, 0, len, copybuf); // caller keeps len * 4 within the scratch size
+	return copybuf[0] + copybuf[len-1];
+}
+
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_lookupMethod(JNIEnv *env, jobject thisObj, jobject listener) {
+	jclass cls = env->GetObjectClass(listener);
+	jmethodID id = env->GetMethodID(cls, "onFrame", "(IJ)V");
+	env->DeleteLocalRef(cls);
+	return (jlong) id;
+}
+
+// call listener.onFrame once per element of latencies, at most once every interval ns, recording each call's duration
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_dispatch(JNIEnv *env, jobject thisObj, jobject listener, jboolean cached, jlong interval, jlongArray latencies) {
+	jsize n = env->GetArrayLength(latencies);
+	vector<jlong> times(n);
+
+	jclass cls = env->GetObjectClass(listener);
+	jmethodID id = env->GetMethodID(cls, "onFrame", "(IJ)V");
+
+	long next = now_ns();
+	for (jsize i = 0; i < n; ++i) {
+		while (now_ns() < next); // spin, sleeping is far coarser than the intervals measured
+		long start = now_ns();
+		if (!cached)
+			id = env->GetMethodID(cls, "onFrame", "(IJ)V");
+		env->CallVoidMethod(listener, id, (jint) i, (jlong) start);
+		times[i] = now_ns() - start;
+		next = start + interval;
+	}
+	env->DeleteLocalRef(cls);
+
+	env->SetLongArrayRegion(latencies, 0, n, &times[0]);
+}
@@ -0,0 +1,101 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class JNIBenchmark */
+
+#ifndef _Included_JNIBenchmark
+#define _Included_JNIBenchmark
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     JNIBenchmark
+ * Method:    scratchInit
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_scratchInit
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    scratchTerm
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_scratchTerm
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    nop
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_nop
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    newBuffer
+ * Signature: (J)Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_newBuffer
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    cachedBuffer
+ * Signature: ()Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_cachedBuffer
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    bufferAddress
+ * Signature: (Ljava/nio/ByteBuffer;)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_bufferAddress
+  (JNIEnv *, jobject, jobject);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    readCritical
+ * Signature: ([F)F
+ */
+JNIEXPORT jfloat JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_readCritical
+  (JNIEnv *, jobject, jfloatArray);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    readElements
+ * Signature: ([F)F
+ */
+JNIEXPORT jfloat JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_readElements
+  (JNIEnv *, jobject, jfloatArray);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    readRegion
+ * Signature: ([F)F
+ */
+JNIEXPORT jfloat JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_readRegion
+  (JNIEnv *, jobject, jfloatArray);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    lookupMethod
+ * Signature: (Lgraphics/scenery/insitu/FrameListener;)J
+ */
+JNIEXPORT jlong JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_lookupMethod
+  (JNIEnv *, jobject, jobject);
+
+/*
+ * Class:     JNIBenchmark
+ * Method:    dispatch
+ * Signature: (Lgraphics/scenery/insitu/FrameListener;ZJ[J)V
+ */
+JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_JNIBenchmark_dispatch
+  (JNIEnv *, jobject, jobject, jboolean, jlong, jlongArray);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,97 @@
+package graphics.scenery.insitu.benchmark
+
+import graphics.scenery.insitu.FrameListener
+import org.junit.Test
+import java.nio.ByteBuffer
+
+/**
+ * Measures the cost of each JNI mechanism the in situ bridges use on the frame path, across payload
+ * sizes and call rates, and prints latency percentiles in ns. Needs no producer; the natives are in
+ * JNIBenchmark.cpp, linked into libtestConsumer together with TestConsumer.cpp.
+ *
+ * Calls are timed one by one and paced by spinning, since a call issued right after the previous one
+ * finds caches and branch predictors warm, while a call per frame usually does not.
+ */
+class JNIBenchmark {
+
+    val minsize = 1024L
+    val sizelen = 8 // 1 KiB to 16 MiB in steps of 4
+    val iters = 5000
+    val warmup = 1000
+    val intervals = longArrayOf(0L, 1000L, 10000L, 100000L) // ns between the starts of consecutive calls
+
+    var sink = 0L // consumes results, so calls are not optimized away
+
+    external fun scratchInit(size: Long)
+    external fun scratchTerm()
+
+    external fun nop()
+    external fun newBuffer(size: Long): ByteBuffer
+    external fun cachedBuffer(): ByteBuffer
+    external fun bufferAddress(buffer: ByteBuffer): Long
+    external fun readCritical(array: FloatArray): Float
+    external fun readElements(array: FloatArray): Float
+    external fun readRegion(array: FloatArray): Float
+    external fun lookupMethod(listener: FrameListener): Long
+    external fun dispatch(listener: FrameListener, cached: Boolean, interval: Long, latencies: LongArray)
+
+    @Test
+    fun main() {
+        // load dynamic library
+        System.loadLibrary("testConsumer")
+
+        val maxsize = minsize shl (2 * (sizelen - 1))
+        scratchInit(maxsize)
+        val buffer = cachedBuffer()
+        val listener = FrameListener { handle, frame -> sink += handle + frame }
+
+        println("mechanism\tbytes\tinterval\tp50\tp90\tp99\tmax")
+        for (interval in intervals) {
+            measure("nop", 0, interval) { nop() }
+            measure("cachedBuffer", 0, interval) { sink += cachedBuffer().capacity() }
+            measure("bufferAddress", 0, interval) { sink += bufferAddress(buffer) }
+            measure("lookupMethod", 0, interval) { sink += lookupMethod(listener) }
+
+            // callbacks are timed natively, from before the call until it returns
+            for (cached in listOf(true, false)) {
+                val latencies = LongArray(iters)
+                dispatch(listener, cached, interval, LongArray(warmup))
+                dispatch(listener, cached, interval, latencies)
+                report(if (cached) "callback" else "callbackLookup", 0, interval, latencies)
+            }
+
+            var size = minsize
+            for (i in 1..sizelen) {
+                val array = FloatArray((size / 4).toInt())
+                measure("newBuffer", size, interval) { sink += newBuffer(size).capacity() }
+                measure("readCritical", size, interval) { sink += readCritical(array).toLong() }
+                measure("readElements", size, interval) { sink += readElements(array).toLong() }
+                measure("readRegion", size, interval) { sink += readRegion(array).toLong() }
+                size = size shl 2
+            }
+        }
+
+        scratchTerm()
+        println("sink: $sink")
+    }
+
+    private inline fun measure(name: String, size: Long, interval: Long, call: () -> Unit) {
+        val latencies = LongArray(iters)
+        for (i in 0 until warmup + iters) {
+            val start = System.nanoTime()
+            call()
+            val end = System.nanoTime()
+            if (i >= warmup) {
+                latencies[i - warmup] = end - start
+            }
+            while (System.nanoTime() - start < interval);
+        }
+        report(name, size, interval, latencies)
+    }
+
+    private fun report(name: String, size: Long, interval: Long, latencies: LongArray) {
+        latencies.sort()
+        fun percentile(p: Double) = latencies[minOf(latencies.size - 1, (p * latencies.size).toInt())]
+        println("$name\t$size\t$interval\t${percentile(0.5)}\t${percentile(0.9)}\t${percentile(0.99)}\t${latencies.last()}")
+    }
+}
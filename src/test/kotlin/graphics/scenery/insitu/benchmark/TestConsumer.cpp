@@ -54,6 +54,8 @@ using namespace std;
 
 int shmid;
 DTYPE *str;
+size_t strsize;
+jobject strbuf = NULL; // global reference to the buffer wrapping str, returned again while attached
 
 struct timespec start;
 
@@ -72,6 +74,14 @@ JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_TestConsumer_semSi
 JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_benchmark_TestConsumer_sysvInit(JNIEnv *env, jobject thisObj, jlong size) {
 	size_t x = (size_t) size;
 
+	if (strbuf != NULL && strsize == x) // still attached with the same size, reuse the buffer
+		return env->NewLocalRef(strbuf);
+	if (strbuf != NULL) { // size changed, drop the old attachment
+		shmdt(str);
+		env->DeleteGlobalRef(strbuf);
+		strbuf = NULL;
+	}
+
 	printf("creating shared memory with size %lu\n", x);
 
 	key_t key = ftok("/tmp", RANK);
@@ -85,12 +95,17 @@ JNIEXPORT jobject JNICALL Java_graphics_scenery_insitu_benchmark_TestConsumer_sy
 	std::cout << "created shared memory with size " << ((jlong) x) << std::endl;
 
 	jobject bb = (env)->NewDirectByteBuffer((void*) str, x);
+	strbuf = env->NewGlobalRef(bb);
+	strsize = x;
 
 	return bb;
 }
 
 JNIEXPORT void JNICALL Java_graphics_scenery_insitu_benchmark_TestConsumer_sysvTerm(JNIEnv *env, jobject thisObj) {
     shmdt(str);
+    if (strbuf != NULL)
+        env->DeleteGlobalRef(strbuf);
+    strbuf = NULL;
 }
 
 /*